@@ -0,0 +1,144 @@
+/**
+ ** Benchmark of ckalloc/ckfree with a mix of block sizes and
+ ** lifetimes like that of the simulation, and of growing a list
+ ** one element at a time by fixed blocks and by doubling
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "listalloc.h"
+#include "random.h"
+
+#include "benchutils.h"
+
+#define	ALLOC_N_LIVE		256
+#define	ALLOC_OPS			20000
+
+/** appended one at a time; the fixed block is that used before */
+#define	GROWTH_N_ELEMENTS	20000
+#define	GROWTH_BLOCK_SIZE	16
+
+typedef struct allocData {
+	void *ad_live[ALLOC_N_LIVE];
+	int ad_size[ALLOC_OPS];
+	int ad_slot[ALLOC_OPS];
+} allocData;
+
+/**
+ * replace a block in the live set at each op, so blocks are
+ * freed in a different order than they were allocated
+ */
+static void
+sAllocFree(void *data)
+{
+	allocData *ad = (allocData *) data;
+	int slot;
+	int i;
+
+	for (i = 0; i < ALLOC_OPS; i++)
+	{
+		slot = ad->ad_slot[i];
+		if (ad->ad_live[slot] != NULL)
+			ckfree(ad->ad_live[slot]);
+		ad->ad_live[slot] = ckalloc(ad->ad_size[i]);
+	}
+}
+
+/** the list grows by GROWTH_BLOCK_SIZE elements at a time */
+static void
+sGrowFixedBlock(void *data)
+{
+	int *list = NULL;
+	int nBlocks = 0;
+	int i;
+
+	for (i = 0; i < GROWTH_N_ELEMENTS; i++)
+	{
+		listMkCheckSize(i + 1, (void **) &list, &nBlocks,
+				GROWTH_BLOCK_SIZE, sizeof(int), __FILE__, __LINE__);
+		list[i] = i;
+	}
+	ckfree(list);
+}
+
+/** the list doubles whenever it is full */
+static void
+sGrowDoubling(void *data)
+{
+	int *list = NULL;
+	int nAllocated = 0;
+	int i;
+
+	for (i = 0; i < GROWTH_N_ELEMENTS; i++)
+	{
+		growArrayReserve(i + 1, (void **) &list, &nAllocated, sizeof(int));
+		list[i] = i;
+	}
+	ckfree(list);
+}
+
+/**
+ * time a list growth kernel, then run it once more to count
+ * the reallocations and copying it does
+ */
+static void
+sRunGrowth(const char *name, benchFunction function)
+{
+	ListGrowthStats stats;
+
+	if ( ! benchRun(name, GROWTH_N_ELEMENTS, function, NULL) )
+		return;
+
+	listResetGrowthStats();
+	(*function)(NULL);
+	listGetGrowthStats(&stats);
+
+	benchCount("allocations", stats.lg_nAllocations);
+	benchCount("copies", stats.lg_nCopies);
+	benchCount("bytes_copied", stats.lg_nBytesCopied);
+}
+
+int
+benchAlloc()
+{
+	allocData *ad;
+	int i;
+
+	sRunGrowth("growth/fixed-block", sGrowFixedBlock);
+	sRunGrowth("growth/doubling", sGrowDoubling);
+
+	if ( ! benchIsSelected("ckalloc") )
+		return 1;
+
+	ad = (allocData *) ckalloc(sizeof(allocData));
+	memset(ad, 0, sizeof(allocData));
+
+	/** mostly small blocks, with the odd buffer sized one */
+	seedLocalRandom((int) benchGetSeed());
+	for (i = 0; i < ALLOC_OPS; i++)
+	{
+		if (intRangeRandom(16) == 0)
+			ad->ad_size[i] = 4096 + intRangeRandom(16384);
+		else
+			ad->ad_size[i] = 8 + intRangeRandom(256);
+		ad->ad_slot[i] = intRangeRandom(ALLOC_N_LIVE);
+	}
+
+	benchRun("ckalloc/ckfree", ALLOC_OPS, sAllocFree, ad);
+
+	for (i = 0; i < ALLOC_N_LIVE; i++)
+	{
+		if (ad->ad_live[i] != NULL)
+			ckfree(ad->ad_live[i]);
+	}
+	ckfree(ad);
+	return 1;
+}
@@ -0,0 +1,124 @@
+/**
+ ** Benchmarks of the FFT routines in fft.c, at the sizes used
+ ** when calculating MFAPs
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+# include <math.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "filtertools.h"
+#include "random.h"
+
+#include "benchutils.h"
+
+/** MUP_LENGTH * 2, the length convolved for each MFAP */
+#define	FFT_LENGTH			4096
+#define	FFT_SMALL_LENGTH	1024
+#define	FFT_OPS				50
+
+typedef struct fftData {
+	int fd_n;
+	double *fd_source;
+	double *fd_work;
+	double *fd_weight;
+	double *fd_current;
+	double *fd_fft;
+	double *fd_result;
+} fftData;
+
+static void
+sRealFFT(void *data)
+{
+	fftData *fd = (fftData *) data;
+	int i;
+
+	/** realft works in place, so each op starts from a fresh copy */
+	for (i = 0; i < FFT_OPS; i++)
+	{
+		memcpy(fd->fd_work, fd->fd_source, sizeof(double) * (fd->fd_n + 1));
+		realft(fd->fd_work, fd->fd_n / 2, 1);
+	}
+}
+
+static void
+sConvolve(void *data)
+{
+	fftData *fd = (fftData *) data;
+	int i;
+
+	for (i = 0; i < FFT_OPS; i++)
+	{
+		convolve(fd->fd_fft,
+				fd->fd_weight, fd->fd_n,
+				fd->fd_current, fd->fd_n,
+				1, fd->fd_result, 0.032);
+	}
+}
+
+/**
+ * fill the buffers with a weighting and current function of
+ * the shape convolved for a single fibre
+ */
+static void
+sCreateData(fftData *fd, int n)
+{
+	double z, zInc = 0.1;
+	int i;
+
+	memset(fd, 0, sizeof(fftData));
+	fd->fd_n = n;
+	fd->fd_source = (double *) ckalloc(sizeof(double) * (2 * n + 2));
+	fd->fd_work = (double *) ckalloc(sizeof(double) * (2 * n + 2));
+	fd->fd_weight = (double *) ckalloc(sizeof(double) * (2 * n + 2));
+	fd->fd_current = (double *) ckalloc(sizeof(double) * (2 * n + 2));
+	fd->fd_fft = (double *) ckalloc(sizeof(double) * (2 * n + 2));
+	fd->fd_result = (double *) ckalloc(sizeof(double) * (2 * n + 2));
+
+	seedLocalRandom((int) benchGetSeed());
+	fd->fd_source[0] = fd->fd_weight[0] = fd->fd_current[0] = 0;
+	z = 0;
+	for (i = 1; i <= n; i++)
+	{
+		fd->fd_source[i] = gauss01();
+		fd->fd_weight[i] = 1.0 / sqrt(0.5 + (z - 20.0) * (z - 20.0));
+		fd->fd_current[i] = -z * (1.5 - 3.0 * z + z * z) * exp(-2.0 * z);
+		z += zInc;
+	}
+}
+
+static void
+sDeleteData(fftData *fd)
+{
+	ckfree(fd->fd_source);
+	ckfree(fd->fd_work);
+	ckfree(fd->fd_weight);
+	ckfree(fd->fd_current);
+	ckfree(fd->fd_fft);
+	ckfree(fd->fd_result);
+}
+
+int
+benchFFT()
+{
+	fftData fd;
+
+	sCreateData(&fd, FFT_SMALL_LENGTH);
+	benchRun("realft 1024", FFT_OPS, sRealFFT, &fd);
+	benchRun("convolve 1024", FFT_OPS, sConvolve, &fd);
+	sDeleteData(&fd);
+
+	sCreateData(&fd, FFT_LENGTH);
+	benchRun("realft 4096", FFT_OPS, sRealFFT, &fd);
+	benchRun("convolve 4096", FFT_OPS, sConvolve, &fd);
+	sDeleteData(&fd);
+
+	return 1;
+}
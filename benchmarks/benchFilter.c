@@ -0,0 +1,121 @@
+/**
+ ** Benchmarks of the time domain filtering and convolution
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "filtertools.h"
+#include "random.h"
+
+#include "benchutils.h"
+
+/** one second of EMG at the simulation sampling rate */
+#define	FILTER_SAMPLING_RATE	31250.0
+#define	FILTER_LENGTH			31250
+#define	FILTER_OPS				4
+
+#define	DIRECT_LENGTH			512
+#define	DIRECT_OPS				4
+
+typedef struct filterData {
+	double *fd_x;
+	double *fd_y;
+	double *fd_a;
+	double *fd_b;
+	int fd_nA;
+	int fd_nB;
+} filterData;
+
+typedef struct directData {
+	double *dd_weight;
+	double *dd_current;
+	double *dd_result;
+} directData;
+
+static void
+sFiltfilt(void *data)
+{
+	filterData *fd = (filterData *) data;
+	int i;
+
+	for (i = 0; i < FILTER_OPS; i++)
+	{
+		filtfilt(fd->fd_y, fd->fd_x, FILTER_LENGTH,
+				fd->fd_b, fd->fd_nB, fd->fd_a, fd->fd_nA);
+	}
+}
+
+static void
+sDirectConvolve(void *data)
+{
+	directData *dd = (directData *) data;
+	int i;
+
+	for (i = 0; i < DIRECT_OPS; i++)
+	{
+		directConvolve(dd->dd_weight, DIRECT_LENGTH,
+				dd->dd_current, DIRECT_LENGTH,
+				dd->dd_result, 0.1f);
+	}
+}
+
+int
+benchFilter()
+{
+	filterData fd;
+	directData dd;
+	int i;
+
+	if (benchIsSelected("filtfilt"))
+	{
+		memset(&fd, 0, sizeof(fd));
+		if (getABParams(&fd.fd_b, &fd.fd_nB, &fd.fd_a, &fd.fd_nA,
+					FILTAB_O8_31250_10_10000HZ, FILTER_SAMPLING_RATE) <= 0)
+			return 0;
+
+		fd.fd_x = (double *) ckalloc(sizeof(double) * (FILTER_LENGTH + 1));
+		fd.fd_y = (double *) ckalloc(sizeof(double) * (FILTER_LENGTH + 1));
+		memset(fd.fd_y, 0, sizeof(double) * (FILTER_LENGTH + 1));
+
+		seedLocalRandom((int) benchGetSeed());
+		fd.fd_x[0] = 0;
+		for (i = 1; i <= FILTER_LENGTH; i++)
+			fd.fd_x[i] = gauss01();
+
+		benchRun("filtfilt 31250", FILTER_OPS, sFiltfilt, &fd);
+
+		ckfree(fd.fd_x);
+		ckfree(fd.fd_y);
+	}
+
+	if (benchIsSelected("directConvolve"))
+	{
+		dd.dd_weight = (double *) ckalloc(sizeof(double) * DIRECT_LENGTH);
+		dd.dd_current = (double *) ckalloc(sizeof(double) * DIRECT_LENGTH);
+		dd.dd_result = (double *)
+				ckalloc(sizeof(double) * (2 * DIRECT_LENGTH - 1));
+
+		seedLocalRandom((int) benchGetSeed());
+		for (i = 0; i < DIRECT_LENGTH; i++)
+		{
+			dd.dd_weight[i] = gauss01();
+			dd.dd_current[i] = gauss01();
+		}
+
+		benchRun("directConvolve 512", DIRECT_OPS, sDirectConvolve, &dd);
+
+		ckfree(dd.dd_weight);
+		ckfree(dd.dd_current);
+		ckfree(dd.dd_result);
+	}
+
+	return 1;
+}
@@ -0,0 +1,112 @@
+/**
+ ** Benchmarks of reading an EMG sized file of floats through
+ ** io_utils, a value at a time and in bulk
+ **
+ ** The file is read back from the page cache, so these measure
+ ** the library overhead rather than the disk.
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "io_utils.h"
+#include "filetools.h"
+#include "random.h"
+
+#include "benchutils.h"
+
+/** about 30 seconds of EMG at 31250 Hz */
+#define	IO_N_FLOATS		(1024 * 1024)
+#define	IO_CHUNK		(16 * 1024)
+
+typedef struct ioData {
+	char *id_filename;
+	float *id_buffer;
+	double id_sum;
+} ioData;
+
+static void
+sReadFloats(void *data)
+{
+	ioData *id = (ioData *) data;
+	float value;
+	FP *fp;
+	int i;
+
+	fp = openFP(id->id_filename, "rb");
+	if (fp == NULL)
+		return;
+	for (i = 0; i < IO_N_FLOATS; i++)
+	{
+		if ( ! rFloat(fp, &value) )
+			break;
+		id->id_sum += value;
+	}
+	closeFP(fp);
+}
+
+static void
+sReadBulk(void *data)
+{
+	ioData *id = (ioData *) data;
+	FP *fp;
+	int i;
+
+	fp = openFP(id->id_filename, "rb");
+	if (fp == NULL)
+		return;
+	for (i = 0; i < IO_N_FLOATS; i += IO_CHUNK)
+	{
+		if ( ! rGeneric(fp, id->id_buffer, IO_CHUNK * sizeof(float)) )
+			break;
+		id->id_sum += id->id_buffer[0];
+	}
+	closeFP(fp);
+}
+
+int
+benchIO()
+{
+	ioData id;
+	FP *fp;
+	int status = 1;
+	int i;
+
+	if ( ! benchIsSelected("io_utils") )
+		return 1;
+
+	memset(&id, 0, sizeof(id));
+	id.id_filename = allocTempFileName("bench");
+	if (id.id_filename == NULL)
+		return 0;
+
+	fp = openFP(id.id_filename, "wb");
+	if (fp == NULL)
+	{
+		ckfree(id.id_filename);
+		return 0;
+	}
+	seedLocalRandom((int) benchGetSeed());
+	for (i = 0; i < IO_N_FLOATS && status; i++)
+		status = wFloat(fp, (float) gauss01());
+	closeFP(fp);
+
+	if (status)
+	{
+		id.id_buffer = (float *) ckalloc(IO_CHUNK * sizeof(float));
+		benchRun("io_utils rFloat", IO_N_FLOATS, sReadFloats, &id);
+		benchRun("io_utils rGeneric", IO_N_FLOATS, sReadBulk, &id);
+		ckfree(id.id_buffer);
+	}
+
+	remove(id.id_filename);
+	ckfree(id.id_filename);
+	return status;
+}
@@ -0,0 +1,92 @@
+/**
+ ** Benchmarks of the cost to the caller of a log message: one
+ ** filtered out by its level, a rate limited progress message,
+ ** and one written directly or queued for the writer thread.
+ ** Written messages go to /dev/null.
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+#include "log.h"
+
+#include "benchutils.h"
+
+#define	LOG_OPS				1000
+
+static void
+sSink(void *userData, int loglevel, char *buffer, int size)
+{
+	int fd = *(int *) userData;
+
+	if (write(fd, buffer, size) != size)
+		return;
+}
+
+static void
+sLogLines(void *data)
+{
+	int i;
+
+	for (i = 0; i < LOG_OPS; i++)
+		LogInfo("            Fibre %d of %d (%.2f)%%\n",
+				i, LOG_OPS, (100.0 * i) / LOG_OPS);
+}
+
+static void
+sLogProgress(void *data)
+{
+	int i;
+
+	for (i = 0; i < LOG_OPS; i++)
+		LOG_PROGRESS(LogInfo("            Fibre %d of %d (%.2f)%%\n",
+				i, LOG_OPS, (100.0 * i) / LOG_OPS));
+}
+
+/**
+ * the lines left queued by the previous iteration are flushed
+ * first, so the ring never overflows
+ */
+static void
+sLogQueued(void *data)
+{
+	LogFlush();
+	sLogLines(data);
+}
+
+int
+benchLog()
+{
+	int fd;
+
+	if ( ! benchIsSelected("log") )
+		return 1;
+
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0)
+		return 0;
+
+	LogOpen("benchmark", LOGDEST_FUNCTION | LOGDEST_NO_ID, NULL);
+	LogFunction(sSink, &fd);
+
+	LogSetLevel(LOG_NOTICE);
+	benchRun("log/suppressed", LOG_OPS, sLogLines, NULL);
+	LogSetLevel(LOG_DEBUG);
+
+	benchRun("log/progress", LOG_OPS, sLogProgress, NULL);
+	benchRun("log/direct", LOG_OPS, sLogLines, NULL);
+
+	if (LogStartWriter())
+		benchRun("log/queued", LOG_OPS, sLogQueued, NULL);
+
+	LogClose();
+	close(fd);
+	return 1;
+}
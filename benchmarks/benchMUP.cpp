@@ -0,0 +1,89 @@
+/**
+ ** Benchmark of building jittered MUPs from their MFAPs, as is
+ ** done for every firing when the EMG is generated
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+# include <math.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "random.h"
+
+#include "MUP.h"
+#include "SimulatorConstants.h"
+
+#include "benchutils.h"
+
+/** fibres of an MU within the uptake area of the needle */
+#define	MUP_N_FIBRES			40
+#define	MUP_OPS					100
+
+/** the default 25us jitter, in EMG samples */
+#define	MUP_JITTER_VARIANCE		((25.0 / 1000.0) / DELTA_T_EMG)
+
+static void
+sCalcJitteredMUP(void *data)
+{
+	MUP *mup = (MUP *) data;
+	int i;
+
+	for (i = 0; i < MUP_OPS; i++)
+		mup->calcJitteredMUP(0, 1, (float) MUP_JITTER_VARIANCE);
+}
+
+/**
+ * a biphasic MFAP arriving at the given sample; near fibres
+ * are sharp enough to be jittered on their own, far ones are
+ * merged into the far-field MFAP
+ */
+static void
+sCreateMFAP(generatedElement *data, int length, double arrival, double width)
+{
+	double t;
+	int i;
+
+	for (i = 0; i < length; i++)
+	{
+		t = (i - arrival) / width;
+		data[i] = -t * exp(-t * t) * (10.0 / width);
+	}
+}
+
+int
+benchMUP()
+{
+	generatedElement *mfap;
+	MUP *mup;
+	int i;
+
+	if ( ! benchIsSelected("MUP::calcJitteredMUP") )
+		return 1;
+
+	mfap = (generatedElement *)
+			ckalloc(sizeof(generatedElement) * MUP_LENGTH);
+
+	seedLocalRandom((int) benchGetSeed());
+	mup = new MUP(".", 1);
+	for (i = 0; i < MUP_N_FIBRES; i++)
+	{
+		sCreateMFAP(mfap, MUP_LENGTH,
+				(MUP_LENGTH / 2) + 40.0 * gauss01(),
+				1.0 + 8.0 * floatNormalizedRandom());
+		mup->addMFP(0, MUP_LENGTH, mfap, i);
+	}
+	sCreateMFAP(mfap, MUP_LENGTH, MUP_LENGTH / 2, 30.0);
+	mup->addCannulaMFP(0, MUP_LENGTH, mfap);
+
+	benchRun("MUP::calcJitteredMUP", MUP_OPS, sCalcJitteredMUP, mup);
+
+	delete mup;
+	ckfree(mfap);
+	return 1;
+}
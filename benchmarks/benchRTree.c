@@ -0,0 +1,115 @@
+/**
+ ** Benchmarks of the R-tree fibre index, on a fibre-like layout
+ ** of unit squares on a jittered grid
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "random.h"
+#include "rTreeIndex.h"
+
+#include "benchutils.h"
+
+#define	RTREE_N_RECTS		20000
+#define	RTREE_N_QUERIES		2000
+
+typedef struct rtreeData {
+	struct Rect *rd_rect;
+	struct Rect *rd_query;
+	struct Node *rd_root;
+	long rd_nHits;
+} rtreeData;
+
+static int
+sCountHit(long id, void *arg)
+{
+	(*((long *) arg))++;
+	return 1;
+}
+
+static void
+sInsert(void *data)
+{
+	rtreeData *rd = (rtreeData *) data;
+	struct Node *root;
+	int i;
+
+	root = RTreeNewIndex();
+	for (i = 0; i < RTREE_N_RECTS; i++)
+		RTreeInsertRect(&rd->rd_rect[i], i + 1, &root, 0);
+	RTreeDeleteIndex(root);
+}
+
+static void
+sSearch(void *data)
+{
+	rtreeData *rd = (rtreeData *) data;
+	int i;
+
+	for (i = 0; i < RTREE_N_QUERIES; i++)
+		RTreeSearch(rd->rd_root, &rd->rd_query[i], sCountHit, &rd->rd_nHits);
+}
+
+int
+benchRTree()
+{
+	rtreeData rd;
+	float x, y, w, extent;
+	int side = 1;
+	int i;
+
+	if ( ! benchIsSelected("RTree") )
+		return 1;
+
+	memset(&rd, 0, sizeof(rd));
+	rd.rd_rect = (struct Rect *) ckalloc(sizeof(struct Rect) * RTREE_N_RECTS);
+	rd.rd_query = (struct Rect *)
+			ckalloc(sizeof(struct Rect) * RTREE_N_QUERIES);
+
+	while (side * side < RTREE_N_RECTS)
+		side++;
+	extent = (float) side * 2;
+
+	seedLocalRandom((int) benchGetSeed());
+	for (i = 0; i < RTREE_N_RECTS; i++)
+	{
+		x = (float) (i % side) * 2 + floatNormalizedRandom();
+		y = (float) (i / side) * 2 + floatNormalizedRandom();
+		rd.rd_rect[i].boundary[0] = x - 0.5f;
+		rd.rd_rect[i].boundary[1] = y - 0.5f;
+		rd.rd_rect[i].boundary[2] = x + 0.5f;
+		rd.rd_rect[i].boundary[3] = y + 0.5f;
+	}
+
+	/** needle sized queries */
+	for (i = 0; i < RTREE_N_QUERIES; i++)
+	{
+		x = floatNormalizedRandom() * extent;
+		y = floatNormalizedRandom() * extent;
+		w = 5 + floatNormalizedRandom() * 10;
+		rd.rd_query[i].boundary[0] = x - w;
+		rd.rd_query[i].boundary[1] = y - w;
+		rd.rd_query[i].boundary[2] = x + w;
+		rd.rd_query[i].boundary[3] = y + w;
+	}
+
+	benchRun("RTreeInsertRect", RTREE_N_RECTS, sInsert, &rd);
+
+	rd.rd_root = RTreeNewIndex();
+	for (i = 0; i < RTREE_N_RECTS; i++)
+		RTreeInsertRect(&rd.rd_rect[i], i + 1, &rd.rd_root, 0);
+	benchRun("RTreeSearch", RTREE_N_QUERIES, sSearch, &rd);
+	RTreeDeleteIndex(rd.rd_root);
+
+	ckfree(rd.rd_rect);
+	ckfree(rd.rd_query);
+	return 1;
+}
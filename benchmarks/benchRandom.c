@@ -0,0 +1,57 @@
+/**
+ ** Benchmarks of the gaussian deviate generators used for
+ ** jitter and noise
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+#endif
+
+#include "random.h"
+
+#include "benchutils.h"
+
+#define	RANDOM_OPS		100000
+
+typedef struct randomData {
+	randomStream rd_stream;
+	double rd_sum;
+} randomData;
+
+static void
+sGauss01(void *data)
+{
+	randomData *rd = (randomData *) data;
+	int i;
+
+	for (i = 0; i < RANDOM_OPS; i++)
+		rd->rd_sum += gauss01();
+}
+
+static void
+sStreamGauss01(void *data)
+{
+	randomData *rd = (randomData *) data;
+	int i;
+
+	for (i = 0; i < RANDOM_OPS; i++)
+		rd->rd_sum += randomStreamGauss01(&rd->rd_stream);
+}
+
+int
+benchRandom()
+{
+	randomData rd;
+
+	rd.rd_sum = 0;
+	seedRandomStream(&rd.rd_stream, benchGetSeed());
+
+	benchRun("gauss01", RANDOM_OPS, sGauss01, &rd);
+	benchRun("randomStreamGauss01", RANDOM_OPS, sStreamGauss01, &rd);
+
+	return 1;
+}
@@ -0,0 +1,82 @@
+/**
+ ** Benchmark of the cubic spline interpolation used to expand
+ ** MFAPs for jitter
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+# include <math.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "NRinterpolate.h"
+#include "random.h"
+
+#include "benchutils.h"
+
+/** an MFAP, expanded as MUP.cpp does */
+#define	SPLINE_LENGTH			2048
+#define	SPLINE_EXPANSION		10
+#define	SPLINE_CTRL_POINTS		4
+
+typedef struct splineData {
+	double *sd_source;
+	float *sd_result;
+} splineData;
+
+static void
+sSpline(void *data)
+{
+	splineData *sd = (splineData *) data;
+	int i;
+
+	for (i = SPLINE_CTRL_POINTS + 1;
+			i < SPLINE_LENGTH - SPLINE_CTRL_POINTS; i++)
+	{
+		cubicSplineInterpolation(
+				sd->sd_result,
+				sd->sd_source,
+				SPLINE_LENGTH,
+				SPLINE_EXPANSION,
+				SPLINE_CTRL_POINTS,
+				1.0,
+				i
+			);
+	}
+}
+
+int
+benchSpline()
+{
+	splineData sd;
+	int i;
+
+	if ( ! benchIsSelected("cubicSplineInterpolation") )
+		return 1;
+
+	sd.sd_source = (double *) ckalloc(sizeof(double) * SPLINE_LENGTH);
+	sd.sd_result = (float *)
+			ckalloc(sizeof(float) * (SPLINE_LENGTH + 1) * SPLINE_EXPANSION);
+	memset(sd.sd_result, 0,
+			sizeof(float) * (SPLINE_LENGTH + 1) * SPLINE_EXPANSION);
+
+	/** a noisy biphasic wave, so the spline has turns to follow */
+	seedLocalRandom((int) benchGetSeed());
+	for (i = 0; i < SPLINE_LENGTH; i++)
+	{
+		sd.sd_source[i] = sin(i * 0.05) * exp(-i * 0.002)
+				+ 0.01 * gauss01();
+	}
+
+	benchRun("cubicSplineInterpolation",
+			SPLINE_LENGTH - (2 * SPLINE_CTRL_POINTS) - 1, sSpline, &sd);
+
+	ckfree(sd.sd_source);
+	ckfree(sd.sd_result);
+	return 1;
+}
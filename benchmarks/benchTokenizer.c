@@ -0,0 +1,111 @@
+/**
+ ** Benchmarks of the file tokenizer on a parameter file sized
+ ** text file of identifiers, reals and quoted strings: read from
+ ** the file itself, where it is scanned in place, and through a
+ ** pipe, where it is read a character at a time.
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "tokens.h"
+#include "filetools.h"
+#include "random.h"
+
+#include "benchutils.h"
+
+#define	TKN_N_LINES			20000
+#define	TKN_TOKENS_PER_LINE	5
+
+typedef struct tknData {
+	char *td_filename;
+	char *td_command;
+	double td_sum;
+} tknData;
+
+static void
+sTokenize(tknData *td, FILE *fp)
+{
+	tokenizer *t;
+	token *tok;
+
+	t = tknGetFileTokenizer(fp);
+	while ((tok = tknGetToken(t)) != NULL)
+	{
+		if (tok->type_ == TT_REAL)
+			td->td_sum += tok->data_.dval_;
+	}
+	tknDeleteTokenizer(t);
+}
+
+static void
+sTokenizeFile(void *data)
+{
+	tknData *td = (tknData *) data;
+	FILE *fp;
+
+	if ((fp = fopen(td->td_filename, "r")) == NULL)
+		return;
+	sTokenize(td, fp);
+	fclose(fp);
+}
+
+static void
+sTokenizePipe(void *data)
+{
+	tknData *td = (tknData *) data;
+	FILE *fp;
+
+	if ((fp = popen(td->td_command, "r")) == NULL)
+		return;
+	sTokenize(td, fp);
+	pclose(fp);
+}
+
+int
+benchTokenizer()
+{
+	tknData td;
+	FILE *fp;
+	int i;
+
+	if ( ! benchIsSelected("tokenizer") )
+		return 1;
+
+	memset(&td, 0, sizeof(td));
+	td.td_filename = allocTempFileName("bench");
+	if (td.td_filename == NULL)
+		return 0;
+
+	fp = fopen(td.td_filename, "w");
+	if (fp == NULL)
+	{
+		ckfree(td.td_filename);
+		return 0;
+	}
+	seedLocalRandom((int) benchGetSeed());
+	for (i = 0; i < TKN_N_LINES; i++)
+		fprintf(fp, "muscle_fibre_%d = %.6f %.9e \"MU %d\" # fibre %d\n",
+				i, gauss01(), gauss01() * 1e-3, i % 100, i);
+	fclose(fp);
+
+	td.td_command = (char *) ckalloc(strlen(td.td_filename) + 8);
+	sprintf(td.td_command, "cat '%s'", td.td_filename);
+
+	benchRun("tokenizer file", TKN_N_LINES * TKN_TOKENS_PER_LINE,
+			sTokenizeFile, &td);
+	benchRun("tokenizer pipe", TKN_N_LINES * TKN_TOKENS_PER_LINE,
+			sTokenizePipe, &td);
+
+	remove(td.td_filename);
+	ckfree(td.td_command);
+	ckfree(td.td_filename);
+	return 1;
+}
@@ -0,0 +1,266 @@
+/**
+ ** Harness for the numerical kernel micro-benchmarks
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "listalloc.h"
+#include "stagestats.h"
+#include "random.h"
+
+#include "benchutils.h"
+
+#define	BENCH_N_PERCENTILES		4
+#define	BENCH_MAX_COUNTERS		4
+
+static const double sPercentile[BENCH_N_PERCENTILES] = {
+		10.0, 50.0, 90.0, 99.0
+	};
+static const char *sPercentileName[BENCH_N_PERCENTILES] = {
+		"p10_ns", "median_ns", "p90_ns", "p99_ns"
+	};
+
+typedef struct benchResult {
+	const char *br_name;
+	int br_nOpsPerIteration;
+	double br_percentile[BENCH_N_PERCENTILES];
+	double br_min;
+	double br_max;
+	double br_mean;
+	const char *br_counterName[BENCH_MAX_COUNTERS];
+	long br_counter[BENCH_MAX_COUNTERS];
+	int br_nCounters;
+} benchResult;
+
+static int sNWarmup = 3;
+static int sNIterations = 15;
+static long sSeed = 1;
+
+static char **sFilter = NULL;
+static int sNFilters = 0;
+
+static benchResult *sResult = NULL;
+static int sNResults = 0;
+static int sNResultsAllocated = 0;
+
+
+void
+benchSetup(int nWarmup, int nIterations, long seed)
+{
+	sNWarmup = (nWarmup < 0) ? 0 : nWarmup;
+	sNIterations = (nIterations < 1) ? 1 : nIterations;
+	sSeed = seed;
+}
+
+void
+benchSetFilter(int nFilters, char **filters)
+{
+	sNFilters = nFilters;
+	sFilter = filters;
+}
+
+long
+benchGetSeed()
+{
+	return sSeed;
+}
+
+int
+benchIsSelected(const char *name)
+{
+	int i;
+
+	if (sNFilters == 0)
+		return 1;
+
+	for (i = 0; i < sNFilters; i++)
+	{
+		if (strncmp(name, sFilter[i], strlen(sFilter[i])) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static int
+sCompareDouble(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	if (x < y)
+		return (-1);
+	if (x > y)
+		return 1;
+	return 0;
+}
+
+/**
+ * percentile of sorted values, interpolating between the
+ * values either side of its rank
+ */
+static double
+sPercentileOf(const double *sorted, int n, double percentile)
+{
+	double rank;
+	int below;
+
+	if (n == 1)
+		return sorted[0];
+
+	rank = (percentile / 100.0) * (n - 1);
+	below = (int) rank;
+	if (below >= n - 1)
+		return sorted[n - 1];
+	return sorted[below] + (rank - below) * (sorted[below + 1] - sorted[below]);
+}
+
+int
+benchRun(
+		const char *name,
+		int nOpsPerIteration,
+		benchFunction function,
+		void *data
+	)
+{
+	benchResult *result;
+	double *sample;
+	double start;
+	int i;
+
+	if ( ! benchIsSelected(name) )
+		return 0;
+
+	if (nOpsPerIteration < 1)
+		nOpsPerIteration = 1;
+
+	/** every kernel sees the same random sequence */
+	seedLocalRandom((int) sSeed);
+
+	for (i = 0; i < sNWarmup; i++)
+		(*function)(data);
+
+	sample = (double *) ckalloc(sizeof(double) * sNIterations);
+	for (i = 0; i < sNIterations; i++)
+	{
+		start = stageStatsWallClock();
+		(*function)(data);
+		sample[i] = ((stageStatsWallClock() - start) * 1.0e9)
+				/ nOpsPerIteration;
+	}
+
+	growArrayReserve(sNResults + 1,
+			(void **) &sResult, &sNResultsAllocated,
+			sizeof(benchResult));
+	result = &sResult[sNResults++];
+	memset(result, 0, sizeof(benchResult));
+	result->br_name = name;
+	result->br_nOpsPerIteration = nOpsPerIteration;
+
+	for (i = 0; i < sNIterations; i++)
+		result->br_mean += sample[i];
+	result->br_mean /= sNIterations;
+
+	qsort(sample, sNIterations, sizeof(double), sCompareDouble);
+	result->br_min = sample[0];
+	result->br_max = sample[sNIterations - 1];
+	for (i = 0; i < BENCH_N_PERCENTILES; i++)
+	{
+		result->br_percentile[i] =
+				sPercentileOf(sample, sNIterations, sPercentile[i]);
+	}
+	ckfree(sample);
+
+	printf("%-28s %12.1f ns/op  (p10 %.1f, p90 %.1f, %d x %d ops)\n",
+			name,
+			result->br_percentile[1],
+			result->br_percentile[0],
+			result->br_percentile[2],
+			sNIterations, nOpsPerIteration);
+	fflush(stdout);
+
+	return 1;
+}
+
+void
+benchCount(const char *counter, long value)
+{
+	benchResult *result;
+
+	if (sNResults == 0)
+		return;
+
+	result = &sResult[sNResults - 1];
+	if (result->br_nCounters >= BENCH_MAX_COUNTERS)
+		return;
+
+	result->br_counterName[result->br_nCounters] = counter;
+	result->br_counter[result->br_nCounters++] = value;
+
+	printf("%-28s %12ld %s\n", "", value, counter);
+	fflush(stdout);
+}
+
+int
+benchWriteJSON(FILE *fp)
+{
+	benchResult *result;
+	int i, j;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"seed\": %ld,\n", sSeed);
+	fprintf(fp, "  \"warmup\": %d,\n", sNWarmup);
+	fprintf(fp, "  \"iterations\": %d,\n", sNIterations);
+	fprintf(fp, "  \"benchmarks\": [");
+	for (i = 0; i < sNResults; i++)
+	{
+		result = &sResult[i];
+		fprintf(fp, "%s\n    {\n", (i > 0) ? "," : "");
+		fprintf(fp, "      \"name\": \"%s\",\n", result->br_name);
+		fprintf(fp, "      \"ops_per_iteration\": %d,\n",
+				result->br_nOpsPerIteration);
+		for (j = 0; j < BENCH_N_PERCENTILES; j++)
+		{
+			fprintf(fp, "      \"%s\": %.3f,\n",
+					sPercentileName[j], result->br_percentile[j]);
+		}
+		fprintf(fp, "      \"min_ns\": %.3f,\n", result->br_min);
+		fprintf(fp, "      \"max_ns\": %.3f,\n", result->br_max);
+		fprintf(fp, "      \"mean_ns\": %.3f", result->br_mean);
+		if (result->br_nCounters > 0)
+		{
+			fprintf(fp, ",\n      \"counters\": {");
+			for (j = 0; j < result->br_nCounters; j++)
+			{
+				fprintf(fp, "%s \"%s\": %ld", (j > 0) ? "," : "",
+						result->br_counterName[j], result->br_counter[j]);
+			}
+			fprintf(fp, " }");
+		}
+		fprintf(fp, "\n");
+		fprintf(fp, "    }");
+	}
+	fprintf(fp, "\n  ]\n}\n");
+
+	return ferror(fp) == 0;
+}
+
+void
+benchCleanup()
+{
+	if (sResult != NULL)
+	{
+		ckfree(sResult);
+		sResult = NULL;
+	}
+	sNResults = 0;
+	sNResultsAllocated = 0;
+}
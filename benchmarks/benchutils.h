@@ -0,0 +1,85 @@
+/**
+ ** Harness for the numerical kernel micro-benchmarks.
+ **
+ ** Each kernel is run a number of untimed warmup iterations and
+ ** then a number of timed ones, and the distribution of the time
+ ** per operation over the timed iterations is reported.  The
+ ** random number generator is reseeded before every kernel, so
+ ** a given seed always runs the kernels on the same data.
+ **
+ ** $Id$
+ **/
+
+#ifndef __BENCHMARK_UTILS_HEADER__
+#define __BENCHMARK_UTILS_HEADER__
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+#endif
+
+/** one timed iteration of a kernel */
+typedef void (*benchFunction)(void *data);
+
+# if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+# endif
+
+/** set the iteration counts and seed used for every kernel */
+void benchSetup(int nWarmup, int nIterations, long seed);
+
+/**
+ * restrict the kernels run to those whose names start with
+ * one of the given prefixes (all are run if nFilters is 0)
+ */
+void benchSetFilter(int nFilters, char **filters);
+
+/** the seed, for data set up before a kernel runs */
+long benchGetSeed(void);
+
+/** return 1 if the named kernel will be run */
+int benchIsSelected(const char *name);
+
+/**
+ * time a kernel, each iteration of which carries out
+ * nOpsPerIteration operations; returns 0 if it was not run
+ */
+int benchRun(
+		const char *name,
+		int nOpsPerIteration,
+		benchFunction function,
+		void *data
+	);
+
+/**
+ * attach a count, such as of the copies made, to the kernel
+ * last run; it is printed and written out with the timings
+ */
+void benchCount(const char *counter, long value);
+
+/** write the results of every kernel run as a JSON object */
+int benchWriteJSON(FILE *fp);
+
+/** release the results */
+void benchCleanup(void);
+
+/**
+ * the kernel groups, each of which sets up its data and
+ * calls benchRun() for the kernels it covers
+ */
+int benchFFT(void);
+int benchFilter(void);
+int benchSpline(void);
+int benchRTree(void);
+int benchAlloc(void);
+int benchRandom(void);
+int benchIO(void);
+int benchLog(void);
+int benchTokenizer(void);
+int benchMUP(void);
+# if defined(__cplusplus) || defined(c_plusplus)
+}
+# endif
+
+#endif /* __BENCHMARK_UTILS_HEADER__ */
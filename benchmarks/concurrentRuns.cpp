@@ -0,0 +1,113 @@
+/**
+ ** Run several simulations at once, each on its own thread with
+ ** its own SimulationContext, so that their outputs can be checked
+ ** against those of the same configurations run one at a time.
+ **
+ ** usage: concurrentRuns directory seed [ directory seed ... ]
+ **
+ ** Each directory holds a simulator.cfg, and the run is written
+ ** below it as simtext -skip-confirm would write it, with the
+ ** given seed.
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "stringtools.h"
+#include "workpool.h"
+#include "log.h"
+
+#include "SimulatorControl.h"
+#include "SimulationContext.h"
+#include "Simulator.h"
+
+typedef struct ConcurrentRun {
+	const char *cr_directory;
+	int cr_seed;
+	int cr_status;
+} ConcurrentRun;
+
+static int
+sRunSimulation(int taskIndex, void *userData)
+{
+	ConcurrentRun *run = &((ConcurrentRun *) userData)[taskIndex];
+	char configFile[FILENAME_MAX];
+	char outputRoot[FILENAME_MAX];
+	SimulationContext *context;
+	SimulationResult *result = NULL;
+	Simulator *sim;
+
+	slnprintf(configFile, FILENAME_MAX, "%s/simulator.cfg",
+			run->cr_directory);
+	strlcpy(outputRoot, run->cr_directory, FILENAME_MAX);
+
+	context = new SimulationContext();
+	sim = new Simulator(context);
+
+	if (sim->initializeGlobals(configFile, outputRoot) != NULL)
+	{
+		g->use_last_muscle = 0;
+		g->use_old_firing_times = 0;
+		g->random_seed = run->cr_seed;
+		result = sim->run(0);
+	}
+
+	run->cr_status = (result != NULL && result->getErrorState() == 0);
+	if (result != NULL)
+		delete result;
+	delete sim;
+	delete context;
+
+	return run->cr_status;
+}
+
+int
+main(int argc, char **argv)
+{
+	ConcurrentRun *runs;
+	int nRuns, i, status = 0;
+
+	if (argc < 3 || (argc - 1) % 2 != 0)
+	{
+		fprintf(stderr, "usage: %s directory seed [ directory seed ... ]\n",
+				argv[0]);
+		exit(1);
+	}
+
+	nRuns = (argc - 1) / 2;
+	runs = (ConcurrentRun *) ckalloc(sizeof(ConcurrentRun) * nRuns);
+	for (i = 0; i < nRuns; i++)
+	{
+		runs[i].cr_directory = argv[1 + i * 2];
+		runs[i].cr_seed = atoi(argv[2 + i * 2]);
+		runs[i].cr_status = 0;
+	}
+
+	LogOpen(argv[0], LOGDEST_STDERR | LOGDEST_NO_ID, NULL);
+	LogSetLevel(LOG_WARNING);
+
+	/** one thread for each run, however many processors there are */
+	(void) workPoolRun(nRuns, nRuns, sRunSimulation, runs);
+
+	for (i = 0; i < nRuns; i++)
+	{
+		if ( ! runs[i].cr_status )
+		{
+			fprintf(stderr, "Run in '%s' failed\n", runs[i].cr_directory);
+			status = 1;
+		}
+	}
+
+	ckfree(runs);
+	LogClose();
+
+	return status;
+}
@@ -0,0 +1,102 @@
+/**
+ ** Micro-benchmarks of the numerical kernels used by the simulator.
+ **
+ ** usage: benchmark [ -warmup N ] [ -iterations N ] [ -seed N ]
+ **                  [ -json file ] [ kernel-prefix ... ]
+ **
+ ** Only the kernels whose names start with one of the given
+ ** prefixes are run; with none, all of them are.
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+
+#include "benchutils.h"
+
+typedef int (*benchGroup)(void);
+
+static benchGroup sGroups[] = {
+		benchFFT,
+		benchFilter,
+		benchSpline,
+		benchRTree,
+		benchAlloc,
+		benchRandom,
+		benchIO,
+		benchLog,
+		benchTokenizer,
+		benchMUP,
+		NULL
+	};
+
+static void
+usage(const char *progname)
+{
+	fprintf(stderr,
+			"usage: %s [ -warmup N ] [ -iterations N ] [ -seed N ]\n"
+			"          [ -json file ] [ kernel-prefix ... ]\n",
+			progname);
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *jsonFilename = NULL;
+	int nWarmup = 3, nIterations = 15;
+	long seed = 1;
+	FILE *fp;
+	int i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++)
+	{
+		if (i + 1 >= argc)
+			usage(argv[0]);
+
+		if (strcmp(argv[i], "-warmup") == 0)
+			nWarmup = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-iterations") == 0)
+			nIterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-seed") == 0)
+			seed = atol(argv[++i]);
+		else if (strcmp(argv[i], "-json") == 0)
+			jsonFilename = argv[++i];
+		else
+			usage(argv[0]);
+	}
+
+	benchSetup(nWarmup, nIterations, seed);
+	benchSetFilter(argc - i, &argv[i]);
+
+	for (i = 0; sGroups[i] != NULL; i++)
+	{
+		if ( ! (*sGroups[i])() )
+		{
+			fprintf(stderr, "Benchmark setup failed\n");
+			return 1;
+		}
+	}
+
+	if (jsonFilename != NULL)
+	{
+		fp = fopen(jsonFilename, "w");
+		if (fp == NULL || ! benchWriteJSON(fp))
+		{
+			fprintf(stderr, "Cannot write results to '%s'\n", jsonFilename);
+			return 1;
+		}
+		fclose(fp);
+	}
+
+	benchCleanup();
+	return 0;
+}
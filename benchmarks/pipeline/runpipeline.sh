@@ -0,0 +1,474 @@
+#!/bin/sh
+
+##
+## End-to-end benchmark of the simulator.
+##
+## Each preset in presets/ is run through the whole pipeline with
+## a fixed seed and without user confirmation.  The stage timings
+## and peak memory from its runstats1.json are gathered into one
+## results file, and the checksums of its outputs are compared to
+## those in golden/, so that a change which alters the simulated
+## signal is caught along with one that slows it down.
+##
+## The progression and sweep runs are also made once each on the
+## smallest preset, to check that they leave nothing allocated,
+## and incremental runs are made on it, to check that a new seed,
+## or a new level for a needle seeking the active fibres, is not
+## taken for a repeat of the run before, and that going back to an
+## earlier configuration reuses its run without cataloguing it twice.
+##
+## Two runs of that preset with different seeds are then made at
+## once by the concurrent runner, each on its own thread, and their
+## outputs must be those of the same runs made alone.
+##
+## The golden checksums are kept per seed, as golden/<preset>-<seed>.cksum,
+## and are made with -update-golden.  They depend on the floating
+## point behaviour of the compiler and platform they were made on.
+##
+## $Id$
+##
+
+HERE=`dirname $0`
+HERE=`cd ${HERE} && pwd`
+
+SIMULATOR="${HERE}/../../simtext"
+CONCURRENT="${HERE}/../concurrentRuns"
+SEED=1701
+RESULTS="pipeline.json"
+UPDATE="NO"
+KEEP="NO"
+PRESETS=""
+
+usage() {
+	echo "$0 [options] [preset ...]"
+	echo ""
+	echo "Options:"
+	echo "  -simulator <FILE> : simulator to run (default ${SIMULATOR})"
+	echo "  -concurrent <FILE>: concurrent runner (default ${CONCURRENT})"
+	echo "  -seed <N>         : random seed for every preset (default ${SEED})"
+	echo "  -json <FILE>      : results file (default ${RESULTS})"
+	echo "  -update-golden    : replace the golden checksums with these outputs"
+	echo "  -keep             : keep the run directories"
+	echo ""
+	echo "Presets are:"
+	for preset in ${HERE}/presets/*.cfg
+	do
+		echo "  `basename ${preset} .cfg`"
+	done
+}
+
+while [ $# -gt 0 ]
+do
+	case "$1" in
+	-simulator)
+		SIMULATOR="$2"
+		shift
+		;;
+	-concurrent)
+		CONCURRENT="$2"
+		shift
+		;;
+	-seed)
+		SEED="$2"
+		shift
+		;;
+	-json)
+		RESULTS="$2"
+		shift
+		;;
+	-update-golden)
+		UPDATE="YES"
+		;;
+	-keep)
+		KEEP="YES"
+		;;
+	-h*)
+		usage
+		exit 0
+		;;
+	-*)
+		echo "Unknown option $1"
+		usage
+		exit 1
+		;;
+	*)
+		PRESETS="${PRESETS} $1"
+		;;
+	esac
+	shift
+done
+
+if [ X"${PRESETS}" = X"" ]
+then
+	for preset in ${HERE}/presets/*.cfg
+	do
+		PRESETS="${PRESETS} `basename ${preset} .cfg`"
+	done
+fi
+
+if [ ! -x "${SIMULATOR}" ]
+then
+	echo "No simulator at ${SIMULATOR} -- build it first"
+	exit 1
+fi
+SIMULATOR=`cd \`dirname ${SIMULATOR}\` && pwd`/`basename ${SIMULATOR}`
+if [ -x "${CONCURRENT}" ]
+then
+	CONCURRENT=`cd \`dirname ${CONCURRENT}\` && pwd`/`basename ${CONCURRENT}`
+fi
+
+WORKDIR="${TMPDIR:-/tmp}/pipeline.$$"
+if [ X"${KEEP}" = X"NO" ]
+then
+	trap "rm -rf ${WORKDIR}" 0 2 3 15
+fi
+mkdir -p ${WORKDIR}
+
+
+##
+## The outputs which are fully determined by the seed; the
+## contraction file and the logs carry the time of the run
+##
+outputFiles() {
+	(
+		cd $1
+		ls MU.dat MF-unplowed.dat \
+			emg/MF-plowed1.dat emg/emg1.dat \
+			emg/micro1.dat emg/macro1.dat \
+			Firing-Data/*.dat MFP-Data/*.dat 2>/dev/null
+	)
+}
+
+NFAIL=0
+
+echo "{" > ${RESULTS}
+echo "  \"seed\": ${SEED}," >> ${RESULTS}
+echo "  \"presets\": [" >> ${RESULTS}
+SEPARATOR=""
+
+for preset in ${PRESETS}
+do
+	CONFIG="${HERE}/presets/${preset}.cfg"
+	GOLDEN="${HERE}/golden/${preset}-${SEED}.cksum"
+	RUNDIR="${WORKDIR}/${preset}"
+
+	if [ ! -f "${CONFIG}" ]
+	then
+		echo "No preset '${preset}' -- skipping"
+		NFAIL=`expr ${NFAIL} + 1`
+		continue
+	fi
+
+	mkdir -p ${RUNDIR}
+	cp ${CONFIG} ${RUNDIR}/simulator.cfg
+
+	printf "%-12s : " ${preset}
+	START=`date +%s`
+	(
+		cd ${RUNDIR} && \
+		${SIMULATOR} -skip-confirm \
+				-configuration-dir=${RUNDIR} \
+				-data-root=${RUNDIR} \
+				-seed=${SEED} \
+				> simtext.out 2>&1
+	)
+	RUNSTATUS=$?
+	END=`date +%s`
+
+	OUTPUT="${RUNDIR}/run000/patient"
+	if [ ${RUNSTATUS} -ne 0 ] || [ ! -f ${OUTPUT}/emg/runstats1.json ]
+	then
+		echo "FAILED (see ${RUNDIR}/simtext.out)"
+		NFAIL=`expr ${NFAIL} + 1`
+		KEEP="YES"
+		trap "" 0 2 3 15
+		continue
+	fi
+
+	outputFiles ${OUTPUT} | \
+		( cd ${OUTPUT} && xargs cksum ) > ${RUNDIR}/outputs.cksum
+
+	if [ X"${UPDATE}" = X"YES" ]
+	then
+		cp ${RUNDIR}/outputs.cksum ${GOLDEN}
+		CHECK="updated"
+	elif [ ! -f ${GOLDEN} ]
+	then
+		CHECK="no golden"
+	elif cmp -s ${GOLDEN} ${RUNDIR}/outputs.cksum
+	then
+		CHECK="match"
+	else
+		CHECK="MISMATCH"
+		NFAIL=`expr ${NFAIL} + 1`
+		diff ${GOLDEN} ${RUNDIR}/outputs.cksum | \
+			grep '^[<>]' | head -10 | \
+			sed -e 's/^/    /' > ${RUNDIR}/outputs.diff
+	fi
+
+	echo "`expr ${END} - ${START}` s, outputs ${CHECK}"
+	if [ -f ${RUNDIR}/outputs.diff ]
+	then
+		cat ${RUNDIR}/outputs.diff
+	fi
+
+	printf "${SEPARATOR}" >> ${RESULTS}
+	echo "    {" >> ${RESULTS}
+	echo "      \"name\": \"${preset}\"," >> ${RESULTS}
+	echo "      \"outputs\": \"${CHECK}\"," >> ${RESULTS}
+	printf "      \"runstats\": " >> ${RESULTS}
+	sed -e '2,$s/^/      /' ${OUTPUT}/emg/runstats1.json >> ${RESULTS}
+	printf "    }" >> ${RESULTS}
+	SEPARATOR=",\n"
+done
+
+echo "" >> ${RESULTS}
+echo "  ]" >> ${RESULTS}
+echo "}" >> ${RESULTS}
+
+##
+## The multi-stage runs set up their directories again for each
+## stage; run each kind on the smallest preset and check that a
+## memory debugging build finds nothing left allocated at exit
+##
+LEAKPRESET="${HERE}/presets/small.cfg"
+for stages in \
+		"progression -progression=0.2,0.4,0.6" \
+		"needle-sweep -needle-sweep=0:0,0.5:0.5,1:0" \
+		"contraction-sweep -contraction-sweep=10,20,30"
+do
+	set -- ${stages}
+	RUNDIR="${WORKDIR}/leaks-$1"
+
+	mkdir -p ${RUNDIR}
+	cp ${LEAKPRESET} ${RUNDIR}/simulator.cfg
+
+	printf "%-17s : " $1
+	(
+		cd ${RUNDIR} && \
+		${SIMULATOR} -skip-confirm \
+				-configuration-dir=${RUNDIR} \
+				-data-root=${RUNDIR} \
+				-seed=${SEED} $2 \
+				> simtext.out 2>&1
+	)
+	if [ $? -ne 0 ]
+	then
+		echo "FAILED (see ${RUNDIR}/simtext.out)"
+		NFAIL=`expr ${NFAIL} + 1`
+		KEEP="YES"
+		trap "" 0 2 3 15
+	elif [ ! -f ${RUNDIR}/ckalloc.log ]
+	then
+		echo "not checked (no memory debugging)"
+	elif [ -s ${RUNDIR}/ckalloc.log ]
+	then
+		echo "LEAKED `grep -c ' bytes @ ' ${RUNDIR}/ckalloc.log` blocks"
+		grep ' bytes @ ' ${RUNDIR}/ckalloc.log | \
+			sed -e 's/^.* bytes @ /    /' | sort | uniq -c | head -10
+		NFAIL=`expr ${NFAIL} + 1`
+	else
+		echo "no leaks"
+	fi
+done
+
+##
+## Make an incremental run in ${RUNDIR} with the given seed and
+## check which stages it reports keeping; any failure is left
+## in STATUS
+##
+incrementalRun() {
+	name=$1
+	seed=$2
+	shift 2
+	expected="$*"
+
+	(
+		cd ${RUNDIR} && \
+		${SIMULATOR} -skip-confirm \
+				-configuration-dir=${RUNDIR} \
+				-data-root=${RUNDIR} \
+				-seed=${seed} -incremental \
+				> simtext-${name}.out 2>&1
+	)
+	if [ $? -ne 0 ]
+	then
+		STATUS="FAILED (see ${RUNDIR}/simtext-${name}.out)"
+		return 1
+	fi
+	if ! grep "^Incremental run: ${expected}\$" \
+			${RUNDIR}/simtext-${name}.out > /dev/null
+	then
+		STATUS="FAILED -- ${name} run did not report '${expected}'"
+		return 1
+	fi
+	return 0
+}
+
+## set a value in the configuration of ${RUNDIR}
+setConfig() {
+	sed -e "s/^\( *$1 *=\).*;/\1 $2;/" \
+		${RUNDIR}/simulator.cfg > ${RUNDIR}/simulator.cfg.new
+	mv ${RUNDIR}/simulator.cfg.new ${RUNDIR}/simulator.cfg
+}
+
+incrementalReport() {
+	printf "%-17s : " $1
+	if [ X"${STATUS}" != X ]
+	then
+		echo "${STATUS}"
+		NFAIL=`expr ${NFAIL} + 1`
+		KEEP="YES"
+		trap "" 0 2 3 15
+	else
+		echo "$2"
+	fi
+}
+
+ALLNEW="new muscle, new firing, new needle, new MUPs"
+ALLKEPT="keeping muscle, keeping firing, keeping needle, keeping MUPs"
+
+##
+## An incremental run with the same seed keeps every stage of the
+## run before it, while one with a new seed must redo them all
+##
+RUNDIR="${WORKDIR}/incremental"
+mkdir -p ${RUNDIR}
+cp ${LEAKPRESET} ${RUNDIR}/simulator.cfg
+
+STATUS=""
+incrementalRun first ${SEED} ${ALLNEW} && \
+	incrementalRun repeat ${SEED} ${ALLKEPT} && \
+	incrementalRun new-seed `expr ${SEED} + 1` ${ALLNEW}
+incrementalReport "incremental" "new seed redoes every stage"
+
+##
+## Going back to an earlier configuration carries on from its
+## catalogued run, and redoing that run must not catalogue it
+## a second time
+##
+RUNDIR="${WORKDIR}/incremental-back"
+mkdir -p ${RUNDIR}
+cp ${LEAKPRESET} ${RUNDIR}/simulator.cfg
+cp ${LEAKPRESET} ${RUNDIR}/simulator-A.cfg
+
+STATUS=""
+incrementalRun config-A ${SEED} ${ALLNEW} && \
+	setConfig contractionLevelAsPercentMVC 60 && \
+	incrementalRun config-B ${SEED} \
+			"keeping muscle, new firing, new needle, new MUPs" && \
+	cp ${RUNDIR}/simulator-A.cfg ${RUNDIR}/simulator.cfg && \
+	incrementalRun config-A-again ${SEED} \
+			"keeping muscle, new firing, new needle, new MUPs"
+if [ X"${STATUS}" = X ]
+then
+	if ! grep "^Run 0 in .* has the same configuration\$" \
+			${RUNDIR}/simtext-config-A-again.out > /dev/null
+	then
+		STATUS="FAILED -- config-A-again run did not use the catalogue"
+	elif [ X"`sed -e 1d ${RUNDIR}/catalog.runs | sort | uniq -d`" != X ]
+	then
+		STATUS="FAILED -- ${RUNDIR}/catalog.runs holds a record twice"
+	fi
+fi
+incrementalReport "incremental-back" "earlier run reused, catalogued once"
+
+##
+## A needle which seeks the active fibres is placed from the
+## firing trains, so a new contraction level must move it and
+## remake the MUPs, while the muscle is kept
+##
+RUNDIR="${WORKDIR}/incremental-seek"
+mkdir -p ${RUNDIR}
+cp ${LEAKPRESET} ${RUNDIR}/simulator.cfg
+echo "seekNeedle = yes;" >> ${RUNDIR}/simulator.cfg
+echo "contractionLevelAsPercentMVC = 10;" >> ${RUNDIR}/simulator.cfg
+
+STATUS=""
+incrementalRun seek-10 ${SEED} ${ALLNEW} && \
+	setConfig contractionLevelAsPercentMVC 60 && \
+	incrementalRun seek-60 ${SEED} \
+			"keeping muscle, new firing, new needle, new MUPs"
+incrementalReport "incremental-seek" "new level moves the needle"
+
+##
+## Simulations in separate contexts share no state, so two run at
+## once on separate threads give the outputs they give alone
+##
+printf "%-17s : " "concurrent"
+if [ ! -x "${CONCURRENT}" ]
+then
+	echo "not checked (no concurrent runner)"
+else
+	STATUS=""
+	for run in 1 2
+	do
+		for kind in alone concurrent
+		do
+			RUNDIR="${WORKDIR}/${kind}-${run}"
+			mkdir -p ${RUNDIR}
+			cp ${LEAKPRESET} ${RUNDIR}/simulator.cfg
+		done
+
+		RUNDIR="${WORKDIR}/alone-${run}"
+		(
+			cd ${RUNDIR} && \
+			${SIMULATOR} -skip-confirm \
+					-configuration-dir=${RUNDIR} \
+					-data-root=${RUNDIR} \
+					-seed=`expr ${SEED} + ${run}` \
+					> simtext.out 2>&1
+		) || STATUS="FAILED (see ${RUNDIR}/simtext.out)"
+	done
+
+	if [ X"${STATUS}" = X ]
+	then
+		(
+			cd ${WORKDIR} && \
+			${CONCURRENT} \
+					${WORKDIR}/concurrent-1 `expr ${SEED} + 1` \
+					${WORKDIR}/concurrent-2 `expr ${SEED} + 2` \
+					> concurrent.out 2>&1
+		) || STATUS="FAILED (see ${WORKDIR}/concurrent.out)"
+	fi
+
+	for run in 1 2
+	do
+		[ X"${STATUS}" != X ] && break
+		for kind in alone concurrent
+		do
+			OUTPUT="${WORKDIR}/${kind}-${run}/run000/patient"
+			outputFiles ${OUTPUT} | \
+				( cd ${OUTPUT} && xargs cksum ) \
+				> ${WORKDIR}/${kind}-${run}/outputs.cksum
+		done
+		if ! cmp -s ${WORKDIR}/alone-${run}/outputs.cksum \
+				${WORKDIR}/concurrent-${run}/outputs.cksum
+		then
+			STATUS="MISMATCH -- run ${run} differs from its run alone"
+		fi
+	done
+
+	if [ X"${STATUS}" != X ]
+	then
+		echo "${STATUS}"
+		NFAIL=`expr ${NFAIL} + 1`
+		KEEP="YES"
+		trap "" 0 2 3 15
+	else
+		echo "outputs match runs made alone"
+	fi
+fi
+
+if [ X"${KEEP}" = X"YES" ]
+then
+	echo "Run directories kept in ${WORKDIR}"
+fi
+
+if [ ${NFAIL} -ne 0 ]
+then
+	echo "FAILED -- ${NFAIL} of the checks above did not pass"
+	exit 1
+fi
+echo "SUCCESS -- results in ${RESULTS}"
+exit 0
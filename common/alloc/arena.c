@@ -0,0 +1,184 @@
+/** ------------------------------------------------------------
+ ** Bump allocation of blocks which are all freed together
+ ** ------------------------------------------------------------
+ ** $Id$
+ **/
+
+#ifndef MAKEDEPEND
+#include        <stdio.h>
+#include        <string.h>
+#endif
+
+#include        "os_defs.h"
+#include        "tclCkalloc.h"
+#include        "arena.h"
+
+struct arenaChunk
+{
+    struct arenaChunk *ac_next;
+    size_t      ac_size;
+    size_t      ac_start;       /* offset of the first block */
+    size_t      ac_used;
+};
+
+
+OS_EXPORT void
+arenaInit(arena, firstChunkSize, maxChunkSize, alignment)
+    Arena      *arena;
+    size_t      firstChunkSize;
+    size_t      maxChunkSize;
+    size_t      alignment;
+{
+    memset(arena, 0, sizeof(Arena));
+    arena->ar_firstChunkSize = firstChunkSize;
+    arena->ar_nextChunkSize = firstChunkSize;
+    arena->ar_maxChunkSize = maxChunkSize;
+    arena->ar_alignment = alignment;
+}
+
+/*
+ * ---------------------------------------------
+ * the first offset at or after used which gives
+ * an aligned address
+ * ---------------------------------------------
+ */
+static size_t
+alignedOffset(chunk, used, alignment)
+    arenaChunk *chunk;
+    size_t      used;
+    size_t      alignment;
+{
+    size_t      address;
+
+    address = (size_t) (((char *) (chunk + 1)) + used);
+    return used + ((alignment - (address % alignment)) % alignment);
+}
+
+/*
+ * ---------------------------------------------
+ * start a new chunk with room for at least size
+ * bytes, and make it the one allocated from
+ * ---------------------------------------------
+ */
+static arenaChunk *
+arenaNewChunk(arena, size)
+    Arena      *arena;
+    size_t      size;
+{
+    arenaChunk *chunk;
+    size_t      chunkSize;
+
+    if (arena->ar_nextChunkSize == 0)
+        arena->ar_nextChunkSize = ARENA_DEFAULT_CHUNK_SIZE;
+
+    chunkSize = arena->ar_nextChunkSize;
+    if (chunkSize < size)
+        chunkSize = size;
+
+    chunk = (arenaChunk *) ckalloc(sizeof(arenaChunk) + chunkSize);
+    if (chunk == NULL)
+        return NULL;
+    chunk->ac_next = NULL;
+    chunk->ac_size = chunkSize;
+    chunk->ac_start = 0;
+    chunk->ac_used = 0;
+
+    if (arena->ar_last == NULL)
+        arena->ar_first = chunk;
+    else
+        arena->ar_last->ac_next = chunk;
+    arena->ar_last = chunk;
+    arena->ar_nChunks++;
+
+    if (arena->ar_maxChunkSize == 0)
+        arena->ar_maxChunkSize = ARENA_MAX_CHUNK_SIZE;
+    if (arena->ar_nextChunkSize * 2 <= arena->ar_maxChunkSize)
+        arena->ar_nextChunkSize *= 2;
+
+    return chunk;
+}
+
+/*
+ * ---------------------------------------------
+ * hand out size bytes from the newest chunk
+ * ---------------------------------------------
+ */
+OS_EXPORT void *
+arenaAlloc(arena, size)
+    Arena      *arena;
+    size_t      size;
+{
+    arenaChunk *chunk;
+    size_t      alignment, offset;
+    char       *base;
+
+    alignment = arena->ar_alignment;
+    if (alignment == 0)
+        alignment = ARENA_DEFAULT_ALIGNMENT;
+
+    /**
+     ** align the address rather than the offset, as the
+     ** chunk itself need not be aligned any further than
+     ** the allocator below us cares to
+     **/
+    chunk = arena->ar_last;
+    if (chunk == NULL
+            || alignedOffset(chunk, chunk->ac_used, alignment) + size
+                    > chunk->ac_size)
+    {
+        chunk = arenaNewChunk(arena, size + alignment - 1);
+        if (chunk == NULL)
+            return NULL;
+    }
+
+    base = (char *) (chunk + 1);
+    offset = alignedOffset(chunk, chunk->ac_used, alignment);
+    if (chunk->ac_used == 0)
+        chunk->ac_start = offset;
+    chunk->ac_used = offset + size;
+    arena->ar_nBytesUsed += size;
+
+    return base + offset;
+}
+
+/*
+ * ---------------------------------------------
+ * free every chunk; the arena is left empty, and
+ * starts again from its first chunk size
+ * ---------------------------------------------
+ */
+OS_EXPORT void
+arenaRelease(arena)
+    Arena      *arena;
+{
+    arenaChunk *chunk, *next;
+
+    for (chunk = arena->ar_first; chunk != NULL; chunk = next)
+    {
+        next = chunk->ac_next;
+        ckfree(chunk);
+    }
+
+    arenaInit(arena, arena->ar_firstChunkSize,
+            arena->ar_maxChunkSize, arena->ar_alignment);
+}
+
+OS_EXPORT int
+arenaForEachChunk(arena, function, userData)
+    const Arena *arena;
+    arenaChunkFunction function;
+    void       *userData;
+{
+    arenaChunk *chunk;
+
+    for (chunk = arena->ar_first; chunk != NULL; chunk = chunk->ac_next)
+    {
+        if (chunk->ac_used > 0)
+        {
+            if ( ! (*function)(((char *) (chunk + 1)) + chunk->ac_start,
+                        chunk->ac_used - chunk->ac_start, userData) )
+                return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,471 @@
+/** ------------------------------------------------------------
+ ** Thread caching allocator for release builds
+ ** ------------------------------------------------------------
+ ** $Id$
+ **
+ ** With TCL_MEM_FAST, ckalloc and ckfree come here rather than to
+ ** the debugging allocator in tclCkalloc.c.  Small blocks are
+ ** rounded up to one of a few size classes, and each thread keeps
+ ** the blocks it frees on a list per class, so that the next
+ ** request of that class is met without a call to malloc and
+ ** without taking a lock.  Larger blocks go straight to malloc.
+ **
+ ** Only one in every ckallocGetSampleInterval() blocks carries
+ ** the file and line of its allocation and is kept on the list
+ ** dumped at exit, so a leak which is repeated often enough to
+ ** matter still shows up in ckalloc.log.
+ **
+ ** The per-thread statistics are kept by the debugging allocator
+ ** as well, through ckallocCountAlloc() and ckallocCountFree().
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <fcntl.h>
+#endif
+
+#include "msgir.h"
+#include "tclCkalloc.h"
+#include "stringtools.h"
+
+#ifndef TCL_MEM_SAMPLE
+# define TCL_MEM_SAMPLE		0
+#endif
+
+/** largest number of bytes kept in each thread's list for a class */
+#define	CACHE_BYTES_PER_CLASS	(64 * 1024)
+#define	CACHE_MIN_BLOCKS		16
+
+#define	LARGE_CLASS				0xff
+
+#define	MAGIC_MASK				0xff00
+#define	MAGIC_LIVE				0xc500
+#define	MAGIC_FREE				0xf500
+#define	FLAG_SAMPLED			0x0001
+
+/**
+ ** Every block is preceded by this header; it is 16 bytes long
+ ** so that the body keeps the alignment malloc gives.
+ **/
+typedef struct ck_header
+{
+	unsigned int length;
+	unsigned short sizeClass;
+	unsigned short flags;
+	union {
+		void *next;			/* while on a thread's free list */
+		double align;
+	} u;
+} ck_header;
+
+/**
+ ** Sampled blocks have this in front of their header, linking
+ ** them on the list which is dumped at exit.  It takes up a
+ ** multiple of 16 bytes, so that the header and body of a sampled
+ ** block keep the same alignment as those of any other.
+ **/
+typedef struct ck_sample
+{
+	const char *file;
+	int line;
+	struct ck_sample *flink;
+	struct ck_sample *blink;
+} ck_sample;
+
+#define	SAMPLE_SIZE			((sizeof(ck_sample) + 15) & ~((size_t) 15))
+#define	SAMPLE_HEADER(s)	((ck_header *) (((char *) (s)) + SAMPLE_SIZE))
+#define	HEADER_SAMPLE(h)	((ck_sample *) (((char *) (h)) - SAMPLE_SIZE))
+
+static const unsigned int sClassSize[] = {
+		16, 32, 48, 64, 80, 96, 112, 128,
+		192, 256, 384, 512, 768, 1024, 1536, 2048
+	};
+#define	N_CLASSES	(sizeof(sClassSize) / sizeof(sClassSize[0]))
+
+typedef struct ck_thread_cache
+{
+	ck_header *free[N_CLASSES];
+	int nFree[N_CLASSES];
+	int untilSample;
+	CkallocStats stats;
+} ck_thread_cache;
+
+static OS_THREAD_LOCAL ck_thread_cache sCache;
+
+static int sSampleInterval = TCL_MEM_SAMPLE;
+static ck_sample *sSampleHead = NULL;
+
+/**
+ ** The sample list is shared by every thread; it is only taken
+ ** for the sampled blocks, so a spin lock does.
+ **/
+#if defined(__GNUC__)
+static volatile int sSampleLock = 0;
+# define LOCK_SAMPLES()	\
+		do { \
+			while (__sync_lock_test_and_set(&sSampleLock, 1)) \
+				while (sSampleLock) ; \
+		} while (0)
+# define UNLOCK_SAMPLES()	__sync_lock_release(&sSampleLock)
+#else
+# define LOCK_SAMPLES()		(void) 0
+# define UNLOCK_SAMPLES()	(void) 0
+#endif
+
+
+static int
+sGetClass(unsigned int size)
+{
+	int i;
+
+	if (size <= 128)
+		return (size == 0) ? 0 : (int) ((size - 1) / 16);
+
+	for (i = 8; i < (int) N_CLASSES; i++)
+	{
+		if (size <= sClassSize[i])
+			return i;
+	}
+	return LARGE_CLASS;
+}
+
+static int
+sCacheLimit(int sizeClass)
+{
+	int limit;
+
+	limit = CACHE_BYTES_PER_CLASS / sClassSize[sizeClass];
+	if (limit < CACHE_MIN_BLOCKS)
+		limit = CACHE_MIN_BLOCKS;
+	return limit;
+}
+
+static ck_header *
+sHeader(void *ptr, const char *action)
+{
+	ck_header *header;
+
+	header = ((ck_header *) ptr) - 1;
+	if ((header->flags & MAGIC_MASK) != MAGIC_LIVE)
+	{
+		if ((header->flags & MAGIC_MASK) == MAGIC_FREE)
+			panic("%s of block %p which is already free", action, ptr);
+		panic("%s of block %p not from ckalloc", action, ptr);
+	}
+	return header;
+}
+
+
+OS_EXPORT void
+ckallocCountAlloc(unsigned int size)
+{
+	sCache.stats.cs_mallocs++;
+	sCache.stats.cs_currentBytes += size;
+	if (sCache.stats.cs_currentBytes > sCache.stats.cs_maximumBytes)
+		sCache.stats.cs_maximumBytes = sCache.stats.cs_currentBytes;
+}
+
+OS_EXPORT void
+ckallocCountFree(unsigned int size)
+{
+	sCache.stats.cs_frees++;
+	sCache.stats.cs_currentBytes -= size;
+}
+
+OS_EXPORT void
+ckallocGetThreadStats(CkallocStats *stats)
+{
+	*stats = sCache.stats;
+}
+
+OS_EXPORT void
+ckallocResetThreadStats()
+{
+	memset(&sCache.stats, 0, sizeof(CkallocStats));
+}
+
+OS_EXPORT void
+ckallocSetSampleInterval(int interval)
+{
+	sSampleInterval = (interval < 0) ? 0 : interval;
+}
+
+OS_EXPORT int
+ckallocGetSampleInterval()
+{
+	return sSampleInterval;
+}
+
+/**
+ ** Give the blocks cached by the calling thread back to malloc;
+ ** threads which exit must call this or their cache is lost
+ **/
+OS_EXPORT void
+ckallocReleaseThreadCache()
+{
+	ck_header *header;
+	int i;
+
+	for (i = 0; i < (int) N_CLASSES; i++)
+	{
+		while (sCache.free[i] != NULL)
+		{
+			header = sCache.free[i];
+			sCache.free[i] = (ck_header *) header->u.next;
+			free(header);
+		}
+		sCache.nFree[i] = 0;
+	}
+}
+
+
+static void *
+sSampledAlloc(unsigned int size, const char *file, int line)
+{
+	ck_sample *sample;
+	ck_header *header;
+
+	sample = (ck_sample *) malloc(SAMPLE_SIZE + sizeof(ck_header) + size);
+	if (sample == NULL)
+		return NULL;
+
+	sample->file = file;
+	sample->line = line;
+	sample->blink = NULL;
+
+	LOCK_SAMPLES();
+	sample->flink = sSampleHead;
+	if (sSampleHead != NULL)
+		sSampleHead->blink = sample;
+	sSampleHead = sample;
+	UNLOCK_SAMPLES();
+
+	sCache.stats.cs_sampled++;
+
+	header = SAMPLE_HEADER(sample);
+	header->sizeClass = LARGE_CLASS;
+	header->flags = MAGIC_LIVE | FLAG_SAMPLED;
+	return header;
+}
+
+static void
+sSampledFree(ck_header *header)
+{
+	ck_sample *sample;
+
+	sample = HEADER_SAMPLE(header);
+
+	LOCK_SAMPLES();
+	if (sample->flink != NULL)
+		sample->flink->blink = sample->blink;
+	if (sample->blink != NULL)
+		sample->blink->flink = sample->flink;
+	if (sSampleHead == sample)
+		sSampleHead = sample->flink;
+	UNLOCK_SAMPLES();
+
+	free(sample);
+}
+
+
+/**
+ ** Allocate a block of at least size bytes, panicing if there
+ ** is no memory left, as Tcl_DbCkalloc does
+ **/
+OS_EXPORT void *
+Ck_FastAlloc(unsigned int size, const char *file, int line)
+{
+	ck_header *header = NULL;
+	int sizeClass;
+
+	if (sSampleInterval > 0 && --sCache.untilSample <= 0)
+	{
+		sCache.untilSample = sSampleInterval;
+		header = (ck_header *) sSampledAlloc(size, file, line);
+
+	} else
+	{
+		sizeClass = sGetClass(size);
+		if (sizeClass == LARGE_CLASS)
+		{
+			header = (ck_header *) malloc(sizeof(ck_header) + size);
+
+		} else if (sCache.free[sizeClass] != NULL)
+		{
+			header = sCache.free[sizeClass];
+			sCache.free[sizeClass] = (ck_header *) header->u.next;
+			sCache.nFree[sizeClass]--;
+			sCache.stats.cs_reused++;
+
+		} else
+		{
+			header = (ck_header *) malloc(sizeof(ck_header)
+						+ sClassSize[sizeClass]);
+		}
+
+		if (header != NULL)
+		{
+			header->sizeClass = (unsigned short) sizeClass;
+			header->flags = MAGIC_LIVE;
+		}
+	}
+
+	if (header == NULL)
+	{
+		fflush(stdout);
+		panic("unable to alloc %d bytes, %s line %d", size, file, line);
+	}
+
+	header->length = size;
+	ckallocCountAlloc(size);
+
+	return header + 1;
+}
+
+OS_EXPORT void
+Ck_FastFree(void *ptr)
+{
+	ck_header *header;
+	int sizeClass;
+
+	if (ptr == NULL)
+		return;
+
+	header = sHeader(ptr, "ckfree");
+	ckallocCountFree(header->length);
+
+	sizeClass = header->sizeClass;
+	if (header->flags & FLAG_SAMPLED)
+	{
+		header->flags = MAGIC_FREE;
+		sSampledFree(header);
+
+	} else if (sizeClass == LARGE_CLASS
+			|| sCache.nFree[sizeClass] >= sCacheLimit(sizeClass))
+	{
+		header->flags = MAGIC_FREE;
+		free(header);
+
+	} else
+	{
+		header->flags = MAGIC_FREE;
+		header->u.next = sCache.free[sizeClass];
+		sCache.free[sizeClass] = header;
+		sCache.nFree[sizeClass]++;
+	}
+}
+
+OS_EXPORT void *
+Ck_FastRealloc(void *ptr, unsigned int size, const char *file, int line)
+{
+	ck_header *header;
+	unsigned int copySize;
+	void *result;
+
+	if (ptr == NULL)
+		return Ck_FastAlloc(size, file, line);
+
+	header = sHeader(ptr, "ckrealloc");
+
+	/** a block which still fits its class is simply kept */
+	if (header->sizeClass != LARGE_CLASS
+			&& size <= sClassSize[header->sizeClass])
+	{
+		ckallocCountFree(header->length);
+		ckallocCountAlloc(size);
+		header->length = size;
+		return ptr;
+	}
+
+	copySize = (size < header->length) ? size : header->length;
+	result = Ck_FastAlloc(size, file, line);
+	memcpy(result, ptr, copySize);
+	Ck_FastFree(ptr);
+	return result;
+}
+
+OS_EXPORT char *
+Ck_FastStrdup(const char *string, const char *file, int line)
+{
+	char *result;
+	int len;
+
+	len = strlen(string) + 1;
+	result = (char *) Ck_FastAlloc(len, file, line);
+	memcpy(result, string, len);
+	return result;
+}
+
+
+/**
+ ** List the sampled blocks still allocated, in the format of
+ ** Tcl_DumpActiveMemoryToFP; each stands for about one in
+ ** "sample interval" of the blocks actually outstanding
+ **/
+OS_EXPORT int
+Ck_FastDumpSampledMemoryToFP(FILE *fileP)
+{
+	ck_sample *sample;
+	ck_header *header;
+	char *address;
+
+	fprintf(fileP, "# sampled one in %d allocations\n", sSampleInterval);
+
+	LOCK_SAMPLES();
+	for (sample = sSampleHead; sample != NULL; sample = sample->flink)
+	{
+		header = SAMPLE_HEADER(sample);
+		address = (char *) (header + 1);
+
+		fprintf(fileP, "%8p - %8p  %7u bytes @ %s (%d)\n", address,
+				address + header->length - 1, header->length,
+				sample->file, sample->line);
+
+		if (header->length < 100)
+		{
+			fprintf(fileP, "%*s \"%s\"\n", 30, "",
+					strunctrl(address, header->length));
+		}
+	}
+	UNLOCK_SAMPLES();
+
+	return TCL_OK;
+}
+
+OS_EXPORT int
+Ck_FastDumpSampledMemory(const char *fileName)
+{
+	FILE *fileP;
+	int fd, status;
+
+	/** with sampling off there is nothing to report */
+	if (sSampleInterval <= 0)
+		return TCL_OK;
+
+	if (fileName != NULL)
+	{
+		fd = irOpen(fileName, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+
+#ifndef	OS_WINDOWS_NT
+		fileP = fdopen(fd, "w");
+#else
+		fileP = _fdopen(fd, "w");
+#endif
+		if (fileP == NULL)
+			return TCL_ERROR;
+	} else
+	{
+		fileP = stdout;
+	}
+
+	status = Ck_FastDumpSampledMemoryToFP(fileP);
+
+	if (fileName != NULL)
+		fclose(fileP);
+
+	return status;
+}
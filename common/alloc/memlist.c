@@ -18,6 +18,33 @@ int
 listCheckSize()
 #endif
 
+static OS_THREAD_LOCAL ListGrowthStats sGrowthStats;
+
+static void
+sCountGrowth(nBytesCopied)
+		long nBytesCopied;
+{
+	sGrowthStats.lg_nAllocations++;
+	if (nBytesCopied > 0)
+	{
+		sGrowthStats.lg_nCopies++;
+		sGrowthStats.lg_nBytesCopied += nBytesCopied;
+	}
+}
+
+OS_EXPORT void
+listGetGrowthStats(stats)
+		ListGrowthStats *stats;
+{
+	*stats = sGrowthStats;
+}
+
+OS_EXPORT void
+listResetGrowthStats()
+{
+	memset(&sGrowthStats, 0, sizeof(ListGrowthStats));
+}
+
 /*
  * ---------------------------------------------
  * grow a memory list to the needed size
@@ -67,9 +94,118 @@ listMkCheckSize(size_needed, list,
 		(void) memcpy((*list), old_data,
 					  (*cur_blocks) * blksize * tilesize);
 		ckfree(old_data);
+		sCountGrowth((long) (*cur_blocks) * blksize * tilesize);
+	} else
+	{
+		sCountGrowth(0);
 	}
 	(*cur_blocks) = calcblocks;
 
 	return (1);
 }
 
+/*
+ * ---------------------------------------------
+ * grow a memory list to at least the needed
+ * size, doubling its allocation
+ * ---------------------------------------------
+ */
+OS_EXPORT int
+growArrayMkReserve(size_needed, list,
+		n_allocated, tilesize,
+		filemark, linemark
+	)
+		int size_needed;
+		void **list;
+		int *n_allocated, tilesize;
+		const char *filemark;
+		int linemark;
+{
+	int             calcsize, oldbytes, calcbytes;
+	void           *old_data;
+
+	/** check whether we are just in the simple case **/
+	if (size_needed <= (*n_allocated))
+	{
+		return (1);
+	}
+
+	calcsize = (*n_allocated) * 2;
+	if (calcsize < GROW_ARRAY_MIN_ALLOCATION)
+		calcsize = GROW_ARRAY_MIN_ALLOCATION;
+	if (calcsize < size_needed)
+		calcsize = size_needed;
+
+	old_data = (*list);
+	oldbytes = (old_data == NULL) ? 0 : (*n_allocated) * tilesize;
+	calcbytes = calcsize * tilesize;
+
+	/** allocate and copy old values **/
+	(*list) = (void *) ckmkalloc(calcbytes, filemark, linemark);
+	if ((*list) == NULL)
+	{
+		(*list) = old_data;
+		return (0);
+	}
+
+	if (old_data != NULL)
+	{
+		(void) memcpy((*list), old_data, oldbytes);
+		ckfree(old_data);
+	}
+	memset(((char *) (*list)) + oldbytes, 0, calcbytes - oldbytes);
+	sCountGrowth((long) oldbytes);
+
+	(*n_allocated) = calcsize;
+
+	return (1);
+}
+
+/*
+ * ---------------------------------------------
+ * trim a memory list to the size in use
+ * ---------------------------------------------
+ */
+OS_EXPORT int
+growArrayMkShrink(n_used, list,
+		n_allocated, tilesize,
+		filemark, linemark
+	)
+		int n_used;
+		void **list;
+		int *n_allocated, tilesize;
+		const char *filemark;
+		int linemark;
+{
+	void           *old_data;
+
+	if (n_used >= (*n_allocated))
+	{
+		return (1);
+	}
+
+	old_data = (*list);
+	if (n_used <= 0)
+	{
+		if (old_data != NULL)
+			ckfree(old_data);
+		(*list) = NULL;
+		(*n_allocated) = 0;
+		return (1);
+	}
+
+	(*list) = (void *) ckmkalloc(n_used * tilesize, filemark, linemark);
+	if ((*list) == NULL)
+	{
+		(*list) = old_data;
+		return (0);
+	}
+	(void) memcpy((*list), old_data, n_used * tilesize);
+	ckfree(old_data);
+	sCountGrowth((long) n_used * tilesize);
+
+	(*n_allocated) = n_used;
+
+	return (1);
+}
+
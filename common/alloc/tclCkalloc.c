@@ -114,6 +114,24 @@ static int      validate_memory = 1;
 static int      validate_memory = 0;
 #endif
 
+/**
+ ** The allocated list and the counters above are shared by every
+ ** thread, so changes to them are made under a spin lock.  The
+ ** sections held are only a few pointer updates long.
+ **/
+#if defined(__GNUC__)
+static volatile int memListLock = 0;
+# define LOCK_MEM_LIST()	\
+		do { \
+			while (__sync_lock_test_and_set(&memListLock, 1)) \
+				while (memListLock) ; \
+		} while (0)
+# define UNLOCK_MEM_LIST()	__sync_lock_release(&memListLock)
+#else
+# define LOCK_MEM_LIST()	(void) 0
+# define UNLOCK_MEM_LIST()	(void) 0
+#endif
+
 
 /*
  *----------------------------------------------------------------------
@@ -247,9 +265,11 @@ Tcl_ValidateAllMemory(const char *file, int line)
     /*
      LogInfo("Validating Memory\n");
      */
+    LOCK_MEM_LIST();
     for (memScanP = allocHead; memScanP != NULL;
          memScanP = memScanP->flink)
         ValidateMemory(memScanP, file, line, 0);
+    UNLOCK_MEM_LIST();
 }
 
 
@@ -272,6 +292,7 @@ Tcl_DumpActiveMemoryToFP(fileP)
     char           *address;
     long            numExamined = 0;
 
+    LOCK_MEM_LIST();
     for (memScanP = allocHead; memScanP != NULL;
          memScanP = memScanP->flink)
     {
@@ -291,6 +312,7 @@ Tcl_DumpActiveMemoryToFP(fileP)
             (void) fputc('\n', fileP);
         }
     }
+    UNLOCK_MEM_LIST();
 
     return TCL_OK;
 }
@@ -395,6 +417,8 @@ Tcl_DbCkalloc(size, file, line)
     result->length = size;
     result->file = file;
     result->line = line;
+
+    LOCK_MEM_LIST();
     result->flink = allocHead;
     result->blink = NULL;
     if (allocHead != NULL)
@@ -433,6 +457,9 @@ Tcl_DbCkalloc(size, file, line)
     current_bytes_malloced += size;
     if (current_bytes_malloced > maximum_bytes_malloced)
         maximum_bytes_malloced = current_bytes_malloced;
+    UNLOCK_MEM_LIST();
+
+    ckallocCountAlloc(size);
 
     return result->body;
 }
@@ -488,6 +515,7 @@ Tcl_DbCkfree(ptr, file, line)
     {
         memset((void *) ptr, GUARD_VALUE, memp->length);
     }
+    LOCK_MEM_LIST();
     total_frees++;
     current_malloc_packets--;
     current_bytes_malloced -= memp->length;
@@ -501,6 +529,9 @@ Tcl_DbCkfree(ptr, file, line)
         memp->blink->flink = memp->flink;
     if (allocHead == memp)
         allocHead = memp->flink;
+    UNLOCK_MEM_LIST();
+
+    ckallocCountFree(memp->length);
     free((char *) memp);
     return 0;
 }
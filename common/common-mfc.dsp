@@ -133,6 +133,10 @@ SOURCE=.\path\dirlist.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\path\runcatalog.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\math\factorial.c
 # End Source File
 # Begin Source File
@@ -289,6 +293,14 @@ SOURCE=.\alloc\tclCkalloc.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\alloc\ckfast.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\alloc\arena.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\file\tempfile.c
 # End Source File
 # Begin Source File
@@ -297,6 +309,14 @@ SOURCE=.\timing\timer.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\timing\stagestats.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\thread\workpool.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\file\tokenizer.c
 # End Source File
 # Begin Source File
@@ -413,6 +433,14 @@ SOURCE=.\include\reporttimer.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\stagestats.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\workpool.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\stringtools.h
 # End Source File
 # Begin Source File
@@ -137,6 +137,10 @@ SOURCE=.\path\dirlist.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\path\runcatalog.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\math\factorial.c
 # End Source File
 # Begin Source File
@@ -309,6 +313,14 @@ SOURCE=.\alloc\tclCkalloc.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\alloc\ckfast.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\alloc\arena.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\file\tempfile.c
 # End Source File
 # Begin Source File
@@ -317,6 +329,14 @@ SOURCE=.\timing\timer.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\timing\stagestats.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\thread\workpool.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\file\tokenizer.c
 # End Source File
 # Begin Source File
@@ -437,6 +457,14 @@ SOURCE=.\include\reporttimer.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\stagestats.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\workpool.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\stringtools.h
 # End Source File
 # Begin Source File
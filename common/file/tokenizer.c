@@ -5,10 +5,27 @@
  * $Id: tokenizer.c 89 2011-11-17 22:55:45Z andrew $
  */
 
+#include        "os_defs.h"
+
+/**
+ * Regular files are mapped (or read in one block) rather than
+ * read a character at a time; on NT text mode translation would
+ * upset the file positions, so it keeps using fgetc()
+ */
+#ifndef OS_WINDOWS_NT
+# define        TKN_USE_FILE_BUFFER
+#endif
+
 #ifndef MAKEDEPEND
 #include        <stdio.h>
 #include        <string.h>
 #include        <ctype.h>
+#include        <math.h>
+#ifdef TKN_USE_FILE_BUFFER
+#include        <sys/types.h>
+#include        <sys/stat.h>
+#include        <sys/mman.h>
+#endif
 #endif
 
 #include        "tclCkalloc.h"
@@ -17,11 +34,23 @@
 #include        "tokens.h"
 #include        "massert.h"
 #include        "log.h"
-#include        "os_defs.h"
 
 
+/** how a file tokenizer is reading its file */
+#define TKN_FILE_UNREAD         0
+#define TKN_FILE_BUFFERED       1
+#define TKN_FILE_STREAM         2
+
+/** character classes for scanning runs in place (C locale) */
+#define TKN_IS_SPACE(c)         ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+#define TKN_IS_DIGIT(c)         ((unsigned) ((c) - '0') < 10)
+#define TKN_IS_ID(c)            (TKN_IS_DIGIT(c) \
+                                    || (unsigned) (((c) | 0x20) - 'a') < 26 \
+                                    || (c) == '_')
+
 static int      rToken(tokenizer * t);
 static int      literalCh(tokenizer * t, int ch);
+static void     tknFileRelease(tokenizer * t);
 
 OS_EXPORT int
 tknGetLineNo(tokenizer * t)
@@ -57,6 +86,8 @@ tknReset(tokenizer * t)
 OS_EXPORT void
 tknFileReset(tokenizer * t, FILE * ifp)
 {
+	if (t->type_ == TKNIZER_TYPE_FILE)
+		tknFileRelease(t);
 	tknReset(t);
 
 	MSG_ASSERT(t->type_ == TKNIZER_TYPE_FILE, "type mismatch");
@@ -79,6 +110,7 @@ tknStringReset(tokenizer * t, const char *data)
 		t->typeData_.string_.data_ = NULL;
 
 	t->typeData_.string_.offset_ = 0;
+	t->typeData_.string_.length_ = (data != NULL) ? strlen(data) : 0;
 }
 
 
@@ -133,6 +165,7 @@ tknGetStringTokenizer(const char *string)
 
 	t->typeData_.string_.data_ = ckstrdup(string);
 	t->typeData_.string_.offset_ = 0;
+	t->typeData_.string_.length_ = strlen(string);
 
 	return t;
 }
@@ -163,6 +196,7 @@ tknDeleteTokenizer(tokenizer * t)
 
 	if (t->type_ == TKNIZER_TYPE_FILE)
 	{
+		tknFileRelease(t);
 		t->typeData_.file_.ifp_ = NULL;
 
 	} else if (t->type_ == TKNIZER_TYPE_STRING)
@@ -309,6 +343,236 @@ tknIsDelim(token * tok, const char *delimset)
 	return 0;
 }
 
+/*
+ * --------------------------------------------
+ * map (or load) the rest of a regular file so
+ * that it can be scanned in place; anything
+ * else is read through the FILE as before
+ * ---------------------------------------------
+ */
+static void
+tknFileLoad(tokenizer * t)
+{
+	struct tokenizerFile *f = &t->typeData_.file_;
+#ifdef TKN_USE_FILE_BUFFER
+	struct stat     sb;
+	size_t          fileSize;
+	long            start;
+	void           *map;
+#endif
+
+	f->state_ = TKN_FILE_STREAM;
+
+#ifdef TKN_USE_FILE_BUFFER
+	if (f->ifp_ == NULL)
+		return;
+	if (fstat(fileno(f->ifp_), &sb) != 0 || ! S_ISREG(sb.st_mode))
+		return;
+	start = ftell(f->ifp_);
+	if (start < 0 || (off_t) start > sb.st_size)
+		return;
+	fileSize = (size_t) sb.st_size;
+
+	f->startPos_ = start;
+	f->offset_ = 0;
+	f->length_ = fileSize - start;
+	f->buffer_ = "";
+	if (f->length_ == 0)
+	{
+		f->state_ = TKN_FILE_BUFFERED;
+		return;
+	}
+
+	map = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fileno(f->ifp_), 0);
+	if (map != MAP_FAILED)
+	{
+		f->map_ = map;
+		f->mapLength_ = fileSize;
+		f->buffer_ = ((const char *) map) + start;
+	} else
+	{
+		f->block_ = (char *) ckalloc(f->length_);
+		if (f->block_ == NULL
+				|| fread(f->block_, 1, f->length_, f->ifp_) != f->length_)
+		{
+			if (f->block_ != NULL)
+				ckfree(f->block_);
+			f->block_ = NULL;
+			(void) fseek(f->ifp_, start, SEEK_SET);
+			return;
+		}
+		f->buffer_ = f->block_;
+	}
+	f->state_ = TKN_FILE_BUFFERED;
+#endif
+}
+
+/*
+ * --------------------------------------------
+ * drop the mapping or block, leaving the FILE
+ * just after the last character consumed
+ * ---------------------------------------------
+ */
+static void
+tknFileRelease(tokenizer * t)
+{
+	struct tokenizerFile *f = &t->typeData_.file_;
+
+	if (f->state_ == TKN_FILE_BUFFERED)
+	{
+		(void) fseek(f->ifp_, f->startPos_ + (long) f->offset_, SEEK_SET);
+#ifdef TKN_USE_FILE_BUFFER
+		if (f->map_ != NULL)
+			(void) munmap(f->map_, f->mapLength_);
+#endif
+		if (f->block_ != NULL)
+			ckfree(f->block_);
+	}
+	f->state_ = TKN_FILE_UNREAD;
+	f->buffer_ = NULL;
+	f->offset_ = f->length_ = 0;
+	f->map_ = NULL;
+	f->mapLength_ = 0;
+	f->block_ = NULL;
+}
+
+/*
+ * --------------------------------------------
+ * The unread input as a run of characters in
+ * memory which may be scanned directly, or NULL
+ * if characters must come through getAChar()
+ * (a pushed back character, verbose echoing,
+ * or input not held in memory)
+ * ---------------------------------------------
+ */
+static const char *
+tknPeekRun(tokenizer * t, size_t * nAvailable)
+{
+	struct tokenizerFile *f;
+
+	if (t->saveCh_ >= 0 || (t->options_ & TTOPT_VERBOSE_PARSE) != 0)
+		return NULL;
+
+	if (t->type_ == TKNIZER_TYPE_FILE)
+	{
+		f = &t->typeData_.file_;
+		if (f->state_ == TKN_FILE_UNREAD)
+			tknFileLoad(t);
+		if (f->state_ != TKN_FILE_BUFFERED)
+			return NULL;
+		*nAvailable = f->length_ - f->offset_;
+		return &f->buffer_[f->offset_];
+	}
+
+	if (t->type_ == TKNIZER_TYPE_STRING && t->typeData_.string_.data_ != NULL
+			&& t->typeData_.string_.offset_ <= t->typeData_.string_.length_)
+	{
+		*nAvailable = t->typeData_.string_.length_
+				- t->typeData_.string_.offset_;
+		return &t->typeData_.string_.data_[t->typeData_.string_.offset_];
+	}
+
+	return NULL;
+}
+
+/** consume characters found by tknPeekRun() */
+static void
+tknSkipRun(tokenizer * t, size_t nUsed)
+{
+	if (t->type_ == TKNIZER_TYPE_FILE)
+		t->typeData_.file_.offset_ += nUsed;
+	else
+		t->typeData_.string_.offset_ += nUsed;
+}
+
+/**
+ * copy a run of digits onto the token string, returning the
+ * number copied; the caller carries on one character at a time
+ */
+static int
+tknCopyDigits(tokenizer * t)
+{
+	const char     *run;
+	size_t          nAvailable, n;
+
+	if ((run = tknPeekRun(t, &nAvailable)) == NULL)
+		return 0;
+
+	if (nAvailable > (size_t) (TKN_MAX_STR_SIZE - 1 - t->tokenStringLen_))
+		nAvailable = TKN_MAX_STR_SIZE - 1 - t->tokenStringLen_;
+	for (n = 0; n < nAvailable && TKN_IS_DIGIT(run[n]); n++)
+		;
+	memcpy(&t->tokenString_[t->tokenStringLen_], run, n);
+	t->tokenStringLen_ += (int) n;
+	tknSkipRun(t, n);
+
+	return (int) n;
+}
+
+/**
+ * Exact powers of ten; any double up to 2^53 times or divided by
+ * one of these is correctly rounded in one operation
+ */
+static const double sExactPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22
+	};
+#define TKN_MAX_EXACT_POWER     22
+#define TKN_MAX_EXACT_MANTISSA  9007199254740992.0
+
+/**
+ * Convert the text of a real number.  The common short forms are
+ * converted directly, with exactly the result strtod() would give;
+ * anything longer or out of range is handed to strtod().
+ */
+static double
+tknParseReal(const char *string)
+{
+	const char     *s = string;
+	double          mantissa = 0, value;
+	int             nDigits = 0, exponent = 0, negative = 0;
+	int             explicitExponent = 0, expSign = 1, nExpDigits = 0;
+
+	if (*s == '-' || *s == '+')
+		negative = (*s++ == '-');
+
+	for (; TKN_IS_DIGIT(*s); s++, nDigits++)
+		mantissa = mantissa * 10 + (*s - '0');
+	if (*s == '.')
+	{
+		for (s++; TKN_IS_DIGIT(*s); s++, nDigits++)
+		{
+			mantissa = mantissa * 10 + (*s - '0');
+			exponent--;
+		}
+	}
+	if (*s == 'e' || *s == 'E')
+	{
+		s++;
+		if (*s == '-' || *s == '+')
+			expSign = (*s++ == '-') ? (-1) : 1;
+		for (; TKN_IS_DIGIT(*s) && nExpDigits < 4; s++, nExpDigits++)
+			explicitExponent = explicitExponent * 10 + (*s - '0');
+		if (nExpDigits == 0)
+			return strtod(string, NULL);
+		exponent += expSign * explicitExponent;
+	}
+
+	if (*s != 0 || nDigits == 0 || nDigits > 15
+			|| mantissa > TKN_MAX_EXACT_MANTISSA
+			|| exponent > TKN_MAX_EXACT_POWER
+			|| exponent < (-TKN_MAX_EXACT_POWER))
+		return strtod(string, NULL);
+
+	if (exponent >= 0)
+		value = mantissa * sExactPowersOfTen[exponent];
+	else
+		value = mantissa / sExactPowersOfTen[-exponent];
+
+	return negative ? (-value) : value;
+}
+
 int
 getAChar(tokenizer * t)
 {
@@ -324,7 +588,15 @@ getAChar(tokenizer * t)
 
 	if (t->type_ == TKNIZER_TYPE_FILE)
 	{
-		c = fgetc(t->typeData_.file_.ifp_);
+		struct tokenizerFile *f = &t->typeData_.file_;
+
+		if (f->state_ == TKN_FILE_UNREAD)
+			tknFileLoad(t);
+		if (f->state_ == TKN_FILE_BUFFERED)
+			c = (f->offset_ < f->length_)
+					? (unsigned char) f->buffer_[f->offset_++] : EOF;
+		else
+			c = fgetc(f->ifp_);
 	} else if (t->type_ == TKNIZER_TYPE_STRING)
 	{
 		c = t->typeData_.string_.data_[
@@ -393,8 +665,27 @@ getAChar(tokenizer * t)
 int
 skipSpaces(tokenizer * t)
 {
+	const char     *run;
+	size_t          nAvailable, n;
+	int             stopAtNL;
 	int c;
 
+	/** skip runs of blanks in place, counting the lines passed */
+	if ((run = tknPeekRun(t, &nAvailable)) != NULL)
+	{
+		stopAtNL = ((t->options_ & TTOPT_RETURN_CR) != 0);
+		for (n = 0; n < nAvailable && TKN_IS_SPACE(run[n]); n++)
+		{
+			if (run[n] == '\n')
+			{
+				if (stopAtNL)
+					break;
+				t->lineNo_++;
+			}
+		}
+		tknSkipRun(t, n);
+	}
+
 	while ((c = getAChar(t)) != TT_EOF)
 	{
 		if ((c == '\n') && ((t->options_ & TTOPT_RETURN_CR) != 0))
@@ -413,6 +704,8 @@ skipSpaces(tokenizer * t)
 int
 getString(tokenizer * t)
 	{
+	const char     *run, *end;
+	size_t          nAvailable, n;
 	int readch;
 	int ch = 0;     /** if no chars are read, ch should not == EOF */
 
@@ -420,6 +713,21 @@ getString(tokenizer * t)
 	{
 		t->token_.data_.strptr_ = t->tokenString_;
 	}
+	/** copy up to the closing quote at once if there are no escapes */
+	if ((run = tknPeekRun(t, &nAvailable)) != NULL
+			&& (end = (const char *) memchr(run, '"', nAvailable)) != NULL
+			&& (n = (size_t) (end - run)) > 0
+			&& n < (size_t) (TKN_MAX_STR_SIZE - 1 - t->tokenStringLen_)
+			&& memchr(run, '\\', n) == NULL
+			&& memchr(run, '\n', n) == NULL
+			&& memchr(run, '\0', n) == NULL)
+	{
+		memcpy(&t->tokenString_[t->tokenStringLen_], run, n);
+		t->tokenStringLen_ += (int) n;
+		ch = (unsigned char) run[n - 1];
+		tknSkipRun(t, n);
+	}
+
 	/* get the string */
 	readch = getAChar(t);
 	while ((readch != EOF) && (readch != '"') && (readch != '\n'))
@@ -534,7 +842,7 @@ tknIsIdChar(int ch)
 int
 getNumber(tokenizer * t, int ch)
 {
-	char           *endp;
+	int             start, i;
 	int             sign = 1;
 	int             returnType = TT_INTEGER;
 
@@ -566,6 +874,13 @@ getNumber(tokenizer * t, int ch)
 		}
 
 
+		start = t->tokenStringLen_;
+		if (tknCopyDigits(t) > 0)
+			returnType = TT_INTEGER;
+		for (i = start; i < t->tokenStringLen_; i++)
+			t->token_.data_.ival_ = t->token_.data_.ival_ * 10
+					+ (t->tokenString_[i] - '0');
+
 		while ((ch = getAChar(t)) != TT_EOF && isdigit(ch))
 		{
 			returnType = TT_INTEGER;
@@ -588,6 +903,7 @@ getNumber(tokenizer * t, int ch)
 	{
 		t->tokenString_[t->tokenStringLen_++] = (char) ch;
 
+		(void) tknCopyDigits(t);
 		while ((ch = getAChar(t)) != TT_EOF && isdigit(ch))
 		{
 			t->tokenString_[t->tokenStringLen_++] = (char) ch;
@@ -596,7 +912,7 @@ getNumber(tokenizer * t, int ch)
 		t->saveCh_ = ch;
 
 		/* get the value out of the string */
-		t->token_.data_.dval_ = strtod(t->tokenString_, &endp);
+		t->token_.data_.dval_ = tknParseReal(t->tokenString_);
 		returnType = TT_REAL;
 	} else
 	{
@@ -628,6 +944,7 @@ getNumber(tokenizer * t, int ch)
 		}
 
 		/** handle the value of the exponent */
+		(void) tknCopyDigits(t);
 		while ((ch = getAChar(t)) != TT_EOF && isdigit(ch))
 		{
 			t->tokenString_[t->tokenStringLen_++] = (char) ch;
@@ -636,7 +953,7 @@ getNumber(tokenizer * t, int ch)
 		t->saveCh_ = ch;
 
 		/* get the value out of the string */
-		t->token_.data_.dval_ = strtod(t->tokenString_, &endp);
+		t->token_.data_.dval_ = tknParseReal(t->tokenString_);
 		return (TT_REAL);
 	} else
 	{
@@ -649,12 +966,27 @@ getNumber(tokenizer * t, int ch)
 int
 getIdentifier(tokenizer * t, int ch)
 {
+	const char     *run;
+	size_t          nAvailable, n;
+
 	if (t->tokenStringLen_ == 0)
 	{
 		t->token_.data_.strptr_ = t->tokenString_;
 	}
 	t->tokenString_[t->tokenStringLen_++] = (char) ch;
 
+	/** copy the run of identifier characters at once */
+	if ((run = tknPeekRun(t, &nAvailable)) != NULL)
+	{
+		if (nAvailable > (size_t) (TKN_MAX_STR_SIZE - 1 - t->tokenStringLen_))
+			nAvailable = TKN_MAX_STR_SIZE - 1 - t->tokenStringLen_;
+		for (n = 0; n < nAvailable && TKN_IS_ID(run[n]); n++)
+			;
+		memcpy(&t->tokenString_[t->tokenStringLen_], run, n);
+		t->tokenStringLen_ += (int) n;
+		tknSkipRun(t, n);
+	}
+
 	while ((ch = (int) getAChar(t)) != TT_EOF && tknIsIdChar(ch))
 		t->tokenString_[t->tokenStringLen_++] = (char) ch;
 	t->saveCh_ = ch;
@@ -666,6 +998,8 @@ getIdentifier(tokenizer * t, int ch)
 static int
 rToken(tokenizer * t)
 {
+	const char     *run, *end;
+	size_t          nAvailable;
 	int ch;
 
 	t->tokenStringLen_ = 0;
@@ -699,6 +1033,10 @@ rToken(tokenizer * t)
 			{
 				return ch;
 			}
+			if ((run = tknPeekRun(t, &nAvailable)) != NULL
+					&& (end = (const char *)
+							memchr(run, '\n', nAvailable)) != NULL)
+				tknSkipRun(t, (size_t) (end - run));
 			while ((ch = getAChar(t)) != TT_EOF)
 			{
 				if (ch == '\n')
@@ -0,0 +1,76 @@
+/** ------------------------------------------------------------
+ ** Bump allocation of blocks which are all freed together
+ ** ------------------------------------------------------------
+ ** $Id$
+ **/
+
+#ifndef         ARENA_HEADER__
+#define         ARENA_HEADER__
+
+#ifndef MAKEDEPEND
+# include       <stddef.h>
+#endif
+
+#include        "os_defs.h"
+
+/**
+ ** An arena hands out blocks from the end of its newest chunk,
+ ** starting a new chunk (twice the size of the last, up to the
+ ** maximum chunk size) when that one is full.  Nothing is freed until
+ ** arenaRelease(), which frees every chunk at once.
+ **
+ ** As blocks are only ever taken from the end of the newest
+ ** chunk, the blocks in each chunk lie in the order they were
+ ** allocated; with an alignment that divides every block size
+ ** there is no padding between them, so that the chunks can be
+ ** written out in turn as one run of records.
+ **
+ ** An arena of all zeros is empty and uses the default sizes.
+ **/
+typedef struct arenaChunk arenaChunk;
+
+typedef struct Arena {
+    arenaChunk  *ar_first;
+    arenaChunk  *ar_last;
+    size_t      ar_firstChunkSize;
+    size_t      ar_nextChunkSize;
+    size_t      ar_maxChunkSize;
+    size_t      ar_alignment;
+    size_t      ar_nBytesUsed;
+    int         ar_nChunks;
+} Arena;
+
+/**
+ ** Called for each chunk in allocation order with the bytes
+ ** used in it; returns 1 to continue, 0 to stop
+ **/
+typedef int (*arenaChunkFunction)(const void *data,
+			size_t nBytes, void *userData);
+
+#define ARENA_DEFAULT_CHUNK_SIZE    (64 * 1024)
+#define ARENA_MAX_CHUNK_SIZE        (8 * 1024 * 1024)
+#define ARENA_DEFAULT_ALIGNMENT     sizeof(double)
+
+#ifndef         lint
+/**
+ ** PROTOTYPES
+ **/
+
+# if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+# endif
+
+    /** arena.c **/
+OS_EXPORT void arenaInit(Arena *arena, size_t firstChunkSize,
+			size_t maxChunkSize, size_t alignment);
+OS_EXPORT void *arenaAlloc(Arena *arena, size_t size);
+OS_EXPORT void arenaRelease(Arena *arena);
+OS_EXPORT int arenaForEachChunk(const Arena *arena,
+			arenaChunkFunction function, void *userData);
+
+# if defined(__cplusplus) || defined(c_plusplus)
+}
+# endif
+#endif
+
+#endif  /* ARENA_HEADER__ */
@@ -25,6 +25,12 @@ OS_EXPORT int   convolve(
                                 int isign, double *ans, double deltaT
                         );
 
+OS_EXPORT int   directConvolve(
+                                double *wfn, int wfnSize,
+                                double *cur, int curSize,
+                                double *conv_res, float z_inc
+                        );
+
 
 OS_EXPORT int adjustConvArtifact(
 				int NI,
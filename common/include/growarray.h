@@ -0,0 +1,323 @@
+/** ------------------------------------------------------------
+ ** Typed arrays which grow by doubling
+ ** ------------------------------------------------------------
+ ** $Id$
+ **/
+
+#ifndef         GROW_ARRAY_HEADER__
+#define         GROW_ARRAY_HEADER__
+
+#ifndef MAKEDEPEND
+# include       <string.h>
+#endif
+
+#include        "os_defs.h"
+#include        "tclCkalloc.h"
+#include        "listalloc.h"
+
+/**
+ ** C interface.  A GROW_ARRAY(type) is a struct holding the
+ ** data, the number of elements in use and the number allocated,
+ ** grown with growArrayReserve(), so that the data is always a
+ ** plain ckalloc()'ed array which may be handed on and freed
+ ** with ckfree() as any other list:
+ **
+ **     GROW_ARRAY(int) ids;
+ **
+ **     growArrayInit(ids);
+ **     if ( ! growArrayAppend(ids, 42) )
+ **         ... out of memory ...
+ **     ... ids.ga_data[0 .. ids.ga_n - 1] ...
+ **     growArrayFree(ids);
+ **/
+#define GROW_ARRAY(type) \
+		struct { type *ga_data; int ga_n; int ga_nAllocated; }
+
+#define growArrayInit(array) \
+		((array).ga_data = NULL, \
+				(array).ga_n = 0, \
+				(array).ga_nAllocated = 0)
+
+/** make room for at least n elements; returns 0 on failure */
+#define growArrayReserveFor(array, n) \
+		growArrayReserve((n), (void **) &(array).ga_data, \
+				&(array).ga_nAllocated, sizeof(*(array).ga_data))
+
+/** add a value at the end; returns 0 on failure */
+#define growArrayAppend(array, value) \
+		(growArrayReserveFor(array, (array).ga_n + 1) \
+				? ((array).ga_data[(array).ga_n++] = (value), 1) \
+				: 0)
+
+/** release the unused part of the allocation */
+#define growArrayShrinkToFit(array) \
+		growArrayShrink((array).ga_n, (void **) &(array).ga_data, \
+				&(array).ga_nAllocated, sizeof(*(array).ga_data))
+
+#define growArrayFree(array) \
+		do { \
+			if ((array).ga_data != NULL) \
+				ckfree((array).ga_data); \
+			growArrayInit(array); \
+		} while (0)
+
+
+#if defined(__cplusplus)
+
+/**
+CLASS
+		GrowArray
+
+	A typed array which grows by doubling, for plain data types
+	only -- elements are moved with memcpy() and are never
+	constructed or destroyed.
+	<p>
+	Up to NInline elements are held in the object itself, so a
+	short-lived array which stays small never allocates.  Beyond
+	that the data is held in a ckalloc()'ed block, which may be
+	taken over with release() and later freed with ckfree().
+ **/
+template <class T, int NInline = 0> class GrowArray
+{
+protected:
+	T *data_;
+	int n_;
+	int nAllocated_;
+	T inline_[NInline > 0 ? NInline : 1];
+
+public:
+	////////////////////////////////////////
+	// Constructor
+	GrowArray();
+
+	////////////////////////////////////////
+	// Destructor
+	~GrowArray();
+
+	////////////////////////////////////////
+	// return the number of elements in use
+	int getLength() const;
+
+	////////////////////////////////////////
+	// return the number of elements allocated
+	int getAllocated() const;
+
+	////////////////////////////////////////
+	// set the number of elements in use; new
+	// elements are zeroed.  Returns 0 on failure
+	int setLength(int length);
+
+	////////////////////////////////////////
+	// make room for at least nNeeded elements
+	// without changing the length; returns 0
+	// on failure
+	int reserve(int nNeeded);
+
+	////////////////////////////////////////
+	// release the unused part of the allocation,
+	// moving back to the inline elements if
+	// they are now large enough
+	int shrinkToFit();
+
+	////////////////////////////////////////
+	// Add a value at the end, increasing the
+	// length; returns 0 on failure
+	int append(const T& value);
+
+	////////////////////////////////////////
+	// Returns a reference to the element.
+	T& operator[] (int index);
+	const T& operator[] (int index) const;
+
+	////////////////////////////////////////
+	// Returns the elements as a plain array,
+	// valid until the array next grows
+	T *getData();
+	const T *getData() const;
+
+	////////////////////////////////////////
+	// Hand the elements over to the caller as
+	// a ckalloc()'ed array (NULL if there are
+	// none), leaving this array empty
+	T *release(int *length);
+
+	////////////////////////////////////////
+	// Free the elements, leaving this array empty
+	void clear();
+
+private:
+	// not copyable
+	GrowArray(const GrowArray&);
+	GrowArray& operator= (const GrowArray&);
+};
+
+template <class T, int NInline>
+GrowArray<T, NInline>::GrowArray()
+{
+	n_ = 0;
+	if (NInline > 0)
+	{
+		data_ = inline_;
+		nAllocated_ = NInline;
+	} else
+	{
+		data_ = NULL;
+		nAllocated_ = 0;
+	}
+	memset(inline_, 0, sizeof(inline_));
+}
+
+template <class T, int NInline>
+GrowArray<T, NInline>::~GrowArray()
+{
+	clear();
+}
+
+template <class T, int NInline>
+inline int GrowArray<T, NInline>::getLength() const
+{
+	return n_;
+}
+
+template <class T, int NInline>
+inline int GrowArray<T, NInline>::getAllocated() const
+{
+	return nAllocated_;
+}
+
+template <class T, int NInline>
+int GrowArray<T, NInline>::reserve(int nNeeded)
+{
+	T *heap = NULL;
+	int nHeap = 0;
+
+	if (nNeeded <= nAllocated_)
+		return 1;
+
+	if (data_ != inline_)
+		return growArrayReserve(nNeeded,
+				(void **) &data_, &nAllocated_, sizeof(T));
+
+	/** moving out of the inline elements; still double */
+	if (nNeeded < 2 * nAllocated_)
+		nNeeded = 2 * nAllocated_;
+	if ( ! growArrayReserve(nNeeded, (void **) &heap, &nHeap, sizeof(T)) )
+		return 0;
+	memcpy(heap, inline_, n_ * sizeof(T));
+	data_ = heap;
+	nAllocated_ = nHeap;
+	return 1;
+}
+
+template <class T, int NInline>
+int GrowArray<T, NInline>::setLength(int length)
+{
+	if ( ! reserve(length) )
+		return 0;
+	if (length > n_)
+		memset(&data_[n_], 0, (length - n_) * sizeof(T));
+	n_ = length;
+	return 1;
+}
+
+template <class T, int NInline>
+int GrowArray<T, NInline>::shrinkToFit()
+{
+	if (data_ == inline_)
+		return 1;
+
+	if (NInline > 0 && n_ <= NInline)
+	{
+		memcpy(inline_, data_, n_ * sizeof(T));
+		if (data_ != NULL)
+			ckfree(data_);
+		data_ = inline_;
+		nAllocated_ = NInline;
+		return 1;
+	}
+	return growArrayShrink(n_, (void **) &data_, &nAllocated_, sizeof(T));
+}
+
+template <class T, int NInline>
+inline int GrowArray<T, NInline>::append(const T& value)
+{
+	if (n_ >= nAllocated_ && ! reserve(n_ + 1))
+		return 0;
+	data_[n_++] = value;
+	return 1;
+}
+
+template <class T, int NInline>
+inline T& GrowArray<T, NInline>::operator[] (int index)
+{
+	return data_[index];
+}
+
+template <class T, int NInline>
+inline const T& GrowArray<T, NInline>::operator[] (int index) const
+{
+	return data_[index];
+}
+
+template <class T, int NInline>
+inline T *GrowArray<T, NInline>::getData()
+{
+	return data_;
+}
+
+template <class T, int NInline>
+inline const T *GrowArray<T, NInline>::getData() const
+{
+	return data_;
+}
+
+template <class T, int NInline>
+T *GrowArray<T, NInline>::release(int *length)
+{
+	T *result;
+
+	if (length != NULL)
+		*length = n_;
+
+	if (n_ == 0)
+	{
+		clear();
+		return NULL;
+	}
+
+	if (data_ == inline_)
+	{
+		result = (T *) ckalloc(n_ * sizeof(T));
+		if (result == NULL)
+			return NULL;
+		memcpy(result, inline_, n_ * sizeof(T));
+	} else
+	{
+		result = data_;
+		data_ = NULL;
+	}
+	n_ = 0;
+	clear();
+	return result;
+}
+
+template <class T, int NInline>
+void GrowArray<T, NInline>::clear()
+{
+	if (data_ != inline_ && data_ != NULL)
+		ckfree(data_);
+	n_ = 0;
+	if (NInline > 0)
+	{
+		data_ = inline_;
+		nAllocated_ = NInline;
+	} else
+	{
+		data_ = NULL;
+		nAllocated_ = 0;
+	}
+}
+
+#endif  /* __cplusplus */
+
+#endif  /* GROW_ARRAY_HEADER__ */
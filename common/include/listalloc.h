@@ -43,6 +43,51 @@ OS_EXPORT int listMkCheckSize(int size_needed, void **list,
 				int *cur_blocks, int blksize, int tilesize,
 				const char *filemark, int linemark);
 
+/**
+ ** Grow a list to hold at least size_needed tiles, at least
+ ** doubling its allocation each time so that appending n tiles
+ ** one at a time copies O(n) of them in all.  Unlike
+ ** listCheckSize(), *n_allocated holds the allocation in tiles,
+ ** not blocks.  As with listCheckSize(), the list is allocated
+ ** with ckalloc() and the tiles beyond those copied are zeroed.
+ **/
+#define growArrayReserve(size_needed, list, n_allocated, tilesize) \
+		growArrayMkReserve(size_needed, list, \
+				n_allocated, tilesize, __FILE__, __LINE__)
+
+/**
+ ** Reallocate a list to hold exactly n_used tiles, freeing it
+ ** altogether if n_used is zero
+ **/
+#define growArrayShrink(n_used, list, n_allocated, tilesize) \
+		growArrayMkShrink(n_used, list, \
+				n_allocated, tilesize, __FILE__, __LINE__)
+
+#define GROW_ARRAY_MIN_ALLOCATION	4
+
+OS_EXPORT int growArrayMkReserve(int size_needed, void **list,
+				int *n_allocated, int tilesize,
+				const char *filemark, int linemark);
+
+OS_EXPORT int growArrayMkShrink(int n_used, void **list,
+				int *n_allocated, int tilesize,
+				const char *filemark, int linemark);
+
+/**
+ ** Counts of the reallocations made by listCheckSize() and
+ ** growArrayReserve() on the calling thread, so that the cost
+ ** of growing lists may be compared
+ **/
+typedef struct ListGrowthStats {
+    long        lg_nAllocations;    /* lists allocated or reallocated */
+    long        lg_nCopies;         /* of those, ones which copied data */
+    long        lg_nBytesCopied;    /* bytes copied by them */
+} ListGrowthStats;
+
+OS_EXPORT void listGetGrowthStats(ListGrowthStats *stats);
+
+OS_EXPORT void listResetGrowthStats(void);
+
 
 OS_EXPORT lsBag *lsCreate(const char *name, int blocksize);
 
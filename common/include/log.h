@@ -109,6 +109,33 @@
 
 #endif
 
+/**
+ ** ------------------------------------------------------------
+ ** LOG_IF() checks the level before the message's arguments
+ ** are even evaluated, so a filtered message costs nothing:
+ **
+ **     LOG_IF(LOG_INFO, LogInfo("%s\n", expensiveSummary()));
+ **
+ ** LOG_PROGRESS() does the same for a progress message made in
+ ** a loop, and logs it at most once every
+ ** LogSetProgressInterval() seconds from each place it is used
+ ** ------------------------------------------------------------
+ **/
+#define         LOG_IF(_log_level, _log_call) \
+                    do { \
+                        if ( LogLevelEnabled(_log_level) ) { \
+                            (void) _log_call; \
+                        } \
+                    } while ( 0 )
+
+#define         LOG_PROGRESS(_log_call) \
+                    do { \
+                        static OS_THREAD_LOCAL double _log_last = 0; \
+                        if ( LogProgressDue(&_log_last) ) { \
+                            (void) _log_call; \
+                        } \
+                    } while ( 0 )
+
 #ifndef         lint
 /**
  ** PROTOTYPES
@@ -158,6 +185,14 @@ OS_EXPORT int LogFunction(
 OS_EXPORT void (*LogGetLogFunction()) (void *, int, char *, int);
 OS_EXPORT void *LogGetLogFunctionUserData();
 
+OS_EXPORT int LogSetLevel(int level);
+OS_EXPORT int LogLevelEnabled(int level);
+OS_EXPORT void LogSetProgressInterval(double seconds);
+OS_EXPORT int LogProgressDue(double *lastLogTime);
+
+OS_EXPORT int LogStartWriter(void);
+OS_EXPORT int LogStopWriter(void);
+
 OS_EXPORT int LogIsOpened_(void);
 OS_EXPORT void LogFlush(void);
 OS_EXPORT char *LogPromptUser(const char *message);
@@ -271,6 +271,15 @@
 # endif
 #endif
 
+/**
+ ** Storage class for data of which each thread has its own copy
+ **/
+#if defined( OS_WINDOWS_NT )
+# define OS_THREAD_LOCAL	__declspec(thread)
+#else
+# define OS_THREAD_LOCAL	__thread
+#endif
+
 /**
  ** This ensures that when we include string.h we will get the 
  ** reentrant version of strtok.
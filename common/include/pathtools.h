@@ -22,6 +22,19 @@ typedef struct DirList {
         const char *directory_name;
 } DirList;
 
+/** name of the run catalogue kept in a directory */
+#define         RUN_CATALOG_FILENAME    "catalog.runs"
+#define         RUN_CATALOG_MAX_HASH    64
+#define         RUN_CATALOG_MAX_FIELD   256
+
+/** one run recorded in a run catalogue */
+typedef struct RunCatalogEntry {
+        int rc_id;
+        char rc_configHash[RUN_CATALOG_MAX_HASH];
+        char rc_stageHashes[RUN_CATALOG_MAX_FIELD];
+        char rc_path[FILENAME_MAX];
+} RunCatalogEntry;
+
 
 
 #ifndef         lint
@@ -48,6 +61,14 @@ OS_EXPORT DirList *dirListLoadEntries(const char *path,
 OS_EXPORT void dirListDelete(DirList *list);
 OS_EXPORT int dirToolsGetNextId(const char *path, const char *mask);
 
+    /** runcatalog.c **/
+OS_EXPORT int runCatalogNextId(const char *path, const char *mask,
+		int firstId);
+OS_EXPORT int runCatalogRecord(const char *path,
+		const RunCatalogEntry *entry);
+OS_EXPORT int runCatalogFind(const char *path, const char *configHash,
+		RunCatalogEntry *entry);
+
 
 OS_EXPORT char *getPathStem(const char *path, ...);
 
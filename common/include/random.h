@@ -45,6 +45,26 @@
 # endif
 #endif
 
+/**
+ ** Independent random streams.
+ **
+ ** Each stream carries its own copy of the ran2 generator state
+ ** (and the spare Box-Muller deviate), so that several streams may
+ ** be drawn from concurrently, and a given seed always reproduces
+ ** the same sequence regardless of what other streams are doing.
+ **/
+#define         RANDOM_STREAM_NTAB      32
+
+typedef struct randomStream
+{
+    long        rs_idum;
+    long        rs_idum2;
+    long        rs_iy;
+    long        rs_iv[RANDOM_STREAM_NTAB];
+    int         rs_gaussIsSet;
+    double      rs_gaussSaved;
+} randomStream;
+
 #ifndef         lint
 /** 
  ** PROTOTYPES
@@ -75,6 +95,13 @@ OS_EXPORT float sigmaInt(int nValues, int *values, float mu);
 
 OS_EXPORT double nr_ran2(long *idum);
 
+OS_EXPORT long randomStreamDeriveSeed(long baseSeed, long streamId);
+OS_EXPORT void seedRandomStream(randomStream *stream, long seed);
+OS_EXPORT randomStream *setLocalRandomStream(randomStream *stream);
+OS_EXPORT double randomStreamDouble(randomStream *stream);
+OS_EXPORT float randomStreamFloat(randomStream *stream);
+OS_EXPORT double randomStreamGauss01(randomStream *stream);
+
 extern int gDumpRandom;
  
 
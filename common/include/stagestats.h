@@ -0,0 +1,96 @@
+/** ------------------------------------------------------------
+ ** Per-stage timing, event counters and memory high water marks
+ ** ------------------------------------------------------------
+ ** $Id$
+ **
+ ** Stages are opened and closed in a nested fashion; each keeps
+ ** the number of times it was entered, the monotonic wall clock
+ ** and process CPU time spent in it, the peak resident set size
+ ** seen when it closed, and any counters added while it was the
+ ** innermost open stage.  The statistics belong to the calling
+ ** thread, so simulations on separate threads keep their own;
+ ** counters should be added from the thread which opened the
+ ** stage.
+ **
+ ** Stage and counter names are kept by pointer, so they must be
+ ** string constants.
+ **
+ ** Statistics are enabled per thread as well.  When they are
+ ** disabled every call returns at once, and STAGESTATS_COUNT does
+ ** not even make the call.
+ **/
+
+#ifndef         STAGESTATS_HEADER__
+#define         STAGESTATS_HEADER__
+
+#include        "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include       <stdio.h>
+#endif
+
+/** limits on the distinct stages and counters recorded */
+#define         STAGESTATS_MAX_STAGES           48
+#define         STAGESTATS_MAX_COUNTERS         32
+#define         STAGESTATS_MAX_DEPTH            16
+
+/** add to a counter, without a call when statistics are off */
+#define         STAGESTATS_COUNT(name, amount)                          \
+		do {                                                            \
+			if (gStageStatsEnabled)                                     \
+				stageStatsCount((name), (osInt64) (amount));            \
+		} while (0)
+
+#ifndef         lint
+/**
+ ** PROTOTYPES
+ **/
+
+# if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+# endif
+
+/** non-zero when the calling thread is gathering statistics */
+extern OS_THREAD_LOCAL int gStageStatsEnabled;
+
+    /** stagestats.c **/
+/** start or stop gathering statistics on the calling thread */
+OS_EXPORT void stageStatsSetEnabled(int enabled);
+
+/** clear the statistics of the calling thread */
+OS_EXPORT void stageStatsReset(void);
+
+/**
+ ** open a stage nested in the current one, returning 1 if it
+ ** was opened (and so must be closed)
+ **/
+OS_EXPORT int stageStatsBegin(const char *name);
+
+/** close the innermost open stage */
+OS_EXPORT void stageStatsEnd(void);
+
+/** add to a counter of the innermost open stage */
+OS_EXPORT void stageStatsCount(const char *name, osInt64 amount);
+
+/** clocks, in seconds from an arbitrary origin */
+OS_EXPORT double stageStatsWallClock(void);
+OS_EXPORT double stageStatsCPUClock(void);
+
+/** peak resident set size of the process, in kB (0 if unknown) */
+OS_EXPORT osInt64 stageStatsPeakRSS(void);
+
+/**
+ ** write the statistics of the calling thread as a JSON object,
+ ** returning 0 on failure
+ **/
+OS_EXPORT int stageStatsWriteJSON(FILE *fp, const char *description);
+
+/** release the statistics of the calling thread */
+OS_EXPORT void stageStatsCleanup(void);
+
+# if defined(__cplusplus) || defined(c_plusplus)
+}
+# endif
+#endif
+
+#endif  /* STAGESTATS_HEADER__ */
@@ -120,13 +120,53 @@ extern "C" {
 # endif
 
 /*
- * The following declarations either map ckalloc and ckfree to
- * malloc and free, or they map them to procedures with all sorts
- * of debugging hooks defined in tclCkalloc.c.
+ * The following declarations map ckalloc and ckfree to one of:
+ *
+ *   TCL_MEM_DEBUG  - procedures with all sorts of debugging hooks
+ *                    defined in tclCkalloc.c
+ *   TCL_MEM_FAST   - the thread caching allocator in ckfast.c,
+ *                    which tracks only a sample of the blocks
+ *                    (one in TCL_MEM_SAMPLE, if that is defined)
+ *   neither        - malloc and free
+ *
+ * Every file in a program must be built with the same choice.
  */
 
 #define DEFAULT_DUMP_FILE	"ckalloc.log"
 
+/**
+ * Allocation counts for the calling thread.  A block freed by
+ * another thread than the one which allocated it is counted
+ * against the thread which frees it.
+ */
+typedef struct CkallocStats {
+	long cs_mallocs;
+	long cs_frees;
+	long cs_reused;			/* served from the thread cache */
+	long cs_sampled;		/* tracked for the leak report */
+	long cs_currentBytes;
+	long cs_maximumBytes;
+} CkallocStats;
+
+OS_EXPORT void	ckallocGetThreadStats(CkallocStats *stats);
+OS_EXPORT void	ckallocResetThreadStats(void);
+OS_EXPORT void	ckallocSetSampleInterval(int interval);
+OS_EXPORT int	ckallocGetSampleInterval(void);
+OS_EXPORT void	ckallocReleaseThreadCache(void);
+
+OS_EXPORT void	ckallocCountAlloc(unsigned int size);
+OS_EXPORT void	ckallocCountFree(unsigned int size);
+
+OS_EXPORT void*	Ck_FastAlloc(unsigned int size,
+			const char *file, int line);
+OS_EXPORT void	Ck_FastFree(void *ptr);
+OS_EXPORT void*	Ck_FastRealloc(void *ptr,
+			unsigned int size, const char *file, int line);
+OS_EXPORT char*	Ck_FastStrdup(const char *string,
+			const char *file, int line);
+OS_EXPORT int	Ck_FastDumpSampledMemoryToFP(FILE *);
+OS_EXPORT int	Ck_FastDumpSampledMemory(const char *fileName);
+
 #ifdef TCL_MEM_DEBUG
 
 #define	VALIDATE_MEMORY	Tcl_ValidateAllMemory(__FILE__, __LINE__)
@@ -162,6 +202,19 @@ OS_EXPORT void	Tcl_ValidateAllMemory(const char *file,
 #  define ckstrdup(x) Tcl_DbCkstrdup(x, __FILE__, __LINE__)
 #  define ckrealloc(x,y) Tcl_DbCkrealloc((x), (y),__FILE__, __LINE__)
 
+#elif defined(TCL_MEM_FAST)
+
+#define	 VALIDATE_MEMORY	(void) 0
+#define	 DUMP_MEMORY	Ck_FastDumpSampledMemory(DEFAULT_DUMP_FILE)
+
+#  define ckalloc(x)		Ck_FastAlloc(x, __FILE__, __LINE__)
+#  define ckmkalloc(x,f,l)	Ck_FastAlloc(x, f, l)
+#  define ckfree(x)		Ck_FastFree(x)
+#  define ckstrdup(x)		Ck_FastStrdup(x, __FILE__, __LINE__)
+#  define ckrealloc(x,y)	Ck_FastRealloc((x), (y), __FILE__, __LINE__)
+#  define Tcl_DumpActiveMemory(x)	Ck_FastDumpSampledMemory(x)
+#  define Tcl_ValidateAllMemory(x,y)
+
 #else
 
 #define	 VALIDATE_MEMORY	(void) 0
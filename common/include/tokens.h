@@ -35,6 +35,7 @@ struct tokenizerString
 {
     char *data_;
     size_t offset_;
+    size_t length_;
 };
 
 struct tokenizerStrList
@@ -44,9 +45,24 @@ struct tokenizerStrList
     size_t charOffset_;
 };
 
+/**
+ * A regular file is read from a mapping of (or failing that, a
+ * single block read of) the rest of the file, rather than one
+ * character at a time; when the tokenizer is deleted the file is
+ * left positioned just after the last character consumed, as it
+ * would have been by reading through ifp_.
+ */
 struct tokenizerFile
 {
     FILE *ifp_;
+    int state_;
+    const char *buffer_;
+    size_t offset_;
+    size_t length_;
+    long startPos_;
+    void *map_;
+    size_t mapLength_;
+    char *block_;
 };
 
 typedef struct tokenizer
@@ -0,0 +1,45 @@
+/** ------------------------------------------------------------
+ ** Worker pool for running independent tasks concurrently
+ ** ------------------------------------------------------------
+ ** $Id$
+ **/
+
+#ifndef         WORKPOOL_HEADER__
+#define         WORKPOOL_HEADER__
+
+#include        "os_defs.h"
+
+/**
+ ** A task is called once for each index 0 .. nTasks-1, in no
+ ** particular order and possibly from several threads at once.
+ ** It must only touch state belonging to its own index, and
+ ** returns 1 on success and 0 on failure.
+ **/
+typedef int (*workPoolTask)(int taskIndex, void *userData);
+
+#ifndef         lint
+/**
+ ** PROTOTYPES
+ **/
+
+# if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+# endif
+
+    /** workpool.c **/
+OS_EXPORT int workPoolGetNumProcessors(void);
+OS_EXPORT int workPoolResolveThreads(int requestedThreads, int nTasks);
+OS_EXPORT int workPoolRun(
+			int nTasks,
+			int nThreads,
+			workPoolTask task,
+			void *userData
+		    );
+
+# if defined(__cplusplus) || defined(c_plusplus)
+}
+# endif
+#endif
+
+#endif  /* WORKPOOL_HEADER__ */
+
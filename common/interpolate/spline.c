@@ -7,6 +7,14 @@
 #include "log.h"
 #include "tclCkalloc.h"
 
+/**
+ ** The interpolation below is called for each point of each
+ ** separated MFP with only a handful of control points, so
+ ** the work arrays are kept on the stack up to this size and
+ ** allocated only beyond it
+ **/
+#define	SPLINE_STACK_POINTS	32
+
 
 /**
  ** NR in C, 2nd ed. pp 115.
@@ -33,9 +41,11 @@ nrSpline(
 {
 	int             i, k;
 	double          p, qn, sig, un;
-	double         *u;
+	double          uStack[SPLINE_STACK_POINTS + 1];
+	double         *u = uStack;
 
-	u = (double *) malloc(sizeof(double) * (n + 1));
+	if (n > SPLINE_STACK_POINTS)
+		u = (double *) malloc(sizeof(double) * (n + 1));
 
 	/**
 	 ** the lower boundary condition is set either to be "natural",
@@ -88,7 +98,8 @@ nrSpline(
 		y2[k] = (float) (y2[k] * y2[k + 1] + u[k]);
 	}
 
-	free(u);
+	if (u != uStack)
+		free(u);
 }
 
 /**
@@ -173,9 +184,12 @@ cubicSplineInterpolation(
 		int index
 	)
 {
-	float          *times;
-	float          *workingData;
-	float          *splineControlPoints;
+	float           timesStack[SPLINE_STACK_POINTS + 1];
+	float           workingDataStack[SPLINE_STACK_POINTS + 1];
+	float           splineControlPointsStack[SPLINE_STACK_POINTS + 1];
+	float          *times = timesStack;
+	float          *workingData = workingDataStack;
+	float          *splineControlPoints = splineControlPointsStack;
 	int             j;
 
 
@@ -184,10 +198,13 @@ cubicSplineInterpolation(
 		float           slopeAtStart, slopeAtEnd;
 
 
-		times = ckalloc(sizeof(float) * (2 * numControlPoints + 1));
-		workingData = ckalloc(sizeof(float) * (2 * numControlPoints + 1));
-		splineControlPoints
-			= ckalloc(sizeof(float) * (2 * numControlPoints + 1));
+		if (2 * numControlPoints > SPLINE_STACK_POINTS)
+		{
+			times = ckalloc(sizeof(float) * (2 * numControlPoints + 1));
+			workingData = ckalloc(sizeof(float) * (2 * numControlPoints + 1));
+			splineControlPoints
+				= ckalloc(sizeof(float) * (2 * numControlPoints + 1));
+		}
 
 
 		/**
@@ -263,9 +280,12 @@ cubicSplineInterpolation(
 
 
 	/** delete arrays used in interpolation */
-	ckfree(splineControlPoints);
-	ckfree(workingData);
-	ckfree(times);
+	if (times != timesStack)
+	{
+		ckfree(splineControlPoints);
+		ckfree(workingData);
+		ckfree(times);
+	}
 
 	return 1;
 }
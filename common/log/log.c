@@ -23,6 +23,10 @@
 #include <stdlib.h>
 #include <time.h>
 #include <ctype.h>
+#include <signal.h>
+#ifndef                OS_WINDOWS_NT
+#include <pthread.h>
+#endif
 #endif
 
 #ifdef OS_WINDOWS
@@ -44,6 +48,7 @@
 #include "log.h"
 #include "listalloc.h"
 #include "msgir.h"
+#include "stagestats.h"
 
 
 
@@ -51,6 +56,24 @@
 #define                 LOG_BUFSIZE                     8192
 #define                 LOG_LOAD_BUFSIZE                4096
 
+/**
+ ** The background writer needs POSIX threads and the gcc atomic
+ ** builtins; without them every message is written as it is made
+ **/
+#if !defined(OS_WINDOWS_NT) && defined(__GNUC__)
+# define                LOG_USE_WRITER
+#endif
+
+/** slots in the writer's ring (a power of two) and text per slot **/
+#define                 LOG_RING_SLOTS                  4096
+#define                 LOG_SLOT_TEXT                   128
+
+/** longest the writer sleeps before looking at the ring again  **/
+#define                 LOG_WRITER_WAIT_MS              50
+
+/** default seconds between messages from one LOG_PROGRESS()    **/
+#define                 LOG_PROGRESS_INTERVAL           1.0
+
 /** local variables             **/
 static int      log_fd = (-1),
                 log_dest = LOGDEST_UNINIT,
@@ -58,16 +81,29 @@ static int      log_fd = (-1),
                 log_isInit = 0,
                 log_print_id_option = 1,
                 log_last_loglevel = 0,
+                log_max_level = LOG_DEBUG,
                 log_prevOutputOffset = 0;
-static char     log_obuf[LOG_BUFSIZE], log_writebuf[LOG_BUFSIZE], log_id_string[LOG_ID_LEN + 2], *log_filename = NULL, *log_progname = NULL;
+static double   log_progress_interval = LOG_PROGRESS_INTERVAL;
+static char     log_writebuf[LOG_BUFSIZE], *log_filename = NULL, *log_progname = NULL;
+
+/** messages are formatted by the thread making them            **/
+static OS_THREAD_LOCAL char log_obuf[LOG_BUFSIZE];
+static OS_THREAD_LOCAL char log_id_string[LOG_ID_LEN + 2];
+
+/** id of the message being written out                         **/
+static const char log_no_id[LOG_ID_LEN + 2] = "";
+static const char *log_output_id = log_no_id;
 
 /** local functions             **/
 static int 
 log_output_(
 		int logleve,
+		const char *id,
 		const char *string,
-		int useTime
+		int useTime,
+		time_t when
 	);
+static int      log_emit_(int loglevel, const char *string, int useTime);
 static int      log_output_id_(char *writebuffer);
 static int 
 log_flush_line_(
@@ -75,7 +111,7 @@ log_flush_line_(
 		char *msgline,
 		int withcr
 	);
-static int      log_print_time_(int loglevel);
+static int      log_print_time_(int loglevel, time_t when);
 static int      log_save_file_info_(const char *filename);
 static int      log_open_log_file_(void);
 static int      log_close_log_file_(void);
@@ -89,14 +125,17 @@ static void    *log_user_data = NULL;
  * actually print out the message
  */
 static int
-log_output_(loglevel, message, useTime)
+log_output_(loglevel, id, message, useTime, when)
     int             loglevel;
+    const char     *id;
     const char     *message;
     int             useTime;
+    time_t          when;
 {
 	static int      log_print_id_flag = 1;
 
 	log_last_loglevel = loglevel;
+	log_output_id = id;
 
 
 	while (*message)
@@ -126,7 +165,7 @@ log_output_(loglevel, message, useTime)
 			log_writebuf[log_prevOutputOffset] = 0;
 
 			if (useTime && log_time)
-				log_print_time_(loglevel);
+				log_print_time_(loglevel, when);
 
 			log_flush_line_(loglevel, log_writebuf, 0);
 
@@ -180,11 +219,11 @@ log_flush_line_(loglevel, msgline, withcr)
 
 
 static int
-log_print_time_(loglevel)
+log_print_time_(loglevel, curTime)
     int             loglevel;
+    time_t          curTime;
 {
 	static char     outBuf[256], *loadBuf = NULL;
-	time_t          curTime;
 	int             len;
 
 
@@ -202,7 +241,6 @@ log_print_time_(loglevel)
 	/** add in id               **/
 	log_output_id_(loadBuf);
 
-	curTime = time(NULL);
 	slnprintf(&loadBuf[LOG_ID_LEN + 1], LOG_BUFSIZE - (LOG_ID_LEN + 1),
 					"Time -- %s", ctime(&curTime));
 	len = strlen(outBuf);
@@ -223,6 +261,321 @@ log_print_time_(loglevel)
 }
 
 
+#ifdef LOG_USE_WRITER
+/**
+ ** Ring of messages waiting for the writer thread.  Any thread
+ ** claims the slots for a message by moving log_ring_head on with
+ ** a compare and swap, fills them in and then marks the first one
+ ** ready; only the thread draining the ring moves log_ring_tail.
+ ** A message longer than one slot runs on into the slots after it.
+ ** When the ring is full a message below LOG_ERR is counted and
+ ** dropped rather than making the caller wait; the count is
+ ** reported when the ring is next drained.  An error or anything
+ ** worse is instead written out by the caller itself, once the
+ ** ring ahead of it has been drained.
+ **/
+typedef struct logSlot {
+	volatile int    ls_ready;
+	int             ls_nSlots;
+	int             ls_loglevel;
+	int             ls_useTime;
+	time_t          ls_time;
+	char            ls_id[LOG_ID_LEN + 2];
+	char            ls_text[LOG_SLOT_TEXT];
+} logSlot;
+
+static logSlot *log_ring = NULL;
+static volatile unsigned long log_ring_head = 0, log_ring_tail = 0;
+static volatile long log_nDropped = 0;
+static volatile int log_writer_running = 0;
+static int log_catching_crashes = 0;
+static pthread_t log_writer_thread;
+static pthread_mutex_t log_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_cond = PTHREAD_COND_INITIALIZER;
+
+/** buffer the ring is drained into, used under the drain lock  **/
+static char log_drainbuf[LOG_BUFSIZE + LOG_SLOT_TEXT];
+static char log_drain_id[LOG_ID_LEN + 2];
+
+/**
+ ** Only one thread at a time drains the ring and writes out,
+ ** which also keeps whole lines together
+ **/
+static volatile int log_drain_lock = 0;
+# define LOCK_DRAIN()	\
+		do { \
+			while (__sync_lock_test_and_set(&log_drain_lock, 1)) \
+				while (log_drain_lock) ; \
+		} while (0)
+# define UNLOCK_DRAIN()	__sync_lock_release(&log_drain_lock)
+
+static void     log_drain_(void);
+
+/*
+ * write out a message which will not fit in the ring, after
+ * everything queued ahead of it
+ */
+static int
+log_output_now_(loglevel, message, useTime)
+    int             loglevel;
+    const char     *message;
+    int             useTime;
+{
+	int             status;
+
+	LOCK_DRAIN();
+	log_drain_();
+	status = log_output_(loglevel, log_id_string, message, useTime,
+				(useTime && log_time) ? time(NULL) : 0);
+	UNLOCK_DRAIN();
+	return (status);
+}
+
+/*
+ * queue a message for the writer thread
+ */
+static int
+log_enqueue_(loglevel, message, useTime)
+    int             loglevel;
+    const char     *message;
+    int             useTime;
+{
+	unsigned long   head;
+	logSlot        *slot;
+	int             len, nSlots, nCopy, i;
+
+	len = strlen(message);
+	nSlots = (len / LOG_SLOT_TEXT) + 1;
+
+	do
+	{
+		head = log_ring_head;
+		if (head + nSlots - log_ring_tail > LOG_RING_SLOTS)
+		{
+			if (loglevel <= LOG_ERR)
+				return (log_output_now_(loglevel, message, useTime));
+			(void) __sync_fetch_and_add(&log_nDropped, 1);
+			return (0);
+		}
+	} while ( ! __sync_bool_compare_and_swap(&log_ring_head,
+				head, head + nSlots) );
+
+	for (i = 0; i < nSlots; i++)
+	{
+		slot = &log_ring[(head + i) % LOG_RING_SLOTS];
+		nCopy = (i < nSlots - 1) ? LOG_SLOT_TEXT : len - i * LOG_SLOT_TEXT;
+		memcpy(slot->ls_text, &message[i * LOG_SLOT_TEXT], nCopy);
+		if (i == nSlots - 1)
+			slot->ls_text[nCopy] = 0;
+	}
+
+	slot = &log_ring[head % LOG_RING_SLOTS];
+	slot->ls_nSlots = nSlots;
+	slot->ls_loglevel = loglevel;
+	slot->ls_useTime = useTime;
+	slot->ls_time = (useTime && log_time) ? time(NULL) : 0;
+	memcpy(slot->ls_id, log_id_string, LOG_ID_LEN + 2);
+	__sync_synchronize();
+	slot->ls_ready = 1;
+
+	(void) pthread_cond_signal(&log_writer_cond);
+	return (1);
+}
+
+/*
+ * write out every message which is ready, in order; called with
+ * the drain lock held
+ */
+static void
+log_drain_()
+{
+	unsigned long   tail;
+	logSlot        *slot;
+	long            nDropped;
+	int             nSlots, loglevel, useTime;
+	time_t          when;
+	int             i;
+
+	if (log_ring == NULL)
+		return;
+
+	tail = log_ring_tail;
+	while (tail != log_ring_head)
+	{
+		slot = &log_ring[tail % LOG_RING_SLOTS];
+
+		/** still being filled in by the thread which claimed it */
+		if ( ! slot->ls_ready )
+			break;
+		__sync_synchronize();
+
+		nSlots = slot->ls_nSlots;
+		loglevel = slot->ls_loglevel;
+		useTime = slot->ls_useTime;
+		when = slot->ls_time;
+		memcpy(log_drain_id, slot->ls_id, LOG_ID_LEN + 2);
+		for (i = 0; i < nSlots; i++)
+		{
+			memcpy(&log_drainbuf[i * LOG_SLOT_TEXT],
+					log_ring[(tail + i) % LOG_RING_SLOTS].ls_text,
+					LOG_SLOT_TEXT);
+		}
+
+		/** hand the slots back before the (slow) write */
+		slot->ls_ready = 0;
+		__sync_synchronize();
+		tail += nSlots;
+		log_ring_tail = tail;
+
+		log_output_(loglevel, log_drain_id, log_drainbuf, useTime, when);
+	}
+
+	if (log_nDropped > 0)
+	{
+		nDropped = __sync_fetch_and_and(&log_nDropped, 0);
+		slnprintf(log_drainbuf, LOG_BUFSIZE,
+				"%ld log messages dropped -- log writer too slow\n",
+				nDropped);
+		memset(log_drain_id, 0, LOG_ID_LEN + 2);
+		log_output_(LOG_WARNING, log_drain_id, log_drainbuf, 0, 0);
+	}
+}
+
+/*
+ * the writer thread: sleep until there is something in the ring,
+ * then write it out
+ */
+static void *
+log_writer_(userData)
+    void           *userData;
+{
+	struct timespec wakeAt;
+
+	while (log_writer_running)
+	{
+		pthread_mutex_lock(&log_writer_mutex);
+		if (log_writer_running && log_ring_tail == log_ring_head)
+		{
+			clock_gettime(CLOCK_REALTIME, &wakeAt);
+			wakeAt.tv_nsec += LOG_WRITER_WAIT_MS * 1000000L;
+			if (wakeAt.tv_nsec >= 1000000000L)
+			{
+				wakeAt.tv_sec++;
+				wakeAt.tv_nsec -= 1000000000L;
+			}
+			(void) pthread_cond_timedwait(&log_writer_cond,
+					&log_writer_mutex, &wakeAt);
+		}
+		pthread_mutex_unlock(&log_writer_mutex);
+
+		LOCK_DRAIN();
+		log_drain_();
+		UNLOCK_DRAIN();
+	}
+
+	ckallocReleaseThreadCache();
+	return NULL;
+}
+
+/*
+ * on a crash, write out what is still queued before dying; the
+ * writer itself may be the thread which crashed, holding the lock
+ */
+static void
+log_crash_handler_(sig)
+    int             sig;
+{
+	int             i;
+
+	if ( ! (log_writer_running
+				&& pthread_equal(pthread_self(), log_writer_thread)) )
+	{
+		for (i = 0; i < 1000000
+				&& __sync_lock_test_and_set(&log_drain_lock, 1); i++)
+			;
+	}
+	log_drain_();
+	if (log_prevOutputOffset > 0)
+	{
+		log_writebuf[log_prevOutputOffset] = 0;
+		log_flush_line_(log_last_loglevel, log_writebuf, 1);
+	}
+
+	(void) signal(sig, SIG_DFL);
+	(void) raise(sig);
+}
+
+static void
+log_catch_signal_(sig)
+    int             sig;
+{
+	void            (*previous) (int);
+
+	/** leave alone any handler the program has set up itself */
+	previous = signal(sig, log_crash_handler_);
+	if (previous != SIG_DFL)
+		(void) signal(sig, previous);
+}
+
+static void
+log_at_exit_()
+{
+	(void) LogStopWriter();
+}
+
+static void
+log_catch_crashes_()
+{
+	if (log_catching_crashes)
+		return;
+	log_catching_crashes = 1;
+
+	log_catch_signal_(SIGSEGV);
+	log_catch_signal_(SIGFPE);
+	log_catch_signal_(SIGILL);
+	log_catch_signal_(SIGABRT);
+#ifdef SIGBUS
+	log_catch_signal_(SIGBUS);
+#endif
+	(void) atexit(log_at_exit_);
+}
+
+#else
+
+# define LOCK_DRAIN()		(void) 0
+# define UNLOCK_DRAIN()	(void) 0
+# define log_drain_()		(void) 0
+
+#endif  /* LOG_USE_WRITER */
+
+
+/*
+ * hand a formatted message to the writer, or write it out now
+ * if there is no writer running; the line being built up in
+ * log_writebuf is shared, so it is only touched under the drain
+ * lock
+ */
+static int
+log_emit_(loglevel, message, useTime)
+    int             loglevel;
+    const char     *message;
+    int             useTime;
+{
+	int             status;
+
+#ifdef LOG_USE_WRITER
+	if (log_writer_running)
+		return (log_enqueue_(loglevel, message, useTime));
+#endif
+	LOCK_DRAIN();
+	status = log_output_(loglevel, log_id_string, message, useTime,
+				(useTime && log_time) ? time(NULL) : 0);
+	UNLOCK_DRAIN();
+	return (status);
+}
+
+
+
 
 
 /*
@@ -232,7 +585,7 @@ static int
 log_output_id_(outbuf)
     char           *outbuf;
 {
-	memcpy(outbuf, log_id_string, LOG_ID_LEN + 1);
+	memcpy(outbuf, log_output_id, LOG_ID_LEN + 1);
 	outbuf[LOG_ID_LEN + 1] = 0;
 	return (1);
 }
@@ -280,6 +633,9 @@ LogMessage_(const char *fmt,...)
 {
 	va_list         vargs;
 
+	if (LOG_DEBUG > log_max_level)
+		return (1);
+
 	va_start(vargs, fmt);
 #ifdef		OS_HAS_SNPRINTF
 	(void) vsnprintf(log_obuf, LOG_BUFSIZE, fmt, vargs);
@@ -288,7 +644,7 @@ LogMessage_(const char *fmt,...)
 #endif
 	va_end(vargs);
 
-	return (log_output_(LOG_DEBUG, log_obuf, 0));
+	return (log_emit_(LOG_DEBUG, log_obuf, 0));
 }
 
 
@@ -304,6 +660,9 @@ LogEmerg(const char *fmt,...)
 {
 	va_list         vargs;
 
+	if (LOG_EMERG > log_max_level)
+		return (1);
+
 	LogId_("Emergency");
 
 	va_start(vargs, fmt);
@@ -314,7 +673,7 @@ LogEmerg(const char *fmt,...)
 #endif
 	va_end(vargs);
 
-	return (log_output_(LOG_EMERG, log_obuf, 1));
+	return (log_emit_(LOG_EMERG, log_obuf, 1));
 }
 
 
@@ -330,6 +689,9 @@ LogAlert(const char *fmt,...)
 {
 	va_list         vargs;
 
+	if (LOG_ALERT > log_max_level)
+		return (1);
+
 	LogId_("Alert");
 
 	va_start(vargs, fmt);
@@ -340,7 +702,7 @@ LogAlert(const char *fmt,...)
 #endif
 	va_end(vargs);
 
-	return (log_output_(LOG_ALERT, log_obuf, 1));
+	return (log_emit_(LOG_ALERT, log_obuf, 1));
 }
 
 
@@ -356,6 +718,9 @@ LogCrit(const char *fmt,...)
 {
 	va_list         vargs;
 
+	if (LOG_CRIT > log_max_level)
+		return (1);
+
 	LogId_("Critical");
 
 	va_start(vargs, fmt);
@@ -366,7 +731,7 @@ LogCrit(const char *fmt,...)
 #endif
 	va_end(vargs);
 
-	return (log_output_(LOG_CRIT, log_obuf, 1));
+	return (log_emit_(LOG_CRIT, log_obuf, 1));
 }
 
 
@@ -383,6 +748,9 @@ LogErr(const char *fmt,...)
 	va_list vargs;
 	int status;
 
+	if (LOG_ERR > log_max_level)
+		return (1);
+
 	LogId_("Error");
 
 	va_start(vargs, fmt);
@@ -393,7 +761,7 @@ LogErr(const char *fmt,...)
 #endif
 	va_end(vargs);
 
-	status = log_output_(LOG_ERR, log_obuf, 0);
+	status = log_emit_(LOG_ERR, log_obuf, 0);
 	return status;
 }
 
@@ -411,6 +779,9 @@ LogWarn(const char *fmt,...)
 {
 	va_list         vargs;
 
+	if (LOG_WARNING > log_max_level)
+		return (1);
+
 	LogId_("Warning");
 
 	va_start(vargs, fmt);
@@ -421,7 +792,7 @@ LogWarn(const char *fmt,...)
 #endif
 	va_end(vargs);
 
-	return (log_output_(LOG_WARNING, log_obuf, 1));
+	return (log_emit_(LOG_WARNING, log_obuf, 1));
 }
 
 
@@ -437,6 +808,9 @@ LogNotice(const char *fmt,...)
 {
 	va_list         vargs;
 
+	if (LOG_NOTICE > log_max_level)
+		return (1);
+
 	LogId_("Notice");
 
 	va_start(vargs, fmt);
@@ -447,7 +821,7 @@ LogNotice(const char *fmt,...)
 #endif
 	va_end(vargs);
 
-	return (log_output_(LOG_NOTICE, log_obuf, 1));
+	return (log_emit_(LOG_NOTICE, log_obuf, 1));
 }
 
 
@@ -464,6 +838,9 @@ LogInfo(const char *fmt,...)
 {
 	va_list         vargs;
 
+	if (LOG_INFO > log_max_level)
+		return (1);
+
 	/* LogId_("  Info"); */
 	LogId_("");
 
@@ -475,7 +852,7 @@ LogInfo(const char *fmt,...)
 #endif
 	va_end(vargs);
 
-	return (log_output_(LOG_INFO, log_obuf, 0));
+	return (log_emit_(LOG_INFO, log_obuf, 0));
 }
 
 
@@ -491,6 +868,10 @@ LogDebug(const char *file, int line, const char *fmt,...)
 {
 	va_list vargs;
 	int bufUsed, bufRemain;
+
+	if (LOG_DEBUG > log_max_level)
+		return (1);
+
 	LogId_("Debug");
 
 	va_start(vargs, fmt);
@@ -507,7 +888,135 @@ LogDebug(const char *file, int line, const char *fmt,...)
 
 	va_end(vargs);
 
-	return (log_output_(LOG_DEBUG, log_obuf, 0));
+	return (log_emit_(LOG_DEBUG, log_obuf, 0));
+}
+
+
+/*
+ * ---------------------------------------------
+ * Only log messages at or above (numerically
+ * at or below) the given level; returns the
+ * level which was in effect
+ * ---------------------------------------------
+ */
+OS_EXPORT int
+LogSetLevel(level)
+    int             level;
+{
+	int             previous = log_max_level;
+
+	log_max_level = level;
+	return (previous);
+}
+
+OS_EXPORT int
+LogLevelEnabled(level)
+    int             level;
+{
+	return (level <= log_max_level);
+}
+
+/*
+ * ---------------------------------------------
+ * Set the least time between the messages from
+ * any one LOG_PROGRESS(); 0 logs them all
+ * ---------------------------------------------
+ */
+OS_EXPORT void
+LogSetProgressInterval(seconds)
+    double          seconds;
+{
+	log_progress_interval = seconds;
+}
+
+/*
+ * ---------------------------------------------
+ * Is a progress message due, given when the
+ * last one from the same place was logged?
+ * ---------------------------------------------
+ */
+OS_EXPORT int
+LogProgressDue(lastLogTime)
+    double         *lastLogTime;
+{
+	double          now;
+
+	if (LOG_INFO > log_max_level)
+		return (0);
+	if (log_progress_interval <= 0)
+		return (1);
+
+	now = stageStatsWallClock();
+	if (*lastLogTime > 0 && now - *lastLogTime < log_progress_interval)
+		return (0);
+	*lastLogTime = now;
+	return (1);
+}
+
+/*
+ * ---------------------------------------------
+ * Start writing messages from a background
+ * thread, so that logging never waits on the
+ * terminal or disk.  Anything still queued is
+ * also written out if the program crashes or
+ * exits without calling LogClose()
+ * ---------------------------------------------
+ */
+OS_EXPORT int
+LogStartWriter()
+{
+#ifdef LOG_USE_WRITER
+	if (log_writer_running)
+		return (1);
+
+	if (log_ring == NULL)
+	{
+		log_ring = (logSlot *) ckalloc(sizeof(logSlot) * LOG_RING_SLOTS);
+		if (log_ring == NULL)
+			return (0);
+		memset(log_ring, 0, sizeof(logSlot) * LOG_RING_SLOTS);
+		log_ring_head = log_ring_tail = 0;
+	}
+
+	log_writer_running = 1;
+	if (pthread_create(&log_writer_thread, NULL, log_writer_, NULL) != 0)
+	{
+		log_writer_running = 0;
+		return (0);
+	}
+	log_catch_crashes_();
+	return (1);
+#else
+	return (0);
+#endif
+}
+
+/*
+ * ---------------------------------------------
+ * Stop the writer thread, once everything it
+ * has queued has been written out
+ * ---------------------------------------------
+ */
+OS_EXPORT int
+LogStopWriter()
+{
+#ifdef LOG_USE_WRITER
+	if ( ! log_writer_running )
+		return (1);
+
+	pthread_mutex_lock(&log_writer_mutex);
+	log_writer_running = 0;
+	pthread_cond_signal(&log_writer_cond);
+	pthread_mutex_unlock(&log_writer_mutex);
+	pthread_join(log_writer_thread, NULL);
+
+	LOCK_DRAIN();
+	log_drain_();
+	ckfree(log_ring);
+	log_ring = NULL;
+	UNLOCK_DRAIN();
+#endif
+	return (1);
 }
 
 
@@ -623,6 +1132,8 @@ LogOpen(progname, destflags, filename)
 OS_EXPORT int
 LogClose()
 {
+	(void) LogStopWriter();
+
 	log_time = 0;
 	log_dest = LOGDEST_UNINIT;
 	log_isInit = 0;
@@ -763,7 +1274,7 @@ LogFromFD(id, fd, fileSize)
 		{
 
 			loadbuf[bytesRead] = 0;
-			log_output_(LOG_NOTICE, loadbuf, 0);
+			log_emit_(LOG_NOTICE, loadbuf, 0);
 
 			bytesRemain -= bytesRead;
 			totalRead += bytesRead;
@@ -772,7 +1283,7 @@ LogFromFD(id, fd, fileSize)
 
 	/** flush output if trailing character is not a CR **/
 	if ((totalRead > 0) && (loadbuf[bytesRead - 1] != '\n'))
-		log_output_(LOG_NOTICE, "\n", 0);
+		log_emit_(LOG_NOTICE, "\n", 0);
 
 	return (1);
 }
@@ -829,9 +1340,12 @@ LogGetLogFunctionUserData()
 OS_EXPORT void
 LogFlush()
 {
+	LOCK_DRAIN();
+	log_drain_();
 	log_writebuf[log_prevOutputOffset] = 0;
 	log_flush_line_(log_last_loglevel, log_writebuf, 1);
 	log_prevOutputOffset = 0;
+	UNLOCK_DRAIN();
 }
 
 /**
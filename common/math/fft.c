@@ -29,6 +29,7 @@
 #include "error.h"
 #include "filtertools.h"
 #include "mathtools.h"
+#include "stagestats.h"
 
 
 
@@ -217,6 +218,8 @@ convolve(double *fft,
 	int             no2, i, ii;
 	double          dum, mag2;
 
+	STAGESTATS_COUNT("FFT convolutions", 1);
+
 	if (m != n)
 	{
 
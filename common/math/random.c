@@ -13,6 +13,7 @@
 #include       <math.h>
 #include       <time.h>
 #include       <limits.h>
+#include       <string.h>
 #include       <sys/types.h>
 #ifndef OS_WINDOWS_NT
 #include        <unistd.h>
@@ -27,17 +28,25 @@
 const double    EPS = 1.2e-7;
 
 
-static long     nrRandomSeed = 0;
-static long     nrRandomSeedIsInitialized = 0;
+/**
+ ** The local random functions draw on the stream made current on
+ ** the calling thread by setLocalRandomStream(), or failing that
+ ** on a stream of the thread's own, so that simulations running
+ ** on separate threads do not share generator state
+ **/
+static OS_THREAD_LOCAL randomStream *sLocalStream = NULL;
+static OS_THREAD_LOCAL randomStream sThreadStream;
+static OS_THREAD_LOCAL int sThreadStreamIsSeeded = 0;
 
 int             gDumpRandom = 1;
 
-OS_EXPORT int 
-localRandom()
+static randomStream *
+getLocalStream()
 {
-    int             result;
+    if (sLocalStream != NULL)
+        return sLocalStream;
 
-    if (nrRandomSeedIsInitialized == 0)
+    if (sThreadStreamIsSeeded == 0)
     {
         seedLocalRandom((int) time(NULL) *
 #ifdef	OS_WINDOWS_NT
@@ -47,7 +56,29 @@ localRandom()
 #endif
 			);
     }
-    result = (int) (nr_ran2(&nrRandomSeed) * OS_RAND_MAX);
+    return &sThreadStream;
+}
+
+/**
+ ** Make the local random functions on this thread draw on the
+ ** given stream, or on the thread's own if it is NULL; the
+ ** stream made current before is returned
+ **/
+OS_EXPORT randomStream *
+setLocalRandomStream(randomStream *stream)
+{
+    randomStream   *previous = sLocalStream;
+
+    sLocalStream = stream;
+    return previous;
+}
+
+OS_EXPORT int 
+localRandom()
+{
+    int             result;
+
+    result = (int) (randomStreamDouble(getLocalStream()) * OS_RAND_MAX);
     return result;
 }
 
@@ -57,17 +88,7 @@ localRandomDouble()
 {
     double          result;
 
-    if (nrRandomSeedIsInitialized == 0)
-    {
-        seedLocalRandom((int) time(NULL) *
-#ifdef	OS_WINDOWS_NT
-			_getpid()
-#else
-			getpid()
-#endif
-			);
-    }
-    result = nr_ran2(&nrRandomSeed);
+    result = randomStreamDouble(getLocalStream());
     return result;
 }
 
@@ -162,9 +183,13 @@ lgamma(double xx)
  ** deviates in a sequence.  RNMX should approximate the largest
  ** floating value that is less than 1.
  **/
-#define         RAN2_NTAB               32
-OS_EXPORT double
-nr_ran2(long *idum)
+#define         RAN2_NTAB               RANDOM_STREAM_NTAB
+
+/**
+ ** One step of ran2, with all of the generator state passed in
+ **/
+static double
+ran2Step(long *idum, long *idum2, long *iy, long *iv)
 {
     const long      IM1 = 2147483563;
     const long      IM2 = 2147483399;
@@ -179,9 +204,6 @@ nr_ran2(long *idum)
     const long      NDIV = 1 + IMM1 / RAN2_NTAB;
     const double    RNMX = 1.0 - EPS;
 
-    static long     idum2 = 123456789;
-    static long     iy = 0;
-    static long     iv[RAN2_NTAB] = {0};
     long            j, k;
     double          result;
 
@@ -192,7 +214,7 @@ nr_ran2(long *idum)
         /** be sure to prevent idum == 0 */
         (*idum) = (-(*idum) > 1) ? (-(*idum)) : 1;
 
-        idum2 = (*idum);
+        (*idum2) = (*idum);
 
         /** load the shuffle table (after 8 warm-ups) */
         for (j = RAN2_NTAB + 7; j >= 0; j--)
@@ -204,7 +226,7 @@ nr_ran2(long *idum)
             if (j < RAN2_NTAB)
                 iv[j] = (*idum);
         }
-        iy = iv[0];
+        (*iy) = iv[0];
     }
     /* start here when not initializing */
     k = (*idum) / IQ1;
@@ -215,32 +237,131 @@ nr_ran2(long *idum)
     (*idum) = IA1 * ((*idum) - k * IQ1) - k * IR1;
     if ((*idum) < 0)
         (*idum) = (*idum) + IM1;
-    k = idum2 / IQ2;
+    k = (*idum2) / IQ2;
 
     /** Compute idum2 = mod(IA2 * idum2, IM2) likewise */
-    idum2 = IA2 * (idum2 - k * IQ2) - k * IR2;
-    if (idum2 < 0)
-        idum2 = idum2 + IM2;
+    (*idum2) = IA2 * ((*idum2) - k * IQ2) - k * IR2;
+    if ((*idum2) < 0)
+        (*idum2) = (*idum2) + IM2;
 
 
     /** will be in the range 0:RAN2_NTAB-1 */
-    j = iy / NDIV;
+    j = (*iy) / NDIV;
 
     /*
      * here idum is shuffled, idum and idum 2 are
      * combined to generate output
      */
-    iy = iv[j] - idum2;
+    (*iy) = iv[j] - (*idum2);
     iv[j] = (*idum);
 
-    if (iy < 1)
-        iy = iy + IMM1;
+    if ((*iy) < 1)
+        (*iy) = (*iy) + IMM1;
 
-    result = (AM * iy) < RNMX ? (AM * iy) : RNMX;
+    result = (AM * (*iy)) < RNMX ? (AM * (*iy)) : RNMX;
 
     return result;
 }
 
+/**
+ ** Random value function found in Numerical Recipes as "ran2"
+ **
+ ** Long period (> 2 x 10^18) random number generator of L'Ecuyer
+ ** with Bays-Durham shuffle and added safeguards.  Returns a
+ ** uniform random deviate bewteen 0.0 and 1.0 (exclusive of the
+ ** endpoint values).  Call with <idum> a negative integer to
+ ** initialize; thereafter, do not alter <idum> between sucessive
+ ** deviates in a sequence.  RNMX should approximate the largest
+ ** floating value that is less than 1.
+ **/
+OS_EXPORT double
+nr_ran2(long *idum)
+{
+    static OS_THREAD_LOCAL long idum2 = 123456789;
+    static OS_THREAD_LOCAL long iy = 0;
+    static OS_THREAD_LOCAL long iv[RAN2_NTAB] = {0};
+
+    return ran2Step(idum, &idum2, &iy, iv);
+}
+
+
+/**
+ ** ----------------------------------------------------------------
+ ** Derive the seed of an independent stream from a base seed and
+ ** a stream identifier (such as a motor unit id).  The mix is a
+ ** fixed integer hash, so the same (base, id) pair always gives
+ ** the same stream, and neighbouring ids give unrelated seeds.
+ **/
+OS_EXPORT long
+randomStreamDeriveSeed(long baseSeed, long streamId)
+{
+    unsigned long   z;
+
+    z = ((unsigned long) baseSeed * 0x9E3779B1UL)
+                ^ ((unsigned long) streamId + 0x7F4A7C15UL);
+    z = (z ^ (z >> 16)) * 0x85EBCA6BUL;
+    z = (z ^ (z >> 13)) * 0xC2B2AE35UL;
+    z = z ^ (z >> 16);
+
+    /** ran2 seeds must lie in 1 .. IM1-1 */
+    return (long) (z % 2147483562UL) + 1;
+}
+
+/**
+ ** Seed a stream; a given seed always produces the same sequence
+ **/
+OS_EXPORT void
+seedRandomStream(randomStream *stream, long seed)
+{
+    memset(stream, 0, sizeof(randomStream));
+    stream->rs_idum = (seed > 0) ? -seed : seed;
+    stream->rs_idum2 = 123456789;
+}
+
+/** a uniformly distributed random value between 0 and 1 */
+OS_EXPORT double
+randomStreamDouble(randomStream *stream)
+{
+    return ran2Step(&stream->rs_idum, &stream->rs_idum2,
+                &stream->rs_iy, stream->rs_iv);
+}
+
+/** float value in the range 0 - 1.0 */
+OS_EXPORT float
+randomStreamFloat(randomStream *stream)
+{
+    return (float) randomStreamDouble(stream);
+}
+
+/**
+ ** Normally distributed deviate with zero mean and unit variance,
+ ** as gauss01(), but drawing only on the given stream
+ **/
+OS_EXPORT double
+randomStreamGauss01(randomStream *stream)
+{
+    double          fac, rsq, v1, v2;
+
+    if (stream->rs_gaussIsSet)
+    {
+        stream->rs_gaussIsSet = 0;
+        return stream->rs_gaussSaved;
+    }
+
+    do
+    {
+        v1 = 2.0 * randomStreamDouble(stream) - 1.0;
+        v2 = 2.0 * randomStreamDouble(stream) - 1.0;
+        rsq = v1 * v1 + v2 * v2;
+    } while (rsq >= 1.0 || rsq == 0.0);
+
+    fac = sqrt(-2.0 * log(rsq) / rsq);
+
+    stream->rs_gaussSaved = v1 * fac;
+    stream->rs_gaussIsSet = 1;
+    return v2 * fac;
+}
+
 
 /**
  ** ----------------------------------------------------------------
@@ -304,48 +425,14 @@ zgauss(double prob)
 /**
  ** ----------------------------------------------------------------
  ** This function returns a normally distributed deviate with zero
- ** mean and unit variance, using localRandomDouble() as the
- ** source of the uniform deviate
+ ** mean and unit variance, drawn from the same stream as
+ ** localRandomDouble(); the spare Box-Muller deviate is kept
+ ** with the stream
  **/
 OS_EXPORT double 
 gauss01()
 {
-    static int      iset = 0;
-    static double   gset;
-    double          fac, rsq, v1, v2;
-
-    if (iset == 0)
-    {
-        /* we don't have an extra deviate handy, so . . . */
-        do
-        {
-            /*
-             * Pick two uniform numbers in the square extending
-             * from -1 to +1 in each direction
-             */
-            v1 = 2.0 * localRandomDouble() - 1.0;
-            v2 = 2.0 * localRandomDouble() - 1.0;
-
-            /* check if they are in the unit circle */
-            rsq = v1 * v1 + v2 * v2;
-        } while (rsq >= 1.0 || rsq == 0.0);
-
-        fac = sqrt(-2.0 * log(rsq) / rsq);
-
-        /*
-         * Now make the Box-Muller transformation to et two
-         * normal deviates.  Return one and save the other
-         * for next time.
-         */
-        gset = v1 * fac;
-
-        /* set flag */
-        iset = 1;
-        return v2 * fac;
-    }
-    /* unset the flag */
-    iset = 0;
-    return gset;
+    return randomStreamGauss01(getLocalStream());
 }
 
 
@@ -361,9 +448,9 @@ gauss01()
 OS_EXPORT double 
 poisson(double mean)
 {
-    static double   alxm = 0.0, g = 0.0, sq = 0.0;
+    static OS_THREAD_LOCAL double alxm = 0.0, g = 0.0, sq = 0.0;
     /** flag for whether mean has changed since last call */
-    static double   oldmean = (-1.0);
+    static OS_THREAD_LOCAL double oldmean = (-1.0);
     double          em, t, y;
 
     if (mean < 12)
@@ -442,21 +529,24 @@ poisson(double mean)
 }
 
 /**
- ** Seed the random number generator and re-set the counts
+ ** Seed the random number generator and re-set the counts.  This
+ ** seeds the stream the local random functions currently draw on
  **/
 OS_EXPORT void 
 seedLocalRandom(int seed)
 {
-    if (seed > 0)
+    if (sLocalStream != NULL)
     {
-        nrRandomSeed = -seed;
-        srandom(seed);
+        seedRandomStream(sLocalStream, seed);
     } else
     {
-        nrRandomSeed = seed;
-        srandom(-seed);
+        seedRandomStream(&sThreadStream, seed);
+        sThreadStreamIsSeeded = 1;
     }
 
-    nrRandomSeedIsInitialized = 1;
+    if (seed > 0)
+        srandom(seed);
+    else
+        srandom(-seed);
 }
 
@@ -0,0 +1,366 @@
+/** ------------------------------------------------------------
+ ** A catalogue of the runs made in a directory, so that the
+ ** next run ID can be handed out without listing the directory.
+ **
+ ** The catalogue is a text file holding a fixed width header
+ ** with the next ID to hand out, followed by a line for each
+ ** run recorded:
+ **
+ **		next 0000000004
+ **		<id> TAB <config hash> TAB <stage hashes> TAB <path>
+ **
+ ** The file is locked for every access, so runs sharing the
+ ** directory never receive the same ID.  A directory without a
+ ** catalogue is listed once to start the count after the runs
+ ** already there.
+ ** ------------------------------------------------------------
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef OS_WINDOWS_NT
+#include <io.h>
+#include <sys/locking.h>
+#else
+#include <unistd.h>
+#endif
+#endif
+
+#include "pathtools.h"
+#include "stringtools.h"
+#include "tclCkalloc.h"
+#include "msgir.h"
+#include "log.h"
+
+#define	RUN_CATALOG_HEADER_FORMAT	"next %010d\n"
+#define	RUN_CATALOG_HEADER_LEN		16
+
+
+static char *
+sCatalogFilename(const char *path)
+{
+	char tmpBuffer[FILENAME_MAX];
+
+	slnprintf(tmpBuffer, FILENAME_MAX, "%s\\%s",
+				path, RUN_CATALOG_FILENAME);
+	return osIndependentPath(tmpBuffer);
+}
+
+/**
+ * Wait for a lock on the whole catalogue, exclusive if it is
+ * to be changed
+ */
+static int
+sLockCatalog(int fd, int exclusive)
+{
+#ifdef OS_WINDOWS_NT
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		return 0;
+	return _locking(fd, _LK_LOCK, RUN_CATALOG_HEADER_LEN) == 0;
+#else
+	struct flock lock;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = exclusive ? F_WRLCK : F_RDLCK;
+	lock.l_whence = SEEK_SET;
+	lock.l_start = 0;
+	lock.l_len = 0;
+
+	while (fcntl(fd, F_SETLKW, &lock) < 0)
+	{
+		if (errno != EINTR)
+			return 0;
+	}
+	return 1;
+#endif
+}
+
+static void
+sUnlockCatalog(int fd)
+{
+#ifdef OS_WINDOWS_NT
+	if (lseek(fd, 0, SEEK_SET) >= 0)
+		(void) _locking(fd, _LK_UNLCK, RUN_CATALOG_HEADER_LEN);
+#else
+	struct flock lock;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = F_UNLCK;
+	lock.l_whence = SEEK_SET;
+	(void) fcntl(fd, F_SETLK, &lock);
+#endif
+}
+
+/**
+ * Read the next ID from the header; returns 0 for an empty
+ * catalogue and (-1) for one which cannot be read
+ */
+static int
+sReadHeader(int fd, int *nextId)
+{
+	char header[RUN_CATALOG_HEADER_LEN + 1];
+	int nRead;
+
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		return (-1);
+	nRead = irRead(fd, header, RUN_CATALOG_HEADER_LEN);
+	if (nRead == 0)
+		return 0;
+	if (nRead != RUN_CATALOG_HEADER_LEN)
+		return (-1);
+	header[RUN_CATALOG_HEADER_LEN] = 0;
+	if (sscanf(header, "next %d", nextId) != 1)
+		return (-1);
+	return 1;
+}
+
+static int
+sWriteHeader(int fd, int nextId)
+{
+	char header[RUN_CATALOG_HEADER_LEN + 1];
+
+	slnprintf(header, RUN_CATALOG_HEADER_LEN + 1,
+				RUN_CATALOG_HEADER_FORMAT, nextId);
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		return 0;
+	return irWrite(fd, header, RUN_CATALOG_HEADER_LEN)
+				== RUN_CATALOG_HEADER_LEN;
+}
+
+/**
+ * Find the first ID after those of the entries matching the
+ * mask, as dirToolsGetNextId() does, but passing over any entry
+ * without a number where the wildcard is
+ */
+static int
+sScanNextId(const char *path, const char *mask, int firstId)
+{
+	DirList *dirList;
+	const char *wildcardPos;
+	char *eptr;
+	int i, headLen, curNum, nextId = firstId;
+
+	wildcardPos = strchr(mask, '*');
+	if (wildcardPos == NULL)
+		return firstId;
+	headLen = (int) (wildcardPos - mask);
+
+	dirList = dirListLoadEntries(path, mask);
+	if (dirList == NULL)
+		return firstId;
+
+	for (i = 0; i < dirList->n_entries; i++)
+	{
+		curNum = strtol(&dirList->entry_name[i][headLen], &eptr, 10);
+		if (eptr != &dirList->entry_name[i][headLen] && curNum >= nextId)
+			nextId = curNum + 1;
+	}
+	dirListDelete(dirList);
+
+	return nextId;
+}
+
+/** fields are separated by tabs and records by newlines */
+static int
+sIsValidField(const char *field)
+{
+	return strpbrk(field, "\t\r\n") == NULL;
+}
+
+/**
+ ** Hand out the next ID from the catalogue in the given
+ ** directory, creating it if need be.  A new catalogue starts
+ ** after the highest ID of the entries matching the mask, and
+ ** no ID is less than firstId.  Returns (-1) if the catalogue
+ ** cannot be used.
+ **/
+OS_EXPORT int
+runCatalogNextId(const char *path, const char *mask, int firstId)
+{
+	char *filename;
+	int fd, status, id = (-1);
+
+	filename = sCatalogFilename(path);
+	fd = openPath(filename, O_RDWR | O_CREAT | O_BINARY, 0666);
+	if (fd < 0)
+	{
+		LogError("Cannot open run catalogue '%s'\n", filename);
+		ckfree(filename);
+		return (-1);
+	}
+
+	if ( ! sLockCatalog(fd, 1) )
+	{
+		LogError("Cannot lock run catalogue '%s'\n", filename);
+		goto CLEANUP;
+	}
+
+	status = sReadHeader(fd, &id);
+	if (status == 0)
+	{
+		id = sScanNextId(path, mask, firstId);
+	} else if (status < 0)
+	{
+		LogError("Run catalogue '%s' is damaged\n", filename);
+		id = (-1);
+		goto UNLOCK;
+	}
+	if (id < firstId)
+		id = firstId;
+
+	if ( ! sWriteHeader(fd, id + 1) )
+	{
+		LogError("Cannot update run catalogue '%s'\n", filename);
+		id = (-1);
+	}
+
+UNLOCK:
+	sUnlockCatalog(fd);
+CLEANUP:
+	irClose(fd);
+	ckfree(filename);
+	return id;
+}
+
+/**
+ ** Add a record of a run to the catalogue in the given
+ ** directory, making sure that its ID will not be handed out
+ ** again.  Returns 1 on success.
+ **/
+OS_EXPORT int
+runCatalogRecord(const char *path, const RunCatalogEntry *entry)
+{
+	char *filename, *line;
+	int fd, lineLen, nextId, status = 0;
+
+	if ( ! sIsValidField(entry->rc_configHash)
+			|| ! sIsValidField(entry->rc_stageHashes)
+			|| ! sIsValidField(entry->rc_path) )
+	{
+		LogError("Run %d cannot be catalogued\n", entry->rc_id);
+		return 0;
+	}
+
+	lineLen = (int) (strlen(entry->rc_configHash)
+				+ strlen(entry->rc_stageHashes)
+				+ strlen(entry->rc_path)) + 32;
+	line = (char *) ckalloc(lineLen);
+	lineLen = slnprintf(line, lineLen, "%d\t%s\t%s\t%s\n",
+				entry->rc_id, entry->rc_configHash,
+				entry->rc_stageHashes, entry->rc_path);
+
+	filename = sCatalogFilename(path);
+	fd = openPath(filename, O_RDWR | O_CREAT | O_BINARY, 0666);
+	if (fd < 0)
+	{
+		LogError("Cannot open run catalogue '%s'\n", filename);
+		ckfree(filename);
+		ckfree(line);
+		return 0;
+	}
+
+	if ( ! sLockCatalog(fd, 1) )
+	{
+		LogError("Cannot lock run catalogue '%s'\n", filename);
+		goto CLEANUP;
+	}
+
+	if (sReadHeader(fd, &nextId) <= 0 || nextId <= entry->rc_id)
+	{
+		if ( ! sWriteHeader(fd, entry->rc_id + 1) )
+			goto UNLOCK;
+	}
+
+	if (lseek(fd, 0, SEEK_END) >= 0 && irWrite(fd, line, lineLen) == lineLen)
+		status = 1;
+	else
+		LogError("Cannot update run catalogue '%s'\n", filename);
+
+UNLOCK:
+	sUnlockCatalog(fd);
+CLEANUP:
+	irClose(fd);
+	ckfree(filename);
+	ckfree(line);
+	return status;
+}
+
+/**
+ ** Find the latest run recorded in the catalogue in the given
+ ** directory with the given configuration hash.  Returns 1 and
+ ** fills in the entry if there is one.
+ **/
+OS_EXPORT int
+runCatalogFind(const char *path, const char *configHash,
+		RunCatalogEntry *entry)
+{
+	struct stat sb;
+	char *filename, *contents = NULL;
+	char *line, *next, *field[4];
+	int fd, i, nRead, found = 0;
+
+	filename = sCatalogFilename(path);
+	fd = irOpen(filename, O_RDONLY | O_BINARY, 0);
+	ckfree(filename);
+	if (fd < 0)
+		return 0;
+
+	if ( ! sLockCatalog(fd, 0) )
+	{
+		irClose(fd);
+		return 0;
+	}
+
+	if (fstat(fd, &sb) == 0 && sb.st_size > RUN_CATALOG_HEADER_LEN)
+	{
+		contents = (char *) ckalloc((size_t) sb.st_size + 1);
+		nRead = (lseek(fd, 0, SEEK_SET) < 0) ? (-1)
+				: irRead(fd, contents, (int) sb.st_size);
+		contents[(nRead > 0) ? nRead : 0] = 0;
+	}
+	sUnlockCatalog(fd);
+	irClose(fd);
+
+	if (contents == NULL)
+		return 0;
+
+	for (line = strchr(contents, '\n'); line != NULL; line = next)
+	{
+		line++;
+		if ((next = strchr(line, '\n')) == NULL)
+			break;
+		*next = 0;
+
+		field[0] = line;
+		for (i = 1; i < 4; i++)
+		{
+			if ((field[i] = strchr(field[i - 1], '\t')) == NULL)
+				break;
+			*field[i]++ = 0;
+		}
+		if (i < 4 || strcmp(field[1], configHash) != 0)
+		{
+			*next = '\n';
+			continue;
+		}
+
+		entry->rc_id = atoi(field[0]);
+		strlcpy(entry->rc_configHash, field[1], RUN_CATALOG_MAX_HASH);
+		strlcpy(entry->rc_stageHashes, field[2], RUN_CATALOG_MAX_FIELD);
+		strlcpy(entry->rc_path, field[3], FILENAME_MAX);
+		found = 1;
+		*next = '\n';
+	}
+	ckfree(contents);
+
+	return found;
+}
@@ -14,8 +14,8 @@
 #include <stringtools.h>
 
 
-/** buffer shared by the below two functions */
-static char     sBuffer[128];
+/** buffer shared by the below two functions, one per thread */
+static OS_THREAD_LOCAL char sBuffer[128];
 
 /*
  * -------------------------------------------------
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tclCkalloc.h"
+#include "arena.h"
+
+#include "testutils.h"
+
+typedef struct chunkTally {
+	int nChunks;
+	size_t nBytes;
+	size_t largest;
+	int inOrder;
+	int nextValue;
+} chunkTally;
+
+static int
+tallyChunk(data, nBytes, userData)
+	const void *data;
+	size_t nBytes;
+	void *userData;
+{
+	chunkTally *tally = (chunkTally *) userData;
+	const int *values = (const int *) data;
+	size_t i;
+
+	tally->nChunks++;
+	tally->nBytes += nBytes;
+	if (nBytes > tally->largest)
+		tally->largest = nBytes;
+	for (i = 0; i < nBytes / sizeof(int); i++)
+	{
+		if (values[i] != tally->nextValue++)
+			tally->inOrder = 0;
+	}
+	return 1;
+}
+
+int
+testArena(argc, argv)
+	int argc;
+	char **argv;
+{
+	Arena arena;
+	chunkTally tally;
+	int *block, *first;
+	char *odd;
+	int status = 1;
+	int i, j, value;
+
+	/** an empty arena has no chunks until the first block */
+	arenaInit(&arena, 1024, 0, sizeof(int));
+	if (arena.ar_nChunks != 0 || arena.ar_first != NULL)
+	{
+		FAIL(__FILE__, __LINE__, "empty arena has chunks\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "empty arena has no chunks\n");
+	}
+
+	/** blocks follow each other and new chunks are started as needed */
+	value = 0;
+	first = NULL;
+	for (i = 0; i < 100; i++)
+	{
+		block = (int *) arenaAlloc(&arena, 25 * sizeof(int));
+		if (first == NULL)
+			first = block;
+		for (j = 0; j < 25; j++)
+			block[j] = value++;
+	}
+	if (arena.ar_nChunks < 2 || arena.ar_nBytesUsed != 2500 * sizeof(int)
+			|| first[24] != 24)
+	{
+		FAIL(__FILE__, __LINE__, "arena grew wrongly (%d chunks)\n",
+				arena.ar_nChunks);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "arena grew to %d chunks\n",
+				arena.ar_nChunks);
+	}
+
+	/** the chunks hold the blocks, in order, with no gaps */
+	memset(&tally, 0, sizeof(tally));
+	tally.inOrder = 1;
+	arenaForEachChunk(&arena, tallyChunk, &tally);
+	if (tally.nChunks != arena.ar_nChunks
+			|| tally.nBytes != 2500 * sizeof(int)
+			|| ! tally.inOrder)
+	{
+		FAIL(__FILE__, __LINE__, "chunks do not hold the blocks in order\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "chunks hold the blocks in order\n");
+	}
+
+	/** a block larger than any chunk gets a chunk to itself */
+	block = (int *) arenaAlloc(&arena, 1024 * 1024);
+	block[(1024 * 1024 / sizeof(int)) - 1] = 1;
+	PASS(__FILE__, __LINE__, "large block allocated\n");
+
+	/** releasing frees everything and the arena can be used again */
+	arenaRelease(&arena);
+	if (arena.ar_nChunks != 0 || arena.ar_nBytesUsed != 0
+			|| arena.ar_nextChunkSize != 1024)
+	{
+		FAIL(__FILE__, __LINE__, "release did not empty the arena\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "release emptied the arena\n");
+	}
+
+	/** with a maximum chunk size, the chunks stop growing */
+	arenaInit(&arena, 1000, 1000, sizeof(int));
+	for (i = 0; i < 40; i++)
+	{
+		block = (int *) arenaAlloc(&arena, 250 * sizeof(int));
+		for (j = 0; j < 250; j++)
+			block[j] = i * 250 + j;
+	}
+	memset(&tally, 0, sizeof(tally));
+	tally.inOrder = 1;
+	arenaForEachChunk(&arena, tallyChunk, &tally);
+	if (tally.nChunks != 40 || tally.largest != 1000 || ! tally.inOrder)
+	{
+		FAIL(__FILE__, __LINE__, "chunks grew past their maximum\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "chunks kept to their maximum\n");
+	}
+	arenaRelease(&arena);
+
+	/** with the default alignment, odd sized blocks are padded */
+	arenaInit(&arena, 0, 0, 0);
+	odd = (char *) arenaAlloc(&arena, 3);
+	block = (int *) arenaAlloc(&arena, sizeof(double));
+	if (((size_t) odd) % sizeof(double) != 0
+			|| ((size_t) block) % sizeof(double) != 0)
+	{
+		FAIL(__FILE__, __LINE__, "blocks not aligned\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "blocks aligned\n");
+	}
+	arenaRelease(&arena);
+
+	return status;
+}
@@ -0,0 +1,235 @@
+/**
+ * This file is generated automatically from the make functionality,
+ * built using filename matching from the list of tests in this
+ * directory.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tclCkalloc.h>
+#include <filetools.h>
+
+
+/** prototypes */
+int test_2d_char();
+int test_2d_double();
+int test_2d_int();
+int test_2d_short();
+int test_3d_char();
+int test_3d_double();
+int test_3d_int();
+int test_3d_short();
+
+/**
+ * Print out simple help
+ */
+void printHelp()
+{
+	printf("Test cases in testsuite scaffold\n");
+	printf("\n");
+	printf("Available tests are:\n");
+	printf("  test_2d_char\n");
+	printf("  test_2d_double\n");
+	printf("  test_2d_int\n");
+	printf("  test_2d_short\n");
+	printf("  test_3d_char\n");
+	printf("  test_3d_double\n");
+	printf("  test_3d_int\n");
+	printf("  test_3d_short\n");
+
+}
+
+/**
+ * mainline
+ */
+int
+main(int argc, char **argv)
+{
+	int status = 1;
+	int runAll = 0;
+	int ranATest = 0;
+	int runThis;
+	int s, i;
+
+
+#ifndef OS_WINDOWS_NT
+	system("rm -f ckalloc.log");
+	system("rm -rf plots");
+#endif
+
+	if (argc == 1) {
+		runAll = 1;
+	}
+
+	for (i=1; i < argc; i++) {
+		if (argv[i][0] == '-') {
+			printHelp();
+			exit(0);
+		}
+	}
+
+	runThis = 0;
+	for (i=1; i < argc; i++) {
+		if (strcmp(argv[i],
+				"test_2d_char") == 0) {
+			runThis = 1;
+		}
+		if (strcmp(argv[i],
+				"test_2d_char.c") == 0) {
+			runThis = 1;
+		}
+	}
+	if (runThis || runAll) {
+		ranATest = 1;
+		printf("<TESTCASE> test_2d_char()\n");
+		s = test_2d_char();
+		status = s && status;
+	}
+
+	runThis = 0;
+	for (i=1; i < argc; i++) {
+		if (strcmp(argv[i],
+				"test_2d_double") == 0) {
+			runThis = 1;
+		}
+		if (strcmp(argv[i],
+				"test_2d_double.c") == 0) {
+			runThis = 1;
+		}
+	}
+	if (runThis || runAll) {
+		ranATest = 1;
+		printf("<TESTCASE> test_2d_double()\n");
+		s = test_2d_double();
+		status = s && status;
+	}
+
+	runThis = 0;
+	for (i=1; i < argc; i++) {
+		if (strcmp(argv[i],
+				"test_2d_int") == 0) {
+			runThis = 1;
+		}
+		if (strcmp(argv[i],
+				"test_2d_int.c") == 0) {
+			runThis = 1;
+		}
+	}
+	if (runThis || runAll) {
+		ranATest = 1;
+		printf("<TESTCASE> test_2d_int()\n");
+		s = test_2d_int();
+		status = s && status;
+	}
+
+	runThis = 0;
+	for (i=1; i < argc; i++) {
+		if (strcmp(argv[i],
+				"test_2d_short") == 0) {
+			runThis = 1;
+		}
+		if (strcmp(argv[i],
+				"test_2d_short.c") == 0) {
+			runThis = 1;
+		}
+	}
+	if (runThis || runAll) {
+		ranATest = 1;
+		printf("<TESTCASE> test_2d_short()\n");
+		s = test_2d_short();
+		status = s && status;
+	}
+
+	runThis = 0;
+	for (i=1; i < argc; i++) {
+		if (strcmp(argv[i],
+				"test_3d_char") == 0) {
+			runThis = 1;
+		}
+		if (strcmp(argv[i],
+				"test_3d_char.c") == 0) {
+			runThis = 1;
+		}
+	}
+	if (runThis || runAll) {
+		ranATest = 1;
+		printf("<TESTCASE> test_3d_char()\n");
+		s = test_3d_char();
+		status = s && status;
+	}
+
+	runThis = 0;
+	for (i=1; i < argc; i++) {
+		if (strcmp(argv[i],
+				"test_3d_double") == 0) {
+			runThis = 1;
+		}
+		if (strcmp(argv[i],
+				"test_3d_double.c") == 0) {
+			runThis = 1;
+		}
+	}
+	if (runThis || runAll) {
+		ranATest = 1;
+		printf("<TESTCASE> test_3d_double()\n");
+		s = test_3d_double();
+		status = s && status;
+	}
+
+	runThis = 0;
+	for (i=1; i < argc; i++) {
+		if (strcmp(argv[i],
+				"test_3d_int") == 0) {
+			runThis = 1;
+		}
+		if (strcmp(argv[i],
+				"test_3d_int.c") == 0) {
+			runThis = 1;
+		}
+	}
+	if (runThis || runAll) {
+		ranATest = 1;
+		printf("<TESTCASE> test_3d_int()\n");
+		s = test_3d_int();
+		status = s && status;
+	}
+
+	runThis = 0;
+	for (i=1; i < argc; i++) {
+		if (strcmp(argv[i],
+				"test_3d_short") == 0) {
+			runThis = 1;
+		}
+		if (strcmp(argv[i],
+				"test_3d_short.c") == 0) {
+			runThis = 1;
+		}
+	}
+	if (runThis || runAll) {
+		ranATest = 1;
+		printf("<TESTCASE> test_3d_short()\n");
+		s = test_3d_short();
+		status = s && status;
+	}
+
+	DUMP_MEMORY;
+
+#ifndef OS_WINDOWS_NT
+	copyFileIfPresent(1, "ckalloc.log");
+#endif
+
+
+	if (ranATest == 0) {
+		printf("<FAILURE> -- no tests specified!\n");
+		return 1;
+	}
+
+
+	if (status) {
+		printf("<SUCCESS>\n");
+		return 0;
+	}
+
+	return 1;
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tclCkalloc.h"
+
+#include "testutils.h"
+
+#define	REPORT_FILE		"ckfast.log"
+
+static char *
+loadReport(void)
+{
+	static char buffer[8192];
+	FILE *fp;
+	size_t n;
+
+	fp = fopen(REPORT_FILE, "rb");
+	if (fp == NULL)
+		return NULL;
+	n = fread(buffer, 1, sizeof(buffer) - 1, fp);
+	buffer[n] = 0;
+	fclose(fp);
+	return buffer;
+}
+
+int
+testCkFast(argc, argv)
+	int argc;
+	char **argv;
+{
+	CkallocStats before, after;
+	char *block, *other, *report;
+	int status = 1;
+	int i;
+
+	ckallocSetSampleInterval(0);
+	ckallocResetThreadStats();
+
+	/** a freed small block is handed out again for its class */
+	block = (char *) Ck_FastAlloc(40, __FILE__, __LINE__);
+	Ck_FastFree(block);
+	other = (char *) Ck_FastAlloc(33, __FILE__, __LINE__);
+	ckallocGetThreadStats(&after);
+	if (other != block || after.cs_reused != 1)
+	{
+		FAIL(__FILE__, __LINE__, "freed block not reused\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "freed block reused\n");
+	}
+	if (after.cs_mallocs != 2 || after.cs_frees != 1
+			|| after.cs_currentBytes != 33
+			|| after.cs_maximumBytes != 40)
+	{
+		FAIL(__FILE__, __LINE__, "thread statistics wrong\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "thread statistics counted\n");
+	}
+
+	if (((size_t) other) % sizeof(double) != 0)
+	{
+		FAIL(__FILE__, __LINE__, "block not aligned\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "block aligned\n");
+	}
+
+	/** growth within the class keeps the block, beyond it copies */
+	for (i = 0; i < 33; i++)
+		other[i] = (char) i;
+	block = (char *) Ck_FastRealloc(other, 48, __FILE__, __LINE__);
+	if (block != other)
+	{
+		FAIL(__FILE__, __LINE__, "realloc within class moved block\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "realloc within class kept block\n");
+	}
+	block = (char *) Ck_FastRealloc(block, 100000, __FILE__, __LINE__);
+	for (i = 0; i < 33; i++)
+	{
+		if (block[i] != (char) i)
+			break;
+	}
+	if (i < 33)
+	{
+		FAIL(__FILE__, __LINE__, "realloc lost contents\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "realloc kept contents\n");
+	}
+	Ck_FastFree(block);
+	Ck_FastFree(NULL);
+
+	ckallocGetThreadStats(&after);
+	if (after.cs_currentBytes != 0)
+	{
+		FAIL(__FILE__, __LINE__, "%ld bytes still counted\n",
+				after.cs_currentBytes);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "all bytes freed\n");
+	}
+
+	/** once released, the cache no longer supplies blocks */
+	block = (char *) Ck_FastAlloc(40, __FILE__, __LINE__);
+	Ck_FastFree(block);
+	ckallocReleaseThreadCache();
+	ckallocGetThreadStats(&before);
+	block = (char *) Ck_FastAlloc(40, __FILE__, __LINE__);
+	ckallocGetThreadStats(&after);
+	if (after.cs_reused != before.cs_reused)
+	{
+		FAIL(__FILE__, __LINE__, "released cache still used\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "thread cache released\n");
+	}
+	Ck_FastFree(block);
+
+	/** sampled blocks are listed until they are freed */
+	ckallocSetSampleInterval(1);
+	block = Ck_FastStrdup("sampled block", "sampleFile.c", 1234);
+	other = (char *) Ck_FastAlloc(5000, "otherFile.c", 99);
+	ckallocGetThreadStats(&after);
+	if (strcmp(block, "sampled block") != 0 || after.cs_sampled < 2)
+	{
+		FAIL(__FILE__, __LINE__, "sampled allocation wrong\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "allocations sampled\n");
+	}
+	if (((uintptr_t) block & 15) != 0 || ((uintptr_t) other & 15) != 0)
+	{
+		FAIL(__FILE__, __LINE__, "sampled block not 16 byte aligned\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "sampled blocks 16 byte aligned\n");
+	}
+	Ck_FastFree(other);
+	Ck_FastDumpSampledMemory(REPORT_FILE);
+
+	report = loadReport();
+	if (report == NULL
+			|| strstr(report, "sampleFile.c (1234)") == NULL
+			|| strstr(report, "\"sampled block") == NULL
+			|| strstr(report, "otherFile.c") != NULL)
+	{
+		FAIL(__FILE__, __LINE__, "sampled blocks not reported\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "live sampled blocks reported\n");
+	}
+	Ck_FastFree(block);
+	ckallocSetSampleInterval(0);
+	remove(REPORT_FILE);
+
+	/** the debugging allocator keeps the same statistics */
+	ckallocResetThreadStats();
+	block = (char *) Tcl_DbCkalloc(64, __FILE__, __LINE__);
+	ckallocGetThreadStats(&after);
+	Tcl_DbCkfree(block, __FILE__, __LINE__);
+	if (after.cs_mallocs != 1 || after.cs_currentBytes != 64)
+	{
+		FAIL(__FILE__, __LINE__, "debug allocator not counted\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "debug allocator counted\n");
+	}
+
+	return status;
+}
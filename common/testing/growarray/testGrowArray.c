@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tclCkalloc.h"
+#include "listalloc.h"
+#include "growarray.h"
+
+#include "testutils.h"
+
+#define	N_APPENDED	10000
+
+int
+testGrowArray(argc, argv)
+	int argc;
+	char **argv;
+{
+	GROW_ARRAY(int) ids;
+	ListGrowthStats stats;
+	int *list = NULL;
+	int nAllocated = 0;
+	int status = 1;
+	int inOrder;
+	int i;
+
+	/** the first reservation allocates exactly what is asked for */
+	if ( ! growArrayReserve(100, (void **) &list, &nAllocated, sizeof(int))
+			|| nAllocated != 100 || list == NULL)
+	{
+		FAIL(__FILE__, __LINE__, "first reserve allocated %d\n", nAllocated);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "first reserve allocated %d\n", nAllocated);
+	}
+
+	/** growing by one doubles the allocation, keeping the data */
+	for (i = 0; i < 100; i++)
+		list[i] = i;
+	growArrayReserve(101, (void **) &list, &nAllocated, sizeof(int));
+	if (nAllocated != 200 || list[99] != 99 || list[150] != 0)
+	{
+		FAIL(__FILE__, __LINE__, "grew to %d\n", nAllocated);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "doubled to %d, tail zeroed\n", nAllocated);
+	}
+
+	/** shrinking trims to the size in use, and to nothing */
+	growArrayShrink(100, (void **) &list, &nAllocated, sizeof(int));
+	if (nAllocated != 100 || list[99] != 99)
+	{
+		FAIL(__FILE__, __LINE__, "shrank to %d\n", nAllocated);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "shrank to %d\n", nAllocated);
+	}
+	growArrayShrink(0, (void **) &list, &nAllocated, sizeof(int));
+	if (nAllocated != 0 || list != NULL)
+	{
+		FAIL(__FILE__, __LINE__, "empty shrink left %d\n", nAllocated);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "empty shrink freed the list\n");
+	}
+
+	/** appending one at a time copies only a logarithmic number of times */
+	growArrayInit(ids);
+	listResetGrowthStats();
+	for (i = 0; i < N_APPENDED; i++)
+	{
+		if ( ! growArrayAppend(ids, i) )
+		{
+			FAIL(__FILE__, __LINE__, "append %d failed\n", i);
+			return 0;
+		}
+	}
+	listGetGrowthStats(&stats);
+	inOrder = 1;
+	for (i = 0; i < ids.ga_n; i++)
+	{
+		if (ids.ga_data[i] != i)
+			inOrder = 0;
+	}
+	if (ids.ga_n != N_APPENDED || ! inOrder
+			|| stats.lg_nAllocations > 20
+			|| stats.lg_nBytesCopied > 2L * N_APPENDED * sizeof(int))
+	{
+		FAIL(__FILE__, __LINE__,
+				"%d appends took %ld allocations, %ld bytes copied\n",
+				N_APPENDED, stats.lg_nAllocations, stats.lg_nBytesCopied);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__,
+				"%d appends took %ld allocations, %ld bytes copied\n",
+				N_APPENDED, stats.lg_nAllocations, stats.lg_nBytesCopied);
+	}
+
+	/** the same appends by fixed blocks copy quadratically */
+	listResetGrowthStats();
+	nAllocated = 0;
+	for (i = 0; i < N_APPENDED; i++)
+	{
+		listMkCheckSize(i + 1, (void **) &list, &nAllocated,
+				16, sizeof(int), __FILE__, __LINE__);
+		list[i] = i;
+	}
+	listGetGrowthStats(&stats);
+	if (stats.lg_nAllocations != (N_APPENDED + 15) / 16)
+	{
+		FAIL(__FILE__, __LINE__, "fixed blocks took %ld allocations\n",
+				stats.lg_nAllocations);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__,
+				"fixed blocks took %ld allocations, %ld bytes copied\n",
+				stats.lg_nAllocations, stats.lg_nBytesCopied);
+	}
+	ckfree(list);
+
+	/** the data is a plain ckalloc'ed array */
+	growArrayShrinkToFit(ids);
+	if (ids.ga_nAllocated != N_APPENDED || ids.ga_data[N_APPENDED - 1]
+				!= N_APPENDED - 1)
+	{
+		FAIL(__FILE__, __LINE__, "shrink to fit left %d\n",
+				ids.ga_nAllocated);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "shrink to fit\n");
+	}
+	growArrayFree(ids);
+	if (ids.ga_data != NULL || ids.ga_n != 0)
+	{
+		FAIL(__FILE__, __LINE__, "free left data\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "freed\n");
+	}
+
+	return status;
+}
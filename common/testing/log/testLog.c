@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tclCkalloc.h"
+#include "log.h"
+#include "workpool.h"
+
+#include "testutils.h"
+
+#ifndef OS_WINDOWS_NT
+# include <unistd.h>
+#endif
+
+#define	N_THREADS		4
+#define	N_LINES			500
+#define	LONG_LINE_LEN	1000
+
+/** more than the writer's ring holds */
+#define	N_FLOOD_LINES	5000
+
+typedef struct captured {
+	int nLines;
+	int nOutOfOrder;
+	int nOther;
+	int nErrors;
+	int nDropReports;
+	int longestLine;
+	int lastLine[N_THREADS];
+} captured;
+
+static captured sCaptured;
+static int sNEvaluated = 0;
+
+/** set while the writer is held up in captureLine() */
+static volatile int sHolding = 0, sReleased = 0;
+
+/** check each thread's lines arrive whole and in order */
+static void
+captureLine(userData, loglevel, buffer, size)
+	void *userData;
+	int loglevel;
+	char *buffer;
+	int size;
+{
+	int thread, line;
+
+	if (size <= 1)
+		return;
+
+	/** hold up the writer until released, so that the ring fills */
+	if (strncmp(buffer, "hold", 4) == 0)
+	{
+		sHolding = 1;
+		while ( ! sReleased )
+			;
+		return;
+	}
+	if (loglevel <= LOG_ERR)
+		sCaptured.nErrors++;
+	if (strstr(buffer, "log messages dropped") != NULL)
+		sCaptured.nDropReports++;
+
+	sCaptured.nLines++;
+	if (size > sCaptured.longestLine)
+		sCaptured.longestLine = size;
+
+	if (sscanf(buffer, "thread %d line %d", &thread, &line) == 2
+			&& thread >= 0 && thread < N_THREADS)
+	{
+		if (line != sCaptured.lastLine[thread] + 1)
+			sCaptured.nOutOfOrder++;
+		sCaptured.lastLine[thread] = line;
+	} else
+	{
+		sCaptured.nOther++;
+	}
+}
+
+static void
+resetCapture()
+{
+	int i;
+
+	memset(&sCaptured, 0, sizeof(sCaptured));
+	for (i = 0; i < N_THREADS; i++)
+		sCaptured.lastLine[i] = (-1);
+}
+
+static const char *
+countEvaluation()
+{
+	sNEvaluated++;
+	return "evaluated";
+}
+
+static int
+logLines(taskIndex, userData)
+	int taskIndex;
+	void *userData;
+{
+	int i;
+
+	for (i = 0; i < N_LINES; i++)
+		LogInfo("thread %d line %d\n", taskIndex, i);
+	return 1;
+}
+
+/** task 0 logs an error into the full ring, task 1 lets the writer go */
+static int
+logIntoFullRing(taskIndex, userData)
+	int taskIndex;
+	void *userData;
+{
+	if (taskIndex == 0)
+	{
+		LogErr("error with the ring full\n");
+	} else
+	{
+#ifndef OS_WINDOWS_NT
+		usleep(100000);
+#endif
+		sReleased = 1;
+	}
+	return 1;
+}
+
+int
+testLog(argc, argv)
+	int argc;
+	char **argv;
+{
+	char longLine[LONG_LINE_LEN + 1];
+	double lastLogTime;
+	int status = 1;
+	int nDue, i;
+
+	LogOpen("testLog", LOGDEST_FUNCTION | LOGDEST_NO_ID, NULL);
+	LogFunction(captureLine, NULL);
+
+	/** without a writer, lines are written as they are made */
+	resetCapture();
+	LogInfo("thread 0 line 0\n");
+	if (sCaptured.nLines != 1)
+	{
+		FAIL(__FILE__, __LINE__, "direct line not written\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "direct line written\n");
+	}
+
+	/** filtered messages are neither formatted nor evaluated */
+	resetCapture();
+	LogSetLevel(LOG_NOTICE);
+	LogInfo("filtered %s\n", "info");
+	LOG_IF(LOG_INFO, LogInfo("%s\n", countEvaluation()));
+	LogWarn("kept\n");
+	LogSetLevel(LOG_DEBUG);
+	if (sCaptured.nLines != 1 || sNEvaluated != 0)
+	{
+		FAIL(__FILE__, __LINE__, "%d lines, %d evaluated\n",
+				sCaptured.nLines, sNEvaluated);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "filtered lines skipped\n");
+	}
+
+	/** without a writer, lines from several threads are not mixed */
+	resetCapture();
+	workPoolRun(N_THREADS, N_THREADS, logLines, NULL);
+	if (sCaptured.nLines != N_THREADS * N_LINES
+			|| sCaptured.nOutOfOrder != 0 || sCaptured.nOther != 0)
+	{
+		FAIL(__FILE__, __LINE__, "%d lines, %d out of order, %d other\n",
+				sCaptured.nLines, sCaptured.nOutOfOrder, sCaptured.nOther);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "%d direct lines written whole\n",
+				sCaptured.nLines);
+	}
+
+	/** lines from several threads all arrive, each in order */
+	if ( ! LogStartWriter() )
+	{
+		FAIL(__FILE__, __LINE__, "writer did not start\n");
+		LogClose();
+		return 0;
+	}
+	resetCapture();
+	workPoolRun(N_THREADS, N_THREADS, logLines, NULL);
+	LogFlush();
+	if (sCaptured.nLines != N_THREADS * N_LINES
+			|| sCaptured.nOutOfOrder != 0 || sCaptured.nOther != 0)
+	{
+		FAIL(__FILE__, __LINE__, "%d lines, %d out of order, %d other\n",
+				sCaptured.nLines, sCaptured.nOutOfOrder, sCaptured.nOther);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "%d queued lines written in order\n",
+				sCaptured.nLines);
+	}
+
+	/** a line longer than a ring slot arrives whole */
+	resetCapture();
+	memset(longLine, 'x', LONG_LINE_LEN);
+	longLine[LONG_LINE_LEN] = 0;
+	LogInfo("%s\n", longLine);
+	LogFlush();
+	if (sCaptured.longestLine != LONG_LINE_LEN + 1)
+	{
+		FAIL(__FILE__, __LINE__, "long line arrived as %d\n",
+				sCaptured.longestLine);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "long line arrived whole\n");
+	}
+
+	/** with the ring full, errors are still written and drops counted */
+	resetCapture();
+	LogInfo("hold\n");
+	while ( ! sHolding )
+		;
+	for (i = 0; i < N_FLOOD_LINES; i++)
+		LogInfo("thread 0 line %d\n", i);
+	workPoolRun(2, 2, logIntoFullRing, NULL);
+	LogFlush();
+	if (sCaptured.nErrors != 1 || sCaptured.nDropReports == 0
+			|| sCaptured.nLines >= N_FLOOD_LINES)
+	{
+		FAIL(__FILE__, __LINE__, "%d lines, %d errors, %d drop reports\n",
+				sCaptured.nLines, sCaptured.nErrors,
+				sCaptured.nDropReports);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "error written past full ring, %d lines\n",
+				sCaptured.nLines);
+	}
+
+	/** stopping the writer writes out whatever is still queued */
+	resetCapture();
+	LogInfo("thread 1 line 0\n");
+	LogStopWriter();
+	if (sCaptured.nLines != 1)
+	{
+		FAIL(__FILE__, __LINE__, "queued line lost on stop\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "queued line written on stop\n");
+	}
+
+	/** progress messages are limited to one per interval */
+	LogSetProgressInterval(3600.0);
+	lastLogTime = 0;
+	nDue = LogProgressDue(&lastLogTime);
+	nDue += LogProgressDue(&lastLogTime);
+	LogSetProgressInterval(0);
+	nDue += LogProgressDue(&lastLogTime);
+	LogSetProgressInterval(1.0);
+	if (nDue != 2)
+	{
+		FAIL(__FILE__, __LINE__, "%d progress messages due\n", nDue);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "progress messages limited\n");
+	}
+
+	LogClose();
+
+	return status;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "random.h"
+
+#include "testutils.h"
+
+#define	NDRAWS	1000
+
+/**
+ * Independent streams must reproduce the same sequence for the
+ * same seed, however their draws are interleaved with others.
+ */
+int
+testStream(argc, argv)
+	int argc;
+	char **argv;
+{
+	randomStream a, b, c;
+	double first[NDRAWS];
+	long ran2Seed;
+	int status = 1;
+	int nDiffer = 0;
+	int i;
+
+	seedRandomStream(&a, 4321);
+	for (i = 0; i < NDRAWS; i++)
+		first[i] = randomStreamDouble(&a);
+
+	/** interleave with another stream and the global generator */
+	seedRandomStream(&a, 4321);
+	seedRandomStream(&b, 1234);
+	for (i = 0; i < NDRAWS; i++)
+	{
+		(void) randomStreamDouble(&b);
+		(void) localRandomDouble();
+		if (randomStreamDouble(&a) != first[i])
+		{
+			FAIL(__FILE__, __LINE__,
+					"stream diverged at draw %d\n", i);
+			status = 0;
+			break;
+		}
+	}
+	if (i == NDRAWS)
+		PASS(__FILE__, __LINE__, "stream reproducible when interleaved\n");
+
+	/** the stream generator is the same ran2 as nr_ran2() */
+	ran2Seed = -4321;
+	for (i = 0; i < NDRAWS; i++)
+	{
+		if (nr_ran2(&ran2Seed) != first[i])
+		{
+			FAIL(__FILE__, __LINE__,
+					"stream differs from nr_ran2 at draw %d\n", i);
+			status = 0;
+			break;
+		}
+	}
+	if (i == NDRAWS)
+		PASS(__FILE__, __LINE__, "stream matches nr_ran2\n");
+
+	/** derived seeds give distinct sequences */
+	seedRandomStream(&b, randomStreamDeriveSeed(99, 1));
+	seedRandomStream(&c, randomStreamDeriveSeed(99, 2));
+	for (i = 0; i < NDRAWS; i++)
+	{
+		if (randomStreamDouble(&b) != randomStreamDouble(&c))
+			nDiffer++;
+	}
+	if (nDiffer < NDRAWS - 1)
+	{
+		FAIL(__FILE__, __LINE__,
+				"derived streams overlap (%d of %d differ)\n",
+				nDiffer, NDRAWS);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "derived streams are distinct\n");
+	}
+
+	if (randomStreamDeriveSeed(99, 1) != randomStreamDeriveSeed(99, 1)
+			|| randomStreamDeriveSeed(99, 1) <= 0)
+	{
+		FAIL(__FILE__, __LINE__, "derived seed unstable or invalid\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "derived seed stable\n");
+	}
+
+	return(status);
+}
+
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os_defs.h"
+
+#ifndef OS_WINDOWS_NT
+# include <unistd.h>
+# include <sys/wait.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "filetools.h"
+#include "pathtools.h"
+#include "stringtools.h"
+
+#include "testutils.h"
+
+#define	N_CHILDREN		4
+#define	N_IDS_EACH		50
+
+static void
+touch(directory, name)
+	const char *directory;
+	const char *name;
+{
+	char filename[FILENAME_MAX];
+	FILE *fp;
+
+	slnprintf(filename, FILENAME_MAX, "%s/%s", directory, name);
+	if ((fp = fopenpath(filename, "wb")) != NULL)
+		fclose(fp);
+}
+
+static int
+record(directory, id, configHash, path)
+	const char *directory;
+	int id;
+	const char *configHash;
+	const char *path;
+{
+	RunCatalogEntry entry;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.rc_id = id;
+	strlcpy(entry.rc_configHash, configHash, RUN_CATALOG_MAX_HASH);
+	strlcpy(entry.rc_stageHashes, "muscle=0000abcd", RUN_CATALOG_MAX_FIELD);
+	strlcpy(entry.rc_path, path, FILENAME_MAX);
+	return runCatalogRecord(directory, &entry);
+}
+
+#ifndef OS_WINDOWS_NT
+/** several processes sharing a catalogue never get the same ID */
+static int
+testConcurrentIds(directory)
+	const char *directory;
+{
+	int seen[N_CHILDREN * N_IDS_EACH * 2];
+	int pipeFd[2];
+	int i, child, id, nRead, nRepeated = 0, nOutOfRange = 0;
+	int firstId;
+
+	firstId = runCatalogNextId(directory, "run*", 0);
+	if (pipe(pipeFd) < 0)
+	{
+		FAIL(__FILE__, __LINE__, "cannot make pipe\n");
+		return 0;
+	}
+
+	for (child = 0; child < N_CHILDREN; child++)
+	{
+		if (fork() == 0)
+		{
+			close(pipeFd[0]);
+			for (i = 0; i < N_IDS_EACH; i++)
+			{
+				id = runCatalogNextId(directory, "run*", 0);
+				if (write(pipeFd[1], &id, sizeof(id)) != sizeof(id))
+					break;
+			}
+			_exit(0);
+		}
+	}
+	close(pipeFd[1]);
+
+	memset(seen, 0, sizeof(seen));
+	for (i = 0; read(pipeFd[0], &id, sizeof(id)) == sizeof(id); i++)
+	{
+		id -= firstId + 1;
+		if (id < 0 || id >= N_CHILDREN * N_IDS_EACH * 2)
+			nOutOfRange++;
+		else if (seen[id]++)
+			nRepeated++;
+	}
+	nRead = i;
+	close(pipeFd[0]);
+	while (wait(NULL) > 0)
+		;
+
+	if (nRead != N_CHILDREN * N_IDS_EACH || nRepeated != 0
+			|| nOutOfRange != 0)
+	{
+		FAIL(__FILE__, __LINE__, "%d IDs, %d repeated, %d out of range\n",
+				nRead, nRepeated, nOutOfRange);
+		return 0;
+	}
+	PASS(__FILE__, __LINE__, "%d processes took %d distinct IDs\n",
+			N_CHILDREN, nRead);
+	return 1;
+}
+#endif
+
+int
+testRunCatalog(argc, argv)
+	int argc;
+	char **argv;
+{
+	RunCatalogEntry entry;
+	char command[FILENAME_MAX];
+	char *directory;
+	int id, status = 1;
+
+	/** the name is made as a file, but is wanted for a directory */
+	directory = allocTempFileName("Cat");
+	if (directory == NULL)
+	{
+		FAIL(__FILE__, __LINE__, "cannot make temporary name\n");
+		return 0;
+	}
+	remove(directory);
+
+	/** a new catalogue carries on after the files already there */
+	touch(directory, "contraction3.dat");
+	touch(directory, "contraction7.dat");
+	touch(directory, "contractionX.dat");
+	id = runCatalogNextId(directory, "contraction*.dat", 1);
+	if (id != 8)
+	{
+		FAIL(__FILE__, __LINE__, "first ID %d, expected 8\n", id);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "first ID follows existing files\n");
+	}
+
+	/** after that the directory is not looked at */
+	touch(directory, "contraction50.dat");
+	id = runCatalogNextId(directory, "contraction*.dat", 1);
+	if (id != 9)
+	{
+		FAIL(__FILE__, __LINE__, "second ID %d, expected 9\n", id);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "second ID from the counter\n");
+	}
+
+	/** the latest run of a configuration is found */
+	if ( ! record(directory, 9, "0badcafe", "/runs/run009")
+			|| ! record(directory, 4, "feedface", "/runs/run004")
+			|| ! record(directory, 12, "0badcafe", "/runs/run012") )
+	{
+		FAIL(__FILE__, __LINE__, "cannot record runs\n");
+		status = 0;
+	}
+	memset(&entry, 0, sizeof(entry));
+	if ( ! runCatalogFind(directory, "0badcafe", &entry)
+			|| entry.rc_id != 12
+			|| strcmp(entry.rc_path, "/runs/run012") != 0
+			|| strcmp(entry.rc_stageHashes, "muscle=0000abcd") != 0)
+	{
+		FAIL(__FILE__, __LINE__, "found run %d in '%s'\n",
+				entry.rc_id, entry.rc_path);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "latest run of configuration found\n");
+	}
+	if (runCatalogFind(directory, "00000000", &entry))
+	{
+		FAIL(__FILE__, __LINE__, "found an unknown configuration\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "unknown configuration not found\n");
+	}
+
+	/** recorded IDs are never handed out again */
+	id = runCatalogNextId(directory, "contraction*.dat", 1);
+	if (id != 13)
+	{
+		FAIL(__FILE__, __LINE__, "ID after records %d, expected 13\n", id);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "IDs follow recorded runs\n");
+	}
+
+	/** fields may not break the record layout */
+	if (record(directory, 14, "bad\thash", "/runs/run014"))
+	{
+		FAIL(__FILE__, __LINE__, "recorded a field holding a tab\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "field holding a tab refused\n");
+	}
+
+#ifndef OS_WINDOWS_NT
+	status = testConcurrentIds(directory) && status;
+
+	slnprintf(command, FILENAME_MAX, "rm -rf '%s'", directory);
+	if (system(command) != 0)
+		status = 0;
+#endif
+	ckfree(directory);
+
+	return status;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stagestats.h"
+
+#include "testutils.h"
+
+#define	REPORT_FILE		"stagestats.json"
+
+static double
+spin(int n)
+{
+	double sum = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		sum += (i % 7) * 0.5;
+	return sum;
+}
+
+static char *
+loadReport(void)
+{
+	static char buffer[8192];
+	FILE *fp;
+	size_t n;
+
+	fp = fopen(REPORT_FILE, "rb");
+	if (fp == NULL)
+		return NULL;
+	n = fread(buffer, 1, sizeof(buffer) - 1, fp);
+	buffer[n] = 0;
+	fclose(fp);
+	return buffer;
+}
+
+int
+testStageStats(argc, argv)
+	int argc;
+	char **argv;
+{
+	double before, after;
+	const char *stage, *inner;
+	char *report;
+	FILE *fp;
+	int status = 1;
+	int i;
+
+	before = stageStatsWallClock();
+	(void) spin(100000);
+	after = stageStatsWallClock();
+	if (after < before)
+	{
+		FAIL(__FILE__, __LINE__, "wall clock went backwards\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "wall clock is monotonic\n");
+	}
+
+	/** nothing is recorded while disabled */
+	stageStatsSetEnabled(0);
+	stageStatsReset();
+	if (stageStatsBegin("disabled") != 0)
+	{
+		FAIL(__FILE__, __LINE__, "stage opened while disabled\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "no stage opened while disabled\n");
+	}
+	STAGESTATS_COUNT("ignored", 5);
+
+	stageStatsSetEnabled(1);
+	stageStatsBegin("outer");
+	STAGESTATS_COUNT("items", 3);
+	for (i = 0; i < 2; i++)
+	{
+		stageStatsBegin("inner");
+		STAGESTATS_COUNT("items", 10);
+		STAGESTATS_COUNT("bytes", 100);
+		(void) spin(100000);
+		stageStatsEnd();
+	}
+	stageStatsEnd();
+
+	/** an unbalanced end is ignored */
+	stageStatsEnd();
+
+	fp = fopen(REPORT_FILE, "wb");
+	if (fp == NULL || ! stageStatsWriteJSON(fp, "test \"run\""))
+	{
+		FAIL(__FILE__, __LINE__, "cannot write report\n");
+		return 0;
+	}
+	fclose(fp);
+	stageStatsSetEnabled(0);
+	stageStatsCleanup();
+
+	report = loadReport();
+	if (report == NULL)
+	{
+		FAIL(__FILE__, __LINE__, "cannot read report\n");
+		return 0;
+	}
+
+	if (strstr(report, "\"description\": \"test \\\"run\\\"\"") == NULL)
+	{
+		FAIL(__FILE__, __LINE__, "description not escaped\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "description escaped\n");
+	}
+	if (strstr(report, "disabled") != NULL
+			|| strstr(report, "ignored") != NULL)
+	{
+		FAIL(__FILE__, __LINE__, "disabled stage recorded\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "nothing recorded while disabled\n");
+	}
+
+	/** totals cover every stage */
+	if (strstr(report, "\"items\": 23") == NULL
+			|| strstr(report, "\"bytes\": 200") == NULL)
+	{
+		FAIL(__FILE__, __LINE__, "counter totals wrong\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "counter totals cover every stage\n");
+	}
+
+	stage = strstr(report, "\"name\": \"outer\"");
+	inner = strstr(report, "\"name\": \"inner\"");
+	if (stage == NULL || inner == NULL || inner < stage)
+	{
+		FAIL(__FILE__, __LINE__, "stages missing or out of order\n");
+		return 0;
+	}
+
+	/** outer keeps only the counts made while it was innermost */
+	if (strstr(stage, "\"calls\": 1") == NULL
+			|| strstr(stage, "\"items\": 3") == NULL
+			|| strstr(stage, "\"items\": 3") > inner)
+	{
+		FAIL(__FILE__, __LINE__, "outer stage wrong\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "outer stage recorded\n");
+	}
+	if (strstr(inner, "\"parent\": \"outer\"") == NULL
+			|| strstr(inner, "\"calls\": 2") == NULL
+			|| strstr(inner, "\"items\": 20") == NULL
+			|| strstr(inner, "\"bytes\": 200") == NULL)
+	{
+		FAIL(__FILE__, __LINE__, "inner stage wrong\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "nested stage recorded\n");
+	}
+
+	remove(REPORT_FILE);
+	return status;
+}
@@ -492,6 +492,119 @@ testWithComments()
 	return 1;
 }
 
+/**
+ * A file tokenizer reads ahead through its buffer; once it is
+ * deleted the file must carry on from just after the last
+ * character the tokenizer consumed, as parseAttVal() relies on.
+ */
+int
+testFileResume()
+{
+	FILE *fp;
+	tokenizer *t;
+	token *tok;
+	char *filename;
+	char line[BUFSIZ];
+	int status = 1;
+
+	filename = allocTempFileName("Tok");
+
+	fp = fopen(filename, "w");
+	if (fp == NULL)
+	{
+		FAIL(__FILE__, __LINE__,
+				"cannot open tmp file '%s'\n", filename);
+		return 0;
+	}
+	fputs("skipped line\n", fp);
+	fputs("  alpha \"quoted text\" 42 # comment\n", fp);
+	fputs("rest of file\n", fp);
+	fclose(fp);
+
+	fp = fopen(filename, "r");
+	if (fgets(line, BUFSIZ, fp) == NULL)
+	{
+		FAIL(__FILE__, __LINE__, "cannot read first line\n");
+		return 0;
+	}
+
+	t = tknGetFileTokenizer(fp);
+	tok = tknGetToken(t);
+	if (tok == NULL || tok->type_ != TT_IDENTIFIER
+			|| strcmp(tok->data_.strptr_, "alpha") != 0)
+	{
+		FAIL(__FILE__, __LINE__, "expected identifier 'alpha'\n");
+		status = 0;
+	}
+	tok = tknGetToken(t);
+	if (tok == NULL || tok->type_ != TT_STRING
+			|| strcmp(tok->data_.strptr_, "quoted text") != 0)
+	{
+		FAIL(__FILE__, __LINE__, "expected string 'quoted text'\n");
+		status = 0;
+	}
+	tok = tknGetToken(t);
+	if (tok == NULL || tok->type_ != TT_INTEGER || tok->data_.ival_ != 42)
+	{
+		FAIL(__FILE__, __LINE__, "expected integer 42\n");
+		status = 0;
+	}
+	tknDeleteTokenizer(t);
+
+	/** the integer read one character ahead, the space */
+	if (fgets(line, BUFSIZ, fp) == NULL || strcmp(line, "# comment\n") != 0)
+	{
+		FAIL(__FILE__, __LINE__, "file resumed at '%s'\n", line);
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "file resumed after last token\n");
+	}
+	fclose(fp);
+
+	unlink(filename);
+	ckfree(filename);
+
+	return status;
+}
+
+/**
+ * Reals must come out exactly as strtod() would convert them,
+ * whether short enough for the direct conversion or not.
+ */
+int
+testRealValues()
+{
+	static const char *reals[] = {
+			"0.5", "1.25", "-3.75", "0.1", "2.0e3", "1.5e-7",
+			"123456.789", "9.999999999999999", "0.30000000000000004",
+			"1e22", "1e23", "4.9e-324", "-17.0e+300", ".5",
+			"123456789012345678.0", NULL
+		};
+	tokenizer *t;
+	token *tok;
+	int i, nWrong = 0;
+
+	for (i = 0; reals[i] != NULL; i++)
+	{
+		t = tknGetStringTokenizer(reals[i]);
+		tok = tknGetToken(t);
+		if (tok == NULL || tok->type_ != TT_REAL
+				|| tok->data_.dval_ != strtod(reals[i], NULL))
+		{
+			FAIL(__FILE__, __LINE__, "'%s' converted as %.17g\n", reals[i],
+					(tok == NULL) ? 0.0 : tok->data_.dval_);
+			nWrong++;
+		}
+		tknDeleteTokenizer(t);
+	}
+
+	if (nWrong == 0)
+		PASS(__FILE__, __LINE__, "%d reals converted exactly\n", i);
+
+	return nWrong == 0;
+}
+
 int
 testTokenizer(int argc, char **argv)
 {
@@ -500,6 +613,8 @@ testTokenizer(int argc, char **argv)
 	status = testFromFile();
 	status = testFromString() && status;
 	status = testFromStringList() && status;
+	status = testFileResume() && status;
+	status = testRealValues() && status;
 
 	status = testWithComments() && status;
 
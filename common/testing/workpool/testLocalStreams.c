@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "random.h"
+#include "workpool.h"
+
+#include "testutils.h"
+
+#define	NTASKS	200
+#define	NDRAWS	500
+
+typedef struct localStreamTestData {
+	double	result[NTASKS];
+} localStreamTestData;
+
+/**
+ * Each task makes a stream of its own current on the thread it
+ * runs on, and draws through the local random functions, as a
+ * simulation bound to its own context does.
+ */
+static int
+localStreamTask(int taskIndex, void *userData)
+{
+	localStreamTestData *data = (localStreamTestData *) userData;
+	randomStream stream, *previous;
+	int i;
+
+	previous = setLocalRandomStream(&stream);
+	seedLocalRandom((int) randomStreamDeriveSeed(23, taskIndex));
+
+	data->result[taskIndex] = 0;
+	for (i = 0; i < NDRAWS; i++)
+	{
+		data->result[taskIndex] += localRandomDouble();
+		data->result[taskIndex] += gauss01();
+	}
+
+	setLocalRandomStream(previous);
+	return 1;
+}
+
+int
+testLocalStreams(argc, argv)
+	int argc;
+	char **argv;
+{
+	localStreamTestData serial, parallel;
+	randomStream stream;
+	double first, second;
+	int status = 1;
+	int i;
+
+	memset(&serial, 0, sizeof(serial));
+	memset(&parallel, 0, sizeof(parallel));
+	if ( ! workPoolRun(NTASKS, 1, localStreamTask, &serial)
+			|| ! workPoolRun(NTASKS, 4, localStreamTask, &parallel) )
+	{
+		FAIL(__FILE__, __LINE__, "run reported failure\n");
+		return 0;
+	}
+
+	for (i = 0; i < NTASKS; i++)
+	{
+		if (parallel.result[i] != serial.result[i])
+		{
+			FAIL(__FILE__, __LINE__,
+					"task %d draws differ from serial run\n", i);
+			status = 0;
+			break;
+		}
+	}
+	if (i == NTASKS)
+		PASS(__FILE__, __LINE__,
+				"concurrent local streams match serial draws\n");
+
+	/** binding a stream leaves the thread's own sequence alone */
+	seedLocalRandom(4321);
+	first = localRandomDouble();
+	second = localRandomDouble();
+
+	seedLocalRandom(4321);
+	(void) localRandomDouble();
+	(void) setLocalRandomStream(&stream);
+	seedLocalRandom(99);
+	(void) localRandomDouble();
+	if (setLocalRandomStream(NULL) != &stream)
+	{
+		FAIL(__FILE__, __LINE__, "previous stream not returned\n");
+		status = 0;
+	}
+
+	if (localRandomDouble() != second)
+	{
+		FAIL(__FILE__, __LINE__, "thread stream disturbed by binding\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "thread stream kept while bound\n");
+	}
+
+	seedRandomStream(&stream, 4321);
+	if (randomStreamDouble(&stream) != first)
+	{
+		FAIL(__FILE__, __LINE__, "local seed differs from stream seed\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "local seed matches stream seed\n");
+	}
+
+	return(status);
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tclCkalloc.h"
+#include "random.h"
+#include "workpool.h"
+
+#include "testutils.h"
+
+#define	NTASKS	500
+#define	NDRAWS	200
+
+typedef struct poolTestData {
+	int		runCount[NTASKS];
+	double	result[NTASKS];
+	int		failAt;
+} poolTestData;
+
+/**
+ * Each task draws from its own stream and allocates, so that
+ * the results can be checked against a single-threaded run.
+ */
+static int
+poolTestTask(int taskIndex, void *userData)
+{
+	poolTestData *data = (poolTestData *) userData;
+	randomStream stream;
+	double *scratch;
+	int i;
+
+	if (taskIndex == data->failAt)
+		return 0;
+
+	seedRandomStream(&stream, randomStreamDeriveSeed(17, taskIndex));
+	scratch = (double *) ckalloc(sizeof(double) * NDRAWS);
+	data->result[taskIndex] = 0;
+	for (i = 0; i < NDRAWS; i++)
+	{
+		scratch[i] = randomStreamGauss01(&stream);
+		data->result[taskIndex] += scratch[i];
+	}
+	ckfree(scratch);
+
+	data->runCount[taskIndex]++;
+	return 1;
+}
+
+int
+testWorkPool(argc, argv)
+	int argc;
+	char **argv;
+{
+	poolTestData serial, parallel;
+	int status = 1;
+	int i;
+
+	memset(&serial, 0, sizeof(serial));
+	serial.failAt = (-1);
+	if ( ! workPoolRun(NTASKS, 1, poolTestTask, &serial) )
+	{
+		FAIL(__FILE__, __LINE__, "serial run reported failure\n");
+		status = 0;
+	}
+
+	memset(&parallel, 0, sizeof(parallel));
+	parallel.failAt = (-1);
+	if ( ! workPoolRun(NTASKS, 4, poolTestTask, &parallel) )
+	{
+		FAIL(__FILE__, __LINE__, "parallel run reported failure\n");
+		status = 0;
+	}
+
+	for (i = 0; i < NTASKS; i++)
+	{
+		if (parallel.runCount[i] != 1)
+		{
+			FAIL(__FILE__, __LINE__,
+					"task %d ran %d times\n", i, parallel.runCount[i]);
+			status = 0;
+			break;
+		}
+		if (parallel.result[i] != serial.result[i])
+		{
+			FAIL(__FILE__, __LINE__,
+					"task %d result differs from serial run\n", i);
+			status = 0;
+			break;
+		}
+	}
+	if (i == NTASKS)
+		PASS(__FILE__, __LINE__,
+				"%d tasks ran once each, matching serial results\n",
+				NTASKS);
+
+	memset(&parallel, 0, sizeof(parallel));
+	parallel.failAt = NTASKS / 2;
+	if (workPoolRun(NTASKS, 4, poolTestTask, &parallel))
+	{
+		FAIL(__FILE__, __LINE__, "failing task not reported\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "failing task reported\n");
+	}
+
+	if (workPoolRun(0, 4, poolTestTask, &parallel) != 1)
+	{
+		FAIL(__FILE__, __LINE__, "empty run should succeed\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "empty run succeeds\n");
+	}
+
+	if (workPoolResolveThreads(8, 3) != 3
+			|| workPoolResolveThreads(0, 1000) < 1
+			|| workPoolResolveThreads(-1, 0) != 1)
+	{
+		FAIL(__FILE__, __LINE__, "thread count resolution wrong\n");
+		status = 0;
+	} else
+	{
+		PASS(__FILE__, __LINE__, "thread count resolution\n");
+	}
+
+	return(status);
+}
+
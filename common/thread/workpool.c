@@ -0,0 +1,208 @@
+/** ------------------------------------------------------------
+ ** Worker pool for running independent tasks concurrently
+ ** ------------------------------------------------------------
+ ** $Id$
+ **
+ ** Tasks are handed out one index at a time from a shared
+ ** counter, so uneven task costs balance themselves across the
+ ** workers.  Results must be stored by the task against its own
+ ** index; the caller then gathers them in index order, which keeps
+ ** the output independent of the number of threads used.
+ **
+ ** On platforms without POSIX threads the tasks are simply run
+ ** in order on the calling thread.
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+# ifndef OS_WINDOWS_NT
+#  include <unistd.h>
+#  include <pthread.h>
+# endif
+#endif
+
+#include "tclCkalloc.h"
+#include "workpool.h"
+
+#ifndef OS_WINDOWS_NT
+# define        WORKPOOL_USE_PTHREADS
+#endif
+
+/** upper limit on threads, whatever is requested */
+#define         WORKPOOL_MAX_THREADS    256
+
+/**
+ ** Number of processors available to this process
+ **/
+OS_EXPORT int
+workPoolGetNumProcessors()
+{
+#if defined(WORKPOOL_USE_PTHREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long nProcessors;
+
+    nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nProcessors < 1)
+        return 1;
+    if (nProcessors > WORKPOOL_MAX_THREADS)
+        return WORKPOOL_MAX_THREADS;
+    return (int) nProcessors;
+#else
+    return 1;
+#endif
+}
+
+/**
+ ** Turn a requested thread count (0 or less meaning "one per
+ ** processor") into the number actually worth starting
+ **/
+OS_EXPORT int
+workPoolResolveThreads(int requestedThreads, int nTasks)
+{
+    int nThreads;
+
+    nThreads = requestedThreads;
+    if (nThreads <= 0)
+        nThreads = workPoolGetNumProcessors();
+    if (nThreads > WORKPOOL_MAX_THREADS)
+        nThreads = WORKPOOL_MAX_THREADS;
+    if (nThreads > nTasks)
+        nThreads = nTasks;
+    if (nThreads < 1)
+        nThreads = 1;
+    return nThreads;
+}
+
+
+#ifdef WORKPOOL_USE_PTHREADS
+
+typedef struct workPoolState {
+    pthread_mutex_t wp_lock_;
+    int             wp_nextTask_;
+    int             wp_nTasks_;
+    int             wp_failed_;
+    workPoolTask    wp_task_;
+    void           *wp_userData_;
+} workPoolState;
+
+static int
+claimNextTask(workPoolState *state)
+{
+    int taskIndex;
+
+    pthread_mutex_lock(&state->wp_lock_);
+    if (state->wp_failed_)
+        taskIndex = (-1);
+    else if (state->wp_nextTask_ < state->wp_nTasks_)
+        taskIndex = state->wp_nextTask_++;
+    else
+        taskIndex = (-1);
+    pthread_mutex_unlock(&state->wp_lock_);
+
+    return taskIndex;
+}
+
+static void *
+workPoolWorker(void *userData)
+{
+    workPoolState *state = (workPoolState *) userData;
+    int taskIndex;
+
+    while ((taskIndex = claimNextTask(state)) >= 0)
+    {
+        if ( ! (*state->wp_task_)(taskIndex, state->wp_userData_) )
+        {
+            pthread_mutex_lock(&state->wp_lock_);
+            state->wp_failed_ = 1;
+            pthread_mutex_unlock(&state->wp_lock_);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ ** The threads started for the pool also give back the blocks
+ ** their allocator has cached before they exit
+ **/
+static void *
+workPoolThread(void *userData)
+{
+    (void) workPoolWorker(userData);
+    ckallocReleaseThreadCache();
+    return NULL;
+}
+
+#endif  /* WORKPOOL_USE_PTHREADS */
+
+
+/**
+ ** Run task(i, userData) for every i in 0 .. nTasks-1 using up to
+ ** nThreads threads (0 for one per processor).  Once any task
+ ** fails no further tasks are started.
+ **
+ ** Returns 1 if every task succeeded, 0 otherwise.
+ **/
+OS_EXPORT int
+workPoolRun(
+        int nTasks,
+        int nThreads,
+        workPoolTask task,
+        void *userData
+    )
+{
+    int i;
+#ifdef WORKPOOL_USE_PTHREADS
+    workPoolState state;
+    pthread_t *threads;
+    int nStarted;
+#endif
+
+    if (nTasks <= 0)
+        return 1;
+
+    nThreads = workPoolResolveThreads(nThreads, nTasks);
+
+#ifdef WORKPOOL_USE_PTHREADS
+    if (nThreads > 1)
+    {
+        memset(&state, 0, sizeof(state));
+        pthread_mutex_init(&state.wp_lock_, NULL);
+        state.wp_nTasks_ = nTasks;
+        state.wp_task_ = task;
+        state.wp_userData_ = userData;
+
+        threads = (pthread_t *) ckalloc(sizeof(pthread_t) * nThreads);
+
+        /** the calling thread does its share as worker zero */
+        nStarted = 0;
+        for (i = 1; i < nThreads; i++)
+        {
+            if (pthread_create(&threads[i], NULL,
+                        workPoolThread, &state) != 0)
+                break;
+            nStarted++;
+        }
+
+        (void) workPoolWorker(&state);
+
+        for (i = 1; i <= nStarted; i++)
+            pthread_join(threads[i], NULL);
+
+        ckfree(threads);
+        pthread_mutex_destroy(&state.wp_lock_);
+
+        return state.wp_failed_ ? 0 : 1;
+    }
+#endif
+
+    for (i = 0; i < nTasks; i++)
+    {
+        if ( ! (*task)(i, userData) )
+            return 0;
+    }
+    return 1;
+}
+
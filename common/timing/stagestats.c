@@ -0,0 +1,367 @@
+/** ------------------------------------------------------------
+ ** Per-stage timing, event counters and memory high water marks
+ ** ------------------------------------------------------------
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+# include <time.h>
+# ifdef OS_WINDOWS_NT
+#  include <windows.h>
+#  include <psapi.h>
+# else
+#  include <sys/time.h>
+#  include <sys/resource.h>
+# endif
+#endif
+
+#include "tclCkalloc.h"
+#include "stagestats.h"
+
+#if defined(OS_WINDOWS_NT) && defined(_MSC_VER)
+# pragma comment(lib, "psapi.lib")
+#endif
+
+struct stage_record
+{
+	const char *name_;
+	int parent_;
+	osInt64 nCalls_;
+	double wallSeconds_;
+	double CPUSeconds_;
+	osInt64 peakRSS_;
+	osInt64 counter_[STAGESTATS_MAX_COUNTERS];
+};
+
+struct stage_stats
+{
+	struct stage_record stage_[STAGESTATS_MAX_STAGES];
+	int nStages_;
+
+	const char *counterName_[STAGESTATS_MAX_COUNTERS];
+	int nCounters_;
+
+	/** the open stages, innermost last */
+	int open_[STAGESTATS_MAX_DEPTH];
+	double openWall_[STAGESTATS_MAX_DEPTH];
+	double openCPU_[STAGESTATS_MAX_DEPTH];
+	int depth_;
+
+	/** stages opened too deep or beyond the table are only counted */
+	int nLost_;
+
+	double startWall_;
+	double startCPU_;
+};
+
+OS_THREAD_LOCAL int gStageStatsEnabled = 0;
+
+static OS_THREAD_LOCAL struct stage_stats *sStats = NULL;
+
+
+OS_EXPORT void
+stageStatsSetEnabled(int enabled)
+{
+	gStageStatsEnabled = enabled;
+}
+
+OS_EXPORT double
+stageStatsWallClock()
+{
+#ifdef OS_WINDOWS_NT
+	LARGE_INTEGER count, frequency;
+
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (double) count.QuadPart / (double) frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + (now.tv_nsec / 1.0e9);
+#endif
+}
+
+OS_EXPORT double
+stageStatsCPUClock()
+{
+#ifdef OS_WINDOWS_NT
+	FILETIME created, exited, kernel, user;
+	ULARGE_INTEGER k, u;
+
+	if ( ! GetProcessTimes(GetCurrentProcess(),
+				&created, &exited, &kernel, &user))
+		return 0;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+
+	/** in units of 100ns */
+	return (double) (k.QuadPart + u.QuadPart) / 1.0e7;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return now.tv_sec + (now.tv_nsec / 1.0e9);
+#endif
+}
+
+OS_EXPORT osInt64
+stageStatsPeakRSS()
+{
+#ifdef OS_WINDOWS_NT
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if ( ! GetProcessMemoryInfo(GetCurrentProcess(),
+				&counters, sizeof(counters)))
+		return 0;
+	return (osInt64) (counters.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0;
+# ifdef OS_DARWIN
+	/** reported in bytes rather than kB */
+	return (osInt64) (usage.ru_maxrss / 1024);
+# else
+	return (osInt64) usage.ru_maxrss;
+# endif
+#endif
+}
+
+OS_EXPORT void
+stageStatsReset()
+{
+	if (sStats == NULL)
+		sStats = (struct stage_stats *) ckalloc(sizeof(struct stage_stats));
+	memset(sStats, 0, sizeof(struct stage_stats));
+	sStats->startWall_ = stageStatsWallClock();
+	sStats->startCPU_ = stageStatsCPUClock();
+}
+
+OS_EXPORT void
+stageStatsCleanup()
+{
+	if (sStats != NULL)
+	{
+		ckfree(sStats);
+		sStats = NULL;
+	}
+}
+
+/**
+ ** find a stage by name (names are compared by pointer first,
+ ** as they are almost always the same string constant)
+ **/
+static int
+findStage(const char *name, int parent)
+{
+	int i;
+
+	for (i = 0; i < sStats->nStages_; i++)
+	{
+		if (sStats->stage_[i].name_ == name
+				|| strcmp(sStats->stage_[i].name_, name) == 0)
+			return i;
+	}
+	if (sStats->nStages_ >= STAGESTATS_MAX_STAGES)
+		return (-1);
+
+	sStats->stage_[i].name_ = name;
+	sStats->stage_[i].parent_ = parent;
+	sStats->nStages_++;
+	return i;
+}
+
+static int
+findCounter(const char *name)
+{
+	int i;
+
+	for (i = 0; i < sStats->nCounters_; i++)
+	{
+		if (sStats->counterName_[i] == name
+				|| strcmp(sStats->counterName_[i], name) == 0)
+			return i;
+	}
+	if (sStats->nCounters_ >= STAGESTATS_MAX_COUNTERS)
+		return (-1);
+
+	sStats->counterName_[i] = name;
+	sStats->nCounters_++;
+	return i;
+}
+
+OS_EXPORT int
+stageStatsBegin(const char *name)
+{
+	int stage, parent;
+
+	if ( ! gStageStatsEnabled )
+		return 0;
+
+	if (sStats == NULL)
+		stageStatsReset();
+
+	if (sStats->depth_ >= STAGESTATS_MAX_DEPTH)
+	{
+		sStats->nLost_++;
+		return 0;
+	}
+
+	parent = (sStats->depth_ > 0)
+			? sStats->open_[sStats->depth_ - 1] : (-1);
+	stage = findStage(name, parent);
+	if (stage < 0)
+	{
+		sStats->nLost_++;
+		return 0;
+	}
+
+	sStats->open_[sStats->depth_] = stage;
+	sStats->openWall_[sStats->depth_] = stageStatsWallClock();
+	sStats->openCPU_[sStats->depth_] = stageStatsCPUClock();
+	sStats->depth_++;
+	return 1;
+}
+
+OS_EXPORT void
+stageStatsEnd()
+{
+	struct stage_record *record;
+	osInt64 RSS;
+
+	if (sStats == NULL || sStats->depth_ <= 0)
+		return;
+
+	sStats->depth_--;
+	record = &sStats->stage_[sStats->open_[sStats->depth_]];
+	record->nCalls_++;
+	record->wallSeconds_ +=
+			stageStatsWallClock() - sStats->openWall_[sStats->depth_];
+	record->CPUSeconds_ +=
+			stageStatsCPUClock() - sStats->openCPU_[sStats->depth_];
+
+	RSS = stageStatsPeakRSS();
+	if (RSS > record->peakRSS_)
+		record->peakRSS_ = RSS;
+}
+
+OS_EXPORT void
+stageStatsCount(const char *name, osInt64 amount)
+{
+	int counter;
+
+	if ( ! gStageStatsEnabled || sStats == NULL || sStats->depth_ <= 0)
+		return;
+
+	counter = findCounter(name);
+	if (counter < 0)
+		return;
+
+	sStats->stage_[sStats->open_[sStats->depth_ - 1]].counter_[counter]
+			+= amount;
+}
+
+
+/**
+ ** write a string with the characters JSON requires escaped
+ **/
+static void
+writeJSONString(FILE *fp, const char *string)
+{
+	const char *s;
+
+	fputc('"', fp);
+	for (s = string; *s != 0; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf(fp, "\\%c", *s);
+		else if ((unsigned char) *s < 0x20)
+			fprintf(fp, "\\u%04x", (unsigned char) *s);
+		else
+			fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+static void
+writeJSONCounters(FILE *fp, const osInt64 *counter, const char *indent)
+{
+	int i, nWritten = 0;
+
+	fprintf(fp, "{");
+	for (i = 0; i < sStats->nCounters_; i++)
+	{
+		if (counter[i] == 0)
+			continue;
+		fprintf(fp, "%s\n%s  ", (nWritten > 0) ? "," : "", indent);
+		writeJSONString(fp, sStats->counterName_[i]);
+		fprintf(fp, ": %.0f", (double) counter[i]);
+		nWritten++;
+	}
+	if (nWritten > 0)
+		fprintf(fp, "\n%s", indent);
+	fprintf(fp, "}");
+}
+
+OS_EXPORT int
+stageStatsWriteJSON(FILE *fp, const char *description)
+{
+	osInt64 total[STAGESTATS_MAX_COUNTERS];
+	struct stage_record *record;
+	int i, j;
+
+	if (sStats == NULL)
+		stageStatsReset();
+
+	memset(total, 0, sizeof(total));
+	for (i = 0; i < sStats->nStages_; i++)
+	{
+		for (j = 0; j < sStats->nCounters_; j++)
+			total[j] += sStats->stage_[i].counter_[j];
+	}
+
+	fprintf(fp, "{\n  \"description\": ");
+	writeJSONString(fp, (description == NULL) ? "" : description);
+	fprintf(fp, ",\n  \"wall_seconds\": %.6f",
+			stageStatsWallClock() - sStats->startWall_);
+	fprintf(fp, ",\n  \"cpu_seconds\": %.6f",
+			stageStatsCPUClock() - sStats->startCPU_);
+	fprintf(fp, ",\n  \"peak_rss_kb\": %.0f",
+			(double) stageStatsPeakRSS());
+	if (sStats->nLost_ > 0)
+		fprintf(fp, ",\n  \"untracked_stages\": %d", sStats->nLost_);
+	fprintf(fp, ",\n  \"counters\": ");
+	writeJSONCounters(fp, total, "  ");
+
+	fprintf(fp, ",\n  \"stages\": [");
+	for (i = 0; i < sStats->nStages_; i++)
+	{
+		record = &sStats->stage_[i];
+		fprintf(fp, "%s\n    {\n      \"name\": ", (i > 0) ? "," : "");
+		writeJSONString(fp, record->name_);
+		if (record->parent_ >= 0)
+		{
+			fprintf(fp, ",\n      \"parent\": ");
+			writeJSONString(fp, sStats->stage_[record->parent_].name_);
+		}
+		fprintf(fp, ",\n      \"calls\": %.0f", (double) record->nCalls_);
+		fprintf(fp, ",\n      \"wall_seconds\": %.6f", record->wallSeconds_);
+		fprintf(fp, ",\n      \"cpu_seconds\": %.6f", record->CPUSeconds_);
+		fprintf(fp, ",\n      \"peak_rss_kb\": %.0f",
+				(double) record->peakRSS_);
+		fprintf(fp, ",\n      \"counters\": ");
+		writeJSONCounters(fp, record->counter_, "      ");
+		fprintf(fp, "\n    }");
+	}
+	fprintf(fp, "\n  ]\n}\n");
+
+	return ferror(fp) == 0;
+}
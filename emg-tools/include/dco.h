@@ -54,7 +54,7 @@ typedef struct TrainInfo
 	int isSuppressed_;
 
     osInt32	nRelations_;
-    osInt32	nRelationBlocks_;
+    osInt32	nRelationsAllocated_;
     TrainRelation *relation_;
 } TrainInfo;
 
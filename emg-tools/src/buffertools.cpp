@@ -95,7 +95,7 @@ bandpassFilter(float *target, const emgValue * src,
 static void
 addTurnToBuffer(
 		emgTurn ** turnBuffer,
-		int *turnBufferBlocks,
+		int *turnBufferAllocated,
 		int turnIndex,
 		int turnDuration,
 		double turnAmplitude,
@@ -104,12 +104,11 @@ addTurnToBuffer(
 {
 	int status;
 
-	status = listMkCheckSize(
+	status = growArrayReserve(
 							   turnIndex + 1,
 							   (void **) turnBuffer,
-							   turnBufferBlocks,
-							   sizeof(emgTurn),
-							   128, __FILE__, __LINE__);
+							   turnBufferAllocated,
+							   sizeof(emgTurn));
 	MSG_ASSERT(status, "malloc failed");
 
 	(*turnBuffer)[turnIndex].amplitudeInUV = turnAmplitude;
@@ -137,7 +136,7 @@ countAndStoreTurns(
 	)
 {
 	int turnCount = (-1);
-	int turnBufferBlocks = 0;
+	int turnBufferAllocated = 0;
 	int positiveRiseFlag = 0;
 	int negativeFallFlag = 0;
 	int positiveRisePos = 0;
@@ -183,7 +182,7 @@ countAndStoreTurns(
 					 * and distance
 					 */
 					addTurnToBuffer(
-							   turnBuffer, &turnBufferBlocks, turnCount + 1,
+							   turnBuffer, &turnBufferAllocated, turnCount + 1,
 									i - lastTurnIndex,
 									currentValue - lastTurnVoltageValue,
 									samplingRateInHz
@@ -205,7 +204,7 @@ countAndStoreTurns(
 					 * and distance
 					 */
 					addTurnToBuffer(
-							   turnBuffer, &turnBufferBlocks, turnCount + 1,
+							   turnBuffer, &turnBufferAllocated, turnCount + 1,
 									i - lastTurnIndex,
 									currentValue - lastTurnVoltageValue,
 									samplingRateInHz
@@ -123,7 +123,7 @@ initializeTrain_(TrainInfo *newTrain)
 	newTrain->isSuppressed_ = 0;
 
 	newTrain->nRelations_ = 0;
-	newTrain->nRelationBlocks_ = 0;
+	newTrain->nRelationsAllocated_ = 0;
 	newTrain->relation_ = NULL;
 }
 
@@ -578,9 +578,9 @@ addDcoTrainDependency_(
 
 
 	/** add the relation to this train */
-	if (listCheckSize(dco->train_[trainIndex].nRelations_ + 1,
+	if (growArrayReserve(dco->train_[trainIndex].nRelations_ + 1,
 			(void **) &dco->train_[trainIndex].relation_,
-			&dco->train_[trainIndex].nRelationBlocks_, 4,
+			&dco->train_[trainIndex].nRelationsAllocated_,
 			sizeof(TrainRelation)) <= 0)
 	{
 		return -1;
@@ -185,6 +185,7 @@ runOneSimulation(
 	initializedGlobals = sim->initializeGlobals(configFile, outputRoot);
 
 	if ( initializedGlobals == NULL) {
+		LogFlush();
 		fprintf(stderr,
 				"Failure in internal initialization -- aborting\n");
 		goto END;
@@ -214,6 +215,10 @@ runOneSimulation(
 		g->use_old_firing_times = 0;
 	}
 
+	if (flags->randomSeed != 0) {
+		g->random_seed = flags->randomSeed;
+	}
+
 
 	/** >>>> HANDLE UI **/
 	/*
@@ -259,8 +264,31 @@ runOneSimulation(
 	if (flags->runSurface)
 		simFlags |= Simulator::FLAG_RUN_SURFACE;
 
+	if (flags->incremental)
+		simFlags |= Simulator::FLAG_INCREMENTAL;
+
+	setFiringLogVerbosity(flags->verboseFiring);
+
 	/** GENERATE MUSCLE DATA **/
-	result = sim->run(simFlags);
+	if (flags->nProgressionStages > 0) {
+		result = sim->runProgression(
+				flags->progressionSeverity,
+				flags->nProgressionStages,
+				simFlags);
+	} else if (flags->nSweepPositions > 0) {
+		result = sim->runNeedleSweep(
+				flags->sweepX,
+				flags->sweepY,
+				flags->nSweepPositions,
+				simFlags);
+	} else if (flags->nSweepLevels > 0) {
+		result = sim->runContractionSweep(
+				flags->sweepLevel,
+				flags->nSweepLevels,
+				simFlags);
+	} else {
+		result = sim->run(simFlags);
+	}
 
 	/** let's see what we got! */
 	//result->dump(stdout);
@@ -305,6 +333,36 @@ END:
 	return status;
 }
 
+/**
+ ** Write muscle snapshots into a run directory made by
+ ** an earlier version of the simulator
+ **/
+static int
+upgradeMuscleFiles(
+		struct optionflags *flags,
+		char *configFile,
+		char *outputRoot
+	)
+{
+	class Simulator *sim;
+	int status = 0;
+
+	sim = new Simulator();
+
+	if (sim->initializeGlobals(configFile, outputRoot) == NULL) {
+		LogFlush();
+		fprintf(stderr,
+				"Failure in internal initialization -- aborting\n");
+	} else {
+		status = sim->upgradeMuscleFiles(flags->upgradeMuscleDir);
+	}
+
+	delete sim;
+	deleteGlobals();
+
+	return status;
+}
+
 /**
  ** ----------------------------------------------------------------
  ** mainline routine -- call for option parsing, setup and
@@ -351,6 +409,15 @@ main(int argc, char **argv)
 		        LOGDEST_FUNCTION|LOGDEST_NO_ID|LOGDEST_LOCALFILE,
 		        logFile);
 		LogFunction(outputFunction, NULL);
+
+		/** the menu is written at info level, so is only hidden if skipped */
+		if (flags.quiet && flags.skipValidateGlobals)
+			LogSetLevel(LOG_NOTICE);
+		else if (flags.quiet)
+			LogWarn("-quiet is ignored without -skip-confirm\n");
+
+		/** keep terminal and disk latency out of the simulation */
+		LogStartWriter();
 		LogInfo("Simulator Run Begins: %s\n", ctime(&curtime));
 		LogInfo("\nThis version compiled on %s at %s\n",
 				__DATE__, __TIME__);
@@ -360,19 +427,29 @@ main(int argc, char **argv)
 				LogInfo("    %s\n", argv[i]);
 		}
 
-		do {
-			runCount++;
-
-			if ( ! runOneSimulation(&flags, &isQuitting,
-					configBasePath, configFile, outputRoot, logFile) ) {
-				fprintf(stderr, "Simulation run %d failed\n", runCount);
+		if (flags.upgradeMuscleDir != NULL) {
+			if ( ! upgradeMuscleFiles(&flags, configFile, outputRoot) ) {
+				LogFlush();
+				fprintf(stderr, "Upgrade of '%s' failed\n",
+						flags.upgradeMuscleDir);
 				exitStatus = 1;
 			}
-		} while (flags.runLoop && (!isQuitting));
-
-		if (flags.runLoop)
-		{
-			LogInfo("Simulator run %d times\n", runCount);
+		} else {
+			do {
+				runCount++;
+
+				if ( ! runOneSimulation(&flags, &isQuitting,
+						configBasePath, configFile, outputRoot, logFile) ) {
+					LogFlush();
+					fprintf(stderr, "Simulation run %d failed\n", runCount);
+					exitStatus = 1;
+				}
+			} while (flags.runLoop && (!isQuitting));
+
+			if (flags.runLoop)
+			{
+				LogInfo("Simulator run %d times\n", runCount);
+			}
 		}
 	}
 
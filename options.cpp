@@ -146,6 +146,113 @@ static void doSetDestinationRoot(
 	opts->destinationRoot = ckstrdup(&arg[len]);
 }
 
+static void doUpgradeMuscle(
+		struct optionflags *opts,
+		const char *arg,
+		const char *tag
+	)
+{
+	int len = strlen(tag) + 1;
+	opts->upgradeMuscleDir = ckstrdup(&arg[len]);
+}
+
+/**
+ * Parse the comma separated list of numbers following the tag
+ * into a newly allocated array, replacing any list given before
+ */
+static void parseFloatList(
+		const char *arg,
+		const char *tag,
+		const char *description,
+		float **values,
+		int *nValues
+	)
+{
+	const char *value = &arg[strlen(tag) + 1];
+	char *end;
+	int n = 1;
+	int i;
+
+	for (i = 0; value[i] != 0; i++) {
+		if (value[i] == ',')
+			n++;
+	}
+
+	if (*values != NULL)
+		ckfree((char *) *values);
+	*values = (float *) ckalloc(sizeof(float) * n);
+	*nValues = n;
+
+	for (i = 0; i < n; i++) {
+		(*values)[i] = (float) strtod(value, &end);
+		if (end == value || (*end != ',' && *end != 0)) {
+			Error("Invalid %s list in '%s'\n", description, arg);
+			exit (1);
+		}
+		value = end + 1;
+	}
+}
+
+static void doSetProgression(
+		struct optionflags *opts,
+		const char *arg,
+		const char *tag
+	)
+{
+	parseFloatList(arg, tag, "severity",
+			&opts->progressionSeverity, &opts->nProgressionStages);
+}
+
+static void doSetContractionSweep(
+		struct optionflags *opts,
+		const char *arg,
+		const char *tag
+	)
+{
+	parseFloatList(arg, tag, "contraction level",
+			&opts->sweepLevel, &opts->nSweepLevels);
+}
+
+static void doSetNeedleSweep(
+		struct optionflags *opts,
+		const char *arg,
+		const char *tag
+	)
+{
+	const char *position = &arg[strlen(tag) + 1];
+	char *end;
+	int nPositions = 1;
+	int i;
+
+	for (i = 0; position[i] != 0; i++) {
+		if (position[i] == ',')
+			nPositions++;
+	}
+
+	if (opts->sweepX != NULL)
+		ckfree((char *) opts->sweepX);
+	if (opts->sweepY != NULL)
+		ckfree((char *) opts->sweepY);
+	opts->sweepX = (float *) ckalloc(sizeof(float) * nPositions);
+	opts->sweepY = (float *) ckalloc(sizeof(float) * nPositions);
+	opts->nSweepPositions = nPositions;
+
+	for (i = 0; i < nPositions; i++) {
+		opts->sweepX[i] = (float) strtod(position, &end);
+		if (end == position || *end != ':') {
+			Error("Invalid needle position list in '%s'\n", arg);
+			exit (1);
+		}
+		position = end + 1;
+		opts->sweepY[i] = (float) strtod(position, &end);
+		if (end == position || (*end != ',' && *end != 0)) {
+			Error("Invalid needle position list in '%s'\n", arg);
+			exit (1);
+		}
+		position = end + 1;
+	}
+}
+
 static void doSkipConfirm(
 		struct optionflags *opts,
 		const char *arg,
@@ -196,6 +303,48 @@ static void doUseNewFiringTimes(
 {
 	opts->useOldFiringTimes = 0;
 }
+static void doIncremental(
+		struct optionflags *opts,
+		const char *arg,
+		const char *tag
+	)
+{
+	opts->incremental = 1;
+}
+
+static void doSetRandomSeed(
+		struct optionflags *opts,
+		const char *arg,
+		const char *tag
+	)
+{
+	const char *value = &arg[strlen(tag) + 1];
+	char *end;
+
+	opts->randomSeed = (int) strtol(value, &end, 10);
+	if (end == value || *end != 0 || opts->randomSeed == 0) {
+		Error("Invalid (or zero) random seed in '%s'\n", arg);
+		exit (1);
+	}
+}
+
+static void doVerboseFiring(
+		struct optionflags *opts,
+		const char *arg,
+		const char *tag
+	)
+{
+	opts->verboseFiring = 1;
+}
+
+static void doQuiet(
+		struct optionflags *opts,
+		const char *arg,
+		const char *tag
+	)
+{
+	opts->quiet = 1;
+}
 
 static void doUseDQEmgDataFormat(
 		struct optionflags *opts,
@@ -293,6 +442,30 @@ struct option_set {
 		{"useNewFiringTimes",	  NULL,
 			"if using last muscle, generate new firing times (default)",
 			doUseNewFiringTimes	  },
+		{"incremental",	  NULL,
+			"keep the stages of the last run whose inputs are unchanged",
+			doIncremental	  },
+		{"seed=",	  "<N>",
+			"seed each stage with <N> so that runs are repeatable",
+			doSetRandomSeed	  },
+		{"verbose-firing",	  NULL,
+			"log each firing-time (IPI) correction as it is made",
+			doVerboseFiring	  },
+		{"quiet",	  NULL,
+			"with -skip-confirm, only log notices, warnings and errors",
+			doQuiet	  },
+		{"upgrade-muscle=",	  "<DIR>",
+			"write binary muscle snapshots for the run directory <DIR> and exit",
+			doUpgradeMuscle	  },
+		{"progression=",	  "<S1,S2,...>",
+			"run a disease time-series, scaling the pathology by each severity",
+			doSetProgression	  },
+		{"needle-sweep=",	  "<X1:Y1,X2:Y2,...>",
+			"record at each needle position (mm) in the same muscle",
+			doSetNeedleSweep	  },
+		{"contraction-sweep=",	  "<L1,L2,...>",
+			"record at each contraction level (%MVC) in the same muscle",
+			doSetContractionSweep	  },
 		{"DQEmgData",   NULL,
 			"Generate files in DQEmgData format",
 			doUseDQEmgDataFormat		},
@@ -382,6 +555,21 @@ cleanOptions(struct optionflags *flags)
 
 	if (flags->destinationRoot != NULL)
 		ckfree(flags->destinationRoot);
+
+	if (flags->upgradeMuscleDir != NULL)
+		ckfree(flags->upgradeMuscleDir);
+
+	if (flags->progressionSeverity != NULL)
+		ckfree((char *) flags->progressionSeverity);
+
+	if (flags->sweepX != NULL)
+		ckfree((char *) flags->sweepX);
+
+	if (flags->sweepY != NULL)
+		ckfree((char *) flags->sweepY);
+
+	if (flags->sweepLevel != NULL)
+		ckfree((char *) flags->sweepLevel);
 }
 
 void printHelp(
@@ -19,6 +19,10 @@ struct optionflags {
         int waitForKeyToExit;
         int useLastMuscle;
         int useOldFiringTimes;
+        int incremental;
+        int verboseFiring;
+        int quiet;
+        int randomSeed;
 
         int runSurface;
         int DQEmgDataFormat;
@@ -26,6 +30,17 @@ struct optionflags {
         char driveLetter[3];
 		char *configFilePath;
 		char *destinationRoot;
+		char *upgradeMuscleDir;
+
+		float *progressionSeverity;
+		int nProgressionStages;
+
+		float *sweepX;
+		float *sweepY;
+		int nSweepPositions;
+
+		float *sweepLevel;
+		int nSweepLevels;
 };
 
 
@@ -58,16 +58,32 @@ struct ListNode
  */
 typedef int (*SearchHitCallback)(long id, void* arg);
 
+/*
+ * A data rect found by RTreeNearest: its ID and the distance
+ * from the query point to the centre of the rect.
+ */
+struct RTreeNeighbour
+{
+    int id;
+    RectReal distance;
+};
+
 
 # if defined(__cplusplus) || defined(c_plusplus)
 extern "C" {
 # endif
 
 int RTreeSearch(struct Node*, struct Rect*, SearchHitCallback, void*);
+int RTreeCountSearchNodes(struct Node*, struct Rect*);
+int RTreeNearest(struct Node*, RectReal point[NUMDIMS], int k,
+        struct RTreeNeighbour *out);
+int RTreeRadius(struct Node*, RectReal point[NUMDIMS], RectReal radius,
+        int *ids, int maxIds);
 int RTreeInsertRect(struct Rect*, int, struct Node**, int depth);
 int RTreeDeleteRect(struct Rect*, int, struct Node**);
 
 struct Node * RTreeNewIndex();
+struct Node * RTreeBulkLoad(struct Rect *rects, const int *ids, int n);
 void RTreeDeleteIndex(struct Node *n);
 struct Node * RTreeNewNode();
 
@@ -89,10 +89,18 @@ SOURCE=.\src\card.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\bulkload.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\index.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\nearest.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\node.c
 # End Source File
 # Begin Source File
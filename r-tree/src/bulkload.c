@@ -0,0 +1,227 @@
+/**
+ ** Sort-Tile-Recursive bulk loading of a static set of data
+ ** rectangles.
+ **
+ ** Each level is built by sorting the entries on the X centre,
+ ** cutting them into roughly sqrt(P) vertical slices (where P is
+ ** the number of nodes needed at that level), sorting each slice
+ ** on the Y centre and packing runs of entries into nodes.  The
+ ** covering rectangles of those nodes become the entries of the
+ ** next level up, until a single root remains.
+ **
+ ** Entries are spread evenly over the nodes of a slice, so every
+ ** node (other than a lone root) is at least half full and the
+ ** tree remains valid for later RTreeInsertRect/RTreeDeleteRect
+ ** calls.
+ **
+ ** $Id$
+ **/
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <math.h>
+# include <assert.h>
+#endif
+
+#include "rTreeIndex.h"
+#include "card.h"
+
+#include "tclCkalloc.h"
+
+
+/**
+ * An entry to be packed; order records the original position
+ * so that sorting is repeatable where centres are equal.
+ */
+struct PackEntry
+{
+    struct Branch branch;
+    RectReal centre[NUMDIMS];
+    int order;
+};
+
+
+static int ComparePackEntries(
+        const struct PackEntry *e1,
+        const struct PackEntry *e2,
+        int axis
+    )
+{
+    int other = (axis + 1) % NUMDIMS;
+
+    if (e1->centre[axis] < e2->centre[axis])
+        return -1;
+    if (e1->centre[axis] > e2->centre[axis])
+        return 1;
+    if (e1->centre[other] < e2->centre[other])
+        return -1;
+    if (e1->centre[other] > e2->centre[other])
+        return 1;
+    return e1->order - e2->order;
+}
+
+static int ComparePackEntriesX(const void *v1, const void *v2)
+{
+    return ComparePackEntries(
+            (const struct PackEntry *) v1,
+            (const struct PackEntry *) v2, 0);
+}
+
+static int ComparePackEntriesY(const void *v1, const void *v2)
+{
+    return ComparePackEntries(
+            (const struct PackEntry *) v1,
+            (const struct PackEntry *) v2, 1);
+}
+
+
+static void SetPackEntry(
+        struct PackEntry *entry,
+        struct Rect *rect,
+        struct Node *child,
+        int order
+    )
+{
+    int i;
+
+    entry->branch.rect = *rect;
+    entry->branch.child = child;
+    for (i = 0; i < NUMDIMS; i++)
+    {
+        entry->centre[i] =
+                (rect->boundary[i] + rect->boundary[NUMDIMS + i]) / 2;
+    }
+    entry->order = order;
+}
+
+
+/**
+ * Pack the entries of one slice into nodes at the given level,
+ * appending the new nodes to the parent entry list.
+ */
+static void PackSlice(
+        struct PackEntry *entry,
+        int nEntries,
+        int capacity,
+        int level,
+        struct PackEntry *parent,
+        int *nParents
+    )
+{
+    struct Node *node;
+    struct Rect cover;
+    int nNodes, nInNode, remainder;
+    int i, j, k = 0;
+
+    qsort(entry, nEntries, sizeof(struct PackEntry), ComparePackEntriesY);
+
+    nNodes = (nEntries + capacity - 1) / capacity;
+    remainder = nEntries % nNodes;
+    for (i = 0; i < nNodes; i++)
+    {
+        nInNode = (nEntries / nNodes) + (i < remainder ? 1 : 0);
+
+        node = RTreeNewNode();
+        node->level = level;
+        for (j = 0; j < nInNode; j++)
+        {
+            node->branch[j] = entry[k++].branch;
+        }
+        node->count = nInNode;
+
+        cover = RTreeNodeCover(node);
+        SetPackEntry(&parent[*nParents], &cover, node, *nParents);
+        (*nParents)++;
+    }
+    assert(k == nEntries);
+}
+
+
+/**
+ * Build one level of the tree; returns the number of entries
+ * (one per node) placed in the parent list.
+ */
+static int PackLevel(
+        struct PackEntry *entry,
+        int nEntries,
+        int capacity,
+        int level,
+        struct PackEntry *parent
+    )
+{
+    int nNodes, nSlices;
+    int start, end;
+    int nParents = 0;
+    int i;
+
+    nNodes = (nEntries + capacity - 1) / capacity;
+    nSlices = (int) ceil(sqrt((double) nNodes));
+
+    qsort(entry, nEntries, sizeof(struct PackEntry), ComparePackEntriesX);
+
+    for (i = 0; i < nSlices; i++)
+    {
+        start = (int) (((long) nEntries * i) / nSlices);
+        end = (int) (((long) nEntries * (i + 1)) / nSlices);
+        if (end > start)
+        {
+            PackSlice(&entry[start], end - start, capacity, level,
+                    parent, &nParents);
+        }
+    }
+
+    return nParents;
+}
+
+
+/**
+ * Build a packed index over n data rectangles in O(n log n).
+ * ids[i] is the (non-zero) id reported by RTreeSearch for
+ * rects[i], exactly as it would be passed to RTreeInsertRect.
+ */
+struct Node * RTreeBulkLoad(
+        struct Rect *rects,
+        const int *ids,
+        int n
+    )
+{
+    struct PackEntry *entry, *parent, *swap;
+    struct Node *root;
+    int nEntries, capacity;
+    int level = 0;
+    int i;
+
+    assert(n >= 0);
+    if (n == 0)
+        return RTreeNewIndex();
+
+    assert(rects && ids);
+
+    entry = (struct PackEntry *) ckalloc(sizeof(struct PackEntry) * n);
+    parent = (struct PackEntry *) ckalloc(sizeof(struct PackEntry) * n);
+    for (i = 0; i < n; i++)
+    {
+        assert(ids[i] != 0);
+        SetPackEntry(&entry[i], &rects[i], (struct Node *) (long) ids[i], i);
+    }
+
+    nEntries = n;
+    do {
+        capacity = (level == 0) ? LEAFCARD : NODECARD;
+        nEntries = PackLevel(entry, nEntries, capacity, level, parent);
+
+        swap = entry;
+        entry = parent;
+        parent = swap;
+        level++;
+    } while (nEntries > 1);
+
+    root = entry[0].branch.child;
+
+    ckfree(entry);
+    ckfree(parent);
+
+    return root;
+}
+
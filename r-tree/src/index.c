@@ -80,6 +80,34 @@ int RTreeSearch(
 
 
 
+/**
+ * Count the nodes that RTreeSearch would visit for the
+ * argument rectangle, including the root.  Used to compare
+ * how well different trees over the same data are packed.
+ */
+int RTreeCountSearchNodes(struct Node *N, struct Rect *R)
+{
+    register int nVisits = 1;
+    register int i;
+
+    assert(N);
+    assert(R);
+
+    if (N->level > 0)
+    {
+        for (i=0; i<NODECARD; i++) {
+            if (N->branch[i].child &&
+                RTreeOverlap(R,&N->branch[i].rect))
+            {
+                nVisits += RTreeCountSearchNodes(N->branch[i].child, R);
+            }
+        }
+    }
+    return nVisits;
+}
+
+
+
 /**
  * Inserts a new data rectangle into the index structure.
  * Recursively descends tree, propagates splits back up.
@@ -93,7 +121,7 @@ int RTreeSearch(
  */
 static int RTreeInsertRect2(
         struct Rect *r,
-        long tid,
+        struct Node *child,
         struct Node *n,
         struct Node **new_node,
         int level
@@ -110,7 +138,7 @@ static int RTreeInsertRect2(
     if (n->level > level)
     {
         i = RTreePickBranch(r, n);
-        if (!RTreeInsertRect2(r, tid, n->branch[i].child, &n2, level))
+        if (!RTreeInsertRect2(r, child, n->branch[i].child, &n2, level))
         {
             /** child was not split */
             n->branch[i].rect =
@@ -130,7 +158,7 @@ static int RTreeInsertRect2(
     else if (n->level == level)
     {
         b.rect = *r;
-        b.child = (struct Node *) tid;
+        b.child = child;
         /* child field of leaves contains tid of data record */
         return RTreeAddBranch(&b, n, new_node);
     }
@@ -145,22 +173,22 @@ static int RTreeInsertRect2(
 
 
 /**
- * Insert a data rectangle into an index structure.
- * RTreeInsertRect provides for splitting the root;
- * returns 1 if root was split, 0 if it was not.
- * The level argument specifies the number of steps up from the leaf
- * level to insert; e.g. a data rectangle goes in at level = 0.
- * RTreeInsertRect2 does the recursion.
+ * Insert a branch into an index structure at the given level,
+ * splitting the root if necessary; returns 1 if the root was
+ * split, 0 if it was not.  The child is either a node one level
+ * below the insertion level or, at level 0, the tid of a data
+ * record.  Reinsertion during deletion passes node pointers, so
+ * the child must not pass through the int tid of RTreeInsertRect.
  */
-int RTreeInsertRect(
+static int RTreeInsertBranch(
         struct Rect *R,
-        int Tid,
+        struct Node *Child,
         struct Node **Root,
         int Level
     )
 {
     register struct Rect *r = R;
-    register int tid = Tid;
+    register struct Node *child = Child;
     register struct Node **root = Root;
     register int level = Level;
     register int i;
@@ -176,7 +204,7 @@ int RTreeInsertRect(
     }
 
     /** root split */
-    if (RTreeInsertRect2(r, tid, *root, &newnode, level)) {
+    if (RTreeInsertRect2(r, child, *root, &newnode, level)) {
         newroot = RTreeNewNode();  /* grow a new root, & tree taller */
         newroot->level = (*root)->level + 1;
         b.rect = RTreeNodeCover(*root);
@@ -195,6 +223,25 @@ int RTreeInsertRect(
 }
 
 
+/**
+ * Insert a data rectangle into an index structure.
+ * RTreeInsertRect provides for splitting the root;
+ * returns 1 if root was split, 0 if it was not.
+ * The level argument specifies the number of steps up from the leaf
+ * level to insert; e.g. a data rectangle goes in at level = 0.
+ * RTreeInsertRect2 does the recursion.
+ */
+int RTreeInsertRect(
+        struct Rect *R,
+        int Tid,
+        struct Node **Root,
+        int Level
+    )
+{
+    return RTreeInsertBranch(R, (struct Node *) (long) Tid, Root, Level);
+}
+
+
 
 /**
  * Allocate space for a node in the list used in DeletRect to
@@ -326,9 +373,9 @@ int RTreeDeleteRect(struct Rect *R, int Tid, struct Node**Nn)
             {
                 if (tmp_nptr->branch[i].child)
                 {
-                    RTreeInsertRect(
+                    RTreeInsertBranch(
                         &(tmp_nptr->branch[i].rect),
-                        (long)tmp_nptr->branch[i].child,
+                        tmp_nptr->branch[i].child,
                         nn,
                         tmp_nptr->level);
                 }
@@ -0,0 +1,296 @@
+/**
+ ** Distance queries: the k data rects nearest a point, and all
+ ** data rects within a given radius of a point.
+ **
+ ** Both queries treat each data rect as the point at its centre,
+ ** which is the natural meaning when small boxes are used to
+ ** index point data (as the simulator does for fibres).  The
+ ** minimum distance from the query point to a covering rect is
+ ** a lower bound on the distance to any centre beneath it, and
+ ** is used to prune and to order the search.
+ **
+ ** Neither query recurses; RTreeRadius walks the tree with an
+ ** explicit stack and RTreeNearest with a best-first queue.
+ **
+ ** $Id$
+ **/
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <math.h>
+# include <assert.h>
+#endif
+
+#include "rTreeIndex.h"
+#include "card.h"
+
+#include "tclCkalloc.h"
+
+
+/** deepest tree RTreeRadius will walk; far beyond any real index */
+#define MAX_DEPTH       32
+
+#define QUEUE_BLOCK     (4 * MAXCARD)
+
+
+/**
+ * An entry in the best-first queue; node is NULL for a data
+ * rect, in which case id identifies it.
+ */
+struct QueueEntry
+{
+    RectReal distance;
+    struct Node *node;
+    int id;
+};
+
+
+/** squared distance from the point to the nearest part of the rect */
+static RectReal MinDistanceSquared(RectReal *point, struct Rect *r)
+{
+    RectReal sum = 0, d;
+    int i;
+
+    for (i = 0; i < NUMDIMS; i++)
+    {
+        if (point[i] < r->boundary[i])
+            d = r->boundary[i] - point[i];
+        else if (point[i] > r->boundary[NUMDIMS + i])
+            d = point[i] - r->boundary[NUMDIMS + i];
+        else
+            d = 0;
+        sum += d * d;
+    }
+    return sum;
+}
+
+
+/** squared distance from the point to the centre of the rect */
+static RectReal CentreDistanceSquared(RectReal *point, struct Rect *r)
+{
+    RectReal sum = 0, d;
+    int i;
+
+    for (i = 0; i < NUMDIMS; i++)
+    {
+        d = (r->boundary[i] + r->boundary[NUMDIMS + i]) / 2 - point[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+
+/**
+ * Queue order: nearest first; at equal distance nodes come
+ * before data rects, so that every data rect at that distance
+ * has been queued before any is reported, and data rects are
+ * then reported in id order.  This makes the result independent
+ * of the shape of the tree.
+ */
+static int QueueEntryBefore(struct QueueEntry *e1, struct QueueEntry *e2)
+{
+    if (e1->distance != e2->distance)
+        return e1->distance < e2->distance;
+    if ((e1->node == NULL) != (e2->node == NULL))
+        return e1->node != NULL;
+    return e1->id < e2->id;
+}
+
+static void QueuePush(
+        struct QueueEntry **queue,
+        int *nQueued,
+        int *nAllocated,
+        struct QueueEntry *entry
+    )
+{
+    struct QueueEntry swap;
+    int i, parent;
+
+    if (*nQueued >= *nAllocated)
+    {
+        *nAllocated += QUEUE_BLOCK;
+        *queue = (struct QueueEntry *) ckrealloc((char *) *queue,
+                sizeof(struct QueueEntry) * (*nAllocated));
+    }
+
+    i = (*nQueued)++;
+    (*queue)[i] = *entry;
+    while (i > 0)
+    {
+        parent = (i - 1) / 2;
+        if ( ! QueueEntryBefore(&(*queue)[i], &(*queue)[parent]))
+            break;
+        swap = (*queue)[i];
+        (*queue)[i] = (*queue)[parent];
+        (*queue)[parent] = swap;
+        i = parent;
+    }
+}
+
+static void QueuePop(
+        struct QueueEntry *queue,
+        int *nQueued,
+        struct QueueEntry *entry
+    )
+{
+    struct QueueEntry swap;
+    int i = 0, child;
+
+    *entry = queue[0];
+    queue[0] = queue[--(*nQueued)];
+    for (;;)
+    {
+        child = 2 * i + 1;
+        if (child >= *nQueued)
+            break;
+        if (child + 1 < *nQueued
+                && QueueEntryBefore(&queue[child + 1], &queue[child]))
+            child++;
+        if ( ! QueueEntryBefore(&queue[child], &queue[i]))
+            break;
+        swap = queue[i];
+        queue[i] = queue[child];
+        queue[child] = swap;
+        i = child;
+    }
+}
+
+
+/**
+ * Find the k data rects whose centres are nearest the point,
+ * writing them to out[] in order of increasing distance (ties
+ * in id order).  Returns the number found, which is less than
+ * k only if the tree holds fewer than k rects.
+ */
+int RTreeNearest(
+        struct Node *root,
+        RectReal point[NUMDIMS],
+        int k,
+        struct RTreeNeighbour *out
+    )
+{
+    struct QueueEntry *queue;
+    struct QueueEntry entry;
+    struct Node *n;
+    int nQueued = 0, nAllocated = QUEUE_BLOCK;
+    int nFound = 0;
+    int i;
+
+    assert(root);
+    assert(point);
+    assert(k >= 0);
+    assert(out || k == 0);
+
+    if (k == 0)
+        return 0;
+
+    queue = (struct QueueEntry *)
+            ckalloc(sizeof(struct QueueEntry) * nAllocated);
+
+    entry.distance = 0;
+    entry.node = root;
+    entry.id = 0;
+    QueuePush(&queue, &nQueued, &nAllocated, &entry);
+
+    while (nQueued > 0 && nFound < k)
+    {
+        QueuePop(queue, &nQueued, &entry);
+
+        if (entry.node == NULL)
+        {
+            out[nFound].id = entry.id;
+            out[nFound].distance = (RectReal) sqrt(entry.distance);
+            nFound++;
+            continue;
+        }
+
+        n = entry.node;
+        for (i = 0; i < MAXKIDS(n); i++)
+        {
+            if (n->branch[i].child == NULL)
+                continue;
+
+            if (n->level > 0)
+            {
+                entry.distance = MinDistanceSquared(point,
+                        &n->branch[i].rect);
+                entry.node = n->branch[i].child;
+                entry.id = 0;
+            } else
+            {
+                entry.distance = CentreDistanceSquared(point,
+                        &n->branch[i].rect);
+                entry.node = NULL;
+                entry.id = (int) (long) n->branch[i].child;
+            }
+            QueuePush(&queue, &nQueued, &nAllocated, &entry);
+        }
+    }
+
+    ckfree((char *) queue);
+    return nFound;
+}
+
+
+/**
+ * Find all data rects whose centres lie within the given radius
+ * of the point.  Up to maxIds of their ids are written to ids[];
+ * the return value is the total number found, so if it exceeds
+ * maxIds the caller may enlarge the buffer and search again.
+ */
+int RTreeRadius(
+        struct Node *root,
+        RectReal point[NUMDIMS],
+        RectReal radius,
+        int *ids,
+        int maxIds
+    )
+{
+    struct Node *stack[MAX_DEPTH * MAXCARD];
+    struct Node *n;
+    RectReal radiusSquared = radius * radius;
+    int nStacked = 0;
+    int nFound = 0;
+    int i;
+
+    assert(root);
+    assert(point);
+    assert(ids || maxIds == 0);
+    assert(root->level < MAX_DEPTH);
+
+    stack[nStacked++] = root;
+    while (nStacked > 0)
+    {
+        n = stack[--nStacked];
+
+        if (n->level > 0)
+        {
+            for (i = 0; i < NODECARD; i++)
+            {
+                if (n->branch[i].child != NULL
+                        && MinDistanceSquared(point, &n->branch[i].rect)
+                                <= radiusSquared)
+                {
+                    assert(nStacked < MAX_DEPTH * MAXCARD);
+                    stack[nStacked++] = n->branch[i].child;
+                }
+            }
+        } else
+        {
+            for (i = 0; i < LEAFCARD; i++)
+            {
+                if (n->branch[i].child != NULL
+                        && CentreDistanceSquared(point, &n->branch[i].rect)
+                                <= radiusSquared)
+                {
+                    if (nFound < maxIds)
+                        ids[nFound] = (int) (long) n->branch[i].child;
+                    nFound++;
+                }
+            }
+        }
+    }
+
+    return nFound;
+}
+
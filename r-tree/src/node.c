@@ -249,14 +249,20 @@ int RTreeAddBranch(
 
 
 
-/* Disconnect a dependent node. */
+/**
+ * Disconnect a dependent node.  The last branch is moved into
+ * the gap so that the branches stay packed at the front of the
+ * node, as RTreeAddBranch and RTreeDeleteIndex expect.
+ */
 void RTreeDisconnectBranch(struct Node *n, int i)
 {
     assert(n && i>=0 && i<MAXKIDS(n));
     assert(n->branch[i].child);
+    assert(i < n->count);
 
-    RTreeInitBranch(&(n->branch[i]));
     n->count--;
+    n->branch[i] = n->branch[n->count];
+    RTreeInitBranch(&(n->branch[n->count]));
 }
 
 /**
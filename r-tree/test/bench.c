@@ -0,0 +1,121 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "rTreeIndex.h"
+
+/**
+ * Compare building an index by repeated insertion against
+ * RTreeBulkLoad for a fibre-like layout of unit squares on a
+ * jittered grid, and report how many nodes a typical needle
+ * sized query visits in each tree.
+ *
+ * usage: bench [ nRects [ nQueries ] ]
+ */
+
+static unsigned long seed = 1;
+
+static float NextUnit()
+{
+    seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return (float) seed / (float) 0x7fffffffUL;
+}
+
+static int CountCallback(long id, void* arg)
+{
+    return 1; /* keep going */
+}
+
+static double Seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv)
+{
+    struct Node *insertRoot, *bulkRoot;
+    struct Rect *rects, *queries;
+    int *ids;
+    int nRects = 200000, nQueries = 10000;
+    long insertVisits = 0, bulkVisits = 0;
+    long insertHits = 0, bulkHits = 0;
+    double insertTime, bulkTime, insertSearch, bulkSearch;
+    clock_t start;
+    float x, y, w, extent;
+    int side = 1;
+    int i;
+
+    if (argc > 1)
+        nRects = atoi(argv[1]);
+    if (argc > 2)
+        nQueries = atoi(argv[2]);
+
+    while (side * side < nRects)
+        side++;
+    extent = (float) side * 2;
+
+    rects = (struct Rect *) malloc(sizeof(struct Rect) * nRects);
+    ids = (int *) malloc(sizeof(int) * nRects);
+    queries = (struct Rect *) malloc(sizeof(struct Rect) * nQueries);
+
+    for (i = 0; i < nRects; i++) {
+        x = (float) (i % side) * 2 + NextUnit();
+        y = (float) (i / side) * 2 + NextUnit();
+        rects[i].boundary[0] = x - 0.5f;
+        rects[i].boundary[1] = y - 0.5f;
+        rects[i].boundary[2] = x + 0.5f;
+        rects[i].boundary[3] = y + 0.5f;
+        ids[i] = i + 1;
+    }
+    for (i = 0; i < nQueries; i++) {
+        x = NextUnit() * extent;
+        y = NextUnit() * extent;
+        w = 5 + NextUnit() * 10;
+        queries[i].boundary[0] = x - w;
+        queries[i].boundary[1] = y - w;
+        queries[i].boundary[2] = x + w;
+        queries[i].boundary[3] = y + w;
+    }
+
+    start = clock();
+    insertRoot = RTreeNewIndex();
+    for (i = 0; i < nRects; i++)
+        RTreeInsertRect(&rects[i], ids[i], &insertRoot, 0);
+    insertTime = Seconds(start);
+
+    start = clock();
+    bulkRoot = RTreeBulkLoad(rects, ids, nRects);
+    bulkTime = Seconds(start);
+
+    start = clock();
+    for (i = 0; i < nQueries; i++)
+        insertHits += RTreeSearch(insertRoot, &queries[i], CountCallback, 0);
+    insertSearch = Seconds(start);
+
+    start = clock();
+    for (i = 0; i < nQueries; i++)
+        bulkHits += RTreeSearch(bulkRoot, &queries[i], CountCallback, 0);
+    bulkSearch = Seconds(start);
+
+    for (i = 0; i < nQueries; i++) {
+        insertVisits += RTreeCountSearchNodes(insertRoot, &queries[i]);
+        bulkVisits += RTreeCountSearchNodes(bulkRoot, &queries[i]);
+    }
+
+    printf("%d rects, %d queries\n", nRects, nQueries);
+    printf("         build(s)  search(s)  nodes/query  hits\n");
+    printf("insert   %8.3f  %9.3f  %11.1f  %ld\n",
+            insertTime, insertSearch,
+            (double) insertVisits / nQueries, insertHits);
+    printf("bulk     %8.3f  %9.3f  %11.1f  %ld\n",
+            bulkTime, bulkSearch,
+            (double) bulkVisits / nQueries, bulkHits);
+
+    RTreeDeleteIndex(insertRoot);
+    RTreeDeleteIndex(bulkRoot);
+    free(rects);
+    free(ids);
+    free(queries);
+
+    return insertHits == bulkHits ? 0 : 1;
+}
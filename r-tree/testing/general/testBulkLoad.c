@@ -0,0 +1,258 @@
+/**
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rTreeIndex.h"
+#include "tclCkalloc.h"
+
+#include "testutils.h"
+
+
+#define	N_QUERIES	64
+
+typedef struct HitTally {
+    int nHits;
+    long idSum;
+} HitTally;
+
+static unsigned long sSeed;
+
+/** small LCG so that the layout is the same on every platform */
+static float sNextUnit()
+{
+    sSeed = (sSeed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return (float) sSeed / (float) 0x7fffffffUL;
+}
+
+/**
+ * Unit squares on a jittered grid, as buildFibreRTree makes;
+ * returns the width of the grid
+ */
+static float sMakeFibreRects(struct Rect *rects, int *ids, int n)
+{
+    int side = 1;
+    float x, y;
+    int i;
+
+    while (side * side < n)
+        side++;
+
+    for (i = 0; i < n; i++) {
+        x = (float) (i % side) * 2 + sNextUnit();
+        y = (float) (i / side) * 2 + sNextUnit();
+        rects[i].boundary[0] = x - 0.5f;
+        rects[i].boundary[1] = y - 0.5f;
+        rects[i].boundary[2] = x + 0.5f;
+        rects[i].boundary[3] = y + 0.5f;
+        ids[i] = i + 1;
+    }
+    return (float) side * 2;
+}
+
+static void sMakeQuery(struct Rect *query, float extent)
+{
+    float x = sNextUnit() * extent;
+    float y = sNextUnit() * extent;
+    float w = sNextUnit() * 12;
+
+    query->boundary[0] = x - w;
+    query->boundary[1] = y - w;
+    query->boundary[2] = x + w;
+    query->boundary[3] = y + w;
+}
+
+static int TallyCallback(long id, void *arg)
+{
+    HitTally *tally = (HitTally *) arg;
+    tally->nHits++;
+    tally->idSum += id;
+    return 1;
+}
+
+static HitTally sBruteForce(
+        struct Rect *rects,
+        int *ids,
+        int *isDeleted,
+        int n,
+        struct Rect *query
+    )
+{
+    HitTally tally;
+    int i;
+
+    memset(&tally, 0, sizeof(tally));
+    for (i = 0; i < n; i++) {
+        if (isDeleted != NULL && isDeleted[i])
+            continue;
+        if (RTreeOverlap(query, &rects[i]))
+            TallyCallback(ids[i], &tally);
+    }
+    return tally;
+}
+
+static int sContains(struct Rect *outer, struct Rect *inner)
+{
+    return outer->boundary[0] <= inner->boundary[0]
+            && outer->boundary[1] <= inner->boundary[1]
+            && outer->boundary[2] >= inner->boundary[2]
+            && outer->boundary[3] >= inner->boundary[3];
+}
+
+/**
+ * Check that branches are packed from slot 0, that each
+ * covering rect holds its child and that no node below the
+ * root is less than half full; returns the number of data rects
+ */
+static int sCheckNode(struct Node *node, int level, int isRoot, int *isValid)
+{
+    struct Rect cover;
+    int capacity;
+    int nData = 0;
+    int i;
+
+    capacity = (level > 0) ? RTreeGetNodeMax() : RTreeGetLeafMax();
+    if (node->level != level || node->count > capacity
+            || ( ! isRoot && node->count < capacity / 2))
+        *isValid = 0;
+
+    for (i = 0; i < capacity; i++) {
+        if ((i < node->count) != (node->branch[i].child != NULL))
+            *isValid = 0;
+    }
+
+    if (level == 0)
+        return node->count;
+
+    for (i = 0; i < node->count; i++) {
+        cover = RTreeNodeCover(node->branch[i].child);
+        if ( ! sContains(&node->branch[i].rect, &cover))
+            *isValid = 0;
+        nData += sCheckNode(node->branch[i].child, level - 1, 0, isValid);
+    }
+    return nData;
+}
+
+static void sCheckSize(int n)
+{
+    struct Rect *rects;
+    struct Rect query;
+    struct Node *bulkRoot, *insertRoot;
+    HitTally expected, bulk, inserted;
+    long bulkVisits = 0, insertVisits = 0;
+    int *ids, *isDeleted;
+    int nMismatch = 0, nDeleteMismatch = 0;
+    int isValid = 1;
+    float extent;
+    int nData;
+    int i;
+
+    rects = (struct Rect *) ckalloc(sizeof(struct Rect) * (n + 1));
+    ids = (int *) ckalloc(sizeof(int) * (n + 1));
+    isDeleted = (int *) ckalloc(sizeof(int) * (n + 1));
+    memset(isDeleted, 0, sizeof(int) * (n + 1));
+
+    sSeed = 1000 + n;
+    extent = sMakeFibreRects(rects, ids, n);
+
+    bulkRoot = RTreeBulkLoad(rects, ids, n);
+    insertRoot = RTreeNewIndex();
+    for (i = 0; i < n; i++)
+        RTreeInsertRect(&rects[i], ids[i], &insertRoot, 0);
+
+    nData = sCheckNode(bulkRoot, bulkRoot->level, 1, &isValid);
+    if (isValid && nData == n) {
+        PASS(__FILE__, __LINE__,
+                "Bulk tree of %d rects is packed and consistent\n", n);
+    } else {
+        FAIL(__FILE__, __LINE__,
+                "Bulk tree of %d rects malformed (%d data rects)\n",
+                n, nData);
+    }
+
+    for (i = 0; i < N_QUERIES; i++) {
+        sMakeQuery(&query, extent);
+        expected = sBruteForce(rects, ids, NULL, n, &query);
+
+        memset(&bulk, 0, sizeof(bulk));
+        memset(&inserted, 0, sizeof(inserted));
+        RTreeSearch(bulkRoot, &query, TallyCallback, &bulk);
+        RTreeSearch(insertRoot, &query, TallyCallback, &inserted);
+        if (bulk.nHits != expected.nHits || bulk.idSum != expected.idSum
+                || inserted.nHits != expected.nHits)
+            nMismatch++;
+
+        bulkVisits += RTreeCountSearchNodes(bulkRoot, &query);
+        insertVisits += RTreeCountSearchNodes(insertRoot, &query);
+    }
+
+    if (nMismatch == 0) {
+        PASS(__FILE__, __LINE__,
+                "Bulk tree of %d rects matches brute force\n", n);
+    } else {
+        FAIL(__FILE__, __LINE__,
+                "%d of %d queries on %d rects differ from brute force\n",
+                nMismatch, N_QUERIES, n);
+    }
+
+    if (n >= 1000) {
+        if (bulkVisits <= insertVisits) {
+            PASS(__FILE__, __LINE__,
+                    "Bulk tree visits %ld nodes, inserted tree %ld\n",
+                    bulkVisits, insertVisits);
+        } else {
+            FAIL(__FILE__, __LINE__,
+                    "Bulk tree visits %ld nodes, more than inserted %ld\n",
+                    bulkVisits, insertVisits);
+        }
+    }
+
+    /** the packed tree must still support deletion */
+    for (i = 0; i < n; i += 3) {
+        if (RTreeDeleteRect(&rects[i], ids[i], &bulkRoot) == 0)
+            isDeleted[i] = 1;
+        else
+            nDeleteMismatch++;
+    }
+    for (i = 0; i < N_QUERIES; i++) {
+        sMakeQuery(&query, extent);
+        expected = sBruteForce(rects, ids, isDeleted, n, &query);
+        memset(&bulk, 0, sizeof(bulk));
+        RTreeSearch(bulkRoot, &query, TallyCallback, &bulk);
+        if (bulk.nHits != expected.nHits || bulk.idSum != expected.idSum)
+            nDeleteMismatch++;
+    }
+
+    if (nDeleteMismatch == 0) {
+        PASS(__FILE__, __LINE__,
+                "Deletion from bulk tree of %d rects is consistent\n", n);
+    } else {
+        FAIL(__FILE__, __LINE__,
+                "%d failures after deletion from bulk tree of %d rects\n",
+                nDeleteMismatch, n);
+    }
+
+    RTreeDeleteIndex(bulkRoot);
+    RTreeDeleteIndex(insertRoot);
+    ckfree(rects);
+    ckfree(ids);
+    ckfree(isDeleted);
+}
+
+int testBulkLoad()
+{
+    int sizes[] = { 0, 1, 2, 0, 0, 0, 5000 };
+    int i;
+
+    sizes[3] = RTreeGetLeafMax();
+    sizes[4] = RTreeGetLeafMax() + 1;
+    sizes[5] = RTreeGetLeafMax() * RTreeGetNodeMax() + 1;
+
+    for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++)
+        sCheckSize(sizes[i]);
+
+    return 1;
+}
+
@@ -0,0 +1,248 @@
+/**
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rTreeIndex.h"
+#include "tclCkalloc.h"
+
+#include "testutils.h"
+
+
+#define	N_RECTS		3000
+#define	N_QUERIES	50
+#define	MAX_K		40
+
+static unsigned long sSeed;
+
+static float sNextUnit()
+{
+    sSeed = (sSeed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return (float) sSeed / (float) 0x7fffffffUL;
+}
+
+/**
+ * Unit boxes around centres; centres on the integer grid give
+ * many exact distance ties, which must come back in id order.
+ */
+static void sMakeRects(struct Rect *rects, RectReal (*centre)[2],
+        int n, int onGrid)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (onGrid) {
+            centre[i][0] = (RectReal) (i % 55);
+            centre[i][1] = (RectReal) (i / 55);
+        } else {
+            centre[i][0] = sNextUnit() * 110;
+            centre[i][1] = sNextUnit() * 110;
+        }
+        rects[i].boundary[0] = centre[i][0] - 0.5f;
+        rects[i].boundary[1] = centre[i][1] - 0.5f;
+        rects[i].boundary[2] = centre[i][0] + 0.5f;
+        rects[i].boundary[3] = centre[i][1] + 0.5f;
+    }
+}
+
+static RectReal sDistanceSquared(RectReal *p, RectReal *c)
+{
+    RectReal dx = c[0] - p[0];
+    RectReal dy = c[1] - p[1];
+    return dx * dx + dy * dy;
+}
+
+/** brute-force equivalent of RTreeNearest by selection */
+static int sBruteNearest(RectReal (*centre)[2], int *isDeleted, int n,
+        RectReal *point, int k, int *outIds)
+{
+    RectReal best, d;
+    int *used;
+    int nFound, bestIndex;
+    int i;
+
+    used = (int *) ckalloc(sizeof(int) * (n + 1));
+    memset(used, 0, sizeof(int) * (n + 1));
+    for (nFound = 0; nFound < k; nFound++) {
+        bestIndex = (-1);
+        best = 0;
+        for (i = 0; i < n; i++) {
+            if (used[i] || (isDeleted != NULL && isDeleted[i]))
+                continue;
+            d = sDistanceSquared(point, centre[i]);
+            if (bestIndex < 0 || d < best) {
+                best = d;
+                bestIndex = i;
+            }
+        }
+        if (bestIndex < 0)
+            break;
+        used[bestIndex] = 1;
+        outIds[nFound] = bestIndex + 1;
+    }
+    ckfree(used);
+    return nFound;
+}
+
+static int sCompareIds(const void *v1, const void *v2)
+{
+    return *((const int *) v1) - *((const int *) v2);
+}
+
+/** returns number of queries on which the tree disagrees */
+static int sCheckTree(struct Node *root, RectReal (*centre)[2],
+        int *isDeleted, int n)
+{
+    struct RTreeNeighbour neighbour[MAX_K];
+    int expected[MAX_K];
+    int *radiusIds, *bruteIds;
+    RectReal point[2], radius;
+    int nExpected, nFound, nBrute;
+    int nBad = 0;
+    int q, i, k;
+
+    radiusIds = (int *) ckalloc(sizeof(int) * (n + 1));
+    bruteIds = (int *) ckalloc(sizeof(int) * (n + 1));
+
+    for (q = 0; q < N_QUERIES; q++) {
+        point[0] = (q % 5 == 0) ? (RectReal) (q % 40) : sNextUnit() * 120 - 5;
+        point[1] = (q % 5 == 0) ? (RectReal) (q % 30) : sNextUnit() * 120 - 5;
+        k = 1 + (q * 7) % MAX_K;
+
+        nExpected = sBruteNearest(centre, isDeleted, n, point, k, expected);
+        nFound = RTreeNearest(root, point, k, neighbour);
+        if (nFound != nExpected) {
+            nBad++;
+            continue;
+        }
+        for (i = 0; i < nFound; i++) {
+            if (neighbour[i].id != expected[i])
+                break;
+            if (i > 0 && neighbour[i].distance < neighbour[i-1].distance)
+                break;
+        }
+        if (i < nFound)
+            nBad++;
+
+        radius = 1 + sNextUnit() * 8;
+        nBrute = 0;
+        for (i = 0; i < n; i++) {
+            if (isDeleted != NULL && isDeleted[i])
+                continue;
+            if (sDistanceSquared(point, centre[i]) <= radius * radius)
+                bruteIds[nBrute++] = i + 1;
+        }
+        nFound = RTreeRadius(root, point, radius, radiusIds, n);
+        if (nFound != nBrute) {
+            nBad++;
+            continue;
+        }
+        qsort(radiusIds, nFound, sizeof(int), sCompareIds);
+        if (memcmp(radiusIds, bruteIds, sizeof(int) * nFound) != 0)
+            nBad++;
+
+        /** a short buffer still reports the full count */
+        if (nBrute > 2 && RTreeRadius(root, point, radius, radiusIds, 2)
+                != nBrute)
+            nBad++;
+    }
+
+    ckfree(radiusIds);
+    ckfree(bruteIds);
+    return nBad;
+}
+
+static void sCheckLayout(int onGrid)
+{
+    struct Rect *rects;
+    RectReal (*centre)[2];
+    struct Node *bulkRoot, *insertRoot;
+    int *ids, *isDeleted;
+    const char *layout = onGrid ? "grid" : "random";
+    int nBad;
+    int i;
+
+    rects = (struct Rect *) ckalloc(sizeof(struct Rect) * N_RECTS);
+    centre = (RectReal (*)[2]) ckalloc(sizeof(RectReal) * 2 * N_RECTS);
+    ids = (int *) ckalloc(sizeof(int) * N_RECTS);
+    isDeleted = (int *) ckalloc(sizeof(int) * N_RECTS);
+    memset(isDeleted, 0, sizeof(int) * N_RECTS);
+
+    sSeed = 4242 + onGrid;
+    sMakeRects(rects, centre, N_RECTS, onGrid);
+    for (i = 0; i < N_RECTS; i++)
+        ids[i] = i + 1;
+
+    bulkRoot = RTreeBulkLoad(rects, ids, N_RECTS);
+    insertRoot = RTreeNewIndex();
+    for (i = 0; i < N_RECTS; i++)
+        RTreeInsertRect(&rects[i], ids[i], &insertRoot, 0);
+
+    nBad = sCheckTree(bulkRoot, centre, NULL, N_RECTS);
+    if (nBad == 0) {
+        PASS(__FILE__, __LINE__,
+                "Nearest/radius on bulk %s tree match brute force\n", layout);
+    } else {
+        FAIL(__FILE__, __LINE__,
+                "%d mismatches on bulk %s tree\n", nBad, layout);
+    }
+
+    nBad = sCheckTree(insertRoot, centre, NULL, N_RECTS);
+    if (nBad == 0) {
+        PASS(__FILE__, __LINE__,
+                "Nearest/radius on inserted %s tree match brute force\n",
+                layout);
+    } else {
+        FAIL(__FILE__, __LINE__,
+                "%d mismatches on inserted %s tree\n", nBad, layout);
+    }
+
+    /** deletion leaves empty branch slots which must be skipped */
+    for (i = 0; i < N_RECTS; i += 4) {
+        RTreeDeleteRect(&rects[i], ids[i], &insertRoot);
+        isDeleted[i] = 1;
+    }
+    nBad = sCheckTree(insertRoot, centre, isDeleted, N_RECTS);
+    if (nBad == 0) {
+        PASS(__FILE__, __LINE__,
+                "Nearest/radius after deletion on %s tree are correct\n",
+                layout);
+    } else {
+        FAIL(__FILE__, __LINE__,
+                "%d mismatches after deletion on %s tree\n", nBad, layout);
+    }
+
+    RTreeDeleteIndex(bulkRoot);
+    RTreeDeleteIndex(insertRoot);
+    ckfree(rects);
+    ckfree(centre);
+    ckfree(ids);
+    ckfree(isDeleted);
+}
+
+int testNearest()
+{
+    struct RTreeNeighbour neighbour[4];
+    struct Node *root;
+    RectReal point[2] = { 0, 0 };
+    int id;
+
+    /** an empty tree, and a tree smaller than k */
+    root = RTreeNewIndex();
+    if (RTreeNearest(root, point, 4, neighbour) == 0
+            && RTreeRadius(root, point, 100, &id, 1) == 0) {
+        PASS(__FILE__, __LINE__, "Empty tree yields no neighbours\n");
+    } else {
+        FAIL(__FILE__, __LINE__, "Empty tree yields neighbours\n");
+    }
+    RTreeDeleteIndex(root);
+
+    sCheckLayout(1);
+    sCheckLayout(0);
+
+    return 1;
+}
+
@@ -0,0 +1,200 @@
+/**
+ ** Lattice index of the muscle fibres.
+ **
+ ** allocateFibres() places fibres on the cell grid (CELLS_PER_MM
+ ** to the mm), so a fibre can be found by rounding its location
+ ** to the nearest cell and indexing a dense array of cells.  A
+ ** neighbourhood is then simply the cells in a square ring (or
+ ** set of rings) around a centre cell.
+ **
+ ** Fibres which do not sit alone in their cell -- the halves of
+ ** a fibre split by myopathy, or fibres moved by plowing -- are
+ ** kept in a small overflow table sorted by cell, and the cell
+ ** is flagged so that the table is only consulted when needed.
+ ** Fibres moved beyond the extent of the lattice are kept in a
+ ** list of their own, which is only searched by queries that
+ ** reach past the edge.
+ **
+ ** The index refers to fibres by their position in the master
+ ** fibre list of the MuscleData it was built from, exactly as
+ ** the fibre R-tree did.  Fibres which are moved, appended to
+ ** the master list or deleted must be reported through
+ ** moveFibre(), addFibre() and deleteFibre(), so the index
+ ** follows the muscle through disease without a rebuild.  A
+ ** fibre removed from the muscle but not reported remains in
+ ** the index, so callers must check getFibre() for NULL.
+ **
+ ** $Id$
+ **/
+#ifndef __FIBRE_LATTICE_INDEX_CLASS_HEADER__
+#define __FIBRE_LATTICE_INDEX_CLASS_HEADER__
+
+#include "os_defs.h"
+#include "bitstring.h"
+#include "growarray.h"
+
+class MuscleData;
+class MuscleFibre;
+struct rTreeResultList;
+
+/** a fibre sharing its cell with a lower-numbered fibre */
+struct FibreLatticeOverflow {
+	int cell_;
+	int fibre_;
+};
+
+/**
+CLASS
+		FibreLatticeIndex
+
+	Maps (xCell, yCell) to the fibres in that cell.
+ **/
+class FibreLatticeIndex
+{
+public:
+		////////////////////////////////
+		// Create an empty index
+		FibreLatticeIndex();
+
+		////////////////////////////////
+		// Destructor
+		~FibreLatticeIndex();
+
+		////////////////////////////////
+		// Index all the fibres currently in the muscle;
+		// returns 1 on success
+		int build(const MuscleData *MD);
+
+		////////////////////////////////
+		// Round a location (in cells) to the cell holding it
+		static int sCellOf(float locationInCells);
+
+		////////////////////////////////
+		// Return the index of a fibre in the given cell, or
+		// -1 if the cell is empty; where the cell is shared
+		// the lowest index is returned
+		int getFibreAtCell(int xCell, int yCell) const;
+
+		////////////////////////////////
+		// Append to the result list the fibres in all cells
+		// exactly "ring" cells from the centre cell in X or Y
+		// (ring 0 is the centre cell alone); returns the
+		// number appended
+		int appendRing(
+				int xCell,
+				int yCell,
+				int ring,
+				struct rTreeResultList *resultList
+			) const;
+
+		////////////////////////////////
+		// Replace the contents of the result list with the
+		// fibres whose centres lie within the given radius
+		// (in cells) of the point, in fibre index order;
+		// returns the number found
+		int findWithinRadius(
+				float xCell,
+				float yCell,
+				float radiusInCells,
+				struct rTreeResultList *resultList
+			) const;
+
+		////////////////////////////////
+		// Replace the contents of the result list with the
+		// fibres whose centres lie within the given distance
+		// (in cells) of the line of the given slope through
+		// the point, and not below the point, in fibre index
+		// order; returns the number found
+		int findAlongLine(
+				float xCell,
+				float yCell,
+				float slope,
+				float halfWidthInCells,
+				struct rTreeResultList *resultList
+			) const;
+
+		////////////////////////////////
+		// Return the master list index of the given fibre,
+		// found from its location, or -1 if it is not indexed
+		int findFibre(
+				const MuscleData *MD,
+				const MuscleFibre *fibre
+			) const;
+
+		////////////////////////////////
+		// Record that a fibre has moved to a new location
+		void moveFibre(int fibreId, float xCell, float yCell);
+
+		////////////////////////////////
+		// Index a fibre just appended to the master list
+		void addFibre(int fibreId, float xCell, float yCell);
+
+		////////////////////////////////
+		// Remove a fibre deleted from the muscle; its index
+		// must not be passed to the index again
+		void deleteFibre(int fibreId);
+
+		////////////////////////////////
+		// Number of fibres held in the overflow table
+		int getNumOverflowFibres() const;
+
+		////////////////////////////////
+		// Number of fibres outside the extent of the lattice
+		int getNumOutsideFibres() const;
+
+private:
+		int firstOverflowOf(int cell) const;
+		int firstOutsideOf(int fibreId) const;
+		int appendOutside(
+				float xCell,
+				float yCell,
+				float radiusSquared,
+				struct rTreeResultList *resultList
+			) const;
+
+		void removeFibre(int fibreId);
+		void insertFibre(int fibreId);
+
+		int appendCell(
+				int xCell,
+				int yCell,
+				struct rTreeResultList *resultList
+			) const;
+
+		int xMin_;
+		int yMin_;
+		int width_;
+		int height_;
+
+		/** fibre index + 1 of the first fibre in each cell, or 0 */
+		int *cell_;
+
+		/** set for cells which also have overflow entries */
+		BITSTRING hasOverflow_;
+
+		/** overflow entries, sorted by cell then fibre */
+		struct FibreLatticeOverflow *overflow_;
+		int nOverflow_;
+		int nOverflowAllocated_;
+
+		/** fibres beyond the lattice, sorted by index */
+		int *outside_;
+		int nOutside_;
+		int nOutsideAllocated_;
+
+		/** fibre locations, by master list index */
+		GrowArray<float> xCell_;
+		GrowArray<float> yCell_;
+		int nFibres_;
+};
+
+inline int FibreLatticeIndex::getNumOverflowFibres() const {
+	return nOverflow_;
+}
+
+inline int FibreLatticeIndex::getNumOutsideFibres() const {
+	return nOutside_;
+}
+
+#endif /* __FIBRE_LATTICE_INDEX_CLASS_HEADER__ */
+
@@ -0,0 +1,97 @@
+/**
+ ** Firing sources supply the firing train of each motor unit
+ ** to the EMG generation stage.
+ **
+ ** When the simulation runs end to end in one process the trains
+ ** are already held on each MotorUnit, and a MemoryFiringSource
+ ** hands them over directly.  A DiskFiringSource parses the
+ ** FTMU%d.dat export files, and is used when re-using the firing
+ ** times of an earlier run.
+ **
+ ** $Id$
+ **/
+#ifndef __FIRING_SOURCE_CLASS_HEADER__
+#define __FIRING_SOURCE_CLASS_HEADER__
+
+#include "os_defs.h"
+
+class MotorUnit;
+class MuscleData;
+
+/**
+ ** FiringSource abstract interface.
+ **
+ ** getFiringTimes() returns the train for the given MU in
+ ** units of DELTA_T_FIRING_TIMES (0.1 ms); the list remains
+ ** valid until it is handed back through releaseFiringTimes().
+ **/
+class FiringSource {
+public:
+		virtual ~FiringSource();
+
+		/** obtain the train for this MU; returns 1 on success */
+		virtual int getFiringTimes(
+				MotorUnit *motorUnit,
+				const long **firingTimes,
+				int *nFiringTimes
+			) = 0;
+
+		/** hand back a list obtained from getFiringTimes() */
+		virtual void releaseFiringTimes(const long *firingTimes);
+};
+
+
+/**
+ ** Supplies the trains already stored on the MotorUnit by
+ ** firing() or loadFiring() -- no copy is made.
+ **/
+class MemoryFiringSource : public FiringSource {
+public:
+		MemoryFiringSource();
+		virtual ~MemoryFiringSource();
+
+		virtual int getFiringTimes(
+				MotorUnit *motorUnit,
+				const long **firingTimes,
+				int *nFiringTimes
+			);
+};
+
+
+/**
+ ** Parses the FTMU%d.dat files found in a firings directory.
+ **/
+class DiskFiringSource : public FiringSource {
+private:
+		char *firingsDirectory_;
+
+public:
+		DiskFiringSource(const char *firingsDirectory);
+		virtual ~DiskFiringSource();
+
+		virtual int getFiringTimes(
+				MotorUnit *motorUnit,
+				const long **firingTimes,
+				int *nFiringTimes
+			);
+		virtual void releaseFiringTimes(const long *firingTimes);
+
+		/** parse one FTMU file into a ckalloc'ed list */
+		static int sLoadFiringTimeFile(
+				const char *filename,
+				long **firingTimes,
+				int *nFiringTimes
+			);
+};
+
+
+/**
+ ** Write the FTMU%d.dat export file for a single MU
+ **/
+int writeFiringTimeFile(
+		const char *firingsDirectory,
+		MotorUnit *motorUnit
+	);
+
+#endif
+
@@ -0,0 +1,136 @@
+/**
+ ** Cache of the MFAPs calculated for each fibre.
+ **
+ ** An MFAP depends only on the geometry between one fibre and
+ ** the needle: the distances fed to the tip and cannula kernels,
+ ** the endplate distance and the fibre diameter.  When the needle
+ ** is moved through a muscle which is otherwise left alone, most
+ ** fibres are far from the tip and their geometry barely changes,
+ ** so their MFAPs can be taken from this cache rather than being
+ ** calculated again.
+ **
+ ** Only fibres whose MFAP was merged into the far-field MFP of
+ ** the MUP are kept; those near enough to be kept as a separate
+ ** MFP are always calculated again.  As the merged and cannula
+ ** MFAPs are summed as MUPDataElement values, they are stored
+ ** at that precision, and an unchanged geometry gives exactly
+ ** the same MUP.
+ **
+ ** Entries are kept per MU, in the order of the MU's fibre list,
+ ** and are checked against the fibre they were made for, so a
+ ** change of MU membership simply misses.  An entry is reused
+ ** when no distance has changed by more than the tolerance (a
+ ** fraction of the fibre's distance from the tip).  The cache
+ ** stops taking new fibres once it holds its maximum number.
+ **
+ ** $Id$
+ **/
+#ifndef __MFAP_CACHE_CLASS_HEADER__
+#define __MFAP_CACHE_CLASS_HEADER__
+
+#include "os_defs.h"
+#include "MUP.h"
+
+#ifndef PRIVATE
+#define PRIVATE private
+#endif
+
+class MuscleFibre;
+
+/** the geometry an MFAP is calculated from */
+#define	MFAP_GEOMETRY_ENDPLATE_DISTANCE		0
+#define	MFAP_GEOMETRY_RADIAL_SEPARATION		1
+#define	MFAP_GEOMETRY_AUX_RADIAL_SEPARATION	2
+#define	MFAP_GEOMETRY_X_LOCATION			3
+#define	MFAP_GEOMETRY_SHAFT_DISTANCE		4
+#define	MFAP_GEOMETRY_X_PROJ_TO_TIP			5
+#define	MFAP_GEOMETRY_X_PROJ_TO_END			6
+#define	MFAP_GEOMETRY_CANNULA_LENGTH		7
+#define	MFAP_GEOMETRY_DIAMETER				8
+#define	MFAP_GEOMETRY_SIZE					9
+
+struct MFAPCacheEntry {
+	const MuscleFibre *ce_fibre;
+	float ce_geometry[MFAP_GEOMETRY_SIZE];
+	MUPDataElement *ce_tipMFAP;
+	MUPDataElement *ce_cannulaMFAP;
+};
+
+/** the entries for the fibres of one MU */
+struct MFAPCacheMU {
+	MFAPCacheEntry *cm_entry;
+	int cm_nEntries;
+	int cm_nEntriesAllocated;
+};
+
+/**
+CLASS
+		MFAPCache
+
+	Holds the tip and cannula MFAPs of the far fibres in
+	the uptake area, with the geometry they were made for.
+ **/
+class MFAPCache
+{
+public:
+		////////////////////////////////
+		// Create an empty cache for up to maxEntries fibres'
+		// MFAPs of the given length
+		MFAPCache(int MFAPLength, float tolerance, int maxEntries);
+
+		////////////////////////////////
+		// Destructor
+		~MFAPCache();
+
+		////////////////////////////////
+		// Return the entry for fibre "fibreIndex" of the MU
+		// if it can be used for the given geometry, otherwise
+		// NULL; the hit and miss counts are updated
+		const MFAPCacheEntry *find(
+				int muId,
+				int fibreIndex,
+				const MuscleFibre *fibre,
+				const float *geometry
+			);
+
+		////////////////////////////////
+		// Return the entry to be filled in with the MFAPs
+		// calculated for the given geometry, allocating it
+		// if need be, or NULL if the cache is full.  The entry
+		// is not used until the caller sets ce_fibre, once
+		// both MFAPs have been copied in
+		MFAPCacheEntry *update(
+				int muId,
+				int fibreIndex,
+				const float *geometry
+			);
+
+		////////////////////////////////
+		// Length of the MFAPs held
+		int getMFAPLength() const;
+
+		////////////////////////////////
+		// Log and clear the hit and miss counts
+		void logStatistics();
+
+PRIVATE:
+		int MFAPLength_;
+		float tolerance_;
+		int maxEntries_;
+		int nAllocatedEntries_;
+
+		/** entries for each MU, indexed by MU id */
+		MFAPCacheMU *mu_;
+		int nMUs_;
+		int nMUsAllocated_;
+
+		int nExactHits_;
+		int nToleranceHits_;
+		int nMisses_;
+};
+
+inline int MFAPCache::getMFAPLength() const {
+	return MFAPLength_;
+}
+
+#endif /* __MFAP_CACHE_CLASS_HEADER__ */
@@ -27,6 +27,7 @@
 # endif
 
 #include "io_utils.h"
+#include "arena.h"
 
 /** conditional debug dump control flags */
 /*
@@ -35,7 +36,6 @@
 */
 
 
-#define         MFP_BLOCKSIZE          2
 #define         MUP_ID_WIDTH           4
 
 typedef float MUPDataElement;
@@ -75,8 +75,10 @@ public:
 		// threshold at which the MFP's will be stored in their
 		// own "Jitterable" buffers.  Any data which has
 		// accelerations consistently less than this threshold
-		// will be merged into a single, composite MUP
-		static generatedElement sAccelerationThreshold_;
+		// will be merged into a single, composite MUP.  Each
+		// thread has its own, so that concurrent simulations may
+		// use different thresholds
+		static OS_THREAD_LOCAL generatedElement sAccelerationThreshold_;
 
 		////////////////////////////////////////////////////////////////
 		// Constants for cannula/tip combination selection
@@ -99,8 +101,8 @@ private:
 		// expansion factor by which we expand the "Jitterable"
 		// MFPs in order to be able to select data when shifted
 		// by units of less than integer sampling rate in the
-		// jitter shift.
-		static int      sExpansionFactor_;
+		// jitter shift.  Again, one per thread.
+		static OS_THREAD_LOCAL int sExpansionFactor_;
 
 private:
 #       ifdef   DUMP_MUP_DATA
@@ -108,6 +110,11 @@ private:
 #       endif
 
 private:
+		/**
+		 ** MFPs and their data are made in the arenas below and
+		 ** are all freed together in unload(), so have no
+		 ** destructor of their own
+		 **/
 		class MFP {
 		public:
 		        MUPDataElement *data_;
@@ -115,9 +122,6 @@ private:
 		        osInt32 numPoints_;
 		        osInt32 expansionFactor_;
 		        osInt32 fibreIdentifier_;
-
-		         MFP();
-		        ~MFP();
 		};
 
 
@@ -161,11 +165,21 @@ private:
 		 ** component.
 		 **/
 		osInt32 nMFPs_;
-		int nMFPBlocks_;
+		int nMFPsAllocated_;
 		MFP **mfapList_;
 		MFP *cannulaMFP_;
 		int hasCannulaMFP_;
 
+		/**
+		 ** arena_ holds the MFP structures, MFP 0 and the
+		 ** cannula MFP.  The separated MFPs 1 .. nMFPs_-1 are
+		 ** made in order in recordArena_, each preceded by its
+		 ** fibre id and number of points, so that they lie in
+		 ** memory just as they are laid out in the file
+		 **/
+		Arena arena_;
+		Arena recordArena_;
+
 		struct JitterValue *jitterValue_;
 		struct JitterValue *jitterValueSums_;
 		int nJitterValuesInSum_;
@@ -198,6 +212,12 @@ private:
 		        osInt32 fibreIdentifier
 		    );
 		void addAsMergedMFP__(generatedElement *data);
+		MFP *newMFP__(
+		        int asRecord,
+		        osInt32 numPoints,
+		        osInt32 expansionFactor,
+		        osInt32 fibreIdentifier
+		    );
 		off_t headerOffsetSize__() const;
 		int writeHeader__(FP *fp, off_t *mfapOffsetTable) const;
 		int readHeader__(FP *fp, off_t **mfapOffsetTable);
@@ -207,10 +227,12 @@ private:
 		                        MFP *curMFP,
 		                        off_t *offset
 		                ) const;
+		int writeRecords__(FP *fp, off_t *mfapOffsetTable) const;
 		int readData__(
 		                        FP *fp,
 		                        MFP **curMFP,
-		                        off_t offset
+		                        off_t offset,
+		                        int asRecord
 		                );
 
 		void initializeMUPVector__();
@@ -258,7 +280,8 @@ public:
 
 		////////////////////////////////////////////////////////////////
 		// Set the jitter threshold.  This is static so that it will
-		// affect all instances of the MUP class
+		// affect all instances of the MUP class made on the
+		// calling thread
 		static void sSetJitterAccelerationThreshold(
 		                generatedElement jitterThreshold
 		            );
@@ -272,13 +295,19 @@ public:
 		// expanded.  By default, this is 30.
 		// <p>
 		// Again, this is static, and so affects all instances of this
-		// class
+		// class made on the calling thread
 		static void sSetExpansionFactor(int newExpansionFactor);
 
 		////////////////////////////////////////////////////////////////
 		// Return the current static expansion factor
 		static int sGetExpansionFactor();
 
+		////////////////////////////////////////////////////////////////
+		// Free the scratch space kept by the calling thread for
+		// adding MFPs.  Call this once a thread has finished
+		// making its MUPs.
+		static void sReleaseScratch();
+
 		////////////////////////////////////////////////////////////////
 		// the file we will be using as the file back-end store
 		const char *getFileName() const;
@@ -318,8 +347,9 @@ public:
 		    );
 
 		////////////////////////////////////////////////////////////////
-		// add in a new MFP
-		void addMFP(
+		// add in a new MFP; returns 1 if it is kept as a separate
+		// MFP, or 0 if it is merged into the far-field MFP
+		int addMFP(
 		                int MUPIndex,
 		                int nElements,
 		                generatedElement *data,
@@ -10,6 +10,7 @@
 #include "MUP.h"
 
 class NeedleInfo;
+class MFAPCache;
 
 #define  BIPOLE_SEP             0.200           /* mm */
 
@@ -25,6 +26,8 @@ typedef struct MUPControlStruct {
 		float   stdDev_X;
 		float   stdDev_Y;
 		float   stdDev_Z;
+		int             reuseCleanMUPs;
+		MFAPCache       *MFAPs;
 } MUPControl;
 
 
@@ -40,7 +43,8 @@ struct mscl_fibr_record {
 int makeMUP(
 		        MuscleData *muscleDefinition,
 		        int **loadMUPVector,
-		        int *nMUPs
+		        int *nMUPs,
+		        int reuseCleanMUPs = 0
 		);
 
 int loadMUPs(
@@ -31,6 +31,8 @@
 class MotorUnit;
 class MuscleFibre;
 class NeedleInfo;
+class FibreLatticeIndex;
+class MFAPCache;
 
 struct Node;
 
@@ -48,6 +50,11 @@ class MuscleData
 PRIVATE:
 		void allocateNMotorUnits(int nMotorUnits);
 
+		int loadTextLayout(
+				const char *MFfilename,
+				const char *MUfilename
+			);
+
 private:
 		int readMotorUnit(
 		        FILE *fp,
@@ -152,6 +159,36 @@ public:
 		// area and are active
 		int writeAMUInDetectInfo(const char *filename) const;
 
+		////////////////////////////////
+		// write the fibre and motor unit layout as a
+		// binary snapshot (see MuscleSnapshot.h)
+		int writeSnapshot(const char *filename) const;
+
+		////////////////////////////////
+		// load the fibre and motor unit layout from a
+		// binary snapshot; nothing is changed on failure
+		int loadSnapshot(const char *filename);
+
+		////////////////////////////////
+		// write the locations of the given fibres (indices
+		// into the master list) as a plow delta against the
+		// unplowed snapshot, given where they were before
+		int writePlowDelta(
+				const char *filename,
+				int nMovedFibres,
+				const int *fibreIndex,
+				const float *oldXCell,
+				const float *oldYCell
+			) const;
+
+		////////////////////////////////
+		// load an unplowed snapshot and apply a plow delta
+		// to it; nothing is changed on failure
+		int loadPlowDelta(
+				const char *snapshotFilename,
+				const char *deltaFilename
+			);
+
 		////////////////////////////////
 		// load the persisted data
 		int loadData(
@@ -200,6 +237,10 @@ public:
 		// Get the Fibre RTree
 		Node *getFibreRTreeRoot() const;
 
+		////////////////////////////////
+		// Get the fibre lattice index (NULL until built)
+		FibreLatticeIndex *getFibreLatticeIndex() const;
+
 public:
 		const static int PRINT_MU_DATA;
 		const static int PRINT_FIBRE_DATA;
@@ -227,24 +268,31 @@ PRIVATE:
 		float minMotorUnitDiameter_;
 
 		MotorUnit **motorUnitInDetect_;
-		int motorUnitInDetectBlocks_;
+		int motorUnitInDetectAllocated_;
 
 		MotorUnit **activeMotorUnit_;
 		int nActiveMotorUnits_;
-		int nActiveMotorUnitBlocks_;
+		int nActiveMotorUnitsAllocated_;
 
 		MotorUnit **activeInDetectMotorUnit_;
 		int nActiveInDetectMotorUnits_;
-		int nActiveInDetectMotorUnitBlocks_;
+		int nActiveInDetectMotorUnitsAllocated_;
 
 		NeedleInfo *needle_;
 
 		Node *fibreRTreeRoot_;
+		FibreLatticeIndex *fibreLattice_;
+
+		/** MFAPs kept while the needle is swept through us */
+		MFAPCache *MFAPCache_;
+
+		/** set once a later stage has changed the snapshot layout */
+		int differsFromSnapshot_;
 
 		int nTotalFibres_;
 		int nMaxFibres_;
 
-		int nFibreBlocks_;
+		int nFibresAllocated_;
 		MuscleFibre **masterFibreList_;
 };
 
@@ -330,6 +378,10 @@ inline Node *MuscleData::getFibreRTreeRoot() const {
 	return fibreRTreeRoot_;
 }
 
+inline FibreLatticeIndex *MuscleData::getFibreLatticeIndex() const {
+	return fibreLattice_;
+}
+
 ////////////////////////////////////////////////////////////////
 
 /**
@@ -398,6 +450,15 @@ public:
 		// return the firing time N of getNumFirings()
 		long getFiringTimeN(int index) const;
 
+		////////////////////////////////
+		// return non-zero if the fibres of this MU have changed
+		// since its MUP was last generated
+		int isDirty() const;
+
+		////////////////////////////////
+		// mark whether the MUP of this MU is out of date
+		void setDirty(int isDirty);
+
 PRIVATE:
 		////////////////////////////////
 		// add a new fibre to this MU
@@ -430,14 +491,16 @@ PRIVATE:
 
 		int mu_nHealthyFibres_;
 		int mu_nFibres_;
-		int mu_nFibreAllocationBlocks_;
+		int mu_nFibresAllocated_;
 		MuscleFibre **mu_fibre_;
 
 		long *mu_firingTime_;
 		int mu_nFirings_;
-		int mu_nFiringBlocks_;
+		int mu_nFiringsAllocated_;		/* capacity, in elements */
 
 		int mu_expectedNumFibres_;
+
+		int mu_isDirty_;
 };
 
 inline int MotorUnit::getID() const {
@@ -476,6 +539,14 @@ inline long MotorUnit::getFiringTimeN(int id) const {
 	return mu_firingTime_[id];
 }
 
+inline int MotorUnit::isDirty() const {
+	return mu_isDirty_;
+}
+
+inline void MotorUnit::setDirty(int isDirty) {
+	mu_isDirty_ = isDirty;
+}
+
 ////////////////////////////////////////////////////////////////
 
 
@@ -0,0 +1,122 @@
+/**
+ ** Binary snapshot of the muscle layout.
+ **
+ ** The snapshot holds everything that MU.dat and MF-*.dat hold
+ ** (and the healthy fibre sizes, which the text files drop) in a
+ ** form which can be mapped and used without parsing.  The file
+ ** is an array of little-endian 32-bit words following the magic:
+ **
+ **     header          MuscleSnapshotHeader
+ **     in-detect ids   int32[nMotorUnitsInDetectionArea]
+ **     MU table        MuscleSnapshotMotorUnit[nMotorUnitRecords]
+ **     fibre indices   int32[nFibres] -- each MU's fibres in order,
+ **                     starting at its ms_firstFibreIndex
+ **     fibre arrays    x, y, diameter, healthy diameter, jShift
+ **                     (float[nFibres] each) and owning MU id
+ **                     (int32[nFibres]), in master list order
+ **
+ ** Each section is located through its offset in the header so
+ ** that later versions may append sections.
+ **
+ ** Plowing moves only the fibres in the path of the cannula, so
+ ** the plowed layout of a contraction is stored as a delta from
+ ** the unplowed snapshot in the muscle directory:
+ **
+ **     header          MusclePlowDeltaHeader
+ **     moved fibres    MusclePlowDeltaFibre[nMovedFibres]
+ **
+ ** Each moved fibre records its snapshot index and both its old
+ ** and new location; the old location is checked against the
+ ** unplowed snapshot so that a delta is never applied to a
+ ** muscle other than the one it was made from.
+ **
+ ** $Id$
+ **/
+#ifndef __MUSCLE_SNAPSHOT_HEADER__
+#define __MUSCLE_SNAPSHOT_HEADER__
+
+#include "os_defs.h"
+
+#define	MUSCLE_SNAPSHOT_MAGIC		"EMGMSNAP"
+#define	MUSCLE_SNAPSHOT_MAGIC_LEN	8
+#define	MUSCLE_SNAPSHOT_VERSION		1
+
+#define	MUSCLE_SNAPSHOT_UNPLOWED	"MF-unplowed.msnap"
+#define	MUSCLE_SNAPSHOT_PLOWED_FMT	"MF-plowed%d.msnap"
+
+#define	MUSCLE_PLOW_DELTA_MAGIC		"EMGMPLOW"
+#define	MUSCLE_PLOW_DELTA_VERSION	1
+#define	MUSCLE_PLOW_DELTA_FMT		"MF-plowed%d.mdelta"
+
+typedef struct MuscleSnapshotHeader {
+	char		ms_magic[MUSCLE_SNAPSHOT_MAGIC_LEN];
+	osUint32	ms_version;
+	osUint32	ms_headerSize;
+	osUint32	ms_fileSize;
+
+	osInt32		ms_xDetect;
+	osInt32		ms_yDetect;
+	osInt32		ms_nMotorUnitsInMuscle;
+	float		ms_muscleDiameter;
+	float		ms_minMotorUnitDiameter;
+	float		ms_maxMotorUnitDiameter;
+	osInt32		ms_nMotorUnitsInDetectionArea;
+	osInt32		ms_nMaxFibres;
+	osInt32		ms_nFibres;
+	osInt32		ms_nMotorUnitRecords;
+
+	/** byte offsets of each section from the start of the file */
+	osUint32	ms_inDetectOffset;
+	osUint32	ms_motorUnitOffset;
+	osUint32	ms_fibreIndexOffset;
+	osUint32	ms_fibreXOffset;
+	osUint32	ms_fibreYOffset;
+	osUint32	ms_fibreDiameterOffset;
+	osUint32	ms_fibreHealthyDiameterOffset;
+	osUint32	ms_fibreJShiftOffset;
+	osUint32	ms_fibreMotorUnitOffset;
+} MuscleSnapshotHeader;
+
+typedef struct MuscleSnapshotMotorUnit {
+	osInt32		ms_id;
+	osInt32		ms_nFibres;
+	osInt32		ms_nHealthyFibres;
+	osInt32		ms_firstFibreIndex;
+	float		ms_locationRadius;
+	float		ms_locationTheta;
+	float		ms_diameter;
+} MuscleSnapshotMotorUnit;
+
+
+typedef struct MusclePlowDeltaHeader {
+	char		ms_magic[MUSCLE_SNAPSHOT_MAGIC_LEN];
+	osUint32	ms_version;
+	osUint32	ms_headerSize;
+	osUint32	ms_fileSize;
+
+	/** fibres in the unplowed snapshot this delta applies to */
+	osInt32		ms_nBaseFibres;
+	osInt32		ms_nMovedFibres;
+	osUint32	ms_movedOffset;
+} MusclePlowDeltaHeader;
+
+typedef struct MusclePlowDeltaFibre {
+	osInt32		ms_fibreIndex;
+	float		ms_oldX;
+	float		ms_oldY;
+	float		ms_newX;
+	float		ms_newY;
+} MusclePlowDeltaFibre;
+
+
+/**
+ ** Write snapshots for any text muscle files in the given
+ ** directories which do not yet have one.  Returns 1 on success.
+ **/
+int upgradeMuscleDirectory(
+		const char *muscleDir,
+		const char *outputDir
+	);
+
+#endif
+
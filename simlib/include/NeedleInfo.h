@@ -160,6 +160,31 @@ public:
 		        float fibreLocYInMM
 		    );
 
+		////////////////////////////////
+		// getNeedleDistances() for an array of
+		// fibres, with the needle lines worked
+		// out once for the whole array
+		void getNeedleDistanceArrays(
+		        int nFibres,
+		        const float *fibreLocXInMM,
+		        const float *fibreLocYInMM,
+		        double *distanceToTipInMM,
+		        double *distanceToEndInMM,
+		        double *distanceToShaftInMM
+		    );
+
+		////////////////////////////////
+		// getProjectedNeedleDistances() for an
+		// array of fibres in a single pass
+		void getProjectedNeedleDistanceArrays(
+		        int nFibres,
+		        const float *fibreLocXInMM,
+		        const float *fibreLocYInMM,
+		        double *xProjDeltaToTipInMM,
+		        double *xProjDeltaToEndInMM,
+		        double *distanceToShaftInMM
+		    );
+
 		void getNeedleLocations(
 		        double *xTipInMM,
 		        double *yTipInMM,
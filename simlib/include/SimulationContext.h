@@ -0,0 +1,125 @@
+/**
+ ** The state which belongs to one simulation rather than to the
+ ** process: its configuration and output paths (the globals
+ ** structure) and the random stream the muscle, firing and EMG
+ ** code draw on.
+ **
+ ** The simulation code still reaches its configuration through
+ ** "g", which is now kept per thread; binding a context on a
+ ** thread points g and the local random functions of that thread
+ ** at the context.  A Simulator binds its context for the length
+ ** of each run, so several Simulators, each with its own context,
+ ** may run at once on separate threads.  The convolution and FFT
+ ** workspaces of makeMUP and the jitter settings of the MUP class
+ ** are likewise kept per thread.
+ **
+ ** A program which runs one simulation at a time need not know
+ ** about any of this: a Simulator made without a context makes
+ ** its own around the globals it allocates, and g behaves as it
+ ** always has on the thread which set it up.
+ **
+ ** $Id$
+ **/
+#ifndef __SIMULATION_CONTEXT_CLASS_HEADER__
+#define __SIMULATION_CONTEXT_CLASS_HEADER__
+
+#include "os_defs.h"
+#include "random.h"
+
+#ifndef PRIVATE
+#define PRIVATE private
+#endif
+
+struct globals;
+
+/**
+CLASS
+		SimulationContext
+
+	Holds the globals structure and random stream of one
+	simulation, and makes them current on a thread.
+ **/
+class SimulationContext
+{
+public:
+		////////////////////////////////
+		// Create a context with no globals yet.  If ownsGlobals
+		// is set, the globals given to setGlobals() are freed with
+		// the context; otherwise they are left for deleteGlobals()
+		SimulationContext(int ownsGlobals = 1);
+
+		////////////////////////////////
+		// Destructor; the context must not be bound on any
+		// thread other than the calling one
+		~SimulationContext();
+
+		////////////////////////////////
+		// The configuration of this simulation
+		struct globals *getGlobals() const;
+
+		////////////////////////////////
+		// Take on the given globals, updating g if the context
+		// is bound on the calling thread
+		void setGlobals(struct globals *globals);
+
+		////////////////////////////////
+		// The stream drawn on by localRandom() and friends
+		// while the context is bound
+		randomStream *getRandomStream();
+
+		////////////////////////////////
+		// Make this context current on the calling thread,
+		// returning the context which was current before (which
+		// may be NULL)
+		SimulationContext *bind();
+
+		////////////////////////////////
+		// Make the given context current on the calling thread,
+		// or unbind the current one if it is NULL.  The globals
+		// g points at are left alone when unbinding, as they
+		// are still needed by deleteGlobals()
+		static void sBind(SimulationContext *context);
+
+		////////////////////////////////
+		// The context bound on the calling thread, if any
+		static SimulationContext *sGetCurrent();
+
+PRIVATE:
+		struct globals *globals_;
+		int ownsGlobals_;
+		randomStream random_;
+
+		static OS_THREAD_LOCAL SimulationContext *sCurrent_;
+};
+
+inline struct globals *SimulationContext::getGlobals() const {
+	return globals_;
+}
+
+inline randomStream *SimulationContext::getRandomStream() {
+	return &random_;
+}
+
+inline SimulationContext *SimulationContext::sGetCurrent() {
+	return sCurrent_;
+}
+
+
+/**
+CLASS
+		SimulationContextBinding
+
+	Binds a context on the calling thread for the life of
+	the binding, restoring the one bound before.
+ **/
+class SimulationContextBinding
+{
+public:
+		SimulationContextBinding(SimulationContext *context);
+		~SimulationContextBinding();
+
+PRIVATE:
+		SimulationContext *previous_;
+};
+
+#endif /* __SIMULATION_CONTEXT_CLASS_HEADER__ */
@@ -22,10 +22,12 @@ class DQEmgData;
 class MUP;
 class NeedleInfo;
 class SMUP;
+class SimulationContext;
 
 struct dcoData;
 
 struct globals;
+struct PathologyControl;
 
 /**
 CLASS
@@ -40,19 +42,36 @@ class Simulator
 PRIVATE:
 	char *configFile_;
 
+	/** keep the MFAPs of each run for the next, as in a sweep */
+	int cacheMFAPs_;
+
+	/** our configuration and random stream, bound while we run */
+	SimulationContext *context_;
+	int ownsContext_;
+
 public:
 	////////////////////////////////////////////////////////////////
 	// constant bitflag
 	static const int FLAG_USE_LAST_MUSCLE;
 	static const int FLAG_USE_OLD_FIRING_TIMES;
 	static const int FLAG_RUN_SURFACE;
+	static const int FLAG_INCREMENTAL;
 
 public:
 
 	////////////////////////////////////////////////////////////////
-	// Constructor.
+	// Constructor.  The Simulator makes a context of its own,
+	// leaving the globals made by initializeGlobals() to be
+	// freed by deleteGlobals().
 	Simulator();
 
+	////////////////////////////////////////////////////////////////
+	// Construct a Simulator which runs in the given context.
+	// Simulators with separate contexts may run at the same
+	// time on separate threads.  The context is not deleted
+	// with the Simulator.
+	Simulator(SimulationContext *context);
+
 	////////////////////////////////////////////////////////////////
 	// Destroy the Simulator object
 	~Simulator();
@@ -60,6 +79,8 @@ public:
 	////////////////////////////////////////////////////////////////
 	// Get a pointer to the global config structure, initializing
 	// it from the given file, or the default file if none is given.
+	// The structure belongs to our context, which is left bound
+	// on the calling thread so that g refers to it.
 	//
 	struct globals *initializeGlobals(
 			const char *configFile,
@@ -72,9 +93,70 @@ public:
 	//     <li>FLAG_USE_LAST_MUSCLE</li>
 	//     <li>FLAG_USE_OLD_FIRING_TIMES</li>
 	//     <li>FLAG_RUN_SURFACE</li>
+	//     <li>FLAG_INCREMENTAL</li>
 	// </ul>
+	// With FLAG_INCREMENTAL, the stage hashes stored by the last
+	// run are compared with those of the current configuration,
+	// and the muscle, firing trains, needle placement and MUPs
+	// of the last run are kept wherever their hashes match (see
+	// StageHash.h).  Only the stages downstream of a change are
+	// run again.
 	SimulationResult *run(int flags = 0x00);
 
+	////////////////////////////////////////////////////////////////
+	// Run a progressive disease time-series.  Each of the
+	// nStages severities scales the configured pathology
+	// (0.0 is healthy, 1.0 is the configured pathology), and
+	// must be no smaller than the one before it.
+	// <p>
+	// Each stage is derived from the muscle of the stage before
+	// it, applying only the additional pathology, and is written
+	// with the next file id in the same run directory.  Only the
+	// MUPs of the MUs which the new pathology changes are made
+	// again.  The result of the final stage is returned.
+	SimulationResult *runProgression(
+		        const float *severities,
+		        int nStages,
+		        int flags = 0x00
+		    );
+
+	////////////////////////////////////////////////////////////////
+	// Run the simulator at each of nPositions needle positions
+	// (X and Y, in mm), keeping the muscle and firing trains of
+	// the first run for all the others.
+	// <p>
+	// Each position is written with the next file id in the
+	// same run directory.  Far-field MFAPs are cached between
+	// positions, and are reused for any fibre whose distances
+	// from the needle change by less than MFAPReuseTolerance
+	// (a fraction of the fibre's distance from the tip).  The
+	// result of the final position is returned.
+	SimulationResult *runNeedleSweep(
+		        const float *xPositions,
+		        const float *yPositions,
+		        int nPositions,
+		        int flags = 0x00
+		    );
+
+	////////////////////////////////////////////////////////////////
+	// Run the simulator at each of nLevels contraction levels
+	// (in %MVC) with the same muscle and needle.
+	// <p>
+	// The muscle is built for the first level only.  Every level
+	// still runs each stage: the (empty) pathology pass, new
+	// firing trains, storing the needle info, plowing, makeMUP
+	// and makeEmg, and is written with the next file id in the
+	// same run directory.  makeMUP keeps the MUPs of every MU
+	// which has them, so those of an MU are made once, when it
+	// is first recruited.  The needle is placed (and sought, if
+	// seekNeedle is set) for the first level only.  The result
+	// of the final level is returned.
+	SimulationResult *runContractionSweep(
+		        const float *levels,
+		        int nLevels,
+		        int flags = 0x00
+		    );
+
 	////////////////////////////////////////////////////////////////
 	// Run the simulator for surface simulation only.  No flags
 	// at the moment
@@ -93,6 +175,11 @@ public:
 		        int usePlowedFibres = 1
 		    );
 
+	////////////////////////////////////////////////////////////////
+	// Write binary muscle snapshots for the text muscle files
+	// of a run directory made by an earlier version
+	int upgradeMuscleFiles(const char *path);
+
 	////////////////////////////////////////////////////////////////
 	// Get the config file name
 	const char *getConfigFileName();
@@ -109,6 +196,19 @@ private:
 	////////////////////////////////////////////////////////////////
 	// read in configuation info from file
 	int readConfigInfo();
+
+	////////////////////////////////////////////////////////////////
+	// Run one simulation.  If previousStage is given, the
+	// pathology is applied to that (unplowed) muscle rather than
+	// to a new one, and only dirty MUPs are made again; if
+	// keepUnplowed is set, the plowing is undone after the EMG
+	// is made so that the muscle can seed another stage.
+	SimulationResult *runStage(
+		        int flags,
+		        PathologyControl *pathology,
+		        MuscleData *previousStage,
+		        int keepUnplowed
+		    );
 };
 
 
@@ -78,6 +78,9 @@ typedef struct globals
 	/* 3rd level data  directory emg directory */
 	char *output_dir;
 
+	/* ID of the run directory holding muscle_dir, or -1 if unknown */
+	int run_id;
+
 	/* patient directory name */
 	char patient_name[FILENAME_MAX];
 
@@ -155,6 +158,9 @@ typedef struct globals
 
 	int   use_last_muscle;
 	int   use_old_firing_times;
+	int   write_firing_files;
+	int   write_muscle_text;
+	int   write_run_statistics;
 	int   filter_raw_signal;
 
 	int	  generateMFPsWithoutInitiation;
@@ -173,13 +179,24 @@ typedef struct globals
 	int   generate_second_channel;
 
 	int   text_output;
+
+	/** threads for parallel stages; 0 for one per processor */
+	int   worker_threads;
+
+	/** seed for each stage; 0 to seed from the clock */
+	int   random_seed;
+
+	/** reuse of far-field MFAPs while sweeping the needle */
+	float MFAP_reuse_tolerance;
+	int   MFAP_cache_size_in_MB;
 } SimulationControl;
 
-/* Global Parameters Structure */
-extern struct globals *g;
+/* Global Parameters Structure, one per thread (see SimulationContext) */
+extern OS_THREAD_LOCAL struct globals *g;
 
 int setGlobalDefaultValues(struct globals *globalValues);
 void  clearGlobalPointers(void);
+void deleteGlobalValues(struct globals *globalValues);
 void deleteGlobals(void);
 
 
@@ -0,0 +1,114 @@
+/**
+ ** Content hashes of the inputs of the expensive simulation stages.
+ **
+ ** Each stage declares the configuration values it reads and the
+ ** stages upstream of it; its hash covers those values and the
+ ** hashes of its upstream stages, so a change anywhere above a
+ ** stage changes its hash as well:
+ **
+ **		muscle	<- random seed, layout and pathology settings
+ **		firing	<- muscle, contraction level and firing settings
+ **		needle	<- muscle, needle placement and seek settings
+ **				   (firing in place of muscle when the needle seeks
+ **				   the active fibres, as those depend on the trains)
+ **		MUP		<- needle, electrode, uptake and jitter settings
+ **
+ ** The hashes of a run are stored beside its muscle files, so that
+ ** a later incremental run on the same configuration can tell which
+ ** of the stored outputs are still good and only redo the rest.
+ ** The EMG, 16-bit and decomposition stages are cheap next to
+ ** these and are always run again.
+ **
+ ** The random seed is taken by the muscle stage, as every stage
+ ** draws from the one stream it starts; a new seed therefore
+ ** redoes the whole run.  A kept stage draws nothing from that
+ ** stream, so the stages redone after it start from a different
+ ** point in it than they would in a clean run: their outputs are
+ ** a valid simulation of the configuration, but not bit for bit
+ ** those of a clean run with the same seed.
+ **
+ ** Each run is also entered in the run catalogue of the output
+ ** stem under a hash of its whole configuration, so that an
+ ** incremental run can pick up an earlier run of the same
+ ** configuration even when it was not the last one made.
+ **
+ ** $Id$
+ **/
+#ifndef __STAGE_HASH_HEADER__
+#define __STAGE_HASH_HEADER__
+
+#include "os_defs.h"
+
+#define	STAGE_MUSCLE			0
+#define	STAGE_FIRING			1
+#define	STAGE_NEEDLE			2
+#define	STAGE_MUP				3
+#define	STAGE_NUM_HASHED		4
+
+/** name of the file holding the hashes in the muscle directory */
+#define	STAGE_HASH_FILENAME		"stages.hash"
+
+typedef struct StageHashes {
+	osUint32 sh_hash[STAGE_NUM_HASHED];
+
+	/** stage each hash was chained from, or (-1) for none */
+	int sh_upstream[STAGE_NUM_HASHED];
+
+	/** set for each stage whose outputs were stored */
+	int sh_isValid[STAGE_NUM_HASHED];
+} StageHashes;
+
+struct globals;
+
+/** name of the stage, for logging */
+const char *getStageName(int stage);
+
+/** calculate the hash of every stage from the given configuration */
+void calculateStageHashes(StageHashes *hashes, struct globals *globals);
+
+/** return 1 if the stage is valid in both sets with the same hash */
+int stageHashMatches(
+		const StageHashes *current,
+		const StageHashes *stored,
+		int stage
+	);
+
+/**
+ * work out the hashes describing the outputs of a run: a stage
+ * which was run has the current hash and one kept from the stored
+ * run keeps its stored hash.  A stage is left invalid if its
+ * upstream stage no longer holds the hash it was made from, or if
+ * it was not run and nothing was stored for it
+ */
+void resolveStageHashes(
+		StageHashes *outputs,
+		const StageHashes *current,
+		const StageHashes *stored,
+		const int *wasRun
+	);
+
+/**
+ * a single hash of the whole configuration, from the hashes of
+ * the valid stages, under which a run is catalogued
+ */
+osUint32 getConfigurationHash(const StageHashes *hashes);
+
+/** list the valid hashes as "stage=hash,..." for the run catalogue */
+void formatStageHashes(char *buffer, int size, const StageHashes *hashes);
+
+/**
+ * load the hashes stored in a muscle directory; if there are none,
+ * 0 is returned and no stage is valid
+ */
+int loadStageHashes(StageHashes *hashes, const char *muscleDirectory);
+
+/** store the hashes of the valid stages in a muscle directory */
+int storeStageHashes(const StageHashes *hashes, const char *muscleDirectory);
+
+/**
+ * remove any stored hashes, when the outputs of the directory
+ * no longer follow from its configuration alone
+ */
+void removeStageHashes(const char *muscleDirectory);
+
+#endif /* __STAGE_HASH_HEADER__ */
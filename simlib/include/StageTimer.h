@@ -0,0 +1,43 @@
+/**
+ ** Scoped timing of a simulation stage
+ **
+ ** $Id$
+ **/
+#ifndef __STAGE_TIMER_CLASS_HEADER__
+#define __STAGE_TIMER_CLASS_HEADER__
+
+#include "os_defs.h"
+#include "stagestats.h"
+
+#ifndef PRIVATE
+#define PRIVATE private
+#endif
+
+/**
+CLASS
+		StageTimer
+
+	Times the enclosing scope as a stage in the run statistics
+	(see stagestats.h), closing it however the scope is left.
+	The name must be a string constant.
+ **/
+class StageTimer
+{
+public:
+		StageTimer(const char *name);
+		~StageTimer();
+
+PRIVATE:
+		int isOpen_;
+};
+
+inline StageTimer::StageTimer(const char *name) {
+	isOpen_ = stageStatsBegin(name);
+}
+
+inline StageTimer::~StageTimer() {
+	if (isOpen_)
+		stageStatsEnd();
+}
+
+#endif /* __STAGE_TIMER_CLASS_HEADER__ */
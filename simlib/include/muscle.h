@@ -125,7 +125,7 @@ MuscleParameters *getMuscleParameters(
 struct rTreeResultList {
 	int *results_;
 	int nEntries_;
-	int nBlocks_;
+	int nAllocated_;
 };
 
 /**
@@ -154,7 +154,9 @@ MuscleData *muscle(
 		float needleZ,
 		int motorUnitLayoutType,
 		int doJitterSuperFibres,
-		int muscleLayoutFunctionType
+		int muscleLayoutFunctionType,
+		int exportMuscleText,
+		int nThreads
 	);
 MuscleData *loadMuscleData(
 		int emgFileId,
@@ -164,7 +166,9 @@ MuscleData *loadMuscleData(
 	);
 
 int FibreRTreeSearchCallback__(long id, void *resultList);
+void sortRTreeResultList(struct rTreeResultList *resultList);
 int buildFibreRTree(MuscleData *MD);
+int buildFibreLatticeIndex(MuscleData *MD);
 
 int setAndClipNeedleLocation(
 		MuscleData *MD,
@@ -187,15 +191,24 @@ int seekNeedleToNearbyFibres(
 int plowMuscleFibres(
 		int emgFileId,
 		const char *outputDir,
+		const char *muscleDir,
 		MuscleData *MD,
-		float canPhysicalRadius
+		float canPhysicalRadius,
+		int exportMuscleText
+	);
+
+int applyMusclePathology(
+		MuscleData *MD,
+		PathologyControl *pathologyParams,
+		int nThreads
 	);
 
 int updateMuscleWithNeuropathy(
 		MuscleData *MD,
 		float involvement,
 		int maxAdoptionDistanceInCells,
-		float neuropathicEnlargementFraction
+		float neuropathicEnlargementFraction,
+		int nThreads
 	);
 
 int updateMuscleWithMyopathy(
@@ -225,15 +238,23 @@ int firing(
 		float maximumFiringRate,
 		float maximumFiringThreshold,
 		int totalElapsedTimeInSeconds,
-		int forceFiring
+		int forceFiring,
+		int exportFiringTimes,
+		int nThreads
 	);
 int loadFiring(
 		MuscleData *muscleDataDefinition,
 		const char *firingsDirectory
 	);
+void setFiringLogVerbosity(int verbosity);
 
 /** EMG generation functions */
-int makeEmg(MuscleData *muscleDataDefinition, int fileId);
+class FiringSource;
+int makeEmg(
+		MuscleData *muscleDataDefinition,
+		FiringSource *firingSource,
+		int fileId
+	);
 int create_next_dir(
 				char *path,
 				char *dirmask,
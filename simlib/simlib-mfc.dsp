@@ -97,10 +97,22 @@ SOURCE=.\src\fileutil.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\FibreLatticeIndex.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\MFAPCache.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\firing.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\FiringSource.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\globalHandler.cpp
 # End Source File
 # Begin Source File
@@ -137,6 +149,10 @@ SOURCE=.\src\MuscleData.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\MuscleSnapshot.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\muscleNeuropathy.cpp
 # End Source File
 # Begin Source File
@@ -153,10 +169,18 @@ SOURCE=.\src\NoiseGenerator.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\SimulationContext.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\SimulationResult.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\StageHash.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\Simulator.cpp
 # End Source File
 # Begin Source File
@@ -189,6 +213,18 @@ SOURCE=.\include\3Circle.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\FibreLatticeIndex.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\MFAPCache.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\FiringSource.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\globalHandler.h
 # End Source File
 # Begin Source File
@@ -221,6 +257,10 @@ SOURCE=.\include\MuscleData.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\MuscleSnapshot.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\NeedleInfo.h
 # End Source File
 # Begin Source File
@@ -233,6 +273,10 @@ SOURCE=.\include\NoiseGenerator.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\SimulationContext.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\Simulator.h
 # End Source File
 # Begin Source File
@@ -241,6 +285,14 @@ SOURCE=.\include\SimulatorControl.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\StageHash.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\include\StageTimer.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\SineWave.h
 # End Source File
 # Begin Source File
@@ -0,0 +1,754 @@
+/**
+ ** Lattice index of the muscle fibres
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <math.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "listalloc.h"
+#include "massert.h"
+#include "log.h"
+
+#define PRIVATE public
+#include "MuscleData.h"
+#include "muscle.h"
+#include "FibreLatticeIndex.h"
+
+FibreLatticeIndex::FibreLatticeIndex()
+{
+	xMin_ = yMin_ = 0;
+	width_ = height_ = 0;
+	cell_ = NULL;
+	hasOverflow_ = NULL;
+	overflow_ = NULL;
+	nOverflow_ = 0;
+	nOverflowAllocated_ = 0;
+	outside_ = NULL;
+	nOutside_ = 0;
+	nOutsideAllocated_ = 0;
+	nFibres_ = 0;
+}
+
+FibreLatticeIndex::~FibreLatticeIndex()
+{
+	if (cell_ != NULL)
+		ckfree(cell_);
+	if (hasOverflow_ != NULL)
+		FREE_BITSTRING(hasOverflow_);
+	if (overflow_ != NULL)
+		ckfree(overflow_);
+	if (outside_ != NULL)
+		ckfree(outside_);
+}
+
+int
+FibreLatticeIndex::sCellOf(float locationInCells)
+{
+	return (int) floor(locationInCells + 0.5);
+}
+
+static int
+sCompareOverflow(const void *v1, const void *v2)
+{
+	const struct FibreLatticeOverflow *o1 =
+				(const struct FibreLatticeOverflow *) v1;
+	const struct FibreLatticeOverflow *o2 =
+				(const struct FibreLatticeOverflow *) v2;
+
+	if (o1->cell_ != o2->cell_)
+		return o1->cell_ - o2->cell_;
+	return o1->fibre_ - o2->fibre_;
+}
+
+int
+FibreLatticeIndex::build(const MuscleData *MD)
+{
+	MuscleFibre *fibre;
+	int xMax = 0, yMax = 0;
+	int xCell, yCell;
+	int haveBounds = 0;
+	int nCells;
+	int cell;
+	int status;
+	int i;
+
+	MSG_ASSERT(cell_ == NULL, "Lattice index built twice");
+
+	nFibres_ = MD->getTotalNumberOfFibres();
+	status = xCell_.setLength(nFibres_ + 1)
+			&& yCell_.setLength(nFibres_ + 1);
+	MSG_ASSERT(status, "Allocation failed");
+
+	/** find the extent of the lattice */
+	for (i = 0; i < nFibres_; i++)
+	{
+		fibre = MD->getFibre(i);
+		if (fibre == NULL)
+			continue;
+
+		xCell_[i] = fibre->getXCell();
+		yCell_[i] = fibre->getYCell();
+		xCell = sCellOf(xCell_[i]);
+		yCell = sCellOf(yCell_[i]);
+
+		if ( ! haveBounds || xCell < xMin_)
+			xMin_ = xCell;
+		if ( ! haveBounds || yCell < yMin_)
+			yMin_ = yCell;
+		if ( ! haveBounds || xCell > xMax)
+			xMax = xCell;
+		if ( ! haveBounds || yCell > yMax)
+			yMax = yCell;
+		haveBounds = 1;
+	}
+
+	if (haveBounds)
+	{
+		width_ = xMax - xMin_ + 1;
+		height_ = yMax - yMin_ + 1;
+	}
+
+	nCells = width_ * height_;
+	cell_ = (int *) ckalloc(sizeof(int) * (nCells + 1));
+	memset(cell_, 0, sizeof(int) * (nCells + 1));
+	hasOverflow_ = ALLOC_BITSTRING(nCells + 1);
+	ZERO_BITSTRING(hasOverflow_, nCells + 1);
+
+	/**
+	 * fill in the cells in index order, so that the lowest
+	 * index in each cell lives in the lattice itself
+	 */
+	for (i = 0; i < nFibres_; i++)
+	{
+		if (MD->getFibre(i) == NULL)
+			continue;
+
+		cell = ((sCellOf(yCell_[i]) - yMin_) * width_)
+					+ (sCellOf(xCell_[i]) - xMin_);
+		if (cell_[cell] == 0)
+		{
+			cell_[cell] = i + 1;
+			continue;
+		}
+
+		growArrayReserve(
+				nOverflow_ + 1,
+				(void **) &overflow_,
+				&nOverflowAllocated_,
+				sizeof(struct FibreLatticeOverflow));
+		overflow_[nOverflow_].cell_ = cell;
+		overflow_[nOverflow_].fibre_ = i;
+		nOverflow_++;
+		SET_BIT(hasOverflow_, cell, 1);
+	}
+
+	if (nOverflow_ > 1)
+		qsort(overflow_, nOverflow_, sizeof(struct FibreLatticeOverflow),
+				sCompareOverflow);
+
+	LogInfo("Fibre lattice of %d x %d cells, %d overflow fibres\n",
+			width_, height_, nOverflow_);
+
+	return 1;
+}
+
+int
+FibreLatticeIndex::getFibreAtCell(int xCell, int yCell) const
+{
+	int x = xCell - xMin_;
+	int y = yCell - yMin_;
+	int i;
+
+	if (x < 0 || x >= width_ || y < 0 || y >= height_)
+	{
+		for (i = 0; i < nOutside_; i++)
+		{
+			if (sCellOf(xCell_[outside_[i]]) == xCell
+					&& sCellOf(yCell_[outside_[i]]) == yCell)
+				return outside_[i];
+		}
+		return (-1);
+	}
+
+	return cell_[(y * width_) + x] - 1;
+}
+
+/**
+ ** Binary search for the first overflow entry of a cell
+ **/
+int
+FibreLatticeIndex::firstOverflowOf(int cell) const
+{
+	int low = 0, high = nOverflow_, mid;
+
+	while (low < high)
+	{
+		mid = (low + high) / 2;
+		if (overflow_[mid].cell_ < cell)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/**
+ ** Binary search for the position of a fibre in the outside list
+ **/
+int
+FibreLatticeIndex::firstOutsideOf(int fibreId) const
+{
+	int low = 0, high = nOutside_, mid;
+
+	while (low < high)
+	{
+		mid = (low + high) / 2;
+		if (outside_[mid] < fibreId)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/**
+ ** Append the fibres beyond the lattice which lie within the
+ ** radius of the point; returns the number appended
+ **/
+int
+FibreLatticeIndex::appendOutside(
+		float xCell,
+		float yCell,
+		float radiusSquared,
+		struct rTreeResultList *resultList
+	) const
+{
+	float dx, dy;
+	int nAppended = 0;
+	int i;
+
+	for (i = 0; i < nOutside_; i++)
+	{
+		dx = xCell_[outside_[i]] - xCell;
+		dy = yCell_[outside_[i]] - yCell;
+		if ((dx * dx) + (dy * dy) > radiusSquared)
+			continue;
+
+		growArrayReserve(
+				resultList->nEntries_ + 1,
+				(void **) &resultList->results_,
+				&resultList->nAllocated_,
+				sizeof(int));
+		resultList->results_[resultList->nEntries_++] = outside_[i];
+		nAppended++;
+	}
+
+	return nAppended;
+}
+
+/**
+ ** Append the fibres in a single cell, if it is inside the
+ ** lattice; returns the number appended
+ **/
+int
+FibreLatticeIndex::appendCell(
+		int xCell,
+		int yCell,
+		struct rTreeResultList *resultList
+	) const
+{
+	int x = xCell - xMin_;
+	int y = yCell - yMin_;
+	int cell;
+	int nAppended = 0;
+	int low;
+	int i;
+
+	if (x < 0 || x >= width_ || y < 0 || y >= height_)
+	{
+		for (i = 0; i < nOutside_; i++)
+		{
+			if (sCellOf(xCell_[outside_[i]]) != xCell
+					|| sCellOf(yCell_[outside_[i]]) != yCell)
+				continue;
+
+			growArrayReserve(
+					resultList->nEntries_ + 1,
+					(void **) &resultList->results_,
+					&resultList->nAllocated_,
+					sizeof(int));
+			resultList->results_[resultList->nEntries_++] = outside_[i];
+			nAppended++;
+		}
+		return nAppended;
+	}
+
+	cell = (y * width_) + x;
+	if (cell_[cell] == 0)
+		return 0;
+
+	growArrayReserve(
+			resultList->nEntries_ + 1,
+			(void **) &resultList->results_,
+			&resultList->nAllocated_,
+			sizeof(int));
+	resultList->results_[resultList->nEntries_++] = cell_[cell] - 1;
+	nAppended++;
+
+	if ( ! GET_BIT(hasOverflow_, cell))
+		return nAppended;
+
+	low = firstOverflowOf(cell);
+	while (low < nOverflow_ && overflow_[low].cell_ == cell)
+	{
+		growArrayReserve(
+				resultList->nEntries_ + 1,
+				(void **) &resultList->results_,
+				&resultList->nAllocated_,
+				sizeof(int));
+		resultList->results_[resultList->nEntries_++] =
+					overflow_[low].fibre_;
+		nAppended++;
+		low++;
+	}
+
+	return nAppended;
+}
+
+int
+FibreLatticeIndex::appendRing(
+		int xCell,
+		int yCell,
+		int ring,
+		struct rTreeResultList *resultList
+	) const
+{
+	int nAppended = 0;
+	int i;
+
+	if (ring == 0)
+		return appendCell(xCell, yCell, resultList);
+
+	/** top and bottom rows, then the sides between them */
+	for (i = xCell - ring; i <= xCell + ring; i++)
+	{
+		nAppended += appendCell(i, yCell - ring, resultList);
+		nAppended += appendCell(i, yCell + ring, resultList);
+	}
+	for (i = yCell - ring + 1; i < yCell + ring; i++)
+	{
+		nAppended += appendCell(xCell - ring, i, resultList);
+		nAppended += appendCell(xCell + ring, i, resultList);
+	}
+
+	return nAppended;
+}
+
+int
+FibreLatticeIndex::findWithinRadius(
+		float xCell,
+		float yCell,
+		float radiusInCells,
+		struct rTreeResultList *resultList
+	) const
+{
+	float radiusSquared = radiusInCells * radiusInCells;
+	float dx, dy;
+	int xLow, xHigh, yLow, yHigh;
+	int isClipped = 0;
+	int nFound = 0;
+	int isSorted = 1;
+	int fibreId;
+	int cell;
+	int x, y, i;
+
+	resultList->nEntries_ = 0;
+
+	/**
+	 * a fibre within the radius rounds into a cell no further
+	 * out than the cell holding the edge of the circle
+	 */
+	xLow = sCellOf(xCell - radiusInCells) - xMin_;
+	xHigh = sCellOf(xCell + radiusInCells) - xMin_;
+	yLow = sCellOf(yCell - radiusInCells) - yMin_;
+	yHigh = sCellOf(yCell + radiusInCells) - yMin_;
+	if (xLow < 0 || xHigh >= width_ || yLow < 0 || yHigh >= height_)
+		isClipped = 1;
+	if (xLow < 0)
+		xLow = 0;
+	if (xHigh >= width_)
+		xHigh = width_ - 1;
+	if (yLow < 0)
+		yLow = 0;
+	if (yHigh >= height_)
+		yHigh = height_ - 1;
+
+	/** fibres beyond the lattice can only be reached past its edge */
+	if (xLow > xHigh || yLow > yHigh)
+	{
+		if (isClipped && nOutside_ > 0)
+			appendOutside(xCell, yCell, radiusSquared, resultList);
+		return resultList->nEntries_;
+	}
+
+	/** room for every cell in the square plus all overflow */
+	growArrayReserve(
+			((xHigh - xLow + 1) * (yHigh - yLow + 1)) + nOverflow_,
+			(void **) &resultList->results_,
+			&resultList->nAllocated_,
+			sizeof(int));
+
+	/**
+	 * allocateFibres() numbers the fibres up each column in
+	 * turn, so scanning the same way finds them in index order
+	 * unless they have since been split or moved
+	 */
+	for (x = xLow; x <= xHigh; x++)
+	{
+		for (y = yLow; y <= yHigh; y++)
+		{
+			cell = (y * width_) + x;
+			if (cell_[cell] == 0)
+				continue;
+
+			fibreId = cell_[cell] - 1;
+			dx = xCell_[fibreId] - xCell;
+			dy = yCell_[fibreId] - yCell;
+			if ((dx * dx) + (dy * dy) <= radiusSquared)
+			{
+				if (nFound > 0 && resultList->results_[nFound - 1] > fibreId)
+					isSorted = 0;
+				resultList->results_[nFound++] = fibreId;
+			}
+
+			if ( ! GET_BIT(hasOverflow_, cell))
+				continue;
+
+			for (i = firstOverflowOf(cell);
+					i < nOverflow_ && overflow_[i].cell_ == cell; i++)
+			{
+				fibreId = overflow_[i].fibre_;
+				dx = xCell_[fibreId] - xCell;
+				dy = yCell_[fibreId] - yCell;
+				if ((dx * dx) + (dy * dy) <= radiusSquared)
+				{
+					if (nFound > 0
+							&& resultList->results_[nFound - 1] > fibreId)
+						isSorted = 0;
+					resultList->results_[nFound++] = fibreId;
+				}
+			}
+		}
+	}
+	resultList->nEntries_ = nFound;
+
+	if (isClipped && nOutside_ > 0
+			&& appendOutside(xCell, yCell, radiusSquared, resultList) > 0)
+		isSorted = 0;
+
+	if ( ! isSorted)
+		sortRTreeResultList(resultList);
+
+	return resultList->nEntries_;
+}
+
+int
+FibreLatticeIndex::findAlongLine(
+		float xCell,
+		float yCell,
+		float slope,
+		float halfWidthInCells,
+		struct rTreeResultList *resultList
+	) const
+{
+	double norm = sqrt(1.0 + (slope * slope));
+	double xRowLow, xRowHigh, xAtRow, stripHalfWidth;
+	float across;
+	int xLow, xHigh, yLow;
+	int nFound = 0;
+	int fibreId;
+	int cell;
+	int x, y, i;
+
+	resultList->nEntries_ = 0;
+
+	/** a fibre on or above the point rounds into its row or higher */
+	yLow = sCellOf(yCell) - yMin_;
+	if (yLow < 0)
+		yLow = 0;
+
+	for (y = yLow; y < height_; y++)
+	{
+		/**
+		 * the strip crosses a row of cells over the span of X
+		 * where the line crosses the row, widened by the
+		 * horizontal width of the strip; a flat line crosses
+		 * every cell in its rows
+		 */
+		if (fabs(slope) < 1.0e-6)
+		{
+			xLow = 0;
+			xHigh = width_ - 1;
+		} else
+		{
+			stripHalfWidth = halfWidthInCells * norm / fabs(slope);
+			xAtRow = xCell + ((y + yMin_ - 0.5 - yCell) / slope);
+			xRowLow = xRowHigh = xAtRow;
+			xAtRow = xCell + ((y + yMin_ + 0.5 - yCell) / slope);
+			if (xAtRow < xRowLow)
+				xRowLow = xAtRow;
+			if (xAtRow > xRowHigh)
+				xRowHigh = xAtRow;
+
+			xLow = sCellOf((float) (xRowLow - stripHalfWidth)) - xMin_;
+			xHigh = sCellOf((float) (xRowHigh + stripHalfWidth)) - xMin_;
+			if (xLow < 0)
+				xLow = 0;
+			if (xHigh >= width_)
+				xHigh = width_ - 1;
+			if (xLow > xHigh)
+				continue;
+		}
+
+		for (x = xLow; x <= xHigh; x++)
+		{
+			cell = (y * width_) + x;
+			if (cell_[cell] == 0)
+				continue;
+
+			appendCell(x + xMin_, y + yMin_, resultList);
+		}
+	}
+
+	/** the line runs on past the lattice, so check all outsiders */
+	for (i = 0; i < nOutside_; i++)
+	{
+		growArrayReserve(
+				resultList->nEntries_ + 1,
+				(void **) &resultList->results_,
+				&resultList->nAllocated_,
+				sizeof(int));
+		resultList->results_[resultList->nEntries_++] = outside_[i];
+	}
+
+	/** keep only those truly within the strip */
+	for (i = 0; i < resultList->nEntries_; i++)
+	{
+		fibreId = resultList->results_[i];
+		if (yCell_[fibreId] < yCell)
+			continue;
+
+		across = (float) (((yCell_[fibreId] - yCell)
+					- (slope * (xCell_[fibreId] - xCell))) / norm);
+		if (fabs(across) <= halfWidthInCells)
+			resultList->results_[nFound++] = fibreId;
+	}
+	resultList->nEntries_ = nFound;
+
+	sortRTreeResultList(resultList);
+
+	return nFound;
+}
+
+/**
+ ** Take a fibre out of its cell (or the outside list), promoting
+ ** the next fibre in a shared cell into the lattice
+ **/
+void
+FibreLatticeIndex::removeFibre(int fibreId)
+{
+	int x = sCellOf(xCell_[fibreId]) - xMin_;
+	int y = sCellOf(yCell_[fibreId]) - yMin_;
+	int cell;
+	int i;
+
+	if (x < 0 || x >= width_ || y < 0 || y >= height_)
+	{
+		i = firstOutsideOf(fibreId);
+		MSG_ASSERT(i < nOutside_ && outside_[i] == fibreId,
+				"Fibre missing from lattice");
+		memmove(&outside_[i], &outside_[i + 1],
+				sizeof(int) * (nOutside_ - i - 1));
+		nOutside_--;
+		return;
+	}
+
+	cell = (y * width_) + x;
+	if (cell_[cell] == fibreId + 1)
+	{
+		if ( ! GET_BIT(hasOverflow_, cell))
+		{
+			cell_[cell] = 0;
+			return;
+		}
+		i = firstOverflowOf(cell);
+		cell_[cell] = overflow_[i].fibre_ + 1;
+	} else
+	{
+		for (i = firstOverflowOf(cell);
+				i < nOverflow_ && overflow_[i].cell_ == cell; i++)
+		{
+			if (overflow_[i].fibre_ == fibreId)
+				break;
+		}
+		MSG_ASSERT(i < nOverflow_ && overflow_[i].cell_ == cell,
+				"Fibre missing from lattice");
+	}
+
+	memmove(&overflow_[i], &overflow_[i + 1],
+			sizeof(struct FibreLatticeOverflow) * (nOverflow_ - i - 1));
+	nOverflow_--;
+
+	if (i >= nOverflow_ || overflow_[i].cell_ != cell)
+	{
+		if (i == 0 || overflow_[i - 1].cell_ != cell)
+			SET_BIT(hasOverflow_, cell, 0);
+	}
+}
+
+/**
+ ** Place a fibre according to its recorded location, keeping
+ ** the lowest index of a shared cell in the lattice itself
+ **/
+void
+FibreLatticeIndex::insertFibre(int fibreId)
+{
+	struct FibreLatticeOverflow entry;
+	int x = sCellOf(xCell_[fibreId]) - xMin_;
+	int y = sCellOf(yCell_[fibreId]) - yMin_;
+	int cell;
+	int i;
+
+	if (x < 0 || x >= width_ || y < 0 || y >= height_)
+	{
+		growArrayReserve(
+				nOutside_ + 1,
+				(void **) &outside_,
+				&nOutsideAllocated_,
+				sizeof(int));
+		i = firstOutsideOf(fibreId);
+		memmove(&outside_[i + 1], &outside_[i],
+				sizeof(int) * (nOutside_ - i));
+		outside_[i] = fibreId;
+		nOutside_++;
+		return;
+	}
+
+	cell = (y * width_) + x;
+	if (cell_[cell] == 0)
+	{
+		cell_[cell] = fibreId + 1;
+		return;
+	}
+
+	entry.cell_ = cell;
+	entry.fibre_ = fibreId;
+	if (fibreId + 1 < cell_[cell])
+	{
+		entry.fibre_ = cell_[cell] - 1;
+		cell_[cell] = fibreId + 1;
+	}
+
+	growArrayReserve(
+			nOverflow_ + 1,
+			(void **) &overflow_,
+			&nOverflowAllocated_,
+			sizeof(struct FibreLatticeOverflow));
+	for (i = firstOverflowOf(cell); i < nOverflow_
+			&& sCompareOverflow(&overflow_[i], &entry) < 0; i++)
+		;
+	memmove(&overflow_[i + 1], &overflow_[i],
+			sizeof(struct FibreLatticeOverflow) * (nOverflow_ - i));
+	overflow_[i] = entry;
+	nOverflow_++;
+	SET_BIT(hasOverflow_, cell, 1);
+}
+
+void
+FibreLatticeIndex::moveFibre(int fibreId, float xCell, float yCell)
+{
+	MSG_ASSERT(fibreId >= 0 && fibreId < nFibres_, "Fibre out of range");
+
+	removeFibre(fibreId);
+	xCell_[fibreId] = xCell;
+	yCell_[fibreId] = yCell;
+	insertFibre(fibreId);
+}
+
+void
+FibreLatticeIndex::addFibre(int fibreId, float xCell, float yCell)
+{
+	int status;
+
+	MSG_ASSERT(fibreId == nFibres_, "Fibres must be added in order");
+
+	status = xCell_.setLength(nFibres_ + 2)
+			&& yCell_.setLength(nFibres_ + 2);
+	MSG_ASSERT(status, "Allocation failed");
+
+	xCell_[fibreId] = xCell;
+	yCell_[fibreId] = yCell;
+	nFibres_++;
+	insertFibre(fibreId);
+}
+
+void
+FibreLatticeIndex::deleteFibre(int fibreId)
+{
+	MSG_ASSERT(fibreId >= 0 && fibreId < nFibres_, "Fibre out of range");
+
+	removeFibre(fibreId);
+}
+
+int
+FibreLatticeIndex::findFibre(
+		const MuscleData *MD,
+		const MuscleFibre *fibre
+	) const
+{
+	int xCell = sCellOf(fibre->getXCell());
+	int yCell = sCellOf(fibre->getYCell());
+	int x = xCell - xMin_;
+	int y = yCell - yMin_;
+	int cell;
+	int i;
+
+	if (x < 0 || x >= width_ || y < 0 || y >= height_)
+	{
+		for (i = 0; i < nOutside_; i++)
+		{
+			if (MD->getFibre(outside_[i]) == fibre)
+				return outside_[i];
+		}
+		return (-1);
+	}
+
+	cell = (y * width_) + x;
+	if (cell_[cell] == 0)
+		return (-1);
+	if (MD->getFibre(cell_[cell] - 1) == fibre)
+		return cell_[cell] - 1;
+
+	if (GET_BIT(hasOverflow_, cell))
+	{
+		for (i = firstOverflowOf(cell);
+				i < nOverflow_ && overflow_[i].cell_ == cell; i++)
+		{
+			if (MD->getFibre(overflow_[i].fibre_) == fibre)
+				return overflow_[i].fibre_;
+		}
+	}
+
+	return (-1);
+}
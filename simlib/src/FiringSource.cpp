@@ -0,0 +1,233 @@
+/**
+ ** Firing train sources for EMG generation
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <errno.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "pathtools.h"
+#include "stringtools.h"
+#include "error.h"
+#include "log.h"
+
+#define PRIVATE public
+#include "MuscleData.h"
+#include "FiringSource.h"
+
+
+#ifdef OS_WINDOWS
+		/*
+		 * disable _CRT_SECURE_NO_WARNINGS related flags for now,
+		 * as they completely break the POSIX interface, as we
+		 * will have to re-write wrappers for things like fopen
+		 * to make this work more gracefully
+		 */
+# pragma warning(disable : 4996)
+#endif
+
+#define INPUT_BUFFER_SIZE       2048
+
+
+FiringSource::~FiringSource()
+{
+}
+
+void
+FiringSource::releaseFiringTimes(const long *)
+{
+}
+
+
+MemoryFiringSource::MemoryFiringSource()
+{
+}
+
+MemoryFiringSource::~MemoryFiringSource()
+{
+}
+
+int
+MemoryFiringSource::getFiringTimes(
+		MotorUnit *motorUnit,
+		const long **firingTimes,
+		int *nFiringTimes
+	)
+{
+	if (motorUnit->mu_firingTime_ == NULL && motorUnit->mu_nFirings_ > 0)
+	{
+		LogError("No firing times in memory for MU %d\n",
+				motorUnit->mu_id_);
+		return 0;
+	}
+
+	*firingTimes = motorUnit->mu_firingTime_;
+	*nFiringTimes = motorUnit->mu_nFirings_;
+	return 1;
+}
+
+
+DiskFiringSource::DiskFiringSource(const char *firingsDirectory)
+{
+	firingsDirectory_ = ckstrdup(firingsDirectory);
+}
+
+DiskFiringSource::~DiskFiringSource()
+{
+	ckfree(firingsDirectory_);
+}
+
+int
+DiskFiringSource::getFiringTimes(
+		MotorUnit *motorUnit,
+		const long **firingTimes,
+		int *nFiringTimes
+	)
+{
+	char filename[FILENAME_MAX];
+	long *loadedTimes;
+
+	slnprintf(filename, FILENAME_MAX, "%s\\FTMU%d.dat",
+			firingsDirectory_, motorUnit->mu_id_);
+
+	if ( ! sLoadFiringTimeFile(filename, &loadedTimes, nFiringTimes) )
+		return 0;
+
+	*firingTimes = loadedTimes;
+	return 1;
+}
+
+void
+DiskFiringSource::releaseFiringTimes(const long *firingTimes)
+{
+	if (firingTimes != NULL)
+		ckfree((void *) firingTimes);
+}
+
+/**
+ ** Read a file consisting of a count followed by that many
+ ** firing times, one per line.  Lines beginning with '#' are
+ ** comments.
+ **/
+int
+DiskFiringSource::sLoadFiringTimeFile(
+		const char *filename,
+		long **firingTimes,
+		int *nFiringTimes
+	)
+{
+	char inputLine[INPUT_BUFFER_SIZE];
+	FILE *fp;
+	long *loadedTimes = NULL;
+	int nExpected = (-1);
+	int firingTimeIndex = 0;
+
+
+	fp = fopenpath(filename, "rb");
+	if (fp == NULL)
+	{
+		Error("Unable to open firing times file %s : %s\n",
+				filename, strerror(errno));
+		return 0;
+	}
+
+	while (fgets(inputLine, INPUT_BUFFER_SIZE, fp) != NULL)
+	{
+		if (inputLine[0] == '#')
+			continue;
+
+		if (nExpected < 0)
+		{
+			if (sscanf(inputLine, "%d", &nExpected) != 1
+					|| nExpected < 0)
+			{
+				LogError("Cannot parse firing count in '%s' from:\n%s\n",
+						filename, inputLine);
+				goto FAIL;
+			}
+
+			loadedTimes = (long *) ckalloc(sizeof(long)
+						* (nExpected > 0 ? nExpected : 1));
+		} else
+		{
+			if (firingTimeIndex >= nExpected)
+			{
+				LogError("Too many lines in '%s'\n", filename);
+				goto FAIL;
+			}
+
+			if (sscanf(inputLine, "%ld",
+						&loadedTimes[firingTimeIndex]) != 1)
+			{
+				LogError("Cannot parse firing time %d in '%s' from:\n%s\n",
+						firingTimeIndex, filename, inputLine);
+				goto FAIL;
+			}
+			firingTimeIndex++;
+		}
+	}
+	fclose(fp);
+	fp = NULL;
+
+	if (nExpected < 0 || firingTimeIndex < nExpected)
+	{
+		LogError("Too few lines in '%s'\n", filename);
+		goto FAIL;
+	}
+
+	*firingTimes = loadedTimes;
+	*nFiringTimes = nExpected;
+	return 1;
+
+FAIL:
+	if (fp != NULL)
+		fclose(fp);
+	if (loadedTimes != NULL)
+		ckfree(loadedTimes);
+	return 0;
+}
+
+
+/**
+ ** Store the firing times of a MU in the file "FTMU%d.dat".
+ **
+ ** This file stores the number of firings at the top of the
+ ** file followed by the list of firing times
+ **/
+int
+writeFiringTimeFile(
+		const char *firingsDirectory,
+		MotorUnit *motorUnit
+	)
+{
+	char filename[FILENAME_MAX];
+	FILE *fp;
+	int i;
+
+	slnprintf(filename, FILENAME_MAX, "%s\\FTMU%d.dat",
+			firingsDirectory, motorUnit->mu_id_);
+	fp = fopenpath(filename, "wb");
+	if (fp == NULL)
+	{
+		Error("Unable to open %s", filename);
+		return 0;
+	}
+
+	fprintf(fp, "%d\n", motorUnit->mu_nFirings_);
+	for (i = 0; i < motorUnit->mu_nFirings_; i++)
+	{
+		fprintf(fp, "    %ld\n", motorUnit->mu_firingTime_[i]);
+	}
+	fclose(fp);
+
+	return 1;
+}
+
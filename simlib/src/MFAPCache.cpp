@@ -0,0 +1,159 @@
+/**
+ ** Cache of the MFAPs calculated for each fibre
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <math.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "listalloc.h"
+#include "massert.h"
+#include "log.h"
+
+#include "MFAPCache.h"
+
+
+MFAPCache::MFAPCache(int MFAPLength, float tolerance, int maxEntries)
+{
+	MFAPLength_ = MFAPLength;
+	tolerance_ = tolerance;
+	maxEntries_ = maxEntries;
+	nAllocatedEntries_ = 0;
+	mu_ = NULL;
+	nMUs_ = 0;
+	nMUsAllocated_ = 0;
+	nExactHits_ = nToleranceHits_ = nMisses_ = 0;
+}
+
+MFAPCache::~MFAPCache()
+{
+	int i, j;
+
+	for (i = 0; i < nMUs_; i++)
+	{
+		for (j = 0; j < mu_[i].cm_nEntries; j++)
+		{
+			if (mu_[i].cm_entry[j].ce_tipMFAP != NULL)
+			{
+				ckfree(mu_[i].cm_entry[j].ce_tipMFAP);
+				ckfree(mu_[i].cm_entry[j].ce_cannulaMFAP);
+			}
+		}
+		if (mu_[i].cm_entry != NULL)
+			ckfree(mu_[i].cm_entry);
+	}
+	if (mu_ != NULL)
+		ckfree(mu_);
+}
+
+const MFAPCacheEntry *
+MFAPCache::find(
+		int muId,
+		int fibreIndex,
+		const MuscleFibre *fibre,
+		const float *geometry
+	)
+{
+	const MFAPCacheEntry *entry;
+	double delta, maxDelta = 0;
+	int i;
+
+	if (muId >= nMUs_ || fibreIndex >= mu_[muId].cm_nEntries)
+		goto MISS;
+
+	entry = &mu_[muId].cm_entry[fibreIndex];
+	if (entry->ce_fibre != fibre || entry->ce_tipMFAP == NULL)
+		goto MISS;
+
+	/** the diameter does not change with the needle */
+	if (entry->ce_geometry[MFAP_GEOMETRY_DIAMETER]
+				!= geometry[MFAP_GEOMETRY_DIAMETER])
+		goto MISS;
+
+	for (i = 0; i < MFAP_GEOMETRY_SIZE; i++)
+	{
+		delta = fabs(entry->ce_geometry[i] - geometry[i]);
+		if (delta > maxDelta)
+			maxDelta = delta;
+	}
+
+	if (maxDelta == 0)
+	{
+		nExactHits_++;
+		return entry;
+	}
+
+	if (maxDelta <= tolerance_
+				* entry->ce_geometry[MFAP_GEOMETRY_RADIAL_SEPARATION])
+	{
+		nToleranceHits_++;
+		return entry;
+	}
+
+MISS:
+	nMisses_++;
+	return NULL;
+}
+
+MFAPCacheEntry *
+MFAPCache::update(
+		int muId,
+		int fibreIndex,
+		const float *geometry
+	)
+{
+	MFAPCacheEntry *entry;
+	int status;
+
+	if (nAllocatedEntries_ >= maxEntries_
+			&& (muId >= nMUs_ || fibreIndex >= mu_[muId].cm_nEntries
+				|| mu_[muId].cm_entry[fibreIndex].ce_tipMFAP == NULL))
+		return NULL;
+
+	status = growArrayReserve(muId + 1,
+				(void **) &mu_,
+				&nMUsAllocated_,
+				sizeof(MFAPCacheMU));
+	MSG_ASSERT(status, "Allocation failed");
+	if (nMUs_ <= muId)
+		nMUs_ = muId + 1;
+
+	status = growArrayReserve(fibreIndex + 1,
+				(void **) &mu_[muId].cm_entry,
+				&mu_[muId].cm_nEntriesAllocated,
+				sizeof(MFAPCacheEntry));
+	MSG_ASSERT(status, "Allocation failed");
+	if (mu_[muId].cm_nEntries <= fibreIndex)
+		mu_[muId].cm_nEntries = fibreIndex + 1;
+
+	entry = &mu_[muId].cm_entry[fibreIndex];
+	if (entry->ce_tipMFAP == NULL)
+	{
+		entry->ce_tipMFAP = (MUPDataElement *)
+				ckalloc(sizeof(MUPDataElement) * MFAPLength_);
+		entry->ce_cannulaMFAP = (MUPDataElement *)
+				ckalloc(sizeof(MUPDataElement) * MFAPLength_);
+		nAllocatedEntries_++;
+	}
+	entry->ce_fibre = NULL;
+	memcpy(entry->ce_geometry, geometry,
+				sizeof(float) * MFAP_GEOMETRY_SIZE);
+
+	return entry;
+}
+
+void
+MFAPCache::logStatistics()
+{
+	LogInfo("MFAP cache: %d unchanged, %d within tolerance, %d calculated\n",
+			nExactHits_, nToleranceHits_, nMisses_);
+	nExactHits_ = nToleranceHits_ = nMisses_ = 0;
+}
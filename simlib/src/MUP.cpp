@@ -29,6 +29,7 @@
 #include "pathtools.h"
 #include "io_utils.h"
 #include "listalloc.h"
+#include "arena.h"
 #include "random.h"
 
 #include "NRinterpolate.h"
@@ -53,6 +54,18 @@
 
 #define         N_INTERPOLATION_CTRL_POINTS     4
 
+/**
+ ** First chunk size of the MUP arena.  The record arena has
+ ** chunks of a fixed number of the separated MFPs (about 240k
+ ** each at the default expansion of 30), so that at most a few
+ ** records' worth is left unused
+ **/
+#define         MUP_ARENA_CHUNK_SIZE            (32 * 1024)
+#define         MUP_RECORDS_PER_CHUNK           4
+
+/** fibre id and number of points before each record */
+#define         MFP_RECORD_HEADER_SIZE          (2 * sizeof(osInt32))
+
 
 struct MUP::JitterValue {
 	long        jitterOffset_;
@@ -68,19 +81,21 @@ struct MUP::JitterValue {
 	 * sampling-rate^ in s, so use DELTA_T_MUP in ms, and multiply
 	 * DELTA_T_MUP by 10^3, so take 10^6 off of the top . . .
 	 */
-	generatedElement MUP::sAccelerationThreshold_ = 10.0; //(1.250);
+	OS_THREAD_LOCAL generatedElement MUP::sAccelerationThreshold_ = 10.0; //(1.250);
 		        // * (DELTA_T_MUP * DELTA_T_MUP);
 
 	/*
 	 * factor by which the jitterable buffers are expanded
 	 */
-int MUP::sExpansionFactor_ = 30;
+OS_THREAD_LOCAL int MUP::sExpansionFactor_ = 30;
 
 MUP::MUP(const char *path, int id)
 {
 	char idBuffer[10], *tmpName;
 
 	memset(this, 0, sizeof(MUP));
+	arenaInit(&arena_, MUP_ARENA_CHUNK_SIZE, 0, 0);
+	arenaInit(&recordArena_, 0, 0, sizeof(osInt32));
 
 	dcoID_ = (-1);
 	id_ = id;
@@ -113,6 +128,8 @@ MUP::MUP(const char *filename)
 	char *delim;
 
 	memset(this, 0, sizeof(MUP));
+	arenaInit(&arena_, MUP_ARENA_CHUNK_SIZE, 0, 0);
+	arenaInit(&recordArena_, 0, 0, sizeof(osInt32));
 
 	filename_ = ckstrdup(filename);
 	delim = (char *) strstr(filename, "MUPData");
@@ -158,8 +175,6 @@ MUP::sSetJitterAccelerationThreshold(generatedElement jitterThreshold)
 void
 MUP::unload(void)
 {
-	int i;
-
 	isLoaded_ = 0;
 
 	if (MUPVector_ != NULL)
@@ -197,22 +212,16 @@ MUP::unload(void)
 	{
 		if (mfapList_ != NULL)
 		{
-			for (i = 0; i < nMFPs_; i++)
-			{
-		        if (mfapList_[i] != NULL)
-					delete mfapList_[i];
-			}
 			ckfree(mfapList_);
 			mfapList_ = NULL;
 		}
 		nMFPs_ = 0;
 	}
+	cannulaMFP_ = NULL;
 
-	if (hasCannulaMFP_ != 0 && cannulaMFP_ != NULL)
-	{
-		delete cannulaMFP_;
-		cannulaMFP_ = NULL;
-	}
+	/** this frees every MFP and all of their data */
+	arenaRelease(&arena_);
+	arenaRelease(&recordArena_);
 
 	if (mfapLoadOffsets_ != NULL)
 	{
@@ -233,14 +242,92 @@ MUP::unload(void)
 }
 
 
-MUP::MFP::MFP()
+/**
+ ** Make an MFP in the arenas.  A record is placed in
+ ** recordArena_ after a copy of its fibre id and length, in
+ ** the order they are written by writeData__(); all others go
+ ** in arena_.  The data is not cleared.
+ **/
+MUP::MFP *
+MUP::newMFP__(
+		int asRecord,
+		osInt32 numPoints,
+		osInt32 expansionFactor,
+		osInt32 fibreIdentifier
+	)
+{
+	MFP *mfap;
+	osInt32 *record;
+	size_t recordSize;
+
+	mfap = (MFP *) arenaAlloc(&arena_, sizeof(MFP));
+	MSG_ASSERT(mfap != NULL, "Allocation failed");
+
+	mfap->numPoints_ = numPoints;
+	mfap->allocatedSize_ = numPoints;
+	mfap->expansionFactor_ = expansionFactor;
+	mfap->fibreIdentifier_ = fibreIdentifier;
+
+	if (asRecord)
+	{
+		recordSize = MFP_RECORD_HEADER_SIZE
+		                + numPoints * sizeof(MUPDataElement);
+		if (recordArena_.ar_nChunks == 0)
+		{
+		    arenaInit(&recordArena_,
+		            MUP_RECORDS_PER_CHUNK * recordSize,
+		            MUP_RECORDS_PER_CHUNK * recordSize,
+		            sizeof(osInt32));
+		}
+		record = (osInt32 *) arenaAlloc(&recordArena_, recordSize);
+		MSG_ASSERT(record != NULL, "Allocation failed");
+		record[0] = fibreIdentifier;
+		record[1] = numPoints;
+		mfap->data_ = (MUPDataElement *) &record[2];
+	} else
+	{
+		mfap->data_ = (MUPDataElement *) arenaAlloc(&arena_,
+		        numPoints * sizeof(MUPDataElement));
+		MSG_ASSERT(mfap->data_ != NULL, "Allocation failed");
+	}
+
+	return mfap;
+}
+
+
+/**
+ * The slope workspace is kept per thread, as for the
+ * convolution buffers in makeMUP.cpp, rather than being
+ * made anew for every separated MFP
+ */
+static OS_THREAD_LOCAL int sSlopeScratchLength = 0;
+static OS_THREAD_LOCAL float *sSlopeScratch = NULL;
+
+void MUP::sReleaseScratch()
 {
-	memset(this, 0, sizeof(MFP));
+	if (sSlopeScratch != NULL)
+	{
+		ckfree(sSlopeScratch);
+		sSlopeScratch = NULL;
+		sSlopeScratchLength = 0;
+	}
 }
 
-MUP::MFP::~MFP()
+static float *sGetSlopeScratch(int nDataPoints)
 {
-	if (data_ != NULL)  ckfree(data_);
+	if (sSlopeScratch == NULL || sSlopeScratchLength < nDataPoints)
+	{
+		MUP::sReleaseScratch();
+
+		sSlopeScratch = (float *) ckalloc(sizeof(float) * nDataPoints);
+		sSlopeScratchLength = nDataPoints;
+
+		MSG_ASSERT(sSlopeScratch != NULL,
+		        "Failed allocating slope buffer");
+	}
+	memset(sSlopeScratch, 0, sizeof(float) * nDataPoints);
+
+	return sSlopeScratch;
 }
 
 
@@ -258,7 +345,7 @@ MUP::calculateMaxSlopeAlignmentPoint__(
 	osInt32 maxSlopeOffset = (-1);
 	int i;
 
-	slopeData = (float *) ckalloc(sizeof(float) * numDataPoints);
+	slopeData = sGetSlopeScratch(numDataPoints);
 
 	(void) calculateSlopeBuffer(
 		        slopeData,
@@ -301,13 +388,10 @@ MUP::calculateMaxSlopeAlignmentPoint__(
 		        g->muscle_dir, id_, nMFPs_);
 */
 
-	ckfree(slopeData);
-
 	return (maxSlopeOffset);
 
 
 FAIL:
-	ckfree(slopeData);
 	return (-1);
 }
 
@@ -323,26 +407,16 @@ MUP::addAsSeparateMFP__(
 	int i, j, k, forceLinear;
 	double lower, higher;
 
-	status = listMkCheckSize(nMFPs_ + 1,
+	status = growArrayReserve(nMFPs_ + 1,
 		        (void **) &mfapList_,
-		        &nMFPBlocks_,
-		        MFP_BLOCKSIZE,
-		        sizeof(MFP *), __FILE__, __LINE__);
+		        &nMFPsAllocated_,
+		        sizeof(MFP *));
 
 	MSG_ASSERT(status, "Allocation failed");
-	mfapList_[nMFPs_] = new MFP();
-
-
-	mfapList_[nMFPs_]->numPoints_ =
-		        sExpansionFactor_ * nInterfaceDataPoints_;
-
-	mfapList_[nMFPs_]->allocatedSize_ = mfapList_[nMFPs_]->numPoints_;
-	mfapList_[nMFPs_]->expansionFactor_ = sExpansionFactor_;
-	mfapList_[nMFPs_]->fibreIdentifier_ = fibreIdentifier;
-
-	mfapList_[nMFPs_]->data_ = (MUPDataElement *)
-		        ckalloc(mfapList_[nMFPs_]->allocatedSize_
-		            * sizeof(MUPDataElement));
+	mfapList_[nMFPs_] = newMFP__(1,
+		        sExpansionFactor_ * nInterfaceDataPoints_,
+		        sExpansionFactor_,
+		        fibreIdentifier);
 
 	memset(mfapList_[nMFPs_]->data_, 0,
 		        mfapList_[nMFPs_]->allocatedSize_
@@ -447,15 +521,8 @@ MUP::addAsMergedMFP__(generatedElement *data)
 	/** if the storage isn't here, yet, make it appear */
 	if (mfapList_[0] == NULL)
 	{
-		mfapList_[0] = new MFP();
-
 		// note that this buffer is of low-sampling rate size
-		mfapList_[0]->expansionFactor_ = 1;
-		mfapList_[0]->numPoints_ = nInterfaceDataPoints_;
-		mfapList_[0]->allocatedSize_ = mfapList_[0]->numPoints_;
-		mfapList_[0]->data_ = (MUPDataElement *)
-		        ckalloc(mfapList_[0]->allocatedSize_
-		                * sizeof(MUPDataElement));
+		mfapList_[0] = newMFP__(0, nInterfaceDataPoints_, 1, 0);
 		// zero the vector so that we can accumulate data into
 		// it below
 		memset(mfapList_[0]->data_, 0,
@@ -479,7 +546,7 @@ MUP::addAsMergedMFP__(generatedElement *data)
 #   endif
 }
 
-void
+int
 MUP::addMFP(
 		int MUPIndex,
 		int nElements,
@@ -492,17 +559,16 @@ MUP::addMFP(
 	osInt32 slopeAlignmentIndex;
 
 	if (MUPIndex != 0)
-		return;
+		return 0;
 
 	// ensure that the list of MFP's is initialized, so that
 	// we always have room for the 0 element
 	if (nMFPs_ == 0)
 	{
-		status = listMkCheckSize(MFP_BLOCKSIZE * 2,
+		status = growArrayReserve(2,
 		        (void **) &mfapList_,
-		        &nMFPBlocks_,
-		        MFP_BLOCKSIZE,
-		        sizeof(MFP *), __FILE__, __LINE__);
+		        &nMFPsAllocated_,
+		        sizeof(MFP *));
 		MSG_ASSERT(status, "Allocation failed");
 		mfapList_[0] = NULL;
 		nMFPs_ = 1;
@@ -550,10 +616,11 @@ MUP::addMFP(
 		    alignmentMFP_ = (nMFPs_ - 1);
 		    expandedUnitsAlignmentOffset_ = slopeAlignmentIndex;
 		}
-	} else
-	{
-		addAsMergedMFP__(data);
+		return 1;
 	}
+
+	addAsMergedMFP__(data);
+	return 0;
 }
 
 
@@ -568,18 +635,9 @@ MUP::addCannulaMFP(
 
 	if (cannulaMFP_ == NULL)
 	{
-		cannulaMFP_ = new MFP();
+		cannulaMFP_ = newMFP__(0, nElements, 1, (-1));
 		hasCannulaMFP_ = 1;
 
-		cannulaMFP_->numPoints_ =
-		        cannulaMFP_->allocatedSize_ = nElements;
-		cannulaMFP_->expansionFactor_ = 1;
-		cannulaMFP_->fibreIdentifier_ = (-1);
-
-		cannulaMFP_->data_ = (MUPDataElement *)
-		        ckalloc(cannulaMFP_->allocatedSize_
-		            * sizeof(MUPDataElement));
-
 		memset(cannulaMFP_->data_, 0,
 		        cannulaMFP_->allocatedSize_ * sizeof(MUPDataElement));
 	}
@@ -1286,8 +1344,59 @@ MUP::writeData__(FP *fp, int index, MFP *curMFP, off_t *offset) const
 }
 
 
+#ifndef OS_BIG_ENDIAN
+static int
+sWriteRecordChunk(const void *data, size_t nBytes, void *userData)
+{
+	return wGeneric((FP *) userData, (void *) data, (int) nBytes);
+}
+#endif
+
+/**
+ ** Write the separated MFPs 1 .. nMFPs_-1.  As they were made
+ ** in order in recordArena_ with their headers, each chunk of
+ ** the arena is written with a single call.  Records that were
+ ** not made that way, and all records on a big-endian machine
+ ** (where the headers must be swapped as they are written) are
+ ** written one at a time.
+ **/
+int
+MUP::writeRecords__(FP *fp, off_t *mfapOffsetTable) const
+{
+	int status = 1;
+	int i;
+#ifndef OS_BIG_ENDIAN
+	size_t nBytes = 0;
+	off_t offset;
+
+	for (i = 1; i < nMFPs_ && mfapList_[i] != NULL; i++)
+	{
+		nBytes += MFP_RECORD_HEADER_SIZE
+		        + mfapList_[i]->numPoints_ * sizeof(MUPDataElement);
+	}
+
+	if (i == nMFPs_ && nBytes == recordArena_.ar_nBytesUsed)
+	{
+		offset = ftell(fp->fp);
+		for (i = 1; i < nMFPs_; i++)
+		{
+		    mfapOffsetTable[i] = offset;
+		    offset += MFP_RECORD_HEADER_SIZE
+		            + mfapList_[i]->numPoints_ * sizeof(MUPDataElement);
+		}
+		return arenaForEachChunk(&recordArena_, sWriteRecordChunk, fp);
+	}
+#endif
+
+	for (i = 1; i < nMFPs_; i++)
+	{
+		status &= writeData__(fp, i, mfapList_[i], &mfapOffsetTable[i]);
+	}
+	return status;
+}
+
 int
-MUP::readData__(FP *fp, MFP **curMFP, off_t offset)
+MUP::readData__(FP *fp, MFP **curMFP, off_t offset, int asRecord)
 {
 	osInt32 numPoints;
 	osInt32 fibreIdentifier;
@@ -1304,13 +1413,8 @@ MUP::readData__(FP *fp, MFP **curMFP, off_t offset)
 		    (*curMFP) = NULL;
 		} else
 		{
-		    (*curMFP) = new MFP();
-		    (*curMFP)->fibreIdentifier_ = fibreIdentifier;
-		    (*curMFP)->numPoints_ = numPoints;
-		    (*curMFP)->allocatedSize_ = numPoints;
-		    (*curMFP)->data_ = (MUPDataElement *)
-		            ckalloc((*curMFP)->allocatedSize_
-		                    * sizeof(MUPDataElement));
+		    (*curMFP) = newMFP__(asRecord,
+		            numPoints, 1, fibreIdentifier);
 
 		    status &= rGeneric(fp, (*curMFP)->data_,
 		            numPoints * sizeof(MUPDataElement));
@@ -1333,7 +1437,6 @@ MUP::save() const
 	off_t *mfapOffsets = NULL;
 	FP *fp;
 	int status = 1;
-	int i;
 	off_t headerSize;
 
 	fp = openFP(filename_, "wb");
@@ -1346,10 +1449,8 @@ MUP::save() const
 		mfapOffsets = (off_t *) ckalloc(sizeof(off_t) * (nMFPs_ + 1));
 
 		fseek(fp->fp, headerSize, SEEK_SET);
-		for (i = 0; i < nMFPs_; i++)
-		{
-		    status &= writeData__(fp, i, mfapList_[i], &mfapOffsets[i]);
-		}
+		status &= writeData__(fp, 0, mfapList_[0], &mfapOffsets[0]);
+		status &= writeRecords__(fp, mfapOffsets);
 
 		if (hasCannulaMFP_)
 		{
@@ -1405,13 +1506,13 @@ MUP::loadMFPs__()
 		for (i = 0; i < nMFPs_; i++)
 		{
 		    status &= readData__(mfapLoadFP_,
-							&mfapList_[i], mfapLoadOffsets_[i]);
+							&mfapList_[i], mfapLoadOffsets_[i], i > 0);
 		}
 	}
 
 	if (hasCannulaMFP_)
 		status &= readData__(mfapLoadFP_,
-						&cannulaMFP_, mfapLoadOffsets_[nMFPs_]);
+						&cannulaMFP_, mfapLoadOffsets_[nMFPs_], 0);
 
 
 	closeFP(mfapLoadFP_);
@@ -20,12 +20,15 @@
 #include "msgir.h"
 
 #include "rTreeIndex.h"
+#include "FibreLatticeIndex.h"
 
 #define PRIVATE public
 
 #include "MuscleData.h"
+#include "MuscleSnapshot.h"
 #include "NeedleInfo.h"
 #include "3Circle.h"
+#include "MFAPCache.h"
 
 
 #ifdef OS_WINDOWS
@@ -63,21 +66,24 @@ MuscleData::MuscleData()
 	minMotorUnitDiameter_ = 0;
 
 	motorUnitInDetect_ = NULL;
-	motorUnitInDetectBlocks_ = 0;
+	motorUnitInDetectAllocated_ = 0;
 
 	activeMotorUnit_ = NULL;
 	nActiveMotorUnits_ = 0;
-	nActiveMotorUnitBlocks_ = 0 ;
+	nActiveMotorUnitsAllocated_ = 0 ;
 
 	activeInDetectMotorUnit_ = NULL;
 	nActiveInDetectMotorUnits_ = 0;
-	nActiveInDetectMotorUnitBlocks_ = 0;
+	nActiveInDetectMotorUnitsAllocated_ = 0;
 
 	needle_ = NULL;
 	fibreRTreeRoot_ = NULL;
+	fibreLattice_ = NULL;
+	MFAPCache_ = NULL;
+	differsFromSnapshot_ = 0;
 
 	nTotalFibres_ = 0;
-	nFibreBlocks_ = 0;
+	nFibresAllocated_ = 0;
 	masterFibreList_ = NULL;
 	nMaxFibres_ = 0;
 }
@@ -117,6 +123,11 @@ MuscleData::~MuscleData()
 	if (fibreRTreeRoot_ != NULL)
 		RTreeDeleteIndex(fibreRTreeRoot_);
 
+	if (fibreLattice_ != NULL)
+		delete fibreLattice_;
+	if (MFAPCache_ != NULL)
+		delete MFAPCache_;
+
 	if (masterFibreList_ != NULL)
 		ckfree(masterFibreList_);
 
@@ -693,6 +704,20 @@ int MuscleData::loadMUdata(const char *filename)
 }
 
 
+/**
+ ** Load MU.dat and then the given MF file
+ **/
+int MuscleData::loadTextLayout(
+		const char *MFfilename,
+		const char *MUfilename
+	)
+{
+	if ( ! loadMUdata(MUfilename) )
+		return 0;
+
+	return loadMFdata(MFfilename);
+}
+
 int MuscleData::loadData(
 		const char *muscleDir,
 		const char *outputDir,
@@ -701,11 +726,15 @@ int MuscleData::loadData(
 	)
 {
 	char *MFfilename, *MUfilename, *AMUfilename;
+	char *snapshotFilename;
+	char *deltaFilename = NULL;
+	char *unplowedFilename = NULL;
 	struct stat sb;
 	int status;
 
 	/**
-	 * Get the fibre and muscle layout data
+	 * Get the fibre and muscle layout data, preferring
+	 * the binary snapshot if one was written
 	 */
 	if (usePlowedFibres && outputDir != NULL)
 	{
@@ -717,33 +746,78 @@ int MuscleData::loadData(
 				OS_PATH_DELIM_STRING,
 				"MF-plowed",
 				idBuffer, ".dat", NULL);
+		snapshotFilename = strconcat(outputDir,
+				OS_PATH_DELIM_STRING,
+				"MF-plowed",
+				idBuffer, ".msnap", NULL);
+
+		/** or as a delta against the unplowed snapshot */
+		deltaFilename = strconcat(outputDir,
+				OS_PATH_DELIM_STRING,
+				"MF-plowed",
+				idBuffer, ".mdelta", NULL);
+		unplowedFilename = strconcat(muscleDir,
+				OS_PATH_DELIM_STRING,
+				MUSCLE_SNAPSHOT_UNPLOWED, NULL);
 	} else
 	{
 		/** unplowed data is in the muscle dir */
 		MFfilename = strconcat(muscleDir,
 				OS_PATH_DELIM_STRING,
 				"MF-unplowed.dat", NULL);
+		snapshotFilename = strconcat(muscleDir,
+				OS_PATH_DELIM_STRING,
+				MUSCLE_SNAPSHOT_UNPLOWED, NULL);
 	}
-	/** if not found, old data was in the muscle dir too */
-	if ( irStat(MFfilename, &sb) < 0 && errno == ENOENT)
+
+	status = 0;
+	if ( deltaFilename != NULL && irStat(deltaFilename, &sb) >= 0 )
 	{
-		ckfree(MFfilename);
-		MFfilename = strconcat(muscleDir,
-					OS_PATH_DELIM_STRING,
-					"MF.dat", NULL);
+		status = loadPlowDelta(unplowedFilename, deltaFilename);
+		if ( ! status )
+		{
+			LogWarn("Plow delta '%s' unusable -- trying full layout\n",
+					deltaFilename);
+		}
+	}
+	if (deltaFilename != NULL)
+	{
+		ckfree(deltaFilename);
+		ckfree(unplowedFilename);
+	}
+
+	if ( ! status && irStat(snapshotFilename, &sb) >= 0 )
+	{
+		status = loadSnapshot(snapshotFilename);
+		if ( ! status )
+		{
+			LogWarn("Snapshot '%s' unusable -- reading text files\n",
+					snapshotFilename);
+		}
 	}
+	ckfree(snapshotFilename);
 
+	if ( ! status )
+	{
+		/** if not found, old data was in the muscle dir too */
+		if ( irStat(MFfilename, &sb) < 0 && errno == ENOENT)
+		{
+			ckfree(MFfilename);
+			MFfilename = strconcat(muscleDir,
+						OS_PATH_DELIM_STRING,
+						"MF.dat", NULL);
+		}
 
-	MUfilename = strconcat(muscleDir,
-				OS_PATH_DELIM_STRING,
-				"MU.dat", NULL);
 
-	status = loadMUdata(MUfilename);
-	if (status)
-		status = loadMFdata(MFfilename);
+		MUfilename = strconcat(muscleDir,
+					OS_PATH_DELIM_STRING,
+					"MU.dat", NULL);
+
+		status = loadTextLayout(MFfilename, MUfilename);
 
+		ckfree(MUfilename);
+	}
 	ckfree(MFfilename);
-	ckfree(MUfilename);
 
 
 	/*
@@ -1361,11 +1435,10 @@ MuscleData::addFibre(MuscleFibre *newFibre)
 {
 	int status;
 
-	status = listMkCheckSize(nTotalFibres_ + 1,
+	status = growArrayReserve(nTotalFibres_ + 1,
 				(void **) &masterFibreList_,
-				&nFibreBlocks_,
-				8,
-				sizeof(MuscleFibre *), __FILE__, __LINE__);
+				&nFibresAllocated_,
+				sizeof(MuscleFibre *));
 	MSG_ASSERT(status, "Allocation failed");
 	masterFibreList_[nTotalFibres_++] = newFibre;
 
@@ -1401,12 +1474,15 @@ MotorUnit::MotorUnit()
 	mu_diameter_mm_ = 0;
 	mu_nFibres_ = 0;
 	mu_nHealthyFibres_ = (-1);
-	mu_nFibreAllocationBlocks_ = 0;
+	mu_nFibresAllocated_ = 0;
 	mu_fibre_ = NULL;
 	mu_firingTime_ = NULL;
 	mu_nFirings_ = 0;
-	mu_nFiringBlocks_ = 0;
+	mu_nFiringsAllocated_ = 0;
 	mu_expectedNumFibres_ = 0;
+
+	/** no MUP has been made for a new MU */
+	mu_isDirty_ = 1;
 }
 
 MotorUnit::~MotorUnit()
@@ -1493,15 +1569,15 @@ MotorUnit::addFibre(MuscleFibre *newFibre)
 {
 	int status;
 
-	status = listMkCheckSize(mu_nFibres_ + 1,
+	status = growArrayReserve(mu_nFibres_ + 1,
 				(void **) &mu_fibre_,
-				&mu_nFibreAllocationBlocks_,
-				8,
-				sizeof(MuscleFibre *), __FILE__, __LINE__);
+				&mu_nFibresAllocated_,
+				sizeof(MuscleFibre *));
 	MSG_ASSERT(status, "Allocation failed");
 	mu_fibre_[mu_nFibres_] = newFibre;
 	mu_fibre_[mu_nFibres_]->mf_motorUnit_ = mu_id_;
 	mu_nFibres_++;
+	mu_isDirty_ = 1;
 
 	return 1;
 }
@@ -1520,6 +1596,7 @@ MotorUnit::removeFibre(MuscleFibre *oldFibre)
 				mu_fibre_[j - 1] = mu_fibre_[j];
 			}
 			mu_nFibres_--;
+			mu_isDirty_ = 1;
 			return 1;
 		}
 	}
@@ -1536,6 +1613,7 @@ MotorUnit::removeFibre(int index)
 		mu_fibre_[j - 1] = mu_fibre_[j];
 	}
 	mu_nFibres_--;
+	mu_isDirty_ = 1;
 	return 1;
 }
 
@@ -0,0 +1,1090 @@
+/**
+ ** Binary snapshot read/write for the muscle layout
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <errno.h>
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# ifndef OS_WINDOWS_NT
+#  include <unistd.h>
+#  include <sys/mman.h>
+# endif
+#endif
+
+#include "tclCkalloc.h"
+#include "stringtools.h"
+#include "pathtools.h"
+#include "listalloc.h"
+#include "msgir.h"
+#include "massert.h"
+#include "bitstring.h"
+#include "log.h"
+
+#define PRIVATE public
+#include "MuscleData.h"
+#include "MuscleSnapshot.h"
+
+
+#ifdef OS_WINDOWS
+		/*
+		 * disable _CRT_SECURE_NO_WARNINGS related flags for now,
+		 * as they completely break the POSIX interface, as we
+		 * will have to re-write wrappers for things like fopen
+		 * to make this work more gracefully
+		 */
+# pragma warning(disable : 4996)
+#endif
+
+
+/**
+ ** A snapshot file brought into memory, either mapped
+ ** or (where mapping is not possible) read into a buffer
+ **/
+typedef struct SnapshotImage {
+	char *base;
+	osUint32 length;
+	int isMapped;
+} SnapshotImage;
+
+/**
+ ** Used to find the master list position of each MU's fibres
+ **/
+typedef struct FibreSlot {
+	const MuscleFibre *fibre;
+	int masterIndex;
+} FibreSlot;
+
+
+#if defined(OS_BIG_ENDIAN)
+/**
+ ** Everything past the magic is a 32-bit word, so converting
+ ** to or from the file byte order is a single pass
+ **/
+static void
+sSwapSnapshotWords(char *base, osUint32 length)
+{
+	osUint32 *word;
+	osUint32 i, nWords;
+
+	word = (osUint32 *) (base + MUSCLE_SNAPSHOT_MAGIC_LEN);
+	nWords = (length - MUSCLE_SNAPSHOT_MAGIC_LEN) / sizeof(osUint32);
+	for (i = 0; i < nWords; i++)
+	{
+		word[i] = ((word[i] & 0x000000ffU) << 24)
+				| ((word[i] & 0x0000ff00U) << 8)
+				| ((word[i] & 0x00ff0000U) >> 8)
+				| ((word[i] & 0xff000000U) >> 24);
+	}
+}
+#endif
+
+static int
+sCompareFibreSlots(const void *v1, const void *v2)
+{
+	const FibreSlot *s1 = (const FibreSlot *) v1;
+	const FibreSlot *s2 = (const FibreSlot *) v2;
+
+	if (s1->fibre < s2->fibre)
+		return (-1);
+	if (s1->fibre > s2->fibre)
+		return 1;
+	return 0;
+}
+
+static int
+sFindFibreSlot(const FibreSlot *slot, int nSlots, const MuscleFibre *fibre)
+{
+	int low = 0, high = nSlots - 1, mid;
+
+	while (low <= high)
+	{
+		mid = (low + high) / 2;
+		if (slot[mid].fibre == fibre)
+			return slot[mid].masterIndex;
+		if (slot[mid].fibre < fibre)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return (-1);
+}
+
+/**
+ ** Locate each MU fibre in the master list, and number those
+ ** fibres in master list order, as they are stored in the
+ ** snapshot; fibres owned by no MU are given (-1).  On success
+ ** the caller owns the slot and index arrays (either may be
+ ** NULL if the muscle has no fibres).
+ **/
+static int
+sBuildSnapshotIndex(
+		const MuscleData *MD,
+		FibreSlot **slotPtr,
+		int *nSlotsPtr,
+		int **compactIndexPtr,
+		int *nFibresPtr,
+		int *nRecordsPtr
+	)
+{
+	FibreSlot *slot = NULL;
+	int *compactIndex = NULL;
+	MotorUnit *mu;
+	int nSlots = 0, nFibres = 0, nRecords = 0;
+	int masterIndex;
+	int i, j;
+
+	if (MD->nTotalFibres_ > 0)
+	{
+		slot = (FibreSlot *) ckalloc(sizeof(FibreSlot) * MD->nTotalFibres_);
+		compactIndex = (int *) ckalloc(sizeof(int) * MD->nTotalFibres_);
+	}
+	for (i = 0; i < MD->nTotalFibres_; i++)
+	{
+		compactIndex[i] = (-1);
+		if (MD->masterFibreList_[i] != NULL)
+		{
+			slot[nSlots].fibre = MD->masterFibreList_[i];
+			slot[nSlots].masterIndex = i;
+			nSlots++;
+		}
+	}
+	qsort(slot, nSlots, sizeof(FibreSlot), sCompareFibreSlots);
+
+	for (i = 0; i < MD->nMotorUnitsInMuscle_; i++)
+	{
+		mu = MD->motorUnit_[i];
+		if (mu == NULL || mu->mu_nFibres_ <= 0)
+			continue;
+
+		nRecords++;
+		for (j = 0; j < mu->mu_nFibres_; j++)
+		{
+			masterIndex = sFindFibreSlot(slot, nSlots, mu->mu_fibre_[j]);
+			if (masterIndex < 0 || compactIndex[masterIndex] != (-1))
+			{
+				LogError("Fibre %d of MU %d is %s the master list\n",
+						j, mu->mu_id_,
+						masterIndex < 0 ? "not in" : "repeated in");
+				if (slot != NULL)
+					ckfree(slot);
+				if (compactIndex != NULL)
+					ckfree(compactIndex);
+				return 0;
+			}
+			compactIndex[masterIndex] = (-2);
+		}
+	}
+
+	for (i = 0; i < MD->nTotalFibres_; i++)
+	{
+		if (compactIndex[i] == (-2))
+			compactIndex[i] = nFibres++;
+	}
+
+	*slotPtr = slot;
+	*nSlotsPtr = nSlots;
+	*compactIndexPtr = compactIndex;
+	*nFibresPtr = nFibres;
+	*nRecordsPtr = nRecords;
+	return 1;
+}
+
+/**
+ ** Check that a section of nItems tiles lies within the file
+ **/
+static int
+sSectionFits(
+		const SnapshotImage *image,
+		osUint32 offset,
+		osInt32 nItems,
+		osUint32 tileSize
+	)
+{
+	if (nItems < 0 || (offset % sizeof(osUint32)) != 0)
+		return 0;
+
+	if (offset > image->length)
+		return 0;
+
+	return ((image->length - offset) / tileSize) >= (osUint32) nItems;
+}
+
+
+static int
+sOpenSnapshotImage(
+		const char *filename,
+		SnapshotImage *image,
+		osUint32 headerSize
+	)
+{
+	char *localName;
+	int fileLength;
+	int nRead, totalRead;
+	int fd;
+
+	image->base = NULL;
+	image->length = 0;
+	image->isMapped = 0;
+
+	localName = osIndependentPath(filename);
+	fd = irOpen(localName, O_RDONLY | O_BINARY, 0);
+	ckfree(localName);
+	if (fd < 0)
+	{
+		LogError("Cannot open muscle snapshot '%s' : %s\n",
+				filename, strerror(errno));
+		return 0;
+	}
+
+	fileLength = getFDFileLength(fd);
+	if (fileLength < (int) headerSize)
+	{
+		LogError("Muscle snapshot '%s' is truncated\n", filename);
+		irClose(fd);
+		return 0;
+	}
+	image->length = (osUint32) fileLength;
+
+#if !defined(OS_WINDOWS_NT) && !defined(OS_BIG_ENDIAN)
+	{
+		void *mapping;
+
+		mapping = mmap(NULL, image->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED)
+		{
+			image->base = (char *) mapping;
+			image->isMapped = 1;
+			irClose(fd);
+			return 1;
+		}
+	}
+#endif
+
+	/** no mapping available, so read the whole image in */
+	image->base = (char *) ckalloc(image->length);
+	totalRead = 0;
+	while (totalRead < fileLength)
+	{
+		nRead = irRead(fd, image->base + totalRead, fileLength - totalRead);
+		if (nRead <= 0)
+		{
+			LogError("Failure reading muscle snapshot '%s' : %s\n",
+					filename, strerror(errno));
+			ckfree(image->base);
+			image->base = NULL;
+			irClose(fd);
+			return 0;
+		}
+		totalRead += nRead;
+	}
+	irClose(fd);
+
+#if defined(OS_BIG_ENDIAN)
+	sSwapSnapshotWords(image->base, image->length);
+#endif
+
+	return 1;
+}
+
+static void
+sCloseSnapshotImage(SnapshotImage *image)
+{
+	if (image->base == NULL)
+		return;
+
+#if !defined(OS_WINDOWS_NT) && !defined(OS_BIG_ENDIAN)
+	if (image->isMapped)
+	{
+		munmap(image->base, image->length);
+		image->base = NULL;
+		return;
+	}
+#endif
+
+	ckfree(image->base);
+	image->base = NULL;
+}
+
+
+/**
+ ** Check the header, the section bounds and every id and index
+ ** in the image, so that construction cannot fail part way
+ **/
+static int
+sValidateSnapshot(const char *filename, const SnapshotImage *image)
+{
+	const MuscleSnapshotHeader *header;
+	const MuscleSnapshotMotorUnit *muTable;
+	const osInt32 *inDetect, *fibreIndex, *fibreMU;
+	BITSTRING isInDetect = NULL, isReferenced = NULL;
+	osInt32 i, j, index;
+	osInt32 nIndices = 0;
+
+	header = (const MuscleSnapshotHeader *) image->base;
+
+	if (memcmp(header->ms_magic, MUSCLE_SNAPSHOT_MAGIC,
+				MUSCLE_SNAPSHOT_MAGIC_LEN) != 0)
+	{
+		LogError("'%s' is not a muscle snapshot\n", filename);
+		return 0;
+	}
+
+	if (header->ms_version != MUSCLE_SNAPSHOT_VERSION
+			|| header->ms_headerSize < sizeof(MuscleSnapshotHeader))
+	{
+		LogError("Muscle snapshot '%s' has unsupported version %u\n",
+				filename, header->ms_version);
+		return 0;
+	}
+
+	if (header->ms_fileSize != image->length)
+	{
+		LogError("Muscle snapshot '%s' is %u bytes, expected %u\n",
+				filename, image->length, header->ms_fileSize);
+		return 0;
+	}
+
+	if (header->ms_nMotorUnitsInMuscle < 0
+			|| header->ms_nMotorUnitsInDetectionArea
+					> header->ms_nMotorUnitsInMuscle
+			|| header->ms_nMotorUnitRecords
+					> header->ms_nMotorUnitsInMuscle
+			|| ! sSectionFits(image, header->ms_inDetectOffset,
+					header->ms_nMotorUnitsInDetectionArea, sizeof(osInt32))
+			|| ! sSectionFits(image, header->ms_motorUnitOffset,
+					header->ms_nMotorUnitRecords,
+					sizeof(MuscleSnapshotMotorUnit))
+			|| ! sSectionFits(image, header->ms_fibreIndexOffset,
+					header->ms_nFibres, sizeof(osInt32))
+			|| ! sSectionFits(image, header->ms_fibreXOffset,
+					header->ms_nFibres, sizeof(float))
+			|| ! sSectionFits(image, header->ms_fibreYOffset,
+					header->ms_nFibres, sizeof(float))
+			|| ! sSectionFits(image, header->ms_fibreDiameterOffset,
+					header->ms_nFibres, sizeof(float))
+			|| ! sSectionFits(image, header->ms_fibreHealthyDiameterOffset,
+					header->ms_nFibres, sizeof(float))
+			|| ! sSectionFits(image, header->ms_fibreJShiftOffset,
+					header->ms_nFibres, sizeof(float))
+			|| ! sSectionFits(image, header->ms_fibreMotorUnitOffset,
+					header->ms_nFibres, sizeof(osInt32)))
+	{
+		LogError("Muscle snapshot '%s' has a corrupt header\n", filename);
+		return 0;
+	}
+
+	/** each MU in the detection area must be listed only once */
+	inDetect = (const osInt32 *) (image->base + header->ms_inDetectOffset);
+	isInDetect = ALLOC_BITSTRING(header->ms_nMotorUnitsInMuscle + 1);
+	ZERO_BITSTRING(isInDetect, header->ms_nMotorUnitsInMuscle + 1);
+	for (i = 0; i < header->ms_nMotorUnitsInDetectionArea; i++)
+	{
+		if (inDetect[i] < 1 || inDetect[i] > header->ms_nMotorUnitsInMuscle
+				|| GET_BIT(isInDetect, inDetect[i]))
+		{
+			LogError("Muscle snapshot '%s' : bad MU id %d in detect list\n",
+					filename, inDetect[i]);
+			goto FAIL;
+		}
+		SET_BIT(isInDetect, inDetect[i], 1);
+	}
+
+	/**
+	 * Each fibre must be referenced by exactly one MU, and that
+	 * MU must be the one recorded as owning it
+	 */
+	muTable = (const MuscleSnapshotMotorUnit *)
+			(image->base + header->ms_motorUnitOffset);
+	fibreIndex = (const osInt32 *) (image->base + header->ms_fibreIndexOffset);
+	fibreMU = (const osInt32 *) (image->base + header->ms_fibreMotorUnitOffset);
+	isReferenced = ALLOC_BITSTRING(header->ms_nFibres + 1);
+	ZERO_BITSTRING(isReferenced, header->ms_nFibres + 1);
+	for (i = 0; i < header->ms_nMotorUnitRecords; i++)
+	{
+		if (muTable[i].ms_id < 1
+				|| muTable[i].ms_id > header->ms_nMotorUnitsInMuscle
+				|| muTable[i].ms_nFibres < 0
+				|| muTable[i].ms_firstFibreIndex != nIndices
+				|| muTable[i].ms_nFibres > header->ms_nFibres - nIndices)
+		{
+			LogError("Muscle snapshot '%s' : bad MU record %d\n",
+					filename, i);
+			goto FAIL;
+		}
+
+		for (j = 0; j < muTable[i].ms_nFibres; j++)
+		{
+			index = fibreIndex[nIndices + j];
+			if (index < 0 || index >= header->ms_nFibres
+					|| GET_BIT(isReferenced, index)
+					|| fibreMU[index] != muTable[i].ms_id)
+			{
+				LogError("Muscle snapshot '%s' : bad fibre %d in MU %d\n",
+						filename, index, muTable[i].ms_id);
+				goto FAIL;
+			}
+			SET_BIT(isReferenced, index, 1);
+		}
+		nIndices += muTable[i].ms_nFibres;
+	}
+
+	if (nIndices != header->ms_nFibres)
+	{
+		LogError("Muscle snapshot '%s' : %d of %d fibres owned by MUs\n",
+				filename, nIndices, header->ms_nFibres);
+		goto FAIL;
+	}
+
+	FREE_BITSTRING(isInDetect);
+	FREE_BITSTRING(isReferenced);
+	return 1;
+
+FAIL:
+	if (isInDetect != NULL)
+		FREE_BITSTRING(isInDetect);
+	if (isReferenced != NULL)
+		FREE_BITSTRING(isReferenced);
+	return 0;
+}
+
+
+/**
+ ** Write an image built in memory to disk, converting it to the
+ ** file byte order on the way (which destroys the image)
+ **/
+static int
+sWriteImage(const char *filename, char *image, osUint32 length)
+{
+	FILE *ofp;
+
+#if defined(OS_BIG_ENDIAN)
+	sSwapSnapshotWords(image, length);
+#endif
+
+	ofp = fopenpath(filename, "wb");
+	if (ofp == NULL)
+	{
+		LogError("Error in opening file %s", filename);
+		return 0;
+	}
+
+	if (fwrite(image, 1, length, ofp) != length)
+	{
+		LogError("Failure writing muscle snapshot '%s' : %s\n",
+				filename, strerror(errno));
+		fclose(ofp);
+		return 0;
+	}
+
+	if (fclose(ofp) != 0)
+	{
+		LogError("Failure closing muscle snapshot '%s' : %s\n",
+				filename, strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+
+int
+MuscleData::writeSnapshot(const char *filename) const
+{
+	MuscleSnapshotHeader *header;
+	MuscleSnapshotMotorUnit *muTable;
+	osInt32 *inDetect, *fibreIndex, *fibreMU;
+	float *fibreX, *fibreY, *fibreDiameter;
+	float *fibreHealthyDiameter, *fibreJShift;
+	FibreSlot *slot = NULL;
+	int *compactIndex = NULL;
+	char *image = NULL;
+	osUint32 offset;
+	MuscleFibre *fibre;
+	MotorUnit *mu;
+	int nSlots = 0, nFibres = 0, nRecords = 0, nIndices = 0;
+	int masterIndex;
+	int i, j;
+
+
+	LogInfo("Writing muscle snapshot to file:\n");
+	LogInfo("    '%s'\n", filename);
+
+	if ( ! sBuildSnapshotIndex(this, &slot, &nSlots,
+				&compactIndex, &nFibres, &nRecords) )
+		goto FAIL;
+
+	/** lay out the sections and build the image */
+	offset = sizeof(MuscleSnapshotHeader);
+	image = (char *) ckalloc(offset
+				+ sizeof(osInt32) * nMotorUnitsInDetectionArea_
+				+ sizeof(MuscleSnapshotMotorUnit) * nRecords
+				+ (sizeof(osInt32) * 2 + sizeof(float) * 5) * nFibres);
+	memset(image, 0, sizeof(MuscleSnapshotHeader));
+
+	header = (MuscleSnapshotHeader *) image;
+	memcpy(header->ms_magic, MUSCLE_SNAPSHOT_MAGIC, MUSCLE_SNAPSHOT_MAGIC_LEN);
+	header->ms_version = MUSCLE_SNAPSHOT_VERSION;
+	header->ms_headerSize = sizeof(MuscleSnapshotHeader);
+	header->ms_xDetect = xDetect_;
+	header->ms_yDetect = yDetect_;
+	header->ms_nMotorUnitsInMuscle = nMotorUnitsInMuscle_;
+	header->ms_muscleDiameter = muscleDiameter_;
+	header->ms_minMotorUnitDiameter = minMotorUnitDiameter_;
+	header->ms_maxMotorUnitDiameter = maxMotorUnitDiameter_;
+	header->ms_nMotorUnitsInDetectionArea = nMotorUnitsInDetectionArea_;
+	header->ms_nMaxFibres = nMaxFibres_;
+	header->ms_nFibres = nFibres;
+	header->ms_nMotorUnitRecords = nRecords;
+
+	header->ms_inDetectOffset = offset;
+	offset += sizeof(osInt32) * nMotorUnitsInDetectionArea_;
+	header->ms_motorUnitOffset = offset;
+	offset += sizeof(MuscleSnapshotMotorUnit) * nRecords;
+	header->ms_fibreIndexOffset = offset;
+	offset += sizeof(osInt32) * nFibres;
+	header->ms_fibreXOffset = offset;
+	offset += sizeof(float) * nFibres;
+	header->ms_fibreYOffset = offset;
+	offset += sizeof(float) * nFibres;
+	header->ms_fibreDiameterOffset = offset;
+	offset += sizeof(float) * nFibres;
+	header->ms_fibreHealthyDiameterOffset = offset;
+	offset += sizeof(float) * nFibres;
+	header->ms_fibreJShiftOffset = offset;
+	offset += sizeof(float) * nFibres;
+	header->ms_fibreMotorUnitOffset = offset;
+	offset += sizeof(osInt32) * nFibres;
+	header->ms_fileSize = offset;
+
+	inDetect = (osInt32 *) (image + header->ms_inDetectOffset);
+	for (i = 0; i < nMotorUnitsInDetectionArea_; i++)
+		inDetect[i] = motorUnitInDetect_[i]->mu_id_;
+
+	muTable = (MuscleSnapshotMotorUnit *) (image + header->ms_motorUnitOffset);
+	fibreIndex = (osInt32 *) (image + header->ms_fibreIndexOffset);
+	for (i = 0; i < nMotorUnitsInMuscle_; i++)
+	{
+		mu = motorUnit_[i];
+		if (mu == NULL || mu->mu_nFibres_ <= 0)
+			continue;
+
+		muTable->ms_id = mu->mu_id_;
+		muTable->ms_nFibres = mu->mu_nFibres_;
+		muTable->ms_nHealthyFibres = mu->mu_nHealthyFibres_;
+		muTable->ms_firstFibreIndex = nIndices;
+		muTable->ms_locationRadius = mu->mu_loc_r_mm_;
+		muTable->ms_locationTheta = mu->mu_loc_theta_;
+		muTable->ms_diameter = mu->mu_diameter_mm_;
+		muTable++;
+
+		for (j = 0; j < mu->mu_nFibres_; j++)
+		{
+			masterIndex = sFindFibreSlot(slot, nSlots, mu->mu_fibre_[j]);
+			fibreIndex[nIndices++] = compactIndex[masterIndex];
+		}
+	}
+
+	fibreX = (float *) (image + header->ms_fibreXOffset);
+	fibreY = (float *) (image + header->ms_fibreYOffset);
+	fibreDiameter = (float *) (image + header->ms_fibreDiameterOffset);
+	fibreHealthyDiameter =
+			(float *) (image + header->ms_fibreHealthyDiameterOffset);
+	fibreJShift = (float *) (image + header->ms_fibreJShiftOffset);
+	fibreMU = (osInt32 *) (image + header->ms_fibreMotorUnitOffset);
+	for (i = 0; i < nTotalFibres_; i++)
+	{
+		if (compactIndex[i] < 0)
+			continue;
+
+		fibre = masterFibreList_[i];
+		j = compactIndex[i];
+		fibreX[j] = fibre->mf_xCell_;
+		fibreY[j] = fibre->mf_yCell_;
+		fibreDiameter[j] = fibre->mf_diameter_;
+		fibreHealthyDiameter[j] = fibre->mf_healthyDiameter_;
+		fibreJShift[j] = fibre->mf_jShift_;
+		fibreMU[j] = fibre->mf_motorUnit_;
+	}
+
+	if ( ! sWriteImage(filename, image, header->ms_fileSize) )
+		goto FAIL;
+
+	ckfree(image);
+	if (slot != NULL)
+		ckfree(slot);
+	if (compactIndex != NULL)
+		ckfree(compactIndex);
+	return 1;
+
+FAIL:
+	if (image != NULL)
+		ckfree(image);
+	if (slot != NULL)
+		ckfree(slot);
+	if (compactIndex != NULL)
+		ckfree(compactIndex);
+	return 0;
+}
+
+
+int
+MuscleData::loadSnapshot(const char *filename)
+{
+	const MuscleSnapshotHeader *header;
+	const MuscleSnapshotMotorUnit *muTable;
+	const osInt32 *inDetect, *fibreIndex, *fibreMU;
+	const float *fibreX, *fibreY, *fibreDiameter;
+	const float *fibreHealthyDiameter, *fibreJShift;
+	MuscleFibre **fibre = NULL;
+	SnapshotImage image;
+	MotorUnit *target;
+	int status;
+	int i, j;
+
+
+	if (motorUnit_ != NULL || nTotalFibres_ > 0)
+	{
+		LogError("Muscle snapshot '%s' loaded over existing data\n",
+				filename);
+		return 0;
+	}
+
+	if ( ! sOpenSnapshotImage(filename, &image,
+				sizeof(MuscleSnapshotHeader)) )
+		return 0;
+
+	if ( ! sValidateSnapshot(filename, &image) )
+	{
+		sCloseSnapshotImage(&image);
+		return 0;
+	}
+
+	header = (const MuscleSnapshotHeader *) image.base;
+	inDetect = (const osInt32 *) (image.base + header->ms_inDetectOffset);
+	muTable = (const MuscleSnapshotMotorUnit *)
+			(image.base + header->ms_motorUnitOffset);
+	fibreIndex = (const osInt32 *) (image.base + header->ms_fibreIndexOffset);
+	fibreX = (const float *) (image.base + header->ms_fibreXOffset);
+	fibreY = (const float *) (image.base + header->ms_fibreYOffset);
+	fibreDiameter = (const float *)
+			(image.base + header->ms_fibreDiameterOffset);
+	fibreHealthyDiameter = (const float *)
+			(image.base + header->ms_fibreHealthyDiameterOffset);
+	fibreJShift = (const float *) (image.base + header->ms_fibreJShiftOffset);
+	fibreMU = (const osInt32 *)
+			(image.base + header->ms_fibreMotorUnitOffset);
+
+	/** MU records must name a unit in the detection area */
+	for (i = 0; i < header->ms_nMotorUnitRecords; i++)
+	{
+		for (j = 0; j < header->ms_nMotorUnitsInDetectionArea; j++)
+		{
+			if (inDetect[j] == muTable[i].ms_id)
+				break;
+		}
+		if (j == header->ms_nMotorUnitsInDetectionArea)
+		{
+			LogError("Muscle snapshot '%s' : MU %d not in detect list\n",
+					filename, muTable[i].ms_id);
+			sCloseSnapshotImage(&image);
+			return 0;
+		}
+	}
+
+	xDetect_ = header->ms_xDetect;
+	yDetect_ = header->ms_yDetect;
+	nMotorUnitsInMuscle_ = header->ms_nMotorUnitsInMuscle;
+	muscleDiameter_ = header->ms_muscleDiameter;
+	minMotorUnitDiameter_ = header->ms_minMotorUnitDiameter;
+	maxMotorUnitDiameter_ = header->ms_maxMotorUnitDiameter;
+	nMotorUnitsInDetectionArea_ = header->ms_nMotorUnitsInDetectionArea;
+
+	/** as in loadMUdata, only units in the detection area exist */
+	motorUnit_ = (MotorUnit **)
+				ckalloc(sizeof(MotorUnit *) * nMotorUnitsInMuscle_);
+	memset(motorUnit_, 0, sizeof(MotorUnit *) * nMotorUnitsInMuscle_);
+	motorUnitInDetect_ = (MotorUnit **)
+				ckalloc(sizeof(MotorUnit *) * nMotorUnitsInDetectionArea_);
+	for (i = 0; i < nMotorUnitsInDetectionArea_; i++)
+	{
+		motorUnitInDetect_[i] = new MotorUnit();
+		motorUnitInDetect_[i]->mu_id_ = inDetect[i];
+		motorUnit_[inDetect[i] - 1] = motorUnitInDetect_[i];
+	}
+
+	/** fibres go into the master list in one allocation */
+	status = growArrayReserve(header->ms_nFibres,
+				(void **) &masterFibreList_,
+				&nFibresAllocated_,
+				sizeof(MuscleFibre *));
+	MSG_ASSERT(status, "Allocation failed");
+	fibre = masterFibreList_;
+	for (i = 0; i < header->ms_nFibres; i++)
+	{
+		fibre[i] = new MuscleFibre();
+		fibre[i]->mf_motorUnit_ = fibreMU[i];
+		fibre[i]->mf_xCell_ = fibreX[i];
+		fibre[i]->mf_yCell_ = fibreY[i];
+		fibre[i]->mf_diameter_ = fibreDiameter[i];
+		fibre[i]->mf_healthyDiameter_ = fibreHealthyDiameter[i];
+		fibre[i]->mf_jShift_ = fibreJShift[i];
+	}
+	nTotalFibres_ = header->ms_nFibres;
+	nMaxFibres_ = header->ms_nMaxFibres;
+	if (nMaxFibres_ < nTotalFibres_)
+		nMaxFibres_ = nTotalFibres_;
+
+	for (i = 0; i < header->ms_nMotorUnitRecords; i++)
+	{
+		target = motorUnit_[muTable[i].ms_id - 1];
+		target->mu_loc_r_mm_ = muTable[i].ms_locationRadius;
+		target->mu_loc_theta_ = muTable[i].ms_locationTheta;
+		target->mu_diameter_mm_ = muTable[i].ms_diameter;
+		target->mu_nHealthyFibres_ = muTable[i].ms_nHealthyFibres;
+
+		status = growArrayReserve(muTable[i].ms_nFibres,
+					(void **) &target->mu_fibre_,
+					&target->mu_nFibresAllocated_,
+					sizeof(MuscleFibre *));
+		MSG_ASSERT(status, "Allocation failed");
+		for (j = 0; j < muTable[i].ms_nFibres; j++)
+		{
+			target->mu_fibre_[j] =
+					fibre[fibreIndex[muTable[i].ms_firstFibreIndex + j]];
+		}
+		target->mu_nFibres_ = muTable[i].ms_nFibres;
+	}
+
+	LogInfo("Read %d motor Units from snapshot '%s'\n",
+			header->ms_nMotorUnitRecords, filename);
+
+	sCloseSnapshotImage(&image);
+	return 1;
+}
+
+
+int
+MuscleData::writePlowDelta(
+		const char *filename,
+		int nMovedFibres,
+		const int *fibreIndex,
+		const float *oldXCell,
+		const float *oldYCell
+	) const
+{
+	MusclePlowDeltaHeader *header;
+	MusclePlowDeltaFibre *moved;
+	FibreSlot *slot = NULL;
+	int *compactIndex = NULL;
+	char *image = NULL;
+	MuscleFibre *fibre;
+	int nSlots, nFibres, nRecords;
+	int nWritten = 0;
+	int i;
+
+
+	LogInfo("Writing plow delta to file:\n");
+	LogInfo("    '%s'\n", filename);
+
+	/** the delta is indexed as the snapshot is */
+	if ( ! sBuildSnapshotIndex(this, &slot, &nSlots,
+				&compactIndex, &nFibres, &nRecords) )
+		goto FAIL;
+
+	image = (char *) ckalloc(sizeof(MusclePlowDeltaHeader)
+				+ sizeof(MusclePlowDeltaFibre) * nMovedFibres);
+	memset(image, 0, sizeof(MusclePlowDeltaHeader));
+
+	header = (MusclePlowDeltaHeader *) image;
+	memcpy(header->ms_magic, MUSCLE_PLOW_DELTA_MAGIC,
+			MUSCLE_SNAPSHOT_MAGIC_LEN);
+	header->ms_version = MUSCLE_PLOW_DELTA_VERSION;
+	header->ms_headerSize = sizeof(MusclePlowDeltaHeader);
+	header->ms_nBaseFibres = nFibres;
+	header->ms_movedOffset = sizeof(MusclePlowDeltaHeader);
+
+	moved = (MusclePlowDeltaFibre *) (image + header->ms_movedOffset);
+	for (i = 0; i < nMovedFibres; i++)
+	{
+		MSG_ASSERT(fibreIndex[i] >= 0 && fibreIndex[i] < nTotalFibres_,
+				"Moved fibre out of range");
+
+		/** fibres which belong to no MU are not in the snapshot */
+		if (compactIndex[fibreIndex[i]] < 0)
+			continue;
+
+		fibre = masterFibreList_[fibreIndex[i]];
+		moved[nWritten].ms_fibreIndex = compactIndex[fibreIndex[i]];
+		moved[nWritten].ms_oldX = oldXCell[i];
+		moved[nWritten].ms_oldY = oldYCell[i];
+		moved[nWritten].ms_newX = fibre->mf_xCell_;
+		moved[nWritten].ms_newY = fibre->mf_yCell_;
+		nWritten++;
+	}
+	header->ms_nMovedFibres = nWritten;
+	header->ms_fileSize = header->ms_movedOffset
+				+ sizeof(MusclePlowDeltaFibre) * nWritten;
+
+	if ( ! sWriteImage(filename, image, header->ms_fileSize) )
+		goto FAIL;
+
+	ckfree(image);
+	if (slot != NULL)
+		ckfree(slot);
+	if (compactIndex != NULL)
+		ckfree(compactIndex);
+	return 1;
+
+FAIL:
+	if (image != NULL)
+		ckfree(image);
+	if (slot != NULL)
+		ckfree(slot);
+	if (compactIndex != NULL)
+		ckfree(compactIndex);
+	return 0;
+}
+
+
+/**
+ ** Check a plow delta against the image of the snapshot it is
+ ** to be applied to
+ **/
+static int
+sValidatePlowDelta(
+		const char *filename,
+		const SnapshotImage *image,
+		const SnapshotImage *baseImage
+	)
+{
+	const MusclePlowDeltaHeader *header;
+	const MusclePlowDeltaFibre *moved;
+	const MuscleSnapshotHeader *baseHeader;
+	const float *baseX, *baseY;
+	osInt32 i;
+
+	header = (const MusclePlowDeltaHeader *) image->base;
+
+	if (memcmp(header->ms_magic, MUSCLE_PLOW_DELTA_MAGIC,
+				MUSCLE_SNAPSHOT_MAGIC_LEN) != 0)
+	{
+		LogError("'%s' is not a plow delta\n", filename);
+		return 0;
+	}
+
+	if (header->ms_version != MUSCLE_PLOW_DELTA_VERSION
+			|| header->ms_headerSize < sizeof(MusclePlowDeltaHeader))
+	{
+		LogError("Plow delta '%s' has unsupported version %u\n",
+				filename, header->ms_version);
+		return 0;
+	}
+
+	if (header->ms_fileSize != image->length
+			|| ! sSectionFits(image, header->ms_movedOffset,
+					header->ms_nMovedFibres,
+					sizeof(MusclePlowDeltaFibre)))
+	{
+		LogError("Plow delta '%s' has a corrupt header\n", filename);
+		return 0;
+	}
+
+	baseHeader = (const MuscleSnapshotHeader *) baseImage->base;
+	if (header->ms_nBaseFibres != baseHeader->ms_nFibres)
+	{
+		LogError("Plow delta '%s' is for a muscle of %d fibres, not %d\n",
+				filename, header->ms_nBaseFibres, baseHeader->ms_nFibres);
+		return 0;
+	}
+
+	moved = (const MusclePlowDeltaFibre *)
+			(image->base + header->ms_movedOffset);
+	baseX = (const float *) (baseImage->base + baseHeader->ms_fibreXOffset);
+	baseY = (const float *) (baseImage->base + baseHeader->ms_fibreYOffset);
+	for (i = 0; i < header->ms_nMovedFibres; i++)
+	{
+		if (moved[i].ms_fibreIndex < 0
+				|| moved[i].ms_fibreIndex >= baseHeader->ms_nFibres
+				|| baseX[moved[i].ms_fibreIndex] != moved[i].ms_oldX
+				|| baseY[moved[i].ms_fibreIndex] != moved[i].ms_oldY)
+		{
+			LogError("Plow delta '%s' : fibre %d does not match the muscle\n",
+					filename, moved[i].ms_fibreIndex);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int
+MuscleData::loadPlowDelta(
+		const char *snapshotFilename,
+		const char *deltaFilename
+	)
+{
+	const MusclePlowDeltaHeader *header;
+	const MusclePlowDeltaFibre *moved;
+	SnapshotImage image, baseImage;
+	MuscleFibre *fibre;
+	int status;
+	int i;
+
+
+	if ( ! sOpenSnapshotImage(deltaFilename, &image,
+				sizeof(MusclePlowDeltaHeader)) )
+		return 0;
+
+	/** check the delta fits the snapshot before loading anything */
+	if ( ! sOpenSnapshotImage(snapshotFilename, &baseImage,
+				sizeof(MuscleSnapshotHeader)) )
+	{
+		sCloseSnapshotImage(&image);
+		return 0;
+	}
+	status = sValidateSnapshot(snapshotFilename, &baseImage)
+			&& sValidatePlowDelta(deltaFilename, &image, &baseImage);
+	sCloseSnapshotImage(&baseImage);
+
+	if (status)
+		status = loadSnapshot(snapshotFilename);
+
+	if ( ! status )
+	{
+		sCloseSnapshotImage(&image);
+		return 0;
+	}
+
+	header = (const MusclePlowDeltaHeader *) image.base;
+	moved = (const MusclePlowDeltaFibre *)
+			(image.base + header->ms_movedOffset);
+	for (i = 0; i < header->ms_nMovedFibres; i++)
+	{
+		fibre = masterFibreList_[moved[i].ms_fibreIndex];
+		fibre->mf_xCell_ = moved[i].ms_newX;
+		fibre->mf_yCell_ = moved[i].ms_newY;
+	}
+
+	LogInfo("Applied %d plowed fibre locations from '%s'\n",
+			header->ms_nMovedFibres, deltaFilename);
+
+	sCloseSnapshotImage(&image);
+	return 1;
+}
+
+
+static int
+sFileExists(const char *filename)
+{
+	struct stat sb;
+	char *localName;
+	int status;
+
+	localName = osIndependentPath(filename);
+	status = irStat(localName, &sb);
+	ckfree(localName);
+
+	return (status >= 0);
+}
+
+/**
+ ** Load one set of text files and write its snapshot
+ **/
+static int
+sUpgradeLayout(
+		const char *MFfilename,
+		const char *MUfilename,
+		const char *snapshotFilename
+	)
+{
+	MuscleData *MD;
+	int status;
+
+	MD = new MuscleData();
+	status = MD->loadTextLayout(MFfilename, MUfilename);
+	if (status)
+		status = MD->writeSnapshot(snapshotFilename);
+	else
+		LogError("Cannot load muscle text files '%s'\n", MFfilename);
+	delete MD;
+
+	return status;
+}
+
+int
+upgradeMuscleDirectory(
+		const char *muscleDir,
+		const char *outputDir
+	)
+{
+	char MFfilename[FILENAME_MAX];
+	char MUfilename[FILENAME_MAX];
+	char snapshotFilename[FILENAME_MAX];
+	DirList *plowedList;
+	int contractionId;
+	int nUpgraded = 0;
+	int status = 1;
+	int i;
+
+
+	slnprintf(MUfilename, FILENAME_MAX, "%s\\MU.dat", muscleDir);
+	if ( ! sFileExists(MUfilename) )
+	{
+		LogError("No muscle files found in '%s'\n", muscleDir);
+		return 0;
+	}
+
+	slnprintf(snapshotFilename, FILENAME_MAX, "%s\\%s",
+			muscleDir, MUSCLE_SNAPSHOT_UNPLOWED);
+	if ( ! sFileExists(snapshotFilename) )
+	{
+		slnprintf(MFfilename, FILENAME_MAX, "%s\\MF-unplowed.dat", muscleDir);
+		if ( ! sFileExists(MFfilename) )
+			slnprintf(MFfilename, FILENAME_MAX, "%s\\MF.dat", muscleDir);
+
+		if (sUpgradeLayout(MFfilename, MUfilename, snapshotFilename))
+			nUpgraded++;
+		else
+			status = 0;
+	}
+
+	if (outputDir != NULL)
+	{
+		plowedList = dirListLoadEntries(outputDir, "MF-plowed*.dat");
+		for (i = 0; plowedList != NULL && i < plowedList->n_entries; i++)
+		{
+			if (sscanf(plowedList->entry_name[i],
+						"MF-plowed%d.dat", &contractionId) != 1)
+				continue;
+
+			slnprintf(snapshotFilename, FILENAME_MAX, "%s\\"
+					MUSCLE_SNAPSHOT_PLOWED_FMT, outputDir, contractionId);
+			if (sFileExists(snapshotFilename))
+				continue;
+
+			slnprintf(MFfilename, FILENAME_MAX, "%s\\%s",
+					outputDir, plowedList->entry_name[i]);
+			if (sUpgradeLayout(MFfilename, MUfilename, snapshotFilename))
+				nUpgraded++;
+			else
+				status = 0;
+		}
+		if (plowedList != NULL)
+			dirListDelete(plowedList);
+	}
+
+	LogInfo("Wrote %d muscle snapshot%s for '%s'\n",
+			nUpgraded, nUpgraded == 1 ? "" : "s", muscleDir);
+
+	return status;
+}
+
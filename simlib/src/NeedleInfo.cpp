@@ -276,6 +276,23 @@ void NeedleInfo::getProjectedNeedleDistances(
 		float fibreLocXInMM,
 		float fibreLocYInMM
 	)
+{
+	getProjectedNeedleDistanceArrays(
+		        1, &fibreLocXInMM, &fibreLocYInMM,
+		        projDeltaToTipInMM,
+		        projDeltaToEndOfShaftInMM,
+		        distanceToShaftInMM
+		    );
+}
+
+void NeedleInfo::getProjectedNeedleDistanceArrays(
+		int nFibres,
+		const float *fibreLocXInMM,
+		const float *fibreLocYInMM,
+		double *projDeltaToTipInMM,
+		double *projDeltaToEndOfShaftInMM,
+		double *distanceToShaftInMM
+	)
 {
 	double M_cannulaPerpindicular;
 	double B_cannulaPerpindicular;
@@ -286,6 +303,8 @@ void NeedleInfo::getProjectedNeedleDistances(
 	double xEndInMM, yEndInMM;
 	double xIntersection;
 	double yIntersection;
+	double delta;
+	int i;
 
 
 	/**
@@ -306,74 +325,78 @@ void NeedleInfo::getProjectedNeedleDistances(
 	xEndInMM = getXCannulaTerminusInMM();
 	yEndInMM = getYCannulaTerminusInMM();
 
-
-	/**
-	 * calculate distance to shaft line & calculate
-	 * the intersection bewteen this line and the
-	 * cannula
-	 * --
-	 * raise a perpendicular throuch fibreLoc
-	 * to calculate the distance to the (adjusted)
-	 * line of the shaft
-	 */
-
 	/**
-	 *  y = M x + B
-	 *  B = y - ( M x )
+	 * the perpendicular through each fibre has the
+	 * same slope, -1/M
 	 */
 	M_cannulaPerpindicular = (-1.0 / getSlope());
-	B_cannulaPerpindicular =
-		    fibreLocYInMM - M_cannulaPerpindicular * fibreLocXInMM;
 
 
 	/**
-	 *  M_c x_intersection + B_c = M_p x_intersection + B_p
-	 *                 B_c - B_p = x_intersection ( M_p - M_c )
-	 *          x_intersection = (B_c - B_p) / (M_p - M_c)
+	 * Every fibre goes through the same steps, with
+	 * the sign of each delta selected rather than
+	 * branched on, so the loop can be vectorised
 	 */
-	xIntersection = (B_cannula - B_cannulaPerpindicular)
-		        / (M_cannulaPerpindicular - M_cannula);
-	yIntersection = M_cannula * xIntersection + B_cannula;
-
+	for (i = 0; i < nFibres; i++)
+	{
+		/**
+		 * calculate distance to shaft line & calculate
+		 * the intersection bewteen this line and the
+		 * cannula
+		 * --
+		 * raise a perpendicular throuch fibreLoc
+		 * to calculate the distance to the (adjusted)
+		 * line of the shaft
+		 *
+		 *  y = M x + B
+		 *  B = y - ( M x )
+		 */
+		B_cannulaPerpindicular =
+		        fibreLocYInMM[i] - M_cannulaPerpindicular * fibreLocXInMM[i];
 
-	distanceXInMM = xIntersection - fibreLocXInMM;
-	distanceYInMM = yIntersection - fibreLocYInMM;
-	(*distanceToShaftInMM) = sqrt(SQR(distanceXInMM) + SQR(distanceYInMM));
 
+		/**
+		 *  M_c x_intersection + B_c = M_p x_intersection + B_p
+		 *                 B_c - B_p = x_intersection ( M_p - M_c )
+		 *          x_intersection = (B_c - B_p) / (M_p - M_c)
+		 */
+		xIntersection = (B_cannula - B_cannulaPerpindicular)
+		            / (M_cannulaPerpindicular - M_cannula);
+		yIntersection = M_cannula * xIntersection + B_cannula;
 
-	/**
-	 * Now use the intersection to calculate the delta projected
-	 * along the shaft to determine the relative fibre location
-	 *
-	 * The intersection point x,y is used as the projection onto
-	 * the cannula line of the fibre position.  From this, we
-	 * can generate a delta in the "X" direction of the cannula
-	 * co-ordinates to get the projected "X" we desire for the
-	 * current weight function equation.
-	 */
 
-	/** calculate distance to Tip */
-	distanceXInMM = xTipInMM - xIntersection;
-	distanceYInMM = yTipInMM - yIntersection;
+		distanceXInMM = xIntersection - fibreLocXInMM[i];
+		distanceYInMM = yIntersection - fibreLocYInMM[i];
+		distanceToShaftInMM[i] =
+		            sqrt(SQR(distanceXInMM) + SQR(distanceYInMM));
 
-	(*projDeltaToTipInMM) =
-		        sqrt( SQR(distanceXInMM) + SQR(distanceYInMM) );
 
-	if (distanceXInMM < 0)
-		(*projDeltaToTipInMM) = (*projDeltaToTipInMM) * (-1);
+		/**
+		 * Now use the intersection to calculate the delta projected
+		 * along the shaft to determine the relative fibre location
+		 *
+		 * The intersection point x,y is used as the projection onto
+		 * the cannula line of the fibre position.  From this, we
+		 * can generate a delta in the "X" direction of the cannula
+		 * co-ordinates to get the projected "X" we desire for the
+		 * current weight function equation.
+		 */
 
+		/** calculate distance to Tip */
+		distanceXInMM = xTipInMM - xIntersection;
+		distanceYInMM = yTipInMM - yIntersection;
 
+		delta = sqrt( SQR(distanceXInMM) + SQR(distanceYInMM) );
+		projDeltaToTipInMM[i] = (distanceXInMM < 0) ? -delta : delta;
 
-	/** calculate distance to End */
-	distanceXInMM = xEndInMM - xIntersection;
-	distanceYInMM = yEndInMM - yIntersection;
 
-	(*projDeltaToEndOfShaftInMM) =
-		        sqrt( SQR(distanceXInMM) + SQR(distanceYInMM) );
+		/** calculate distance to End */
+		distanceXInMM = xEndInMM - xIntersection;
+		distanceYInMM = yEndInMM - yIntersection;
 
-	if (distanceXInMM < 0)
-		(*projDeltaToEndOfShaftInMM) =
-		        (*projDeltaToEndOfShaftInMM) * (-1);
+		delta = sqrt( SQR(distanceXInMM) + SQR(distanceYInMM) );
+		projDeltaToEndOfShaftInMM[i] = (distanceXInMM < 0) ? -delta : delta;
+	}
 }
 
 void NeedleInfo::getNeedleDistances(
@@ -383,105 +406,110 @@ void NeedleInfo::getNeedleDistances(
 		float fibreLocXInMM,
 		float fibreLocYInMM
 	)
+{
+	getNeedleDistanceArrays(
+		        1, &fibreLocXInMM, &fibreLocYInMM,
+		        distanceToTipInMM,
+		        distanceToEndOfShaftInMM,
+		        distanceToShaftInMM
+		    );
+}
+
+void NeedleInfo::getNeedleDistanceArrays(
+		int nFibres,
+		const float *fibreLocXInMM,
+		const float *fibreLocYInMM,
+		double *distanceToTipInMM,
+		double *distanceToEndOfShaftInMM,
+		double *distanceToShaftInMM
+	)
 {
 	double M_cannulaPerpindicular;
 	double B_cannulaPerpindicular;
-	double M_adjustedCannula;
-	double B_adjustedCannula;
+	double M_adjustedCannula[3];
+	double B_adjustedCannula[3];
+	double xAdjustedTipInMM[3], yAdjustedTipInMM[3];
+	double xAdjustedEndInMM[3], yAdjustedEndInMM[3];
 	double distanceXInMM, distanceYInMM;
-	double xAdjustedTipInMM, yAdjustedTipInMM;
-	double xAdjustedEndInMM, yAdjustedEndInMM;
 	double xIntersection;
 	double yIntersection;
 	double testY;
-	LineEquationChoice lineChoice;
+	int lineChoice;
+	int i;
 
 
-	/** if we are below tip, then everything is simple */
-	if (fibreLocYInMM < yTip_)
+	/**
+	 * get the line equation and the points at the end of
+	 * the needle for each choice of line, which we can use
+	 * to calculate distances for the given points to the
+	 * shaft
+	 */
+	for (i = BelowTip; i <= AboveTip_BelowCannula; i++)
 	{
+		getLineEquation(
+		            &M_adjustedCannula[i],
+		            &B_adjustedCannula[i],
+		            (LineEquationChoice) i
+		        );
+
+		getNeedleLocations(
+		            &xAdjustedTipInMM[i], &yAdjustedTipInMM[i],
+		            &xAdjustedEndInMM[i], &yAdjustedEndInMM[i],
+		            (LineEquationChoice) i
+		        );
+	}
 
-		lineChoice = BelowTip;
+	M_cannulaPerpindicular = (-1.0 / getSlope());
 
-	} else
+	for (i = 0; i < nFibres; i++)
 	{
-
 		/**
-		 * calulate a test point at fibre X on the cannula,
-		 * check if the fibre is above or below the point
-		 * to see if the fibre is above or below the cannula
+		 * if we are below tip, then everything is simple;
+		 * otherwise calulate a test point at fibre X on the
+		 * cannula, check if the fibre is above or below the
+		 * point to see if the fibre is above or below the
+		 * cannula
 		 */
-		testY = getSlope() * fibreLocXInMM;
-
-		if (fibreLocYInMM > testY)
-		{
-		    lineChoice = AboveTip_AboveCannula;
-		} else
-		{
-		    lineChoice = AboveTip_BelowCannula;
-		}
-	}
-
-	/**
-	 * get the line equation for the needle, which we
-	 * can use to calculate distances for the given point
-	 * to the shaft
-	 */
-	getLineEquation(
-		        &M_adjustedCannula,
-		        &B_adjustedCannula,
-		        lineChoice
-		    );
+		testY = getSlope() * fibreLocXInMM[i];
+		lineChoice = (fibreLocYInMM[i] < yTip_)
+		            ? BelowTip
+		            : ((fibreLocYInMM[i] > testY)
+		                    ? AboveTip_AboveCannula
+		                    : AboveTip_BelowCannula);
 
-	/**
-	 * get the points at the end of the needle, for the
-	 * given lineChoice
-	 */
-	getNeedleLocations(
-		        &xAdjustedTipInMM, &yAdjustedTipInMM,
-		        &xAdjustedEndInMM, &yAdjustedEndInMM,
-		        lineChoice
-		    );
+		/**
+		 * Now all the calculations to the ends and offset of shaft
+		 * are the same
+		 */
 
-	/**
-	 * Now all the calculations to the ends and offset of shaft
-	 * are the same
-	 */
-	{
 		/** calculate distance to Tip */
+		distanceXInMM = fibreLocXInMM[i] - xAdjustedTipInMM[lineChoice];
+		distanceYInMM = fibreLocYInMM[i] - yAdjustedTipInMM[lineChoice];
 
-		distanceXInMM = fibreLocXInMM - xAdjustedTipInMM;
-		distanceYInMM = fibreLocYInMM - yAdjustedTipInMM;
-
-		(*distanceToTipInMM) =
+		distanceToTipInMM[i] =
 		        sqrt( SQR(distanceXInMM) + SQR(distanceYInMM) );
 
 
 		/** calculate distance to End */
-		distanceXInMM = fibreLocXInMM - xAdjustedEndInMM;
-		distanceYInMM = fibreLocYInMM - yAdjustedEndInMM;
+		distanceXInMM = fibreLocXInMM[i] - xAdjustedEndInMM[lineChoice];
+		distanceYInMM = fibreLocYInMM[i] - yAdjustedEndInMM[lineChoice];
 
-		(*distanceToEndOfShaftInMM) =
+		distanceToEndOfShaftInMM[i] =
 		        sqrt( SQR(distanceXInMM) + SQR(distanceYInMM) );
-	}
 
 
-	/**
-	 * calculate distance to shaft line
-	 * --
-	 * raise a perpendicular throuch fibreLoc
-	 * to calculate the distance to the (adjusted)
-	 * line of the shaft
-	 */
-	{
-
 		/**
+		 * calculate distance to shaft line
+		 * --
+		 * raise a perpendicular throuch fibreLoc
+		 * to calculate the distance to the (adjusted)
+		 * line of the shaft
+		 *
 		 *  y = M x + B
 		 *  B = y - ( M x )
 		 */
-		M_cannulaPerpindicular = (-1.0 / getSlope());
 		B_cannulaPerpindicular =
-		        fibreLocYInMM - M_cannulaPerpindicular * fibreLocXInMM;
+		        fibreLocYInMM[i] - M_cannulaPerpindicular * fibreLocXInMM[i];
 
 
 		/**
@@ -490,16 +518,16 @@ void NeedleInfo::getNeedleDistances(
 		 *          x_intersection = (B_c - B_p) / (M_p - M_c)
 		 */
 		xIntersection =
-		            (B_adjustedCannula - B_cannulaPerpindicular)
-		            / (M_cannulaPerpindicular - M_adjustedCannula);
+		            (B_adjustedCannula[lineChoice] - B_cannulaPerpindicular)
+		            / (M_cannulaPerpindicular - M_adjustedCannula[lineChoice]);
 		yIntersection =
-		            M_adjustedCannula * xIntersection
-		                    + B_adjustedCannula;
+		            M_adjustedCannula[lineChoice] * xIntersection
+		                    + B_adjustedCannula[lineChoice];
 
 
-		distanceXInMM = xIntersection - fibreLocXInMM;
-		distanceYInMM = yIntersection - fibreLocYInMM;
-		(*distanceToShaftInMM) = sqrt(
+		distanceXInMM = xIntersection - fibreLocXInMM[i];
+		distanceYInMM = yIntersection - fibreLocYInMM[i];
+		distanceToShaftInMM[i] = sqrt(
 		                    SQR(distanceXInMM) + SQR(distanceYInMM));
 	}
 }
@@ -0,0 +1,97 @@
+/**
+ ** The per-simulation state, and its binding to a thread
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <string.h>
+# include <time.h>
+#endif
+
+#include "random.h"
+#include "log.h"
+
+#include "SimulatorControl.h"
+#include "SimulationContext.h"
+
+
+OS_THREAD_LOCAL SimulationContext *SimulationContext::sCurrent_ = NULL;
+
+
+SimulationContext::SimulationContext(int ownsGlobals)
+{
+	globals_ = NULL;
+	ownsGlobals_ = ownsGlobals;
+
+	/** each run re-seeds this; until then, it is seeded from the clock */
+	seedRandomStream(&random_, (long) time(NULL));
+}
+
+SimulationContext::~SimulationContext()
+{
+	if (sCurrent_ == this)
+	{
+		/** the globals may still be needed by deleteGlobals() */
+		if (ownsGlobals_ && g == globals_)
+			g = NULL;
+		sBind(NULL);
+	}
+
+	if (ownsGlobals_ && globals_ != NULL)
+		deleteGlobalValues(globals_);
+}
+
+void
+SimulationContext::setGlobals(struct globals *globals)
+{
+	if (ownsGlobals_ && globals_ != NULL && globals_ != globals)
+		deleteGlobalValues(globals_);
+
+	globals_ = globals;
+	if (sCurrent_ == this)
+		g = globals_;
+}
+
+SimulationContext *
+SimulationContext::bind()
+{
+	SimulationContext *previous = sCurrent_;
+
+	sBind(this);
+	return previous;
+}
+
+void
+SimulationContext::sBind(SimulationContext *context)
+{
+	sCurrent_ = context;
+	if (context == NULL)
+	{
+		setLocalRandomStream(NULL);
+		return;
+	}
+
+	g = context->globals_;
+	setLocalRandomStream(&context->random_);
+}
+
+
+SimulationContextBinding::SimulationContextBinding(
+		SimulationContext *context
+	)
+{
+	previous_ = context->bind();
+}
+
+SimulationContextBinding::~SimulationContextBinding()
+{
+	/**
+	 * with no context bound before, g is left as it is, as
+	 * the thread may have set it up itself
+	 */
+	SimulationContext::sBind(previous_);
+}
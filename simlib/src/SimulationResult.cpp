@@ -37,8 +37,6 @@ static const char *sErrorList[] = {
 		        NULL
 		};
 
-extern struct globals *g;
-
 const int SimulationResult::PRINT_EMG_DATA      = 0x01;
 const int SimulationResult::PRINT_MUP_DATA     = 0x02;
 const int SimulationResult::PRINT_MUSCLE_DATA   = 0x04;
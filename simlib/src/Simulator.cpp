@@ -31,6 +31,7 @@
 #include "massert.h"
 
 #include "SimulatorControl.h"
+#include "SimulatorConstants.h"
 #include "NeedleInfo.h"
 #include "MUP_utils.h"
 #include "globalHandler.h"
@@ -38,6 +39,13 @@
 #include "statistics.h"
 #include "userinput.h"
 #include "MUP.h"
+#include "FiringSource.h"
+#include "MuscleSnapshot.h"
+#include "FibreLatticeIndex.h"
+#include "MFAPCache.h"
+#include "StageHash.h"
+#include "SimulationContext.h"
+#include "stagestats.h"
 #include "DQEmgData.h"
 #include "dco.h"
 
@@ -56,11 +64,10 @@
 const int Simulator::FLAG_USE_LAST_MUSCLE		= 0x01;
 const int Simulator::FLAG_USE_OLD_FIRING_TIMES		= 0x02;
 const int Simulator::FLAG_RUN_SURFACE				= 0x04;
+const int Simulator::FLAG_INCREMENTAL				= 0x08;
 
 static const char *sVersionString = "2.1";
 
-extern struct globals *g;
-
 const char *Simulator::sGetVersion()
 {
 	return sVersionString;
@@ -69,6 +76,17 @@ const char *Simulator::sGetVersion()
 Simulator::Simulator()
 {
 	memset(this, 0, sizeof(*this));
+
+	/** the globals made here are left for deleteGlobals() */
+	context_ = new SimulationContext(0);
+	ownsContext_ = 1;
+}
+
+Simulator::Simulator(SimulationContext *context)
+{
+	memset(this, 0, sizeof(*this));
+	context_ = context;
+	ownsContext_ = 0;
 }
 
 
@@ -76,6 +94,9 @@ Simulator::~Simulator()
 {
 	if (configFile_ != NULL)
 		ckfree(configFile_);
+
+	if (ownsContext_)
+		delete context_;
 }
 
 NeedleInfo *SimulationResult::getNeedleInfo() const
@@ -159,8 +180,12 @@ Simulator::initializeGlobals(
 	MSG_ASSERT(configFile != NULL, "Simulator::initializeGlobals - config file not specified");
 	MSG_ASSERT(outputRoot != NULL, "Simulator::initializeGlobals - output root not specified");
 
-	/** allocate the globals structure */
-	g = (struct globals *) ckalloc(sizeof(struct globals));
+	/**
+	 * allocate the globals structure, and leave our context
+	 * bound so that the caller may adjust it through g
+	 */
+	context_->bind();
+	context_->setGlobals((struct globals *) ckalloc(sizeof(struct globals)));
 	g->muscle_ = new MuscleParameters();
 
 	/* assign hard-coded defaults */
@@ -212,13 +237,83 @@ getNextRunID()
 {
 	int fileId;
 
-	fileId = dirToolsGetNextId(g->output_dir, "contraction*.dat");
-	if (fileId <= 0)
-		fileId = 1;
+	fileId = runCatalogNextId(g->output_dir, "contraction*.dat", 1);
+	if (fileId < 0)
+	{
+		fileId = dirToolsGetNextId(g->output_dir, "contraction*.dat");
+		if (fileId <= 0)
+			fileId = 1;
+	}
 
 	return fileId;
 }
 
+/**
+ * enter the outputs of this run in the catalogue of the output
+ * stem, under the hash of the configuration it was made from
+ */
+static void
+sCatalogueRun(osUint32 configurationHash, const StageHashes *outputs)
+{
+	RunCatalogEntry entry, latest;
+
+	if (g->run_id < 0)
+		return;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.rc_id = g->run_id;
+	slnprintf(entry.rc_configHash, RUN_CATALOG_MAX_HASH, "%08lx",
+			(unsigned long) configurationHash);
+	formatStageHashes(entry.rc_stageHashes, RUN_CATALOG_MAX_FIELD, outputs);
+	strlcpy(entry.rc_path, g->muscle_dir, FILENAME_MAX);
+
+	/** a run carried on from an earlier one may leave it unchanged */
+	if (runCatalogFind(g->output_stem, entry.rc_configHash, &latest)
+			&& latest.rc_id == entry.rc_id
+			&& strcmp(latest.rc_stageHashes, entry.rc_stageHashes) == 0
+			&& strcmp(latest.rc_path, entry.rc_path) == 0)
+		return;
+
+	runCatalogRecord(g->output_stem, &entry);
+}
+
+/**
+ * look in the catalogue for an earlier run of this configuration
+ * whose muscle is still good, and if there is one, carry on from
+ * it in place of the last output
+ */
+static int
+sFindCataloguedRun(
+		osUint32 configurationHash,
+		const StageHashes *current,
+		StageHashes *stored
+	)
+{
+	RunCatalogEntry entry;
+	StageHashes catalogued;
+	char configHash[RUN_CATALOG_MAX_HASH];
+
+	slnprintf(configHash, RUN_CATALOG_MAX_HASH, "%08lx",
+			(unsigned long) configurationHash);
+	if ( ! runCatalogFind(g->output_stem, configHash, &entry) )
+		return 0;
+
+	/** the directory may have been used for another run since */
+	if ( ! loadStageHashes(&catalogued, entry.rc_path)
+			|| ! stageHashMatches(current, &catalogued, STAGE_MUSCLE))
+		return 0;
+
+	LogNotice("Run %d in '%s' has the same configuration\n",
+			entry.rc_id, entry.rc_path);
+	updateAttVal(g->list_,
+			createStringAttribute("LAST_OUTPUT", entry.rc_path));
+	updateAttVal(g->list_,
+			createIntegerAttribute("LAST_RUN_ID", entry.rc_id));
+	*stored = catalogued;
+
+	return 1;
+}
+
 SimulationResult *Simulator::runSurface(int flags)
 {
 	return 0;
@@ -332,7 +427,336 @@ SimulationResult *Simulator::runSurface(int flags)
 //	return result;
 //}
 
+/**
+ * Record where every fibre is, so that the plowing of a
+ * progression stage can be undone afterwards
+ */
+static void
+sRecordFibreLocations(
+		MuscleData *MD,
+		float **xCell,
+		float **yCell
+	)
+{
+	MuscleFibre *fibre;
+	int nFibres;
+	int i;
+
+	nFibres = MD->getTotalNumberOfFibres();
+	*xCell = (float *) ckalloc(sizeof(float) * (nFibres + 1));
+	*yCell = (float *) ckalloc(sizeof(float) * (nFibres + 1));
+
+	for (i = 0; i < nFibres; i++)
+	{
+		fibre = MD->getFibre(i);
+		if (fibre == NULL)
+			continue;
+		(*xCell)[i] = fibre->getXCell();
+		(*yCell)[i] = fibre->getYCell();
+	}
+}
+
+/**
+ * Put back the fibres moved since sRecordFibreLocations(),
+ * keeping the fibre lattice up to date
+ */
+static void
+sRestoreFibreLocations(
+		MuscleData *MD,
+		const float *xCell,
+		const float *yCell
+	)
+{
+	MuscleFibre *fibre;
+	int nRestored = 0;
+	int i;
+
+	for (i = 0; i < MD->getTotalNumberOfFibres(); i++)
+	{
+		fibre = MD->getFibre(i);
+		if (fibre == NULL)
+			continue;
+
+		if (fibre->getXCell() != xCell[i] || fibre->getYCell() != yCell[i])
+		{
+			fibre->setCellLocation(xCell[i], yCell[i]);
+			if (MD->fibreLattice_ != NULL)
+				MD->fibreLattice_->moveFibre(i, xCell[i], yCell[i]);
+			nRestored++;
+		}
+	}
+	LogInfo("Restored %d plowed fibres for the next stage\n", nRestored);
+}
+
+/**
+ * Write the timings and counters gathered over a run beside
+ * its EMG, as "runstats<N>.json"
+ */
+static int
+sWriteRunStatistics(int emgFileId)
+{
+	char tmpBuffer[FILENAME_MAX];
+	char description[BUFSIZ];
+	char *filename;
+	FILE *fp;
+	int status;
+
+	slnprintf(tmpBuffer, FILENAME_MAX, "%s\\runstats%d.json",
+				g->output_dir, emgFileId);
+	filename = osIndependentPath(tmpBuffer);
+	fp = fopenpath(filename, "wb");
+	if (fp == NULL)
+	{
+		LogError("Cannot open run statistics file '%s' for writing\n",
+					filename);
+		ckfree(filename);
+		return 0;
+	}
+
+	slnprintf(description, BUFSIZ, "Contraction %d at %s %% MVC",
+				emgFileId,
+				niceDouble(g->firing_.contractionLevelAsPercentMVC));
+	status = stageStatsWriteJSON(fp, description);
+	if (fclose(fp) != 0)
+		status = 0;
+	if ( ! status )
+		LogError("Failure writing run statistics to '%s'\n", filename);
+	ckfree(filename);
+	return status;
+}
+
 SimulationResult *Simulator::run(int flags)
+{
+	SimulationContextBinding binding(context_);
+
+	return runStage(flags, &g->pathology, NULL, 0);
+}
+
+SimulationResult *Simulator::runProgression(
+		const float *severities,
+		int nStages,
+		int flags
+	)
+{
+	PathologyControl stagePathology;
+	SimulationResult *result;
+	MuscleData *stageMuscle = NULL;
+	double loss, lastLoss = 0;
+	double involved, lastInvolved = 0;
+	int stageFlags;
+	int i;
+	SimulationContextBinding binding(context_);
+
+	for (i = 0; i < nStages; i++)
+	{
+		if (severities[i] < 0 || severities[i] > 1
+				|| (i > 0 && severities[i] < severities[i - 1]))
+		{
+			LogError("Progression severities must rise from 0 to 1\n");
+			return NULL;
+		}
+	}
+
+	/** each stage has new MUs to fire, so old times cannot be used */
+	flags &= (~Simulator::FLAG_USE_OLD_FIRING_TIMES);
+
+	for (i = 0; i < nStages; i++)
+	{
+		/**
+		 * The stage takes only the pathology which the previous
+		 * stage does not yet have: losing fraction f of the MUs
+		 * which remain takes the total loss from L' to L when
+		 * (1 - L) = (1 - L')(1 - f), and the myopathic involvement
+		 * is extended over the unaffected fibres in the same way
+		 */
+		stagePathology = g->pathology;
+
+		loss = severities[i] * g->pathology.neuropathicMULossFraction;
+		stagePathology.neuropathicMULossFraction = (lastLoss < 1.0)
+				? (float) (1.0 - ((1.0 - loss) / (1.0 - lastLoss))) : 0;
+		lastLoss = loss;
+
+		involved = severities[i]
+				* g->pathology.myopathicFractionOfFibresAffected;
+		stagePathology.myopathicFractionOfFibresAffected =
+				(lastInvolved < 1.0)
+				? (float) (1.0 - ((1.0 - involved) / (1.0 - lastInvolved)))
+				: 0;
+		lastInvolved = involved;
+
+		LogNotice("Progression stage %d of %d at severity %s\n",
+				i + 1, nStages, niceDouble(severities[i]));
+
+		stageFlags = flags;
+		if (i > 0)
+			stageFlags |= Simulator::FLAG_USE_LAST_MUSCLE;
+
+		result = runStage(stageFlags, &stagePathology,
+				stageMuscle, (i < nStages - 1));
+		if (result == NULL)
+			return NULL;
+
+		if (result->getErrorState() != 0 || i == nStages - 1)
+			return result;
+
+		/** the next stage takes over the muscle */
+		stageMuscle = result->muscleData_;
+		result->muscleData_ = NULL;
+		delete result;
+	}
+
+	return NULL;
+}
+
+SimulationResult *Simulator::runNeedleSweep(
+		const float *xPositions,
+		const float *yPositions,
+		int nPositions,
+		int flags
+	)
+{
+	PathologyControl noPathology;
+	SimulationResult *result = NULL;
+	MuscleData *sweepMuscle = NULL;
+	float xConfigured, yConfigured;
+	int stageFlags;
+	int i;
+	SimulationContextBinding binding(context_);
+
+	/** later positions add no pathology to the muscle */
+	noPathology = g->pathology;
+	noPathology.neuropathicMULossFraction = 0;
+	noPathology.myopathicFractionOfFibresAffected = 0;
+
+	xConfigured = g->needle_x_position;
+	yConfigured = g->needle_y_position;
+	cacheMFAPs_ = 1;
+
+	for (i = 0; i < nPositions; i++)
+	{
+		LogNotice("Needle sweep position %d of %d at (%.3f, %.3f)\n",
+				i + 1, nPositions, xPositions[i], yPositions[i]);
+
+		g->needle_x_position = xPositions[i];
+		g->needle_y_position = yPositions[i];
+
+		/** the first position fires the muscle; the rest reuse it */
+		stageFlags = flags;
+		if (i > 0)
+			stageFlags |= Simulator::FLAG_USE_LAST_MUSCLE
+					| Simulator::FLAG_USE_OLD_FIRING_TIMES;
+
+		result = runStage(stageFlags,
+				(i == 0) ? &g->pathology : &noPathology,
+				sweepMuscle, (i < nPositions - 1));
+		if (result == NULL)
+			break;
+
+		if (result->getErrorState() != 0 || i == nPositions - 1)
+			break;
+
+		/** the next position takes over the muscle */
+		sweepMuscle = result->muscleData_;
+		result->muscleData_ = NULL;
+		delete result;
+		result = NULL;
+	}
+
+	cacheMFAPs_ = 0;
+	g->needle_x_position = xConfigured;
+	g->needle_y_position = yConfigured;
+	return result;
+}
+
+SimulationResult *Simulator::runContractionSweep(
+		const float *levels,
+		int nLevels,
+		int flags
+	)
+{
+	PathologyControl noPathology;
+	SimulationResult *result = NULL;
+	MuscleData *sweepMuscle = NULL;
+	float levelConfigured;
+	float xConfigured, yConfigured, zConfigured;
+	int seekConfigured;
+	int stageFlags;
+	int i;
+	SimulationContextBinding binding(context_);
+
+	for (i = 0; i < nLevels; i++)
+	{
+		if (levels[i] <= 0 || levels[i] > 100)
+		{
+			LogError("Contraction levels must be within (0, 100] %%MVC\n");
+			return NULL;
+		}
+	}
+
+	/** each level recruits its own MUs, so old times cannot be used */
+	flags &= (~Simulator::FLAG_USE_OLD_FIRING_TIMES);
+
+	/** later levels add no pathology to the muscle */
+	noPathology = g->pathology;
+	noPathology.neuropathicMULossFraction = 0;
+	noPathology.myopathicFractionOfFibresAffected = 0;
+
+	levelConfigured = g->firing_.contractionLevelAsPercentMVC;
+	xConfigured = g->needle_x_position;
+	yConfigured = g->needle_y_position;
+	zConfigured = g->needle_z_position;
+	seekConfigured = g->seekNeedle;
+
+	for (i = 0; i < nLevels; i++)
+	{
+		LogNotice("Contraction sweep level %d of %d at %s%% MVC\n",
+				i + 1, nLevels, niceDouble(levels[i]));
+
+		g->firing_.contractionLevelAsPercentMVC = levels[i];
+
+		stageFlags = flags;
+		if (i > 0)
+			stageFlags |= Simulator::FLAG_USE_LAST_MUSCLE;
+
+		result = runStage(stageFlags,
+				(i == 0) ? &g->pathology : &noPathology,
+				sweepMuscle, (i < nLevels - 1));
+		if (result == NULL)
+			break;
+
+		if (result->getErrorState() != 0 || i == nLevels - 1)
+			break;
+
+		/**
+		 * keep the needle where the first level put it, so
+		 * that the MUPs already made remain valid
+		 */
+		g->needle_x_position = result->muscleData_->needle_->getXTipInMM();
+		g->needle_y_position = result->muscleData_->needle_->getYTipInMM();
+		g->needle_z_position = result->muscleData_->needle_->getZInMM();
+		g->seekNeedle = 0;
+
+		/** the next level takes over the muscle */
+		sweepMuscle = result->muscleData_;
+		result->muscleData_ = NULL;
+		delete result;
+		result = NULL;
+	}
+
+	g->firing_.contractionLevelAsPercentMVC = levelConfigured;
+	g->needle_x_position = xConfigured;
+	g->needle_y_position = yConfigured;
+	g->needle_z_position = zConfigured;
+	g->seekNeedle = seekConfigured;
+	return result;
+}
+
+SimulationResult *Simulator::runStage(
+		int flags,
+		PathologyControl *pathology,
+		MuscleData *previousStage,
+		int keepUnplowed
+	)
 {
 	char patientIdString[256];
 	char contractionDescription[1024 * 12];
@@ -341,8 +765,71 @@ SimulationResult *Simulator::run(int flags)
 	int emgFileId, status;
 	int isNewMuscle;
 	int needMfapsRebuilt;
+	int reuseCleanMUPs = 0;
+	float lastNeedle[6];
+	float *unplowedX = NULL, *unplowedY = NULL;
 	DQEmgData *outputContractionFile;
+	FiringSource *firingSource = NULL;
+	StageHashes currentHashes, storedHashes, outputHashes;
+	osUint32 configurationHash;
+	int stageWasRun[STAGE_NUM_HASHED];
+	int keepNeedle = 0, keepMUPs = 0;
+	int i;
+
+
+	/** statistics cover this run alone */
+	stageStatsSetEnabled(g->write_run_statistics);
+	stageStatsReset();
+
+	/**
+	 * find out which stages the last run can give us; a stage
+	 * is kept only if its hash, and so that of every stage
+	 * upstream of it, is unchanged
+	 */
+	calculateStageHashes(&currentHashes, g);
+	configurationHash = getConfigurationHash(&currentHashes);
+	memset(&storedHashes, 0, sizeof(StageHashes));
+	if (previousStage == NULL && (flags
+				& (Simulator::FLAG_INCREMENTAL
+					| Simulator::FLAG_USE_LAST_MUSCLE)) != 0)
+	{
+		attVal *lastOutput = getAttVal(g->list_, "LAST_OUTPUT");
+
+		if (lastOutput != NULL && lastOutput->data_.strptr_ != NULL)
+			loadStageHashes(&storedHashes, lastOutput->data_.strptr_);
+	}
 
+	if (previousStage == NULL && (flags & Simulator::FLAG_INCREMENTAL) != 0)
+	{
+		flags &= (~(Simulator::FLAG_USE_LAST_MUSCLE
+					| Simulator::FLAG_USE_OLD_FIRING_TIMES));
+		if ( ! stageHashMatches(&currentHashes, &storedHashes, STAGE_MUSCLE))
+			sFindCataloguedRun(configurationHash,
+					&currentHashes, &storedHashes);
+		if (stageHashMatches(&currentHashes, &storedHashes, STAGE_MUSCLE))
+		{
+			flags |= Simulator::FLAG_USE_LAST_MUSCLE;
+			if (stageHashMatches(&currentHashes,
+						&storedHashes, STAGE_FIRING))
+				flags |= Simulator::FLAG_USE_OLD_FIRING_TIMES;
+			keepNeedle = stageHashMatches(&currentHashes,
+						&storedHashes, STAGE_NEEDLE);
+			keepMUPs = keepNeedle && stageHashMatches(&currentHashes,
+						&storedHashes, STAGE_MUP);
+		}
+		LogNotice("Incremental run: %s muscle, %s firing, "
+					"%s needle, %s MUPs\n",
+				(flags & Simulator::FLAG_USE_LAST_MUSCLE)
+						? "keeping" : "new",
+				(flags & Simulator::FLAG_USE_OLD_FIRING_TIMES)
+						? "keeping" : "new",
+				keepNeedle ? "keeping" : "new",
+				keepMUPs ? "keeping" : "new");
+	}
+
+	memset(stageWasRun, 0, sizeof(stageWasRun));
+	stageWasRun[STAGE_MUSCLE] =
+			((flags & Simulator::FLAG_USE_LAST_MUSCLE) == 0);
 
 	needMfapsRebuilt = 0;
 	if ((flags & Simulator::FLAG_USE_LAST_MUSCLE) != 0)
@@ -350,6 +837,8 @@ SimulationResult *Simulator::run(int flags)
 		if ( ! reuseGlobalDirectoryInfo(g))
 		{
 			LogError("Directory management failed\n");
+			if (previousStage != NULL)
+				delete previousStage;
 			return NULL;
 		}
 	} else
@@ -365,6 +854,7 @@ SimulationResult *Simulator::run(int flags)
 
 
 	result = new SimulationResult();
+	result->muscleData_ = previousStage;
 
 	slnprintf(patientIdString, 256, "%d",
 			g->fileDescription.patient_id);
@@ -425,7 +915,11 @@ SimulationResult *Simulator::run(int flags)
 	writeAttValList(fp, g->list_, "version 2.2 simulator config file");
 	fclose(fp);
 
-	seedLocalRandom((int) time(NULL));
+	/** a fixed seed makes the run repeatable */
+	if (g->random_seed != 0)
+		seedLocalRandom(g->random_seed);
+	else
+		seedLocalRandom((int) time(NULL));
 
 	/** set up jitter factor */
 	MUP::sSetExpansionFactor(g->jitterInterpolationExpansion);
@@ -450,7 +944,36 @@ SimulationResult *Simulator::run(int flags)
 	}
 	result->setFileId( emgFileId );
 
-	if ((flags & Simulator::FLAG_USE_LAST_MUSCLE) != 0)
+	if (previousStage != NULL)
+	{
+		/**
+		 * derive this stage from the last one; remember where
+		 * its MUPs were recorded from so that we can tell if
+		 * they may be kept
+		 */
+		lastNeedle[0] = previousStage->needle_->getXTipInMM();
+		lastNeedle[1] = previousStage->needle_->getYTipInMM();
+		lastNeedle[2] = previousStage->needle_->getZInMM();
+		lastNeedle[3] = previousStage->needle_->getCannulaLengthInMM();
+		lastNeedle[4] = previousStage->needle_->getRadiusInMicrons();
+		lastNeedle[5] = previousStage->needle_->getSlope();
+
+		if ( ! applyMusclePathology(previousStage,
+					pathology, g->worker_threads) )
+		{
+			result->setState(-1);
+			LogError("Failure applying stage pathology\n");
+			goto CLEANUP;
+		}
+		if (pathology->neuropathicMULossFraction > 0
+				|| pathology->myopathicFractionOfFibresAffected > 0)
+		{
+			previousStage->differsFromSnapshot_ = 1;
+		}
+		needMfapsRebuilt = 1;
+		reuseCleanMUPs = 1;
+
+	} else if ((flags & Simulator::FLAG_USE_LAST_MUSCLE) != 0)
 	{
 		/** load data from last time */
 		result->muscleData_ = loadMuscleData(
@@ -468,6 +991,7 @@ SimulationResult *Simulator::run(int flags)
 
 		if (result->muscleData_->getNeedleInfo() == NULL)
 		{
+			keepNeedle = keepMUPs = 0;
 			setAndClipNeedleLocation(
 						result->muscleData_,
 						result->muscleData_->muscleDiameter_ / 2.0f,
@@ -491,7 +1015,7 @@ SimulationResult *Simulator::run(int flags)
 				g->muscle_dir,
 				g->output_dir,
 				g->muscle_,
-				&g->pathology,
+				pathology,
 				g->cannula_length,
 				(float) g->canPhysicalRadius,
 				g->needle_x_position,
@@ -499,7 +1023,9 @@ SimulationResult *Simulator::run(int flags)
 				g->needle_z_position,
 				g->mu_layout_type,
 				g->super_jitter_seeds,
-				g->muscleLayoutFunctionType
+				g->muscleLayoutFunctionType,
+				g->write_muscle_text,
+				g->worker_threads
 			);
 		if ( result->muscleData_ == NULL)
 		{
@@ -509,7 +1035,22 @@ SimulationResult *Simulator::run(int flags)
 		}
 	}
 
-	if (result->muscleData_->needle_->isDifferent(
+	/**
+	 * the MUPs of the last run were made for the MUs active
+	 * in it; any MU recruited now is made afresh
+	 */
+	if (keepMUPs)
+	{
+		for (i = 0; i < result->muscleData_->nActiveMotorUnits_; i++)
+			result->muscleData_->activeMotorUnit_[i]->setDirty(0);
+		needMfapsRebuilt = 1;
+		reuseCleanMUPs = 1;
+	} else if ((flags & Simulator::FLAG_INCREMENTAL) != 0)
+	{
+		needMfapsRebuilt = 1;
+	}
+
+	if ( ! keepNeedle && result->muscleData_->needle_->isDifferent(
 				g->needle_x_position,
 				g->needle_y_position,
 				g->needle_z_position,
@@ -529,21 +1070,33 @@ SimulationResult *Simulator::run(int flags)
 		needMfapsRebuilt = 1;
 	}
 
+	if (cacheMFAPs_ && result->muscleData_->MFAPCache_ == NULL)
+	{
+		result->muscleData_->MFAPCache_ = new MFAPCache(
+				MUP_LENGTH,
+				g->MFAP_reuse_tolerance,
+				(int) ((g->MFAP_cache_size_in_MB * 1024.0 * 1024.0)
+						/ (2.0 * MUP_LENGTH * sizeof(MUPDataElement))));
+	}
+
 	result->muscleData_->validate();
-	if ((flags & Simulator::FLAG_USE_OLD_FIRING_TIMES) != 0)
+	if (previousStage != NULL
+			&& (flags & Simulator::FLAG_USE_OLD_FIRING_TIMES) != 0)
 	{
-		status = loadFiring(
-				result->muscleData_,
-				g->firings_dir
-			);
-		if ( ! status )
-		{
-			result->setState(-1);
-			LogError("Failure in firing load routine\n");
-			goto CLEANUP;
-		}
+		/** the trains of the last stage are still in memory */
+		firingSource = new MemoryFiringSource();
+
+	} else if ((flags & Simulator::FLAG_USE_OLD_FIRING_TIMES) != 0)
+	{
+		/**
+		 * re-use the trains exported by an earlier run;
+		 * they are streamed from disk one MU at a time
+		 * while the EMG is built
+		 */
+		firingSource = new DiskFiringSource(g->firings_dir);
 	} else
 	{
+		stageWasRun[STAGE_FIRING] = 1;
 		status = firing(
 				g->firings_dir,
 				result->muscleData_,
@@ -554,7 +1107,9 @@ SimulationResult *Simulator::run(int flags)
 				g->firing_.maximumFiringRate,
 				g->firing_.maximumFiringThreshold,
 				g->emg_elapsed_time,
-				0
+				0,
+				g->write_firing_files,
+				g->worker_threads
 			);
 
 		if ( ! status )
@@ -564,11 +1119,14 @@ SimulationResult *Simulator::run(int flags)
 			goto CLEANUP;
 		}
 
+		/** the new trains are handed to makeEmg in memory */
+		firingSource = new MemoryFiringSource();
+
 	}
 
 
 	result->muscleData_->validate();
-	if (g->seekNeedle)
+	if (g->seekNeedle && ! keepNeedle)
 	{
 		if ( ! seekNeedleToNearbyFibres(
 					result->muscleData_,
@@ -582,6 +1140,19 @@ SimulationResult *Simulator::run(int flags)
 	}
 
 
+	/**
+	 * if the needle has ended up somewhere else than in the
+	 * last stage, none of the MUPs made there can be kept
+	 */
+	if (previousStage != NULL && reuseCleanMUPs
+			&& result->muscleData_->needle_->isDifferent(
+				lastNeedle[0], lastNeedle[1], lastNeedle[2],
+				lastNeedle[3], lastNeedle[4], lastNeedle[5]))
+	{
+		for (i = 0; i < result->muscleData_->getNumMotorUnits(); i++)
+			result->muscleData_->motorUnit_[i]->setDirty(1);
+	}
+
 	result->muscleData_->validate();
 	if ( ! storeNeedleInfo(
 				result->muscleData_,
@@ -595,11 +1166,24 @@ SimulationResult *Simulator::run(int flags)
 	}
 
 	result->muscleData_->validate();
+	if (keepUnplowed)
+	{
+		sRecordFibreLocations(result->muscleData_, &unplowedX, &unplowedY);
+	}
+
+	/**
+	 * a stage whose pathology has changed the muscle no longer
+	 * matches the unplowed snapshot, so its whole plowed layout
+	 * is written
+	 */
 	if ( ! plowMuscleFibres(
 				emgFileId,
 				g->output_dir,
+				result->muscleData_->differsFromSnapshot_
+						? NULL : g->muscle_dir,
 				result->muscleData_,
-				(float) g->canPhysicalRadius
+				(float) g->canPhysicalRadius,
+				g->write_muscle_text
 			) )
 	{
 		result->setState(-1);
@@ -637,6 +1221,7 @@ SimulationResult *Simulator::run(int flags)
 		if ((irStat(g->MUPs_dir, &sb) < 0) && (errno == ENOENT))
 		{
 			needMfapsRebuilt = 1;
+			reuseCleanMUPs = 0;
 		}
 	}
 
@@ -648,11 +1233,12 @@ SimulationResult *Simulator::run(int flags)
 	 */
 	if ( needMfapsRebuilt )
 	{
-
+		stageWasRun[STAGE_MUP] = 1;
 		status = makeMUP(
 				result->muscleData_,
 				&result->MUPIdList_,
-				&result->nMUPs_
+				&result->nMUPs_,
+				reuseCleanMUPs
 			);
 		if ( ! status )
 		{
@@ -665,7 +1251,7 @@ SimulationResult *Simulator::run(int flags)
 
 
 	result->muscleData_->validate();
-	status = makeEmg(result->muscleData_, emgFileId);
+	status = makeEmg(result->muscleData_, firingSource, emgFileId);
 	if (! status)
 	{
 		result->setState(-1);
@@ -708,6 +1294,29 @@ SimulationResult *Simulator::run(int flags)
 	result->muscleData_->validate();
 	saveOutputDirConfigFile(g, emgFileId);
 
+	/**
+	 * record what the outputs of this run were made from; a
+	 * stage derived from another in memory cannot be made again
+	 * from the configuration alone, so nothing is recorded
+	 */
+	if (previousStage == NULL)
+	{
+		/** firing trains are only kept if they were exported */
+		if ( ! g->write_firing_files )
+			currentHashes.sh_isValid[STAGE_FIRING] = 0;
+		stageWasRun[STAGE_NEEDLE] = ! keepNeedle;
+		resolveStageHashes(&outputHashes,
+				&currentHashes, &storedHashes, stageWasRun);
+		storeStageHashes(&outputHashes, g->muscle_dir);
+		sCatalogueRun(configurationHash, &outputHashes);
+	} else
+	{
+		removeStageHashes(g->muscle_dir);
+	}
+
+	if (g->write_run_statistics)
+		sWriteRunStatistics(emgFileId);
+
 	{
 		char tmpBuffer[BUFSIZ];
 		char *filename;
@@ -743,9 +1352,33 @@ SimulationResult *Simulator::run(int flags)
 	}
 
 CLEANUP:
+	if (unplowedX != NULL)
+	{
+		if (result->muscleData_ != NULL)
+			sRestoreFibreLocations(result->muscleData_, unplowedX, unplowedY);
+		ckfree(unplowedX);
+		ckfree(unplowedY);
+	}
+	if (firingSource != NULL)
+		delete firingSource;
+	stageStatsCleanup();
 	return result;
 }
 
+int Simulator::upgradeMuscleFiles(const char *path)
+{
+	SimulationContextBinding binding(context_);
+
+	LogInfo("Upgrading muscle files in '%s'\n", path);
+	if ( ! setupGlobalDirectoryInfoForOpen(g, path) )
+	{
+		LogError("Directory management failed\n");
+		return 0;
+	}
+
+	return upgradeMuscleDirectory(g->muscle_dir, g->output_dir);
+}
+
 SimulationResult *Simulator::open(
 		const char *path,
 		int contractionId,
@@ -757,6 +1390,7 @@ SimulationResult *Simulator::open(
 	SimulationResult *result;
 	int status;
 	/*FILE *zohre;*/
+	SimulationContextBinding binding(context_);
 
 	LogInfo("Opening simulator with path '%s'\n", path);
 	if ( ! setupGlobalDirectoryInfoForOpen(g, path) )
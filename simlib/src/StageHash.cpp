@@ -0,0 +1,390 @@
+/**
+ ** Content hashes of the inputs of the expensive simulation stages
+ **
+ ** $Id$
+ **/
+
+#include "os_defs.h"
+
+#ifndef MAKEDEPEND
+# include <stdio.h>
+# include <stdlib.h>
+# include <stddef.h>
+# include <string.h>
+#endif
+
+#include "tclCkalloc.h"
+#include "attvalfile.h"
+#include "tokens.h"
+#include "pathtools.h"
+#include "stringtools.h"
+#include "log.h"
+
+#include "SimulatorControl.h"
+#include "muscle.h"
+#include "StageHash.h"
+
+#ifdef OS_WINDOWS
+# pragma warning(disable : 4996)
+#endif
+
+/** 32 bit FNV-1a */
+#define	STAGE_HASH_OFFSET_BASIS		((osUint32) 2166136261UL)
+#define	STAGE_HASH_PRIME			((osUint32) 16777619UL)
+
+/** one configuration value read by a stage */
+typedef struct StageInput {
+	const char *si_name;
+	size_t si_offset;
+	size_t si_size;
+} StageInput;
+
+#define	GLOBAL_INPUT(field)											\
+		{ #field, offsetof(struct globals, field),					\
+				sizeof(((struct globals *) 0)->field) }
+
+#define	MUSCLE_INPUT(field)											\
+		{ #field, offsetof(struct MuscleParameters, field),			\
+				sizeof(((struct MuscleParameters *) 0)->field) }
+
+#define	NO_STAGE	(-1)
+
+typedef struct StageDefinition {
+	const char *sd_name;
+	const char *sd_tag;
+
+	/** upstream stage, which always comes earlier in the table */
+	int sd_upstream;
+
+	const StageInput *sd_globalInputs;
+	int sd_nGlobalInputs;
+	const StageInput *sd_muscleInputs;
+	int sd_nMuscleInputs;
+} StageDefinition;
+
+
+static const StageInput sMuscleGlobalInputs[] = {
+		GLOBAL_INPUT(random_seed),
+		GLOBAL_INPUT(muscleLayoutFunctionType),
+		GLOBAL_INPUT(mu_layout_type),
+		GLOBAL_INPUT(super_jitter_seeds),
+		GLOBAL_INPUT(pathology),
+		GLOBAL_INPUT(myopathicFibreGraduallyDying),
+		GLOBAL_INPUT(myopathicDependentProcedure),
+		GLOBAL_INPUT(myopathicCycleNewInvolvementPercentage)
+	};
+
+static const StageInput sMuscleParameterInputs[] = {
+		MUSCLE_INPUT(numMotorUnits),
+		MUSCLE_INPUT(fibreDensity),
+		MUSCLE_INPUT(areaPerFibre),
+		MUSCLE_INPUT(minMUDiam),
+		MUSCLE_INPUT(maxMUDiam),
+		MUSCLE_INPUT(modelLayoutDistanceInUM),
+		MUSCLE_INPUT(fibreLayoutWeightingNoiseFactor)
+	};
+
+static const StageInput sFiringGlobalInputs[] = {
+		GLOBAL_INPUT(firing_),
+		GLOBAL_INPUT(emg_elapsed_time)
+	};
+
+static const StageInput sNeedleGlobalInputs[] = {
+		GLOBAL_INPUT(needle_x_position),
+		GLOBAL_INPUT(needle_y_position),
+		GLOBAL_INPUT(needle_z_position),
+		GLOBAL_INPUT(cannula_length),
+		GLOBAL_INPUT(canPhysicalRadius),
+		GLOBAL_INPUT(seekNeedle),
+		GLOBAL_INPUT(minimumMuscleMetricThreshold)
+	};
+
+static const StageInput sMUPGlobalInputs[] = {
+		GLOBAL_INPUT(smpling_freq),
+		GLOBAL_INPUT(electrode_type),
+		GLOBAL_INPUT(tipUptakeDistance),
+		GLOBAL_INPUT(canUptakeDistance),
+		GLOBAL_INPUT(MUPs_per_mu),
+		GLOBAL_INPUT(stddev_x),
+		GLOBAL_INPUT(stddev_y),
+		GLOBAL_INPUT(stddev_z),
+		GLOBAL_INPUT(jitterAccelThreshold),
+		GLOBAL_INPUT(jitterInterpolationExpansion),
+		GLOBAL_INPUT(significantFibreAccelerationThreshold),
+		GLOBAL_INPUT(generateMFPsWithoutInitiation),
+		GLOBAL_INPUT(recordMFPPeakToPeak)
+	};
+
+#define	NELEMENTS(a)	((int) (sizeof(a) / sizeof(a[0])))
+
+static const StageDefinition sStages[STAGE_NUM_HASHED] = {
+		{ "muscle", "MUSCLE_HASH", NO_STAGE,
+				sMuscleGlobalInputs, NELEMENTS(sMuscleGlobalInputs),
+				sMuscleParameterInputs, NELEMENTS(sMuscleParameterInputs) },
+		{ "firing", "FIRING_HASH", STAGE_MUSCLE,
+				sFiringGlobalInputs, NELEMENTS(sFiringGlobalInputs),
+				NULL, 0 },
+		{ "needle", "NEEDLE_HASH", STAGE_MUSCLE,
+				sNeedleGlobalInputs, NELEMENTS(sNeedleGlobalInputs),
+				NULL, 0 },
+		{ "MUP", "MUP_HASH", STAGE_NEEDLE,
+				sMUPGlobalInputs, NELEMENTS(sMUPGlobalInputs),
+				NULL, 0 }
+	};
+
+
+static osUint32
+sHashBytes(osUint32 hash, const void *data, size_t size)
+{
+	const unsigned char *bytes = (const unsigned char *) data;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= STAGE_HASH_PRIME;
+	}
+	return hash;
+}
+
+static osUint32
+sHashInputs(
+		osUint32 hash,
+		const void *base,
+		const StageInput *inputs,
+		int nInputs
+	)
+{
+	int i;
+
+	for (i = 0; i < nInputs; i++)
+	{
+		hash = sHashBytes(hash,
+				((const char *) base) + inputs[i].si_offset,
+				inputs[i].si_size);
+	}
+	return hash;
+}
+
+const char *
+getStageName(int stage)
+{
+	if (stage < 0 || stage >= STAGE_NUM_HASHED)
+		return "unknown";
+	return sStages[stage].sd_name;
+}
+
+void
+calculateStageHashes(StageHashes *hashes, struct globals *globals)
+{
+	const StageDefinition *stage;
+	MuscleParameters *muscle = globals->muscle_;
+	osUint32 hash;
+	int upstream;
+	int i;
+
+	for (i = 0; i < STAGE_NUM_HASHED; i++)
+	{
+		stage = &sStages[i];
+		upstream = stage->sd_upstream;
+
+		/** a seeking needle is moved towards the active fibres */
+		if (i == STAGE_NEEDLE && globals->seekNeedle)
+			upstream = STAGE_FIRING;
+
+		hash = STAGE_HASH_OFFSET_BASIS;
+		if (upstream != NO_STAGE)
+		{
+			hash = sHashBytes(hash,
+					&hashes->sh_hash[upstream], sizeof(osUint32));
+		}
+		hash = sHashInputs(hash, globals,
+					stage->sd_globalInputs, stage->sd_nGlobalInputs);
+		if (stage->sd_nMuscleInputs > 0)
+		{
+			hash = sHashInputs(hash, muscle,
+					stage->sd_muscleInputs, stage->sd_nMuscleInputs);
+		}
+
+		/** the layout functions are chosen and weighted per muscle */
+		if (i == STAGE_MUSCLE)
+		{
+			if (muscle->fibreLayoutProbabilityFunctionProbabilities != NULL)
+			{
+				hash = sHashBytes(hash,
+						muscle->fibreLayoutProbabilityFunctionProbabilities,
+						sizeof(float)
+							* muscle->numFibreLayoutProbabilityFunctions);
+			}
+			if (muscle->fibreLayoutWeightingFunctionWeights != NULL)
+			{
+				hash = sHashBytes(hash,
+						muscle->fibreLayoutWeightingFunctionWeights,
+						sizeof(float)
+							* muscle->numFibreLayoutWeightingFunctions);
+			}
+		}
+
+		hashes->sh_hash[i] = hash;
+		hashes->sh_upstream[i] = upstream;
+		hashes->sh_isValid[i] = 1;
+	}
+}
+
+int
+stageHashMatches(
+		const StageHashes *current,
+		const StageHashes *stored,
+		int stage
+	)
+{
+	return current->sh_isValid[stage] && stored->sh_isValid[stage]
+			&& current->sh_hash[stage] == stored->sh_hash[stage];
+}
+
+void
+resolveStageHashes(
+		StageHashes *outputs,
+		const StageHashes *current,
+		const StageHashes *stored,
+		const int *wasRun
+	)
+{
+	const StageHashes *source;
+	int upstream;
+	int i;
+
+	for (i = 0; i < STAGE_NUM_HASHED; i++)
+	{
+		source = wasRun[i] ? current : stored;
+		outputs->sh_hash[i] = source->sh_hash[i];
+		outputs->sh_isValid[i] = source->sh_isValid[i];
+
+		upstream = current->sh_upstream[i];
+		if (upstream != NO_STAGE
+				&& ( ! outputs->sh_isValid[upstream]
+					|| ! source->sh_isValid[upstream]
+					|| outputs->sh_hash[upstream]
+							!= source->sh_hash[upstream]))
+		{
+			outputs->sh_isValid[i] = 0;
+		}
+	}
+}
+
+osUint32
+getConfigurationHash(const StageHashes *hashes)
+{
+	osUint32 hash = STAGE_HASH_OFFSET_BASIS;
+	int i;
+
+	for (i = 0; i < STAGE_NUM_HASHED; i++)
+	{
+		if (hashes->sh_isValid[i])
+			hash = sHashBytes(hash, &hashes->sh_hash[i], sizeof(osUint32));
+	}
+	return hash;
+}
+
+void
+formatStageHashes(char *buffer, int size, const StageHashes *hashes)
+{
+	int i, len = 0;
+
+	buffer[0] = 0;
+	for (i = 0; i < STAGE_NUM_HASHED && len < size; i++)
+	{
+		if ( ! hashes->sh_isValid[i] )
+			continue;
+		len += slnprintf(&buffer[len], size - len, "%s%s=%08lx",
+				(len > 0) ? "," : "", sStages[i].sd_name,
+				(unsigned long) hashes->sh_hash[i]);
+	}
+}
+
+static char *
+sHashFilename(const char *muscleDirectory)
+{
+	char tmpBuffer[FILENAME_MAX];
+
+	slnprintf(tmpBuffer, FILENAME_MAX, "%s\\%s",
+				muscleDirectory, STAGE_HASH_FILENAME);
+	return osIndependentPath(tmpBuffer);
+}
+
+int
+loadStageHashes(StageHashes *hashes, const char *muscleDirectory)
+{
+	attValList *list;
+	attVal *attribute;
+	char *filename;
+	int i, nLoaded = 0;
+
+	memset(hashes, 0, sizeof(StageHashes));
+
+	filename = sHashFilename(muscleDirectory);
+	list = loadAttValFile(filename);
+	ckfree(filename);
+	if (list == NULL)
+		return 0;
+
+	for (i = 0; i < STAGE_NUM_HASHED; i++)
+	{
+		attribute = getAttVal(list, sStages[i].sd_tag);
+		if (attribute != NULL && attribute->type_ == TT_STRING)
+		{
+			hashes->sh_hash[i] = (osUint32)
+					strtoul(attribute->data_.strptr_, NULL, 16);
+			hashes->sh_isValid[i] = 1;
+			nLoaded++;
+		}
+	}
+	deleteAttValList(list);
+
+	return nLoaded > 0;
+}
+
+int
+storeStageHashes(const StageHashes *hashes, const char *muscleDirectory)
+{
+	attValList *list;
+	char hexValue[16];
+	char *filename;
+	FILE *fp;
+	int i;
+
+	filename = sHashFilename(muscleDirectory);
+	fp = fopenpath(filename, "wb");
+	if (fp == NULL)
+	{
+		LogError("Cannot open stage hash file '%s' for writing\n",
+					filename);
+		ckfree(filename);
+		return 0;
+	}
+	ckfree(filename);
+
+	list = createAttValList();
+	for (i = 0; i < STAGE_NUM_HASHED; i++)
+	{
+		if ( ! hashes->sh_isValid[i] )
+			continue;
+		slnprintf(hexValue, 16, "%08lx", (unsigned long) hashes->sh_hash[i]);
+		addAttVal(list, createStringAttribute(sStages[i].sd_tag, hexValue));
+	}
+	writeAttValList(fp, list, "stage input hashes");
+	deleteAttValList(list);
+	fclose(fp);
+
+	return 1;
+}
+
+void
+removeStageHashes(const char *muscleDirectory)
+{
+	char *filename;
+
+	filename = sHashFilename(muscleDirectory);
+	remove(filename);
+	ckfree(filename);
+}
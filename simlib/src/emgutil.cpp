@@ -42,6 +42,8 @@
 #include "MUP_utils.h"
 #include "JitterDB.h"
 #include "NoiseGenerator.h"
+#include "FiringSource.h"
+#include "StageTimer.h"
 
 #include "log.h"
 #include "massert.h"
@@ -58,7 +60,6 @@
 # pragma warning(disable : 4996)
 #endif
 
-#define INPUT_BUFFER_SIZE       2048
 
 #define EMG_PEAK_ALIGN          0
 #define EMG_AREA_ALIGN          1
@@ -265,16 +266,17 @@ mapGoldStandardMupTemplates(const char *outputDirectory)
 /**
  ** ----------------------------------------------------------------
  ** Function:     MAKE_EMG
- **    Description:  Makes an emg using the firing times and MUP files.
+ **    Description:  Makes an emg using the MUP files and the firing
+ **                  times supplied by the given FiringSource.
  **
  **
  **/
 int makeEmg(
 		MuscleData *MD,
+		FiringSource *firingSource,
 		int fileId
 	)
 {
-	char input_buffer[INPUT_BUFFER_SIZE];
 	int currentFiringTimeIndex, activeMotorUnitIndex;
 	int m, i;
 	char filename[FILENAME_MAX];
@@ -289,7 +291,7 @@ int makeEmg(
 	//float StartTime;
 	float FinishTime;
 
-	long *firingTimeList;
+	const long *firingTimeList = NULL;
 	long abs_stop_time_smpls;
 	long emgBufferLengthInSamples;
 	long emgBufferIndex;
@@ -305,7 +307,6 @@ int makeEmg(
 		 * time samples
 		 */
 
-	FILE *firingTimeFP = NULL;
 	FP *emgFP = NULL;
 
 #ifdef  SAVE_ASCII_EMG_DATA
@@ -323,6 +324,7 @@ int makeEmg(
 	MUP    *currentMUP = NULL;
 	int MUPsRecordedForCurrentMUP = 0;
 	//double MUPMaxAcceleration = 0;
+	StageTimer timer("EMG");
 
 
 
@@ -445,8 +447,8 @@ int makeEmg(
 	{
 
 
-		LogInfo("    Recording firings for MUP %s\n",
-		                reportTime(activeMotorUnitIndex, reportTimer));
+		LOG_PROGRESS(LogInfo("    Recording firings for MUP %s\n",
+		                reportTime(activeMotorUnitIndex, reportTimer)));
 
 
 		/* load the MUP buffer */
@@ -466,70 +468,16 @@ int makeEmg(
 
 
 
-		/* open and read the  motor unit firing times file */
-		slnprintf(filename, FILENAME_MAX, "%s\\FTMU%d.dat",
-		        g->firings_dir, currentMotorUnit->getID());
-
-
-		if ((firingTimeFP = fopenpath(filename, "rb")) == NULL)
-		{
-		    Error("\nError : Failed to open firing times file %s ",
-		            filename);
-		    goto FAIL;
-		}
-
-		do
-		{
-		    if (fgets(input_buffer, INPUT_BUFFER_SIZE, firingTimeFP) == NULL)
-			{
-		        Error("Bad return from fgets %s(%d)\n", __FILE__, __LINE__);
-		        return 0;
-		    }
-		} while (input_buffer[0] == '#');
-		if (sscanf(input_buffer, "%d", &nFiringTimes) != 1)
-		{
-		        Error("Cannot parse firing times from:\n%s\n", input_buffer);
-		        return 0;
-		}
-
-		/* allocate a vector to contain the firing time samples */
-		firingTimeList =
-		    (long *) ckalloc((nFiringTimes) * (sizeof(long)));
-		if (firingTimeList == NULL)
+		/* get the firing train for this motor unit */
+		if ( ! firingSource->getFiringTimes(currentMotorUnit,
+					&firingTimeList, &nFiringTimes) )
 		{
-		    Error("\n\nError in allocating firing time vector.");
+		    Error("\nError : Failed to obtain firing times for MU %d\n",
+		            currentMotorUnit->getID());
 		    goto FAIL;
 		}
 
 
-		for (currentFiringTimeIndex = 0;
-						currentFiringTimeIndex < nFiringTimes;
-										currentFiringTimeIndex++)
-		{
-		    long loadValue;
-			char *inputLine;
-		    do
-			{
-		        inputLine = fgets(input_buffer,
-								INPUT_BUFFER_SIZE, firingTimeFP);
-		        if (inputLine == NULL)
-				{
-		            Error("Bad return from fgets %s(%d)\n", __FILE__, __LINE__);
-		            return 0;
-		        }
-		    } while (input_buffer[0] == '#');
-
-		    if (sscanf(input_buffer, "%ld", &loadValue) != 1)
-			{
-		            LogError("Cannot parse firing time %d from:\n%s\n",
-		                        currentFiringTimeIndex, input_buffer);
-		            return 0;
-		    }
-		    firingTimeList[currentFiringTimeIndex] = loadValue;
-		}
-		fclose(firingTimeFP);
-
-
 		/** ensure that we have no leftover jitters for this MUP */
 		currentMUP->resetJitterAccounting();
 
@@ -736,7 +684,8 @@ int makeEmg(
 		                GST_ACCEL_THRESHOLD,
 		                MUPMaxAcceleration);
 		*/
-		ckfree(firingTimeList);
+		firingSource->releaseFiringTimes(firingTimeList);
+		firingTimeList = NULL;
 	}
 
 	deleteReportTimer(reportTimer);
@@ -745,6 +694,8 @@ int makeEmg(
 
 	if (g->use_noise)
 	{
+		StageTimer noiseTimer("EMG noise");
+
 		addNoiseToBuffer(EMG, emgBufferLengthInSamples,
 		                1000.0/DELTA_T_EMG, g->signalToNoiseRatio);
 	}
@@ -823,6 +774,8 @@ int makeEmg(
 	ckfree(EMG);
 
 	LogInfo("%d MUPs added\n\n", totalMUPs);
+	STAGESTATS_COUNT("MUP firings", totalMUPs);
+	STAGESTATS_COUNT("samples", emgBufferLengthInSamples);
 
 
 	if (currentMUP != NULL)
@@ -831,6 +784,7 @@ int makeEmg(
 		currentMUP = NULL;
 	}
 
+	STAGESTATS_COUNT("bytes written", ftell(emgFP->fp));
 	closeFP(emgFP);
 
 	LogInfo("EMG file \"%s%cemg%d.dat\" created.\n",
@@ -925,6 +879,8 @@ int makeEmg(
 
 
 FAIL:   /** clean up on failure */
+	if (firingTimeList != NULL)
+		firingSource->releaseFiringTimes(firingTimeList);
 	if (dco != NULL)        deleteDcoData(dco);
 	return -1;
 }
@@ -41,6 +41,7 @@
 #include "tclCkalloc.h"
 #include "reporttimer.h"
 #include "random.h"
+#include "workpool.h"
 #include "pathtools.h"
 #include "stringtools.h"
 #include "listalloc.h"
@@ -50,6 +51,8 @@
 
 #define PRIVATE public
 #include "MuscleData.h"
+#include "FiringSource.h"
+#include "StageTimer.h"
 
 
 #ifdef OS_WINDOWS
@@ -63,16 +66,75 @@
 #endif
 
 
+/**
+ * Per-firing diagnostics are only logged when this is non-zero;
+ * otherwise only the summary counts are reported by firing()
+ */
+static int sFiringLogVerbosity = 0;
+
+OS_EXPORT void
+setFiringLogVerbosity(int verbosity)
+{
+	sFiringLogVerbosity = verbosity;
+}
+
+
+/**
+ * Upper bound on the number of firings in a train.
+ *
+ * Every IPI is at least ceil(10000 / meanFiringRate) (the gaussian
+ * term only lengthens it), and generation stops with the first
+ * firing past the end of the generation window, so a train never
+ * holds more than this many firings.
+ */
+static int
+estimateMaxFirings(
+		float meanFiringRate,
+		int maxGenerationTimeInSeconds
+	)
+{
+	long minimumIPI;
+
+	minimumIPI = (long) ceil(10000.0 * (1.0 / meanFiringRate)) - 1;
+	if (minimumIPI < 1)
+		minimumIPI = 1;
+
+	return (int) ((maxGenerationTimeInSeconds * 10000L) / minimumIPI) + 2;
+}
+
+
+/**
+ * Make room for at least nNeeded firing times.  The list is
+ * normally sized once from estimateMaxFirings(); should that
+ * ever fall short growArrayReserve() doubles it, so the copying
+ * stays linear in the train length.
+ */
+static int
+growFiringTimeList(MotorUnit *currentMU, int nNeeded)
+{
+	return growArrayReserve(
+			nNeeded,
+			(void **) &currentMU->mu_firingTime_,
+			&currentMU->mu_nFiringsAllocated_,
+			sizeof(long));
+}
+
+
 /**
  * Calculate firings times for a single motor unit
  *
  * The equation for the firing times
  * (currentMU->mu_firingTime_[X])
  * is based on Andy Fuglevand's work
+ *
+ * All random values are drawn from the MU's own stream, so the
+ * train depends only on the stream seed and not on which other
+ * trains are being generated at the same time.
  */
 static int
 calculateSingleMUFiringTimes(
 		MotorUnit *currentMU,
+		randomStream *stream,
 		int *nTimesFiringTooShort,
 		float *meanIPI,
 		float meanFiringRate,
@@ -100,15 +162,19 @@ calculateSingleMUFiringTimes(
 	 */
 	currentMU->mu_nFirings_ = 0;
 
+	/** size the list for the whole train up front */
+	if ( ! growFiringTimeList(currentMU,
+				estimateMaxFirings(meanFiringRate,
+						maxGenerationTimeInSeconds)) )
+	{
+		LogCrit("Cannot allocate firing times for MU %d\n",
+					currentMU->mu_id_);
+		return 0;
+	}
+
 	/** add the first firing time separately */
-	listMkCheckSize(
-			1,
-			(void **) &currentMU->mu_firingTime_,
-			&currentMU->mu_nFiringBlocks_,
-			16,
-			sizeof(long), __FILE__, __LINE__);
 	currentMU->mu_firingTime_[0] = (long)
-			(ceil(10000. * (floatNormalizedRandom())
+			(ceil(10000. * (randomStreamFloat(stream))
 					* (1 / meanFiringRate)));
 	currentMU->mu_nFirings_ = 1;
 
@@ -118,7 +184,7 @@ calculateSingleMUFiringTimes(
 			< (maxGenerationTimeInSeconds * 10000L))
 	{
 
-		gaussianVariable = fabs(gauss01());
+		gaussianVariable = fabs(randomStreamGauss01(stream));
 		newDoubleFiringTime =
 				ceil(10000.0 * (1.0 / meanFiringRate
 				+ (1.0 / meanFiringRate)
@@ -141,10 +207,13 @@ calculateSingleMUFiringTimes(
 		/* error check */
 		if (newLongFiringTime < 100)
 		{
-			Error("IPI %d only %ld -- minimum time 10 ms\n",
-					currentMU->mu_nFirings_,
-					newLongFiringTime);
-			Error("   Gaussian value %f\n", gaussianVariable);
+			if (sFiringLogVerbosity > 0)
+			{
+				Error("IPI %d only %ld -- minimum time 10 ms\n",
+						currentMU->mu_nFirings_,
+						newLongFiringTime);
+				Error("   Gaussian value %f\n", gaussianVariable);
+			}
 			(*nTimesFiringTooShort)++;
 			newDoubleFiringTime = 100;
 		}
@@ -164,16 +233,16 @@ calculateSingleMUFiringTimes(
 					];
 
 		/**
-		 * grow the firing list (if necessary)
-		 * and store the new time in the list.
+		 * store the new time in the list; this only grows
+		 * the list if the estimate above was exceeded
 		 */
-		listMkCheckSize(
-					currentMU->mu_nFirings_ + 1,
-					(void **)
-						&currentMU->mu_firingTime_,
-					&currentMU->mu_nFiringBlocks_,
-					16,
-					sizeof(long), __FILE__, __LINE__);
+		if ( ! growFiringTimeList(currentMU,
+					currentMU->mu_nFirings_ + 1) )
+		{
+			LogCrit("Cannot grow firing times for MU %d\n",
+						currentMU->mu_id_);
+			return 0;
+		}
 
 		currentMU->mu_firingTime_[
 						currentMU->mu_nFirings_
@@ -193,6 +262,51 @@ calculateSingleMUFiringTimes(
 }
 
 
+/**
+ * Everything needed to generate one MU's train, and the summary
+ * values it produces.  One of these is filled in for each active
+ * MU, in MU order, before any trains are generated.
+ */
+typedef struct FiringTrainTask
+{
+	MotorUnit *ft_motorUnit;
+	long   ft_seed;
+	float  ft_meanFiringRate;
+	float  ft_meanIPI;
+	int    ft_nTimesFiringTooShort;
+} FiringTrainTask;
+
+typedef struct FiringTrainJob
+{
+	FiringTrainTask *fj_tasks;
+	int    fj_totalElapsedTimeInSeconds;
+	float  fj_coefficientOfVarianceInFiringTimes;
+} FiringTrainJob;
+
+/**
+ * Worker pool task: generate the train for a single MU
+ */
+static int
+generateFiringTrainTask(int taskIndex, void *userData)
+{
+	FiringTrainJob *job = (FiringTrainJob *) userData;
+	FiringTrainTask *task = &job->fj_tasks[taskIndex];
+	randomStream stream;
+
+	seedRandomStream(&stream, task->ft_seed);
+
+	return calculateSingleMUFiringTimes(
+				task->ft_motorUnit,
+				&stream,
+				&task->ft_nTimesFiringTooShort,
+				&task->ft_meanIPI,
+				task->ft_meanFiringRate,
+				job->fj_totalElapsedTimeInSeconds,
+				job->fj_coefficientOfVarianceInFiringTimes
+			);
+}
+
+
 /**
  * Calculate firing times for all MUs above their firing threshold.
  *
@@ -200,6 +314,16 @@ calculateSingleMUFiringTimes(
  * If activation level is above motor unit i's activation
  * threshold, set firing rate for motor unit i, repeat
  * for all i
+ *
+ * The trains do not depend on one another once the thresholds
+ * are set, so they are generated concurrently by a worker pool.
+ * Each MU draws on its own random stream, seeded from a single
+ * value taken from the global generator and the MU id; the trains
+ * are then gathered (and exported) in MU order, so the results
+ * are the same whatever number of threads is used.
+ *
+ * The thresholds belong to the caller, which frees them whether
+ * or not this succeeds.
  */
 static int
 calculateFiringTimes(
@@ -213,19 +337,21 @@ calculateFiringTimes(
 		float contractionLevelAsPercentMVC,
 		float recruitmentSlope,
 		float minimumFiringRate,
-		float maximumFiringRate
+		float maximumFiringRate,
+		int exportFiringTimes,
+		int nThreads
 	)
 {
-	char ftmuFilename[FILENAME_MAX];
-	FILE *ftmuFP;
+	FiringTrainJob job;
+	FiringTrainTask *task;
 	MotorUnit *currentMU;
 	float meanFiringRate;
-	float meanIPI;
+	long baseSeed;
 	long difference;
 	long totalFirings = 0;
 	float squaredMean;
 	//float variance;
-	int i, j;
+	int i, j, status = 0;
 
 	/** if there are previous active MU's we delete them first */
 	if (MD->activeMotorUnit_ != NULL)
@@ -233,28 +359,25 @@ calculateFiringTimes(
 		ckfree(MD->activeMotorUnit_);
 		MD->activeMotorUnit_ = NULL;
 		MD->nActiveMotorUnits_ = 0;
-		MD->nActiveMotorUnitBlocks_ = 0;
+		MD->nActiveMotorUnitsAllocated_ = 0;
 	}
 
 
 	*nTimesFiringTooShort = 0;
 	*pps = 0;
 
+	/**
+	 * one draw from the global generator seeds every MU stream,
+	 * so the global sequence advances identically however the
+	 * trains are generated
+	 */
+	baseSeed = (long) localRandom();
 
-//	LogInfo("\n");
-//	LogInfo("Firing rate by active MU in detection area:\n");
-//	LogInfo("\n");
-//
-//	LogInfo(
-//		" -----+------------+------------+----------+----------+\n");
-//	LogInfo(
-//		"      | Mean Firing|            |          | Coeff.   |\n");
-//	LogInfo(
-//		" MU # |     Rate   |  Mean IPI  | Std. Dev |    of    |\n");
-//	LogInfo(
-//		"      |  (imp/sec) |   (msec)   |          | Variance |\n");
-//	LogInfo(
-//		" -----+------------+------------+----------+----------+\n");
+	job.fj_tasks = (FiringTrainTask *) ckalloc(sizeof(FiringTrainTask)
+				* (MD->nMotorUnitsInDetectionArea_ + 1));
+	job.fj_totalElapsedTimeInSeconds = totalElapsedTimeInSeconds;
+	job.fj_coefficientOfVarianceInFiringTimes =
+				coefficientOfVarianceInFiringTimes;
 
 	for (i = 0; i < MD->nMotorUnitsInDetectionArea_; i++)
 	{
@@ -270,12 +393,11 @@ calculateFiringTimes(
 		{
 
 
-			listMkCheckSize(
+			growArrayReserve(
 					MD->nActiveMotorUnits_ + 1,
 					(void **) &MD->activeMotorUnit_,
-					&MD->nActiveMotorUnitBlocks_,
-					16,
-					sizeof(MotorUnit *), __FILE__, __LINE__);
+					&MD->nActiveMotorUnitsAllocated_,
+					sizeof(MotorUnit *));
 			MD->activeMotorUnit_[
 						MD->nActiveMotorUnits_++
 					] = currentMU;
@@ -292,89 +414,80 @@ calculateFiringTimes(
 			if (meanFiringRate > maximumFiringRate)
 				meanFiringRate = (float) maximumFiringRate;
 
+			task = &job.fj_tasks[MD->nActiveMotorUnits_ - 1];
+			task->ft_motorUnit = currentMU;
+			task->ft_seed = randomStreamDeriveSeed(baseSeed,
+						currentMU->mu_id_);
+			task->ft_meanFiringRate = meanFiringRate;
+			task->ft_meanIPI = 0;
+			task->ft_nTimesFiringTooShort = 0;
+		}
+	}
 
-			/**
-			 * get a set of firing times for this MU
-			 */
-			if ( ! calculateSingleMUFiringTimes(
-						currentMU,
-						nTimesFiringTooShort,
-						&meanIPI,
-						meanFiringRate,
-						totalElapsedTimeInSeconds,
-						coefficientOfVarianceInFiringTimes
-					) )
-			{
-				return 0;
-			}
 
+	/**
+	 * get a set of firing times for each active MU; the
+	 * per-firing diagnostics share the log buffer, so when
+	 * they are enabled the trains are generated in turn
+	 */
+	if (sFiringLogVerbosity > 0)
+		nThreads = 1;
 
-			/*
-			 * Determine if the firing rates are
-			 * statistically valid
-			 */
-			squaredMean = 0.0;   /* sum of squares */
-			for (j = 2; j < currentMU->mu_nFirings_; j++)
-			{
-				difference =
-					(currentMU->mu_firingTime_[j]
-					- currentMU->mu_firingTime_[j-1]);
-				squaredMean += (difference * difference);
-			}
-			//variance =
-			//	(squaredMean -
-			//	(float) currentMU->mu_nFirings_
-			//				* meanIPI * meanIPI) /
-			//	(float) (currentMU->mu_nFirings_ - 1);
+	if ( ! workPoolRun(MD->nActiveMotorUnits_,
+				nThreads, generateFiringTrainTask, &job) )
+		goto CLEANUP;
 
 
-			/**
-			 * let the user see what we did
-			 */
-//			LogInfo(" %4d | %10.2f | %10.2f | %8.2f | %8.2f |\n",
-//							currentMU->mu_id_,
-//							meanFiringRate,
-//							meanIPI / 10.0,
-//							sqrt(variance) / 10.0,
-//							sqrt(variance) / meanIPI);
+	/**
+	 * gather the results in MU order
+	 */
+	for (i = 0; i < MD->nActiveMotorUnits_; i++)
+	{
+		task = &job.fj_tasks[i];
+		currentMU = task->ft_motorUnit;
 
-			/** accumulate the total number of pulses */
-			totalFirings += currentMU->mu_nFirings_;
+		*nTimesFiringTooShort += task->ft_nTimesFiringTooShort;
 
-			/*
-			 * store motor unit i firing times to disk name
-			 * file "mu__.dat" where the blank is the motor
-			 * unit number
-			 *
-			 * This file stores the number of firings at the
-			 * top of the file followed by the list of firing
-			 * times
-			 */
-			slnprintf(ftmuFilename, FILENAME_MAX,
-					"%s\\FTMU%d.dat", firingsDirectory,
-					MD->activeMotorUnit_[i]->mu_id_);
-			ftmuFP = fopenpath(ftmuFilename, "wb");
-			if (ftmuFP == NULL)
-			{
-				Error("Unable to open %s", ftmuFilename);
-				ckfree(firingThresholdsByMUInDetect);
-				return 0;
-			}
-			fprintf(ftmuFP, "%d\n", currentMU->mu_nFirings_);
-			for (j = 0; j < currentMU->mu_nFirings_; j++)
-			{
-				fprintf(ftmuFP, "    %ld\n",
-							currentMU->mu_firingTime_[j]);
-			}
-			fclose(ftmuFP);
+		/*
+		 * Determine if the firing rates are
+		 * statistically valid
+		 */
+		squaredMean = 0.0;   /* sum of squares */
+		for (j = 2; j < currentMU->mu_nFirings_; j++)
+		{
+			difference =
+				(currentMU->mu_firingTime_[j]
+				- currentMU->mu_firingTime_[j-1]);
+			squaredMean += (difference * difference);
 		}
-	}
+		//variance =
+		//	(squaredMean -
+		//	(float) currentMU->mu_nFirings_
+		//				* task->ft_meanIPI * task->ft_meanIPI) /
+		//	(float) (currentMU->mu_nFirings_ - 1);
 
-//	LogInfo(" -----+------------+------------+----------+----------+\n");
+		/** accumulate the total number of pulses */
+		totalFirings += currentMU->mu_nFirings_;
 
+		/*
+		 * export the firing times of this MU as
+		 * "FTMU__.dat" where the blank is the motor
+		 * unit number.  EMG generation takes the trains
+		 * from memory, so this is only needed when a later
+		 * run will re-use these firing times.
+		 */
+		if (exportFiringTimes &&
+				! writeFiringTimeFile(firingsDirectory, currentMU))
+			goto CLEANUP;
+	}
+
+	STAGESTATS_COUNT("firings", totalFirings);
 	*pps = (float) totalFirings / (float) totalElapsedTimeInSeconds;
+	status = 1;
 
-	return 1;
+CLEANUP:
+	ckfree(job.fj_tasks);
+	return status;
 }
 
 /**
@@ -524,7 +637,9 @@ firing(
 		float maximumFiringRate,
 		float maximumFiringThreshold,
 		int totalElapsedTimeInSeconds,
-		int forceFiring
+		int forceFiring,
+		int exportFiringTimes,
+		int nThreads
 	)
 {
 	char amuFilename[FILENAME_MAX];
@@ -532,7 +647,8 @@ firing(
 	float *firingThresholdsByMUInDetect;
 	int nTimesFiringTooShort;
 	float pps;
-	int i;
+	int i, status = 0;
+	StageTimer timer("firing");
 
 
 
@@ -587,11 +703,13 @@ firing(
 				contractionLevelAsPercentMVC,
 				recruitmentSlope,
 				minimumFiringRate,
-				maximumFiringRate
+				maximumFiringRate,
+				exportFiringTimes,
+				nThreads
 			) )
 	{
 		LogCrit("Firing time calculation failed -- aborting\n");
-		return 0;
+		goto CLEANUP;
 	}
 
 
@@ -612,8 +730,7 @@ firing(
 	if (amuFP == NULL)
 	{
 		Error("Unable to open %s", amuFilename);
-		ckfree(firingThresholdsByMUInDetect);
-		return 0;
+		goto CLEANUP;
 	}
 
 	fprintf(amuFP, "%d\n", MD->nActiveMotorUnits_);
@@ -626,80 +743,11 @@ firing(
 	LogInfo("%d active MUs stored in file: %s\n",
 				MD->nActiveMotorUnits_,
 				amuFilename);
+	status = 1;
 
-
+CLEANUP:
 	ckfree(firingThresholdsByMUInDetect);
-
-	return 1;
-}
-
-
-static int
-loadFiringTimeData(const char *filename, MotorUnit *currentMU)
-{
-	char inputLine[4096];
-	FILE *fp;
-	int readHeader = 0;
-	int firingTimeIndex = 0;
-
-
-	/*
-	 * Load the list of active motor units
-	 */
-	fp = fopenpath(filename, "rb");
-	if (fp == NULL)
-	{
-		Error("Unable to open %s", filename);
-		return 0;
-	}
-
-
-	while (fgets(inputLine, 4096, fp) != NULL)
-	{
-		if (inputLine[0] == '#')
-			continue;
-
-		if ( ! readHeader )
-		{
-			sscanf(inputLine, "%d", &currentMU->mu_nFirings_);
-
-			/**
-			 * allocate the list for Active MU's.  The
-			 * actual MU's must already have been loaded
-			 * by a call to loadMUdata
-			 */
-			currentMU->mu_firingTime_ = (long *)
-						ckalloc(sizeof(long)
-								* currentMU->mu_nFirings_);
-			readHeader = 1;
-		} else
-		{
-
-			if (firingTimeIndex < currentMU->mu_nFirings_)
-			{
-
-				/**
-				 * record the firing time in the list
-				 */
-				sscanf(inputLine, "%ld",
-						&currentMU->mu_firingTime_[firingTimeIndex]);
-
-				firingTimeIndex++;
-			} else
-			{
-				LogError("Too many lines in '%s'\n", filename);
-				return 0;
-			}
-		}
-	}
-
-	if (firingTimeIndex < currentMU->mu_nFirings_)
-	{
-		LogError("Too few lines in '%s'\n", filename);
-		return 0;
-	}
-
-	return 1;
+	return status;
 }
 
 
@@ -735,10 +783,21 @@ loadFiring(MuscleData *MD, const char *firingsDirectory)
 						firingsDirectory,
 						currentMU->mu_id_);
 
-		if ( ! loadFiringTimeData(filename, currentMU) )
+		if (currentMU->mu_firingTime_ != NULL)
+		{
+			ckfree(currentMU->mu_firingTime_);
+			currentMU->mu_firingTime_ = NULL;
+		}
+		currentMU->mu_nFirings_ = 0;
+		currentMU->mu_nFiringsAllocated_ = 0;
+
+		if ( ! DiskFiringSource::sLoadFiringTimeFile(filename,
+					&currentMU->mu_firingTime_,
+					&currentMU->mu_nFirings_) )
 		{
 			return 0;
 		}
+		currentMU->mu_nFiringsAllocated_ = currentMU->mu_nFirings_;
 	}
 
 	return 1;
@@ -44,7 +44,11 @@
 # pragma warning(disable : 4996)
 #endif
 
-struct globals *g = NULL;
+/**
+ * each thread sees the globals of the SimulationContext bound
+ * on it; a single-threaded program simply sets this as before
+ */
+OS_THREAD_LOCAL struct globals *g = NULL;
 
 
 /* assign hard-coded defaults */
@@ -236,6 +240,9 @@ int setGlobalDefaultValues(struct globals *globalValues)
 
 	globalValues->use_last_muscle = 0;
 	globalValues->use_old_firing_times = 1;
+	globalValues->write_firing_files = 1;
+	globalValues->write_muscle_text = 1;
+	globalValues->write_run_statistics = 1;
 	globalValues->filter_raw_signal = 0;
 	globalValues->generateMFPsWithoutInitiation = 0;
 	globalValues->recordMFPPeakToPeak = 0;
@@ -248,24 +255,37 @@ int setGlobalDefaultValues(struct globals *globalValues)
 
 	globalValues->generate_second_channel = 1;
 
+	globalValues->worker_threads = 0;
+	globalValues->random_seed = 0;
+	globalValues->run_id = (-1);
+
+	globalValues->MFAP_reuse_tolerance = 0.01f;
+	globalValues->MFAP_cache_size_in_MB = 256;
+
 	return 1;
 }
 
-/* clean up the globals structure */
+/* clean up a globals structure */
+void deleteGlobalValues(struct globals *globalValues)
+{
+	if (globalValues->muscle_dir != NULL)	ckfree(globalValues->muscle_dir);
+	if (globalValues->firings_dir != NULL)	ckfree(globalValues->firings_dir);
+	if (globalValues->MUPs_dir != NULL)		ckfree(globalValues->MUPs_dir);
+	if (globalValues->output_dir != NULL)	ckfree(globalValues->output_dir);
+
+	if (globalValues->muscle_ != NULL)		delete globalValues->muscle_;
+
+	if (globalValues->list_ != NULL)
+	    deleteAttValList(globalValues->list_);
+	ckfree(globalValues);
+}
+
+/* clean up the globals structure of this thread */
 void deleteGlobals()
 {
 	if (g != NULL)
 	{
-		if (g->muscle_dir != NULL)		ckfree(g->muscle_dir);
-		if (g->firings_dir != NULL)		ckfree(g->firings_dir);
-		if (g->MUPs_dir != NULL)		ckfree(g->MUPs_dir);
-		if (g->output_dir != NULL)		ckfree(g->output_dir);
-
-		if (g->muscle_ != NULL)				delete g->muscle_;
-
-		if (g->list_ != NULL)
-		    deleteAttValList(g->list_);
-		ckfree(g);
+		deleteGlobalValues(g);
 		g = NULL;
 	}
 }
@@ -36,6 +36,7 @@
 
 #include "make16bit.h"
 #include "SimulatorControl.h"
+#include "StageTimer.h"
 
 
 
@@ -206,6 +207,7 @@ make16bitFile(
 	EmgVoltageDesc voltageDesc;
 	short *dataValues = NULL;
 	int status = 0;
+	StageTimer timer("16-bit conversion");
 
 	memset(&header, 0, sizeof(EmgHeader));
 
@@ -605,6 +607,8 @@ convertEmgTo16Bit(
 	if ( ! writeConvertedData(ofp, header, voltageDesc, dataAsShorts) )
 		goto FAIL;
 
+	STAGESTATS_COUNT("samples", voltageDesc->nFloats_);
+	STAGESTATS_COUNT("bytes written", ftell(ofp->fp));
 	closeFP(ofp);
 
 
@@ -41,8 +41,10 @@
 #include "log.h"
 
 #include "MUP.h"
+#include "MFAPCache.h"
 #include "NeedleInfo.h"
 #include "Simulator.h"
+#include "StageTimer.h"
 
 
 #ifdef OS_WINDOWS
@@ -191,8 +193,9 @@ static int calculateCannulaMFAP(
 		int MUPLength,
 		double *convolution,
 		float zEndplateDistanceInMM,
-		float fibreLocXInMM,
-		float fibreLocYInMM,
+		double distanceToShaftInMM,
+		double xProj_deltaToTipInMM,
+		double xProj_deltaToEndOfShaftInMM,
 		NeedleInfo *needle,
 		float fibreDiameterInMM,
 		float conductionVelocity_MMperMS
@@ -204,8 +207,9 @@ static int calculateCannulaMFAPWithInitiation(
 		int MUPLength,
 		double *convolution,
 		float zEndplateDistanceInMM,
-		float fibreLocXInMM,
-		float fibreLocYInMM,
+		double distanceToShaftInMM,
+		double xProj_deltaToTipInMM,
+		double xProj_deltaToEndOfShaftInMM,
 		NeedleInfo *needle,
 		float fibreDiameterInMM,
 		float conductionVelocity_MMperMS,
@@ -223,22 +227,55 @@ static FILE *fibreDistCanFP_ = NULL;
 #endif /* DEBUG_DISTANCE */
 
 
+/**
+ * Remove the MUPs left in the MUP directory by an earlier run,
+ * so that none of them can be taken for a MUP of this one
+ */
+static void
+sRemoveOldMUPs(const char *MUPDirectory)
+{
+	char tmpBuffer[FILENAME_MAX];
+	char *filename;
+	DirList *dirList;
+	int i;
+
+	dirList = dirListLoadEntries(MUPDirectory, "MUPData*.dat");
+	if (dirList == NULL)
+		return;
+
+	for (i = 0; i < dirList->n_entries; i++)
+	{
+		slnprintf(tmpBuffer, FILENAME_MAX, "%s\\%s",
+				MUPDirectory, dirList->entry_name[i]);
+		filename = osIndependentPath(tmpBuffer);
+		if (remove(filename) != 0)
+			LogWarn("Cannot remove old MUP '%s'\n", filename);
+		ckfree(filename);
+	}
+	dirListDelete(dirList);
+}
+
 /*
  * ----------------------------------------------------------------
  * This function uses the saved muscle information
  * and makes motor-unit action potentials.
  * Only active motor units are considered.
+ *
+ * If reuseCleanMUPs is set, the MUPs already on disk are
+ * kept for every MU which is not marked dirty, and only the
+ * MUPs of the dirty MUs are calculated again.  Otherwise any
+ * MUPs on disk are removed before the new ones are made.
  */
 int
 makeMUP(
 		MuscleData *muscleDefinition,
 		int **allMUPIds,
-		int *nMUPs
+		int *nMUPs,
+		int reuseCleanMUPs
 	)
 {
 	MUPControl MUPControl;
-
-	extern struct globals *g;
+	StageTimer timer("MUP");
 
 
 	memset(&MUPControl, 0, sizeof(MUPControl));
@@ -254,6 +291,11 @@ makeMUP(
 	MUPControl.stdDev_Z = g->stddev_z;
 	MUPControl.tipUptakeDistanceInMicrons = g->tipUptakeDistance;
 	MUPControl.canUptakeDistanceInMicrons = g->canUptakeDistance;
+	MUPControl.reuseCleanMUPs = reuseCleanMUPs;
+	MUPControl.MFAPs = muscleDefinition->MFAPCache_;
+
+	if ( ! reuseCleanMUPs )
+		sRemoveOldMUPs(MUPControl.MUPDirectory);
 
 	MUP::sSetJitterAccelerationThreshold(
 		        g->jitterAccelThreshold);
@@ -261,7 +303,7 @@ makeMUP(
 	if ( muscleDefinition->nActiveInDetectMotorUnits_ > 0)
 	{
 		muscleDefinition->nActiveInDetectMotorUnits_ = 0;
-		muscleDefinition->nActiveInDetectMotorUnitBlocks_ = 0;
+		muscleDefinition->nActiveInDetectMotorUnitsAllocated_ = 0;
 		ckfree(muscleDefinition->activeInDetectMotorUnit_);
 		muscleDefinition->activeInDetectMotorUnit_ = NULL;
 	}
@@ -291,9 +333,11 @@ MUPGenerationLoop__(
 	)
 {
 	struct report_timer *reportTimer;
+	MotorUnit *mu;
 	MUP *currentMUP;
 	int in_uptake_area;
 	int MUPStatus;
+	int nReused = 0;
 	int i;
 
 	LogInfo("Jitter Calculation Expansion is  : %s samples\n",
@@ -314,6 +358,31 @@ MUPGenerationLoop__(
 	for (i = 0; i < MD->nActiveMotorUnits_; i++)
 	{
 
+		mu = MD->activeMotorUnit_[i];
+
+		/**
+		 * an MU whose fibres are unchanged keeps its MUP; it
+		 * is in the detection area only if that MUP was saved
+		 */
+		if (MUPControl->reuseCleanMUPs && ! mu->isDirty())
+		{
+		    (*allMUPIds)[i] = mu->mu_id_;
+		    nReused++;
+		    if (statFilenameFromMask(MUPControl->MUPDirectory,
+		                "MUPData%04d.dat", mu->mu_id_))
+		    {
+		        growArrayReserve(
+		                MD->nActiveInDetectMotorUnits_ + 1,
+		                (void **) &MD->activeInDetectMotorUnit_,
+		                &MD->nActiveInDetectMotorUnitsAllocated_,
+		                sizeof(MotorUnit *));
+		        MD->activeInDetectMotorUnit_[
+		                    MD->nActiveInDetectMotorUnits_++
+		                ] = mu;
+		    }
+		    continue;
+		}
+
 		LogInfo("    Creating MFPs for MUP %s from MU %d\n",
 		            reportTime(i+1, reportTimer),
 		            MD->activeMotorUnit_[i]->mu_id_);
@@ -360,24 +429,39 @@ MUPGenerationLoop__(
 		{
 		    currentMUP->save();
 
-		    listMkCheckSize(
+		    growArrayReserve(
 		            MD->nActiveInDetectMotorUnits_ + 1,
 		            (void **) &MD->activeInDetectMotorUnit_,
-		            &MD->nActiveInDetectMotorUnitBlocks_,
-		            16,
-		            sizeof(MotorUnit *), __FILE__, __LINE__);
+		            &MD->nActiveInDetectMotorUnitsAllocated_,
+		            sizeof(MotorUnit *));
 		    MD->activeInDetectMotorUnit_[
 		                MD->nActiveInDetectMotorUnits_++
 		            ] = MD->activeMotorUnit_[i];
+		} else if (MUPControl->reuseCleanMUPs)
+		{
+		    /** do not let a stale MUP be taken up again later */
+		    remove(currentMUP->getFileName());
 		}
+		mu->setDirty(0);
 		delete currentMUP;
 	}
 
 	LogInfo("\n");
+	STAGESTATS_COUNT("MUPs made", MD->nActiveMotorUnits_ - nReused);
+	STAGESTATS_COUNT("MUPs reused", nReused);
+	if (nReused > 0)
+	{
+		LogInfo("Reused the MUPs of %d unchanged motor units\n", nReused);
+	}
+	if (MUPControl->MFAPs != NULL)
+	{
+		MUPControl->MFAPs->logStatistics();
+	}
 
 	deleteReportTimer(reportTimer);
 	sCleanBuffers();
 	sCleanLeftBuffers();
+	MUP::sReleaseScratch();
 
 	{
 		char filename[FILENAME_MAX];
@@ -491,6 +575,20 @@ locateValidMUPs(
 	return 1;
 }
 
+/**
+ * Append the peak-to-peak value of an MFP to the log file
+ */
+static void
+sRecordMFPPeakToPeak(double *MFP, int MUPLength)
+{
+	FILE *tfp;
+
+	tfp = fopen(MFPP2PLOGFILE_NAME, "a");
+	fprintf(tfp, "%f\n",
+			calcPeakToPeakDifferenceDouble(MFP, MUPLength));
+	fclose(tfp);
+}
+
 static void printLogInfo(MUP *newMUP, int nTotalActiveFibres)
 {
 	int nFibres = newMUP->getNMFPs();
@@ -542,7 +640,6 @@ calculateMUP(
 {
 	struct report_timer *reportTimer;
 	double *convolutionResult;
-		time_t lastTime, curTime;
 
 	// float cond_delay;
 
@@ -552,7 +649,7 @@ calculateMUP(
 	float diameterInMM;
 	float zEndplateDistanceInMM;
 	float radialSeparationInMM;
-	float auxRadialSeparationInMM;
+	float auxRadialSeparationInMM = 0;
 
 	/* */
 	float FiberLengthInMM;
@@ -563,9 +660,17 @@ calculateMUP(
 	/* */
 
 	double tempvar;
+	float geometry[MFAP_GEOMETRY_SIZE];
+	const MFAPCacheEntry *cachedMFAPs;
+	MFAPCacheEntry *newCacheEntry;
+	float *fibreXInMM = NULL, *fibreYInMM = NULL;
+	double *distanceToShaftInMM = NULL;
+	double *xProjDeltaToTipInMM = NULL;
+	double *xProjDeltaToEndInMM = NULL;
+	int isSeparateMFP;
+	int status = 0;
 	int fibreIndex;
-
-	extern struct globals *g;
+	int i;
 
 
 	/* electrode relative x location of fibre in mm */
@@ -573,19 +678,45 @@ calculateMUP(
 
 	convolutionResult = sGetConvolutionBuffer(MUPControl->MUPLength);
 
-		lastTime = time(NULL);
+	/**
+	 * find the distances from every fibre to the cannula
+	 * in one pass, rather than fibre by fibre in the loop
+	 */
+	if (newMUP != NULL && nTotalActiveFibres > 0)
+	{
+		fibreXInMM = (float *) ckalloc(sizeof(float) * nTotalActiveFibres);
+		fibreYInMM = (float *) ckalloc(sizeof(float) * nTotalActiveFibres);
+		distanceToShaftInMM = (double *)
+					ckalloc(sizeof(double) * nTotalActiveFibres);
+		xProjDeltaToTipInMM = (double *)
+					ckalloc(sizeof(double) * nTotalActiveFibres);
+		xProjDeltaToEndInMM = (double *)
+					ckalloc(sizeof(double) * nTotalActiveFibres);
+
+		for (fibreIndex = 0; fibreIndex < nTotalActiveFibres; fibreIndex++)
+		{
+			fibreXInMM[fibreIndex] =
+					muscleFibre[fibreIndex]->mf_xCell_ / CELLS_PER_MM;
+			fibreYInMM[fibreIndex] =
+					muscleFibre[fibreIndex]->mf_yCell_ / CELLS_PER_MM;
+		}
+
+		needle->getProjectedNeedleDistanceArrays(
+					nTotalActiveFibres,
+					fibreXInMM,
+					fibreYInMM,
+					xProjDeltaToTipInMM,
+					xProjDeltaToEndInMM,
+					distanceToShaftInMM
+				);
+	}
+
 	reportTimer = startReportTimer(nTotalActiveFibres);
 	for (fibreIndex = 0; fibreIndex < nTotalActiveFibres; fibreIndex++)
 	{
 
-		curTime = time(NULL);
-
-		if (((fibreIndex + 1) % 250 == 0) || (curTime - lastTime > 1))
-		{
-			LogInfo("            Fibre %s\n",
-		            reportTime(fibreIndex, reportTimer));
-		}
-		lastTime = curTime;
+		LOG_PROGRESS(LogInfo("            Fibre %s\n",
+		            reportTime(fibreIndex, reportTimer)));
 
 		/* in mm */
 		zEndplateDistanceInMM = (float)
@@ -774,6 +905,68 @@ calculateMUP(
 		(*inUptakeAreaFlag) = 1;
 
 
+		/*
+		 * If the needle has been swept past this fibre before,
+		 * the MFAPs may already be known for this geometry
+		 */
+		newCacheEntry = NULL;
+		if (MUPControl->MFAPs != NULL && newMUP != NULL)
+		{
+			geometry[MFAP_GEOMETRY_ENDPLATE_DISTANCE] = zEndplateDistanceInMM;
+			geometry[MFAP_GEOMETRY_RADIAL_SEPARATION] = radialSeparationInMM;
+			geometry[MFAP_GEOMETRY_AUX_RADIAL_SEPARATION] =
+						auxRadialSeparationInMM;
+			geometry[MFAP_GEOMETRY_X_LOCATION] = (float)
+					((muscleFibre[fibreIndex]->mf_xCell_ / CELLS_PER_MM)
+							- needle->getXTipInMM());
+			geometry[MFAP_GEOMETRY_SHAFT_DISTANCE] =
+						(float) distanceToShaftInMM[fibreIndex];
+			geometry[MFAP_GEOMETRY_X_PROJ_TO_TIP] =
+						(float) xProjDeltaToTipInMM[fibreIndex];
+			geometry[MFAP_GEOMETRY_X_PROJ_TO_END] =
+						(float) xProjDeltaToEndInMM[fibreIndex];
+			geometry[MFAP_GEOMETRY_CANNULA_LENGTH] =
+						needle->getCannulaLengthInMM();
+			geometry[MFAP_GEOMETRY_DIAMETER] =
+						muscleFibre[fibreIndex]->mf_diameter_;
+
+			cachedMFAPs = MUPControl->MFAPs->find(
+						mu_number, fibreIndex,
+						muscleFibre[fibreIndex], geometry);
+			if (cachedMFAPs != NULL)
+			{
+				for (i = 0; i < MUPControl->MUPLength; i++)
+					convolutionResult[i] = cachedMFAPs->ce_tipMFAP[i];
+				newMUP->addMFP(
+						MUPId,
+						MUPControl->MUPLength,
+						convolutionResult,
+						fibreIndex
+					);
+				if (g->recordMFPPeakToPeak)
+				{
+					sRecordMFPPeakToPeak(convolutionResult,
+							MUPControl->MUPLength);
+				}
+
+				for (i = 0; i < MUPControl->MUPLength; i++)
+					convolutionResult[i] = cachedMFAPs->ce_cannulaMFAP[i];
+				newMUP->addCannulaMFP(
+						MUPId,
+						MUPControl->MUPLength,
+						convolutionResult
+					);
+				STAGESTATS_COUNT("MFAPs reused", 1);
+				continue;
+			}
+
+			newCacheEntry = MUPControl->MFAPs->update(
+						mu_number, fibreIndex, geometry);
+		}
+
+
+		STAGESTATS_COUNT("MFAPs computed", 1);
+
 		/* conduction delay in ms  */
 		// cond_delay = zEndplateDistanceInMM
 		//			/ conductionVelocity_MMperMS;
@@ -793,7 +986,7 @@ calculateMUP(
 							conductionVelocity_MMperMS
 						))
 				{
-					return 0;
+					goto CLEANUP;
 				}
 			} else
 			{
@@ -808,7 +1001,7 @@ calculateMUP(
 							EndPlateLocationInMM
 						))
 				{
-					return 0;
+					goto CLEANUP;
 				}
 			}
 
@@ -835,7 +1028,7 @@ calculateMUP(
 							conductionVelocity_MMperMS,
 							muscleFibreXLocationInMM
 						))
-					return 0;
+					goto CLEANUP;
 			} else
 			{
 				if (! calculateConcentricMFAPWithInitiation(
@@ -853,7 +1046,7 @@ calculateMUP(
 							FiberLengthInMM,
 							EndPlateLocationInMM
 						))
-					return 0;
+					goto CLEANUP;
 			}
 
 		} else if (MUPControl->electrodeType == 4)
@@ -869,7 +1062,7 @@ calculateMUP(
 						diameterInMM,
 						conductionVelocity_MMperMS
 					))
-					return 0;
+					goto CLEANUP;
 			} else
 			{
 				if (! calculateBipolarMFAPWithInitiation(
@@ -883,7 +1076,7 @@ calculateMUP(
 					FiberLengthInMM,
 					EndPlateLocationInMM
 					))
-					return 0;
+					goto CLEANUP;
 			}
 		}
 
@@ -893,7 +1086,7 @@ calculateMUP(
 		if (newMUP != NULL)
 		{
 
-			newMUP->addMFP(
+			isSeparateMFP = newMUP->addMFP(
 					MUPId,
 					MUPControl->MUPLength,
 					convolutionResult,
@@ -902,12 +1095,19 @@ calculateMUP(
 
 			if (g->recordMFPPeakToPeak)
 			{
-				FILE *tfp;
-				tfp = fopen(MFPP2PLOGFILE_NAME, "a");
-				fprintf(tfp, "%f\n",
-						calcPeakToPeakDifferenceDouble(convolutionResult,
-									MUPControl->MUPLength));
-				fclose(tfp);
+				sRecordMFPPeakToPeak(convolutionResult,
+						MUPControl->MUPLength);
+			}
+
+			/** only the merged (far field) MFAPs are kept */
+			if (isSeparateMFP)
+			{
+				newCacheEntry = NULL;
+			} else if (newCacheEntry != NULL)
+			{
+				for (i = 0; i < MUPControl->MUPLength; i++)
+					newCacheEntry->ce_tipMFAP[i] =
+							(MUPDataElement) convolutionResult[i];
 			}
 
 			if (g->generateMFPsWithoutInitiation){
@@ -918,17 +1118,14 @@ calculateMUP(
 						MUPControl->MUPLength,
 						convolutionResult,
 						zEndplateDistanceInMM,
-						(float) (muscleFibre[
-										fibreIndex
-									]->mf_xCell_ / CELLS_PER_MM),
-						(float) (muscleFibre[
-										fibreIndex
-									]->mf_yCell_ / CELLS_PER_MM),
+						distanceToShaftInMM[fibreIndex],
+						xProjDeltaToTipInMM[fibreIndex],
+						xProjDeltaToEndInMM[fibreIndex],
 						needle,
 						diameterInMM,
 						conductionVelocity_MMperMS
 					))
-					return 0;
+					goto CLEANUP;
 			}else{
 				if (! calculateCannulaMFAPWithInitiation(
 						(float) muscleFibre[fibreIndex]->mf_xCell_,
@@ -937,12 +1134,9 @@ calculateMUP(
 						MUPControl->MUPLength,
 						convolutionResult,
 						zEndplateDistanceInMM,
-						(float) (muscleFibre[
-										fibreIndex
-									]->mf_xCell_ / CELLS_PER_MM),
-						(float) (muscleFibre[
-										fibreIndex
-									]->mf_yCell_ / CELLS_PER_MM),
+						distanceToShaftInMM[fibreIndex],
+						xProjDeltaToTipInMM[fibreIndex],
+						xProjDeltaToEndInMM[fibreIndex],
 						needle,
 						diameterInMM,
 						conductionVelocity_MMperMS,
@@ -951,7 +1145,7 @@ calculateMUP(
 						EndPlateLocationInMM
 
 					))
-					return 0;
+					goto CLEANUP;
 			}
 
 			newMUP->addCannulaMFP(
@@ -960,13 +1154,32 @@ calculateMUP(
 					convolutionResult
 				);
 
+			/** the entry is only valid once both MFAPs are in */
+			if (newCacheEntry != NULL)
+			{
+				for (i = 0; i < MUPControl->MUPLength; i++)
+					newCacheEntry->ce_cannulaMFAP[i] =
+							(MUPDataElement) convolutionResult[i];
+				newCacheEntry->ce_fibre = muscleFibre[fibreIndex];
+			}
+
 		}
 	}
-	deleteReportTimer(reportTimer);
-
 	printLogInfo(newMUP, nTotalActiveFibres);
+	STAGESTATS_COUNT("fibres processed", nTotalActiveFibres);
+	status = 1;
 
-	return (1);
+CLEANUP:
+	deleteReportTimer(reportTimer);
+	if (fibreXInMM != NULL)
+	{
+		ckfree(fibreXInMM);
+		ckfree(fibreYInMM);
+		ckfree(distanceToShaftInMM);
+		ckfree(xProjDeltaToTipInMM);
+		ckfree(xProjDeltaToEndInMM);
+	}
+	return status;
 }
 
 /*
@@ -2286,8 +2499,9 @@ calculateCannulaMFAP(
 		int MUPLength,
 		double *convolution,
 		float zEndplateDistanceInMM,
-		float fibreLocXInMM,
-		float fibreLocYInMM,
+		double distanceToShaftInMM,
+		double xProj_deltaToTipInMM,
+		double xProj_deltaToEndOfShaftInMM,
 		NeedleInfo *needle,
 		float fibreDiameterInMM,
 		float conductionVelocity_MMperMS
@@ -2313,10 +2527,6 @@ calculateCannulaMFAP(
 		/*  current vector constant  **/
 	double currentfn_const;
 
-	double distanceToShaftInMM;
-	double xProj_deltaToTipInMM;
-	double xProj_deltaToEndOfShaftInMM;
-
 	float z_inc;        /*  increment along the z axis        **/
 	float z;            /*  position along the z axis    **/
 	float weightz;      /*  weighting function calculated at line z **/
@@ -2361,17 +2571,6 @@ calculateCannulaMFAP(
 	memset(weightfn, 0, sizeof(double) * MUPLength * 2);
 
 
-	/**
-	 * get distances from fibre to ends of cannula
-	 */
-	needle->getProjectedNeedleDistances(
-		        &xProj_deltaToTipInMM,
-		            &xProj_deltaToEndOfShaftInMM,
-		            &distanceToShaftInMM,
-		        fibreLocXInMM,
-		            fibreLocYInMM
-		    );
-
 	//if (distanceToShaftInMM < fibreDiameterInMM / 2.0)
 		//distanceToShaftInMM = fibreDiameterInMM / 2.0;
 
@@ -2538,8 +2737,9 @@ calculateCannulaMFAPWithInitiation(
 		int MUPLength,
 		double *convolution,
 		float zEndplateDistanceInMM,
-		float fibreLocXInMM,
-		float fibreLocYInMM,
+		double distanceToShaftInMM,
+		double xProj_deltaToTipInMM,
+		double xProj_deltaToEndOfShaftInMM,
 		NeedleInfo *needle,
 		float fibreDiameterInMM,
 		float conductionVelocity_MMperMS,
@@ -2572,10 +2772,6 @@ calculateCannulaMFAPWithInitiation(
 		/*  current vector constant  **/
 	double currentfn_const;
 
-	double distanceToShaftInMM;
-	double xProj_deltaToTipInMM;
-	double xProj_deltaToEndOfShaftInMM;
-
 	float z_inc;        /*  increment along the z axis        **/
 	float z;            /*  position along the z axis    **/
 	float weightz;      /*  weighting function calculated at line z **/
@@ -2633,17 +2829,6 @@ calculateCannulaMFAPWithInitiation(
 	memset(weightfn_left, 0, sizeof(double) * MUPLength * 2);
 
 
-	/**
-	 * get distances from fibre to ends of cannula
-	 */
-	needle->getProjectedNeedleDistances(
-		        &xProj_deltaToTipInMM,
-		            &xProj_deltaToEndOfShaftInMM,
-		            &distanceToShaftInMM,
-		        fibreLocXInMM,
-		            fibreLocYInMM
-		    );
-
 	//if (distanceToShaftInMM < fibreDiameterInMM / 2.0)
 		//distanceToShaftInMM = fibreDiameterInMM / 2.0;
 
@@ -2835,9 +3020,12 @@ calculateCannulaMFAPWithInitiation(
 }
 
 
-
-static int sConvolutionBufferMUPLength = 0;
-static double *sConvolutionBuffer = NULL;
+/**
+ * The convolution and FFT workspaces below are kept per thread,
+ * so that simulations on separate threads each have their own
+ */
+static OS_THREAD_LOCAL int sConvolutionBufferMUPLength = 0;
+static OS_THREAD_LOCAL double *sConvolutionBuffer = NULL;
 
 
 static void sCleanConvolutionBuffer()
@@ -2871,8 +3059,8 @@ static double *sGetConvolutionBuffer(int MUPLength)
 }
 
 /* New part*/
-static int sConvLeftBufferMUPLength = 0;
-static double *sConvLeftBuffer = NULL;
+static OS_THREAD_LOCAL int sConvLeftBufferMUPLength = 0;
+static OS_THREAD_LOCAL double *sConvLeftBuffer = NULL;
 
 
 static void sCleanConvLeftBuffer()
@@ -2948,10 +3136,10 @@ static double *sGetConvRightBuffer(int MUPLength)
 
 /* Bipolar added buffers end */
 
-static int sFFTBufferMUPLength = 0;
-static double *sFFTBuffer = NULL;
-static double *sWeightBuffer = NULL;
-static double *sCurrentBuffer = NULL;
+static OS_THREAD_LOCAL int sFFTBufferMUPLength = 0;
+static OS_THREAD_LOCAL double *sFFTBuffer = NULL;
+static OS_THREAD_LOCAL double *sWeightBuffer = NULL;
+static OS_THREAD_LOCAL double *sCurrentBuffer = NULL;
 
 static void sCleanFFTBuffers()
 {
@@ -3024,9 +3212,9 @@ static void sCleanBuffers()
 
 /* new part*/
 
-static int sFFTLeftBufferMUPLength = 0;
-static double *sFFTLeftBuffer = NULL;
-static double *sWeightLeftBuffer = NULL;
+static OS_THREAD_LOCAL int sFFTLeftBufferMUPLength = 0;
+static OS_THREAD_LOCAL double *sFFTLeftBuffer = NULL;
+static OS_THREAD_LOCAL double *sWeightLeftBuffer = NULL;
 
 
 static void sCleanFFTLeftBuffers()
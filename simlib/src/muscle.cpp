@@ -36,7 +36,10 @@
 #define PRIVATE public
 #include "Simulator.h"
 #include "MuscleData.h"
+#include "MuscleSnapshot.h"
 #include "NeedleInfo.h"
+#include "FibreLatticeIndex.h"
+#include "StageTimer.h"
 
 #include "SimulatorControl.h"
 #include "SimulatorConstants.h"
@@ -57,6 +60,7 @@
 #include "reporttimer.h"
 #include "error.h"
 #include "massert.h"
+#include "msgir.h"
 #include "log.h"
 
 #include "3Circle.h"
@@ -1119,6 +1123,7 @@ layoutMotorUnitCentroids(
 	int status = 1;
 	const int MAX_TRIES = 10;
 	int sanityCheck = MAX_TRIES;
+	StageTimer timer("motor unit layout");
 
 	/**
 	 * define locations of motor unit centroids.
@@ -1265,7 +1270,7 @@ layoutMotorUnitCentroids(
 //    listMkCheckSize(
 //                result->nEntries_ + 1,
 //                (void **) &result->results_,
-//                &result->nBlocks_,
+//                &result->nAllocated_,
 //                16,
 //                sizeof(int), __FILE__, __LINE__);
 //    result->results_[result->nEntries_++] = id;
@@ -2767,43 +2772,68 @@ chooseMUForFibreUsingWeightingMethod(
 
 /**
  * Add the fibres to a new R-tree so we can find them
- * by distance
+ * by distance.  The fibre set is static while the tree
+ * exists, so it is bulk loaded rather than built by insertion.
  */
 int
 buildFibreRTree(MuscleData *MD)
 {
-	Rect bbox;
+	Rect *bbox;
+	int *fibreId;
 	MuscleFibre *currentFibre;
+	int nFibres = 0;
 	int i;
 
 	if (MD->fibreRTreeRoot_ != NULL)
 		return 1;
 
-	//LogInfo("Building Fibre R-Tree\n");
-	MD->fibreRTreeRoot_ = RTreeNewIndex();
+	bbox = (Rect *) ckalloc(sizeof(Rect)
+				* (MD->getTotalNumberOfFibres() + 1));
+	fibreId = (int *) ckalloc(sizeof(int)
+				* (MD->getTotalNumberOfFibres() + 1));
+
 	for (i = 0; i < MD->getTotalNumberOfFibres(); i++)
 	{
-
-		//if (i > 0 && i % 1000 == 0)
-		//{
-		//	LogInfo(" - fibre %d of %d\n", i, MD->getTotalNumberOfFibres());
-		//}
-
 		currentFibre = MD->getFibre(i);
 		if (currentFibre == NULL)
 		    continue;
 
-		bbox.boundary[0] = currentFibre->getXCell() - (float) 0.5;
-		bbox.boundary[1] = currentFibre->getYCell() - (float) 0.5;
-		bbox.boundary[2] = currentFibre->getXCell() + (float) 0.5;
-		bbox.boundary[3] = currentFibre->getYCell() + (float) 0.5;
+		bbox[nFibres].boundary[0] = currentFibre->getXCell() - (float) 0.5;
+		bbox[nFibres].boundary[1] = currentFibre->getYCell() - (float) 0.5;
+		bbox[nFibres].boundary[2] = currentFibre->getXCell() + (float) 0.5;
+		bbox[nFibres].boundary[3] = currentFibre->getYCell() + (float) 0.5;
 
 		/** we must offset the ids by 1 as 0 is an invalid id */
-		RTreeInsertRect(&bbox,
-			   i + 1,
-			   &MD->fibreRTreeRoot_, 0);
+		fibreId[nFibres] = i + 1;
+		nFibres++;
+	}
+
+	MD->fibreRTreeRoot_ = RTreeBulkLoad(bbox, fibreId, nFibres);
+
+	ckfree(bbox);
+	ckfree(fibreId);
+
+	return 1;
+}
+
+/**
+ * Index the fibres on their cell lattice, for neighbourhood
+ * searches; changes to the fibres must be reported to the
+ * index as they are made (see FibreLatticeIndex).
+ */
+int
+buildFibreLatticeIndex(MuscleData *MD)
+{
+	if (MD->fibreLattice_ != NULL)
+		return 1;
+
+	MD->fibreLattice_ = new FibreLatticeIndex();
+	if ( ! MD->fibreLattice_->build(MD) )
+	{
+		delete MD->fibreLattice_;
+		MD->fibreLattice_ = NULL;
+		return 0;
 	}
-	//LogInfo("Done R-Tree\n");
 
 	return 1;
 }
@@ -2820,7 +2850,6 @@ seekNeedleToNearbyFibres(
 	)
 {
 	struct rTreeResultList rtreeResults;
-	Rect searchRect;
 	int numEligibleFibres;
 	MuscleFibre *currentFibre;
 	MotorUnit *currentMU;
@@ -2840,11 +2869,12 @@ seekNeedleToNearbyFibres(
 	int numFibreFound;
 	int numCandidatesFound = 0;
 	int i, j;
+	StageTimer timer("needle seek");
 
 	const double MAX_NEEDLE_MOVEMENT_IN_UM = 800;
 	const double MIN_METRIC_THRESHOLD = 4;
 
-	if ( ! buildFibreRTree(MD) )
+	if ( ! buildFibreLatticeIndex(MD) )
 		return 0;
 
 	LogInfo("Seeking needle to active fibres\n");
@@ -2852,25 +2882,16 @@ seekNeedleToNearbyFibres(
 	xTipInCells = (MD->needle_->getXTipInMM() * CELLS_PER_MM);
 	yTipInCells = (MD->needle_->getYTipInMM() * CELLS_PER_MM);
 
-	/** move up to MAX_NEEDLE_MOVEMENT_IN_UM in any direction */
-	searchRect.boundary[0] = (float) (xTipInCells
-				- ((MAX_NEEDLE_MOVEMENT_IN_UM / 1000.0) * CELLS_PER_MM));
-	searchRect.boundary[1] = (float) (yTipInCells
-				- ((MAX_NEEDLE_MOVEMENT_IN_UM / 1000.0) * CELLS_PER_MM));
-	searchRect.boundary[2] = (float) (xTipInCells
-				+ ((MAX_NEEDLE_MOVEMENT_IN_UM / 1000.0) * CELLS_PER_MM));
-
-	/** in Y, do not search above the needle tip */
-	searchRect.boundary[3] = (float) (yTipInCells);
-
-
-	/** use the R-Tree to get list of possible MU's */
+	/**
+	 * move up to MAX_NEEDLE_MOVEMENT_IN_UM in any direction;
+	 * use the fibre lattice to get list of possible MU's
+	 */
 	memset(&rtreeResults, 0, sizeof(rtreeResults));
-	numEligibleFibres = RTreeSearch(
-				MD->fibreRTreeRoot_,
-				&searchRect,
-				FibreRTreeSearchCallback__,
-				(void *) &rtreeResults
+	numEligibleFibres = MD->fibreLattice_->findWithinRadius(
+				(float) xTipInCells,
+				(float) yTipInCells,
+				(float) ((MAX_NEEDLE_MOVEMENT_IN_UM / 1000.0) * CELLS_PER_MM),
+				&rtreeResults
 			);
 
 	/**
@@ -2899,6 +2920,10 @@ seekNeedleToNearbyFibres(
 		if (currentFibre == NULL)
 			continue;
 
+		/** do not search above the needle tip */
+		if (currentFibre->getYCell() > yTipInCells)
+			continue;
+
 		fibreMUId = currentFibre->getMotorUnit();
 
 		/** check that we got an active one */
@@ -3125,190 +3150,266 @@ CLEANUP:
 	return 1;
 }
 
+/**
+ ** Needle geometry used by the plowing kernel, in mm
+ **/
+typedef struct PlowGeometry {
+	double xTip;
+	double yTip;
+	double xAlong;			/** unit vector along the cannula */
+	double yAlong;
+	double xRightTipSide;
+	double xPush;			/** offsets along the perpendicular */
+	double yPush;
+	float yTipInMM;
+	float radiusInUM;
+} PlowGeometry;
+
+/**
+ ** Plow the fibres in the given arrays out of the path of the
+ ** cannula, writing their new locations and setting isMoved[]
+ ** for each fibre inside it; returns the number moved.
+ **
+ ** Each fibre is expressed in coordinates rotated to lie along
+ ** the cannula, which gives its distance from the centre line
+ ** and the foot of the perpendicular to it directly.  Every
+ ** outcome is computed for every fibre and the right one then
+ ** selected, so the loop has no branches and can be vectorised.
+ **/
+static int
+sPlowFibreKernel(
+		const PlowGeometry *geometry,
+		int nFibres,
+		const float *xCell,
+		const float *yCell,
+		const float *diameter,
+		float *newXCell,
+		float *newYCell,
+		int *isMoved
+	)
+{
+	double xFromTip, yFromTip;
+	double along, across;
+	double xIntersection, yIntersection;
+	float xInMM, yInMM;
+	float xAbove, yAbove, xBelow, yBelow, yAtTip;
+	float distance;
+	int isInside, isAbove, isNearTip;
+	int nMoved = 0;
+	int i;
+
+	for (i = 0; i < nFibres; i++)
+	{
+		xInMM = xCell[i] / CELLS_PER_MM;
+		yInMM = yCell[i] / CELLS_PER_MM;
+
+		xFromTip = xInMM - geometry->xTip;
+		yFromTip = yInMM - geometry->yTip;
+		along = (xFromTip * geometry->xAlong) + (yFromTip * geometry->yAlong);
+		across = (yFromTip * geometry->xAlong) - (xFromTip * geometry->yAlong);
+
+		xIntersection = geometry->xTip + (along * geometry->xAlong);
+		yIntersection = geometry->yTip + (along * geometry->yAlong);
+		distance = (float) (fabs(across) * 1000.0);
+
+		/** fibres below the tip stay where they are */
+		isInside = (yInMM >= geometry->yTipInMM)
+				& (distance <= geometry->radiusInUM);
+
+		/** above the cannula, projected up along the perpendicular */
+		isAbove = (across > 0);
+		xAbove = (float) ((xIntersection - geometry->xPush) * CELLS_PER_MM);
+		yAbove = (float) ((yIntersection - geometry->yPush) * CELLS_PER_MM);
+
+		/** below it, dropped under the tip or projected down */
+		isNearTip = (xIntersection < geometry->xRightTipSide);
+		yAtTip = (float) ((geometry->yTipInMM - diameter[i]) / 2.0);
+		xBelow = (float) ((xIntersection + geometry->xPush) * CELLS_PER_MM);
+		yBelow = (float) ((yIntersection + geometry->yPush) * CELLS_PER_MM);
+
+		newXCell[i] = isInside
+				? (isAbove ? xAbove : (isNearTip ? xCell[i] : xBelow))
+				: xCell[i];
+		newYCell[i] = isInside
+				? (isAbove ? yAbove : (isNearTip ? yAtTip : yBelow))
+				: yCell[i];
+		isMoved[i] = isInside;
+		nMoved += isInside;
+	}
+
+	return nMoved;
+}
+
 OS_EXPORT int
 plowMuscleFibres(
 		int emgFileId,
 		const char *outputDir,
+		const char *muscleDir,
 		MuscleData *MD,
-		float canPhysicalRadiusInUM
+		float canPhysicalRadiusInUM,
+		int exportMuscleText
 	)
 {
-	float xLocationOfFibreInCells, yLocationOfFibreInCells;
-	float xLocationOfFibreInMM, yLocationOfFibreInMM;
-	double xRightTipSide;
-	double B_cannulaPerpindicular;
-	double B_cannula;
-	double xIntersection, yIntersection;
-	double xDifference, yDifference;
-	double M_cannulaPerpindicular;
+	struct rTreeResultList corridor;
+	PlowGeometry geometry;
 	MuscleFibre *fibre;
-	float distance;
-	int totalFibres;
-	int i;
+	double M_cannulaPerpindicular;
+	double slope, norm;
+	float *xCell = NULL, *yCell = NULL, *diameter = NULL;
+	float *newXCell = NULL, *newYCell = NULL;
+	int *isMoved = NULL, *movedIndex = NULL;
+	int nCandidates, nMoved;
+	int status = 0;
+	int i, j;
+	StageTimer timer("plow");
 
-	totalFibres = MD->getTotalNumberOfFibres();
+	memset(&corridor, 0, sizeof(corridor));
 
 	MD->needle_->getNeedleLocations(
-					&xRightTipSide, NULL,
+					&geometry.xRightTipSide, NULL,
 				NULL, NULL,
 				NeedleInfo::AboveTip_BelowCannula);
 
-	for (i = 0; i < totalFibres; i++)
-	{
-
-		fibre = MD->getFibre(i);
-		if (fibre == NULL)
-			continue;
-
-		xLocationOfFibreInMM = fibre->getXCell() / CELLS_PER_MM;
-		yLocationOfFibreInMM = fibre->getYCell() / CELLS_PER_MM;
-		xLocationOfFibreInCells = fibre->getXCell();
-		yLocationOfFibreInCells = fibre->getYCell();
-
+	slope = MD->needle_->getSlope();
+	norm = sqrt(1.0 + SQR(slope));
+	geometry.xTip = MD->needle_->getXTipInMM();
+	geometry.yTip = MD->needle_->getYTipInMM();
+	geometry.yTipInMM = MD->getNeedleInfo()->getYTipInMM();
+	geometry.xAlong = 1.0 / norm;
+	geometry.yAlong = slope / norm;
+	geometry.radiusInUM = canPhysicalRadiusInUM;
 
-		/**
-		 * if we are below the tip, we are fine
-		 * where we are
-		 */
-		if (yLocationOfFibreInMM < MD->getNeedleInfo()->getYTipInMM())
-		{
-			continue;
-		}
+	/**
+	 * the push off the cannula is the same for every fibre, as
+	 * is the perpendicular (whose slope is simply -1/slope)
+	 */
+	M_cannulaPerpindicular = (-1.0 / slope);
+	geometry.xPush = canPhysicalRadiusInUM
+				* fabs(cos(atan(M_cannulaPerpindicular)));
+	geometry.yPush = canPhysicalRadiusInUM
+				* fabs(sin(atan(M_cannulaPerpindicular)));
 
 
-		/**
-		 * ---------------------------------------------------
-		 * Calculate whether we are inside the cannula or not.
-		 * ---------------------------------------------------
-		 */
+	/**
+	 * Only fibres in the corridor swept by the cannula can move;
+	 * start a cell below the tip and search a cell wider than the
+	 * cannula so that the exact test in the kernel decides every
+	 * borderline fibre
+	 */
+	if (MD->fibreLattice_ == NULL && ! buildFibreLatticeIndex(MD))
+		goto CLEANUP;
 
-		/**
-		 * raise a perpinducular to the cannula perpindicular
-		 * is simply 1/slope
-		 */
-		M_cannulaPerpindicular = (-1.0 / MD->needle_->getSlope());
+	nCandidates = MD->fibreLattice_->findAlongLine(
+				(float) ((geometry.xTip - (1.0 / (slope * CELLS_PER_MM)))
+							* CELLS_PER_MM),
+				(float) (geometry.yTip * CELLS_PER_MM) - 1.0f,
+				(float) slope,
+				(float) ((canPhysicalRadiusInUM / 1000.0) * CELLS_PER_MM)
+							+ 1.0f,
+				&corridor);
 
+	if (nCandidates > 0)
+	{
+		xCell = (float *) ckalloc(sizeof(float) * nCandidates);
+		yCell = (float *) ckalloc(sizeof(float) * nCandidates);
+		diameter = (float *) ckalloc(sizeof(float) * nCandidates);
+		newXCell = (float *) ckalloc(sizeof(float) * nCandidates);
+		newYCell = (float *) ckalloc(sizeof(float) * nCandidates);
+		isMoved = (int *) ckalloc(sizeof(int) * nCandidates);
+		movedIndex = (int *) ckalloc(sizeof(int) * nCandidates);
+	}
 
-		/**
-		 * calculate where this perpindiucular intersects the
-		 * y axis if the line goes through the fibre of interest.
-		 * B = y - Mx
-		 */
-		B_cannulaPerpindicular = yLocationOfFibreInMM -
-					M_cannulaPerpindicular * xLocationOfFibreInMM;
+	for (i = 0, j = 0; i < nCandidates; i++)
+	{
+		fibre = MD->getFibre(corridor.results_[i]);
+		if (fibre == NULL)
+			continue;
 
+		corridor.results_[j] = corridor.results_[i];
+		xCell[j] = fibre->getXCell();
+		yCell[j] = fibre->getYCell();
+		diameter[j] = fibre->getDiameter();
+		j++;
+	}
+	nCandidates = j;
 
-		/**
-		 * Figure out where B for the cannula itself is, based
-		 * on the tip and the slope
-		 */
-		B_cannula = MD->needle_->getYTipInMM() -
-							(MD->needle_->getSlope() * MD->needle_->getXTipInMM());
+	nMoved = sPlowFibreKernel(&geometry, nCandidates,
+				xCell, yCell, diameter,
+				newXCell, newYCell, isMoved);
 
-		/**
-		 * Now figure out where this line and the center of
-		 * the cannula intersect; we then can determine whether
-		 * we are within one radius of the center of the cannula
-		 *
-		 * y = MC x + BC  <-> equation of cannula
-		 * y = MP x + BP  <-> equation of perpindicular
-		 *
-		 * MC x + BC  =  MP x + BP
-		 * MC x - MP x = BP - BC
-		 * x (MC - MP) = BP - BC
-		 *
-		 * .'.
-		 * x = (BP - BC) / (MC - MP)
-		 */
-		xIntersection =
-					(B_cannulaPerpindicular - B_cannula)
-				/ (MD->needle_->getSlope() - M_cannulaPerpindicular);
-		yIntersection = M_cannulaPerpindicular * xIntersection
-				+ B_cannulaPerpindicular;
+	/**
+	 * Move the fibres, keeping the lattice up to date; the old
+	 * locations are packed down for the delta as we go
+	 */
+	for (i = 0, j = 0; i < nCandidates; i++)
+	{
+		if ( ! isMoved[i] )
+			continue;
 
-		xDifference = xLocationOfFibreInMM - xIntersection;
-		yDifference = yLocationOfFibreInMM - yIntersection;
+		fibre = MD->getFibre(corridor.results_[i]);
+		fibre->setCellLocation(newXCell[i], newYCell[i]);
+		MD->fibreLattice_->moveFibre(corridor.results_[i],
+					newXCell[i], newYCell[i]);
 
+		movedIndex[j] = corridor.results_[i];
+		xCell[j] = xCell[i];
+		yCell[j] = yCell[i];
+		j++;
+	}
 
-		/**
-		 * Calculate distance and convert to um (the unit in which
-		 * the physical and model distances are specified)
-		 */
-		distance = (float)
-					(sqrt(SQR(xDifference) + SQR(yDifference)) * 1000.0);
+	LogInfo("Plowed %d of %d fibres in the path of the cannula\n",
+			nMoved, nCandidates);
+	STAGESTATS_COUNT("fibres moved", nMoved);
 
+	/**
+	 * write out contraction-specific fibre locations; where the
+	 * unplowed snapshot is at hand only the moved fibres are
+	 * recorded, otherwise the whole layout is.  A NULL muscle
+	 * directory means the muscle no longer matches its unplowed
+	 * snapshot (as in a progression stage)
+	 */
+	{
+		char tmpFilename[FILENAME_MAX];
+		char *localName;
+		struct stat sb;
+		int haveUnplowed = 0;
 
-		/** if we are inside the cannula, relocate (plow) the fibre */
-		if (distance <= canPhysicalRadiusInUM)
+		if (muscleDir != NULL)
 		{
+			slnprintf(tmpFilename, FILENAME_MAX,
+					"%s\\" MUSCLE_SNAPSHOT_UNPLOWED, muscleDir);
+			localName = osIndependentPath(tmpFilename);
+			haveUnplowed = (irStat(localName, &sb) >= 0);
+			ckfree(localName);
+		}
 
-			/**
-			 * if we are above the needle, we will project
-			 * along the cannula perpindicular
-			 */
-			if (yDifference > 0)
-			{
-				xLocationOfFibreInCells = (float)
-					((xIntersection -
-						(canPhysicalRadiusInUM *
-							fabs(cos(atan(M_cannulaPerpindicular)))
-						)
-					) * CELLS_PER_MM);
-
-				yLocationOfFibreInCells = (float)
-					((yIntersection -
-						(canPhysicalRadiusInUM *
-							fabs(sin(atan(M_cannulaPerpindicular)))
-						)
-					) * CELLS_PER_MM);
-
-			} else
-			{
-				/**
-				 * we need to see if we are near the tip or not
-				 */
-				if (xIntersection < xRightTipSide)
-				{
-					yLocationOfFibreInCells = (float)
-							((MD->getNeedleInfo()->getYTipInMM()
-								   		- fibre->getDiameter()) / 2.0);
-
-				} else
-				{
-					/** simply project right/down */
-					xLocationOfFibreInCells = (float)
-						((xIntersection +
-							(canPhysicalRadiusInUM *
-								fabs(cos(atan(M_cannulaPerpindicular)))
-							)
-						) * CELLS_PER_MM);
-					yLocationOfFibreInCells = (float)
-						((yIntersection +
-							(canPhysicalRadiusInUM *
-								fabs(sin(atan(M_cannulaPerpindicular)))
-							)
-						) * CELLS_PER_MM);
-				}
-			}
-
-			/**
-			 * Now update the fibre location
-			 */
-			fibre->setCellLocation(
-					xLocationOfFibreInCells,
-					yLocationOfFibreInCells
-				);
+		if (haveUnplowed)
+		{
+			slnprintf(tmpFilename, FILENAME_MAX,
+					"%s\\" MUSCLE_PLOW_DELTA_FMT,
+					outputDir,
+					emgFileId);
+			if ( ! MD->writePlowDelta(tmpFilename,
+						nMoved, movedIndex, xCell, yCell) )
+				goto CLEANUP;
+		} else
+		{
+			slnprintf(tmpFilename, FILENAME_MAX,
+					"%s\\" MUSCLE_SNAPSHOT_PLOWED_FMT,
+					outputDir,
+					emgFileId);
+			if ( ! MD->writeSnapshot(tmpFilename) )
+				goto CLEANUP;
 		}
-	}
 
-	/** write out contraction-specific fibre locations */
-	{
-		char tmpFilename[FILENAME_MAX];
-		slnprintf(tmpFilename, FILENAME_MAX,
-				"%s\\MF-plowed%d.dat",
-				outputDir,
-				emgFileId);
-		MD->writeMFInfo(tmpFilename);
+		if (exportMuscleText)
+		{
+			slnprintf(tmpFilename, FILENAME_MAX,
+					"%s\\MF-plowed%d.dat",
+					outputDir,
+					emgFileId);
+			MD->writeMFInfo(tmpFilename);
+		}
 	}
 
 #ifdef  DEBUG_MAHDIEH_NEEDLE_INFO
@@ -3323,7 +3424,22 @@ plowMuscleFibres(
 	}
 #endif
 
-	return 1;
+	status = 1;
+
+CLEANUP:
+	if (corridor.results_ != NULL)
+		ckfree(corridor.results_);
+	if (xCell != NULL)
+	{
+		ckfree(xCell);
+		ckfree(yCell);
+		ckfree(diameter);
+		ckfree(newXCell);
+		ckfree(newYCell);
+		ckfree(isMoved);
+		ckfree(movedIndex);
+	}
+	return status;
 }
 
 
@@ -3925,6 +4041,7 @@ assignFibresToMotorUnitsUsingProbabilityMethod(
 	int chosenMUIndex;
 	BITSTRING bitstring;
 	int i;
+	StageTimer timer("fibre assignment");
 
 
 #ifdef DEBUG_LAYOUT
@@ -4077,6 +4194,7 @@ assignFibresToMotorUnitsUsingWeightingMethod(
 	int chosenMUIndex;
 	BITSTRING bitstring;
 	int i;
+	StageTimer timer("fibre assignment");
 
 
 #ifdef DEBUG_LAYOUT
@@ -4427,8 +4545,8 @@ calculateMotorUnitExpectedFibreCounts(
 	for (i = 0; i < MD->nMotorUnitsInMuscle_; i++)
 	{
 
-		if ((i + 1) % 10 == 0)
-			LogInfo("    Fibres for MU %s\n", reportTime(i, reportTimer));
+		LOG_PROGRESS(LogInfo("    Fibres for MU %s\n",
+					reportTime(i, reportTimer)));
 
 		if (MD->motorUnit_[i] == NULL)
 			continue;
@@ -4866,6 +4984,99 @@ int storeNeedleInfo(
 }
 
 
+/**
+ * Apply the neuropathic and myopathic changes described in
+ * the pathology parameters to a laid out muscle, and recount
+ * the MUs in the detection area.
+ *
+ * This is used both when a muscle is first created and when
+ * a progression stage is derived from the muscle of the stage
+ * before it; the MUs whose fibres change are left marked dirty
+ */
+int
+applyMusclePathology(
+		MuscleData *MD,
+		PathologyControl *pathologyParams,
+		int nThreads
+	)
+{
+	int i;
+	StageTimer timer("pathology");
+
+	if (pathologyParams->neuropathicMULossFraction > 0.0)
+	{
+		LogInfo("Simulating neuropathic involvement . . .\n");
+		updateMuscleWithNeuropathy(MD,
+				pathologyParams->neuropathicMULossFraction,
+				(int) ((pathologyParams->neuropathicMaxAdoptionDistanceInUM
+					   		/ UM_PER_CELL) + 0.5),
+				pathologyParams->neuropathicEnlargementFraction,
+				nThreads
+			);
+	}
+
+
+	if (pathologyParams->myopathicFractionOfFibresAffected > 0.0)
+	{
+		LogInfo("Simulating myopathic involvement . . .\n");
+		updateMuscleWithMyopathy(MD,
+				pathologyParams->myopathicFractionOfFibresAffected,
+				pathologyParams->myopathicFibreDiameterMean,
+				pathologyParams->myopathicFibreGraduallyDying,
+				pathologyParams->myopathicDependentProcedure,
+				pathologyParams->myopathicCycleNewInvolvementPercentage,
+				pathologyParams->myopathicFibreDeathDiameter,
+				pathologyParams->myopathicPercentageOfAffectedFibersDying,
+				pathologyParams->myopathicHypertrophicFibreFraction,
+				pathologyParams->myopathicHypertrophySplitThreshold,
+				pathologyParams->myopathicPercentageOfHypertrophicFibersSplit,
+				pathologyParams->myopathicAtrophyRatePerCycle,
+				pathologyParams->myopathicHypertrophyRatePerCycle
+			);
+	}
+	/**
+	 * if either of these are true, the fibre R-tree is now
+	 * invalid; the fibre lattice is kept up to date as the
+	 * fibres change, so it remains in use
+	 */
+	if ((pathologyParams->myopathicFractionOfFibresAffected > 0.0) ||
+				(pathologyParams->neuropathicMULossFraction > 0.0))
+	{
+		if (MD->fibreRTreeRoot_ != NULL)
+		{
+			RTreeDeleteIndex(MD->fibreRTreeRoot_);
+			MD->fibreRTreeRoot_ = NULL;
+		}
+	}
+
+
+	/**
+	 * calculate the MU's in the detection area
+	 */
+	LogInfo("Calculating which MU's are in the detection area\n");
+	MD->nMotorUnitsInDetectionArea_ = 0;
+	for (i = 0; i < MD->nMotorUnitsInMuscle_; i++)
+	{
+		if (MD->motorUnit_[i]->mu_nFibres_ > 0)
+		{
+		    growArrayReserve(
+		            MD->nMotorUnitsInDetectionArea_ + 1,
+		            (void **) &MD->motorUnitInDetect_,
+		            &MD->motorUnitInDetectAllocated_,
+		            sizeof(MotorUnit *));
+			MSG_ASSERT(MD->motorUnit_[i]->mu_id_ == i + 1,
+							"Motor Unit ID mismatch");
+		    MD->motorUnitInDetect_[
+		                MD->nMotorUnitsInDetectionArea_
+		            ] = MD->motorUnit_[i];
+		    MD->nMotorUnitsInDetectionArea_++;
+		}
+	}
+
+	return 1;
+}
+
+
 /**
  * Create a muscle definition by randomly placing motor
  * unit centers to acheive a given density, and then
@@ -4889,7 +5100,9 @@ muscle(
 		float needleZ,
 		int motorUnitLayoutType,
 		int doJitterSuperFibres,
-		int muscleLayoutFunctionType
+		int muscleLayoutFunctionType,
+		int exportMuscleText,
+		int nThreads
 	)
 {
 	char tmpFilename[FILENAME_MAX];
@@ -4900,6 +5113,7 @@ muscle(
 	int newNumberMotorUnits;
 	int muscleDensityOk = 0;
 	int i;
+	StageTimer timer("muscle");
 
 	/**
 	 * First verify that all the disease information is
@@ -5201,71 +5415,8 @@ muscle(
 	 * be done _after_ the check for density, as it obviously
 	 * affects the density in a possbily detrimental way
 	 */
-	if (pathologyParams->neuropathicMULossFraction > 0.0)
-	{
-		LogInfo("Simulating neuropathic involvement . . .\n");
-		updateMuscleWithNeuropathy(MD,
-				pathologyParams->neuropathicMULossFraction,
-				(int) ((pathologyParams->neuropathicMaxAdoptionDistanceInUM
-					   		/ UM_PER_CELL) + 0.5),
-				pathologyParams->neuropathicEnlargementFraction
-			);
-	}
-
-
-	if (pathologyParams->myopathicFractionOfFibresAffected > 0.0)
-	{
-		LogInfo("Simulating myopathic involvement . . .\n");
-		updateMuscleWithMyopathy(MD,
-				pathologyParams->myopathicFractionOfFibresAffected,
-				pathologyParams->myopathicFibreDiameterMean,
-				pathologyParams->myopathicFibreGraduallyDying,
-				pathologyParams->myopathicDependentProcedure,
-				pathologyParams->myopathicCycleNewInvolvementPercentage,
-				pathologyParams->myopathicFibreDeathDiameter,
-				pathologyParams->myopathicPercentageOfAffectedFibersDying,
-				pathologyParams->myopathicHypertrophicFibreFraction,
-				pathologyParams->myopathicHypertrophySplitThreshold,
-				pathologyParams->myopathicPercentageOfHypertrophicFibersSplit,
-				pathologyParams->myopathicAtrophyRatePerCycle,
-				pathologyParams->myopathicHypertrophyRatePerCycle
-			);
-	}
-	/** if either of these are true, the R-tree is now invalid */
-	if ((pathologyParams->myopathicFractionOfFibresAffected > 0.0) ||
-				(pathologyParams->neuropathicMULossFraction > 0.0))
-	{
-		if (MD->fibreRTreeRoot_ != NULL)
-		{
-			RTreeDeleteIndex(MD->fibreRTreeRoot_);
-			MD->fibreRTreeRoot_ = NULL;
-		}
-	}
-
-
-	/**
-	 * calculate the MU's in the detection area
-	 */
-	LogInfo("Calculating which MU's are in the detection area\n");
-	MD->nMotorUnitsInDetectionArea_ = 0;
-	for (i = 0; i < MD->nMotorUnitsInMuscle_; i++)
-	{
-		if (MD->motorUnit_[i]->mu_nFibres_ > 0)
-		{
-		    listMkCheckSize(
-		            MD->nMotorUnitsInDetectionArea_ + 1,
-		            (void **) &MD->motorUnitInDetect_,
-		            &MD->motorUnitInDetectBlocks_,
-		            16,
-		            sizeof(MotorUnit *), __FILE__, __LINE__);
-			MSG_ASSERT(MD->motorUnit_[i]->mu_id_ == i + 1,
-							"Motor Unit ID mismatch");
-		    MD->motorUnitInDetect_[
-		                MD->nMotorUnitsInDetectionArea_
-		            ] = MD->motorUnit_[i];
-		    MD->nMotorUnitsInDetectionArea_++;
-		}
-	}
+	if ( ! applyMusclePathology(MD, pathologyParams, nThreads) )
+		goto FAIL;
 
 	MD->needle_->cannulaLength_ = (float) (MD->muscleDiameter_ / 2.0);
 
@@ -5297,18 +5448,29 @@ muscle(
 
 
 	slnprintf(tmpFilename, FILENAME_MAX,
-			"%s\\MF-unplowed.dat", muscleDirectory);
-	MD->writeMFInfo(tmpFilename);
+			"%s\\" MUSCLE_SNAPSHOT_UNPLOWED, muscleDirectory);
+	if ( ! MD->writeSnapshot(tmpFilename) )
+		goto FAIL;
 
 	slnprintf(tmpFilename, FILENAME_MAX,
 			"%s\\MUParam.dat", muscleDirectory);
 	MD->writeMUParam(tmpFilename);
 
-	slnprintf(tmpFilename, FILENAME_MAX,
-			"%s\\MU.dat", muscleDirectory);
-	MD->writeMUInfo(tmpFilename);
+	/** the text layout files are an export only */
+	if (exportMuscleText)
+	{
+		slnprintf(tmpFilename, FILENAME_MAX,
+				"%s\\MF-unplowed.dat", muscleDirectory);
+		MD->writeMFInfo(tmpFilename);
+
+		slnprintf(tmpFilename, FILENAME_MAX,
+				"%s\\MU.dat", muscleDirectory);
+		MD->writeMUInfo(tmpFilename);
+	}
 
 	storeNeedleInfo(MD, emgFileId, outputDirectory);
+	STAGESTATS_COUNT("motor units", MD->getNumMotorUnits());
+	STAGESTATS_COUNT("fibres", MD->getTotalNumberOfFibres());
 	return MD;
 
 
@@ -5332,6 +5494,7 @@ loadMuscleData(
 {
 	char tmpFilename[FILENAME_MAX];
 	MuscleData *MD;
+	StageTimer timer("muscle load");
 
 	LogInfo("\nLoading Muscle Data from File\n");
 
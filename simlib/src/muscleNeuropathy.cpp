@@ -9,22 +9,24 @@
 
 #ifndef MAKEDEPEND
 # include <stdio.h>
+# include <stdlib.h>
 # include <string.h>
 #endif
 
 #define PRIVATE public
 #include "MuscleData.h"
 #include "muscle.h"
+#include "FibreLatticeIndex.h"
 
 #include "listalloc.h"
 #include "tclCkalloc.h"
 #include "random.h"
 #include "stringtools.h"
 #include "mathtools.h"
-#include "reporttimer.h"
 #include "bitstring.h"
 #include "massert.h"
 #include "log.h"
+#include "workpool.h"
 
 #include "rTreeIndex.h"
 
@@ -36,12 +38,11 @@ FibreRTreeSearchCallback__(long id, void *voidResultList)
 	struct rTreeResultList *result =
 				(struct rTreeResultList *) voidResultList;
 
-	listMkCheckSize(
+	growArrayReserve(
 			result->nEntries_ + 1,
 			(void **) &result->results_,
-			&result->nBlocks_,
-			16,
-			sizeof(int), __FILE__, __LINE__);
+			&result->nAllocated_,
+			sizeof(int));
 
 	/**
 	 * ids were stored with values 1 greater than that
@@ -54,166 +55,180 @@ FibreRTreeSearchCallback__(long id, void *voidResultList)
 }
 
 static int
-chooseAdjacentMUForFibre(
-		MuscleFibre *fibreData,
-		MuscleData *MD,
-		Node *fibreRTree,
-		int maxDistance,
-		int currentOwnerID,
-		BITSTRING fibreOwnerFlags,
-		float maxFibreCountFraction
-	)
+sCompareFibreIds(const void *v1, const void *v2)
+{
+	return *((const int *) v1) - *((const int *) v2);
+}
+
+/**
+ * Put search results into fibre index order, so that choices
+ * made from the list do not depend on the shape of the index
+ */
+void
+sortRTreeResultList(struct rTreeResultList *resultList)
+{
+	if (resultList->nEntries_ > 1)
+		qsort(resultList->results_, resultList->nEntries_,
+				sizeof(int), sCompareFibreIds);
+}
+
+/**
+ * A fibre left without a neuron, waiting to be adopted
+ */
+typedef struct OrphanFibre
+{
+	int of_fibreId;
+	long of_seed;
+
+	/** MU id chosen this round, or (-1) if none is eligible */
+	int of_chosenMU;
+} OrphanFibre;
+
+typedef struct ReinnervationJob
+{
+	MuscleData *rj_MD;
+	OrphanFibre *rj_orphans;
+	int rj_nOrphanBlocks;
+	const int *rj_fibreOwner;
+	int rj_maxDistance;
+	float rj_maxFibreCountFraction;
+	int rj_round;
+} ReinnervationJob;
+
+static int
+sCompareOrphans(const void *v1, const void *v2)
+{
+	return ((const OrphanFibre *) v1)->of_fibreId
+			- ((const OrphanFibre *) v2)->of_fibreId;
+}
+
+/**
+ * Could this MU take on one more fibre without growing by
+ * more than the enlargement fraction?
+ */
+static int
+sMUCanAdopt(MotorUnit *mu, float maxFibreCountFraction)
 {
-	struct rTreeResultList rtreeResults;
-	MuscleFibre *adoptiveFibre;
-	Rect searchRect;
-	//float fibreXInMM, fibreYInMM;
 	double changeFraction;
-	int muID;
-	int *possibleIdList;
-	int nPossibleFibres;
-	int listIndex;
-	int adoptiveFibreId;
-	int fibreChoiceOK;
-	int i, j;
 
+	changeFraction = (mu->mu_nFibres_ + 1) / (mu->mu_nHealthyFibres_);
 
-	//fibreXInMM = fibreData->getXLocationInMM();
-	//fibreYInMM = fibreData->getYLocationInMM();
+	return (changeFraction <= maxFibreCountFraction);
+}
 
-	// LogInfo("Max adoption distance is %d\n", maxDistance);
+/**
+ * Worker pool task: choose an MU near an orphaned fibre to
+ * adopt it.  Candidates are the fibres within the adoption
+ * distance which still have an owner that can grow; one is
+ * drawn at random from the fibre's own stream.  The owners
+ * and MU sizes are only changed between rounds, so every
+ * orphan in a round sees the same muscle.
+ */
+static int
+sChooseAdoptiveMUTask(int taskIndex, void *userData)
+{
+	ReinnervationJob *job = (ReinnervationJob *) userData;
+	OrphanFibre *orphan = &job->rj_orphans[taskIndex];
+	MuscleData *MD = job->rj_MD;
+	MuscleFibre *fibreData;
+	struct rTreeResultList candidates;
+	randomStream stream;
+	int nPossibleFibres;
+	int nEligible;
+	int muID;
+	int i, j;
 
+	orphan->of_chosenMU = (-1);
+	if (job->rj_maxDistance <= 0)
+		return 1;
+
+	fibreData = MD->getFibre(orphan->of_fibreId);
+	seedRandomStream(&stream,
+			randomStreamDeriveSeed(orphan->of_seed, job->rj_round));
+	memset(&candidates, 0, sizeof(candidates));
 
 #ifdef		EXPANDING_FIBRE_ADOPTION_SEARCH
 	i = 1;
 #else
-	i = maxDistance - 1;
+	i = job->rj_maxDistance - 1;
 #endif
 
-	while (i <= maxDistance)
+	while (i <= job->rj_maxDistance)
 	{
-
-		// LogInfo("   Trying adoption distance of %d\n", i);
 		/**
-		 * Distance is in cells, so we simply add in the
-		 * distance indicated by i to find centers of other
-		 * fibres
+		 * Distance is in cells, so we simply look within
+		 * the distance indicated by i to find centers of
+		 * other fibres
 		 */
-		searchRect.boundary[0] =
-		   		 fibreData->mf_xCell_ - (float) (i + 0.25);
-		searchRect.boundary[1] =
-					fibreData->mf_yCell_ - (float) (i + 0.25);
-		searchRect.boundary[2] =
-					fibreData->mf_xCell_ + (float) (i + 0.25);
-		searchRect.boundary[3] =
-					fibreData->mf_yCell_ + (float) (i + 0.25);
-
-		/** get a list of possible adjacent fibres */
-		memset(&rtreeResults, 0, sizeof(rtreeResults));
-		nPossibleFibres = RTreeSearch(
-					fibreRTree,
-					&searchRect,
-					FibreRTreeSearchCallback__,
-					(void *) &rtreeResults
+		nPossibleFibres = MD->fibreLattice_->findWithinRadius(
+					fibreData->mf_xCell_,
+					fibreData->mf_yCell_,
+					(float) (i + 0.25),
+					&candidates
 				);
-		possibleIdList = rtreeResults.results_;
 
-		/**
-		 * Now determine whether we see anything we like
-		 * in the results list
-		 */
-		while (nPossibleFibres > 0)
+		/** keep the owners of the fibres we could join */
+		nEligible = 0;
+		for (j = 0; j < nPossibleFibres; j++)
 		{
-			adoptiveFibre = NULL;
-			listIndex = intRangeRandom(nPossibleFibres);
-			adoptiveFibreId = possibleIdList[ listIndex ];
-			adoptiveFibre = MD->getFibre(adoptiveFibreId);
-
-			/**
-			 * if we have found a deleted fibre, or our own
-			 * parent MU, then delete this candidate from the
-			 * list and choose another
-			 */
-			MSG_ASSERT(adoptiveFibreId < MD->getTotalNumberOfFibres(),
-									"bitstring");
-
-
-			fibreChoiceOK = 1;
-
-			/** any of the following disallow this fibre */
-			if (adoptiveFibre == NULL)
-			{
-				fibreChoiceOK = 0;
-
-			} else if (adoptiveFibre->getMotorUnit() == currentOwnerID)
-			{
-				fibreChoiceOK = 0;
-
-			} else if (GET_BIT(fibreOwnerFlags, adoptiveFibreId))
-			{
-				fibreChoiceOK = 0;
-
-			} else
-			{
-				muID = adoptiveFibre->getMotorUnit();
-				MSG_ASSERT(MD->motorUnit_[muID-1]->mu_id_ == muID, "index bad");
-
-				changeFraction = (MD->motorUnit_[muID-1]->mu_nFibres_ + 1)
-						/ (MD->motorUnit_[muID-1]->mu_nHealthyFibres_);
-
-				/**
-				 * if this changes the MU by too much, then
-				 * discard this option
-				 */
-				if (changeFraction > maxFibreCountFraction)
-				{
-					fibreChoiceOK = 0;
-				}
-			}
+			muID = job->rj_fibreOwner[candidates.results_[j]];
+			if (muID == 0)
+				continue;
 
+			MSG_ASSERT(MD->motorUnit_[muID-1]->mu_id_ == muID, "index bad");
+			if ( ! sMUCanAdopt(MD->motorUnit_[muID-1],
+						job->rj_maxFibreCountFraction))
+				continue;
 
-			if (! fibreChoiceOK)
-			{
-
-				for (j = listIndex + 1; j < nPossibleFibres; j++)
-				{
-					possibleIdList[ j-1 ] = possibleIdList[ j ];
-				}
-				nPossibleFibres--;
-			} else
-			{
-				/**
-				 * we found something, so we will break
-				 * out of this loop processing
-				 */
-				ckfree(possibleIdList);
-				return adoptiveFibre->getMotorUnit();
-			}
+			candidates.results_[nEligible++] = muID;
 		}
 
-		/** clean up result list */
-		ckfree(possibleIdList);
+		if (nEligible > 0)
+		{
+			j = (int) (randomStreamDouble(&stream) * nEligible);
+			if (j >= nEligible)
+				j = nEligible - 1;
+			orphan->of_chosenMU = candidates.results_[j];
+			break;
+		}
 
 		i++;
 	}
 
-	return (-1);
-}
+	if (candidates.results_ != NULL)
+		ckfree(candidates.results_);
 
+	return 1;
+}
 
+/**
+ * Remove a neuron which still has fibres, and reinnervate its
+ * fibres in rounds.  In each round every orphan chooses an
+ * adoptive MU on the worker pool; the choices are then
+ * committed in fibre order.  A choice which would now enlarge
+ * its MU too much is retried in the next round, when that MU
+ * is no longer eligible, and an orphan with no eligible MU in
+ * reach dies.  The owners of the adopted fibres are only
+ * recorded once all the orphans are settled, so that no fibre
+ * is adopted through one of its siblings.
+ */
 static int
 removeNeuron(
 		MuscleData *MD,
-		Node *fibreRTree,
-		int maxDistance,
-		BITSTRING fibreOwnerFlags,
-		float neuropathicEnlargementFraction
+		int *fibreOwner,
+		ReinnervationJob *job,
+		int nThreads,
+		int *nAdopted,
+		int *nDied
 	)
 {
 	MuscleFibre *fibreData;
+	MotorUnit *mu;
+	OrphanFibre *orphan;
 	int neuronIndex, neuronStartIndex;
 	int nFibres;
-	int chosenMU, chosenMUIndex;
+	int nPending, nRetry;
+	long baseSeed;
 	int i;
 
 	neuronStartIndex = neuronIndex
@@ -234,88 +249,104 @@ removeNeuron(
 		}
 	}
 
-
 	/**
-	 * Clear all the fibre flags.  We will use these flags
-	 * in this loop to ensure that we do not adopt to fibres
-	 * which are being adopted this time around -- ie; that
-	 * each fibre gets a fair chance of being adopted "at
-	 * the same time"
+	 * one draw from the global generator seeds the stream of
+	 * each orphan, so the global sequence advances identically
+	 * however the orphans are handled
 	 */
-	ZERO_BITSTRING(fibreOwnerFlags, MD->getTotalNumberOfFibres() + 1);
+	baseSeed = (long) localRandom();
 
 	/**
-	 * locate all the fibres this MU controls, and add
-	 * them to other MU's, based on coverage
+	 * locate all the fibres this MU controls, and take them
+	 * from it
 	 */
-	for (i = nFibres - 1; i >= 0; i--)
+	listMkCheckSize(
+			nFibres,
+			(void **) &job->rj_orphans,
+			&job->rj_nOrphanBlocks,
+			1024,
+			sizeof(OrphanFibre), __FILE__, __LINE__);
+	orphan = job->rj_orphans;
+	for (i = 0; i < nFibres; i++)
 	{
-
 		fibreData = MD->motorUnit_[neuronIndex]->mu_fibre_[i];
 		MSG_ASSERT(fibreData != NULL, "Null Fibre Found!");
 
-
-
-		/** choose a new MU for this fibre */
-		if (maxDistance > 0)
-		{
-			chosenMU = chooseAdjacentMUForFibre(fibreData,
-						MD, fibreRTree, maxDistance,
-						MD->motorUnit_[neuronIndex]->mu_id_,
-						fibreOwnerFlags,
-						neuropathicEnlargementFraction
-					);
-		} else
+		orphan[i].of_fibreId = MD->fibreLattice_->findFibre(MD, fibreData);
+		MSG_ASSERT(orphan[i].of_fibreId >= 0, "Fibre missing from lattice");
+		orphan[i].of_chosenMU = (-1);
+		fibreOwner[orphan[i].of_fibreId] = 0;
+	}
+	MD->motorUnit_[neuronIndex]->mu_nFibres_ = 0;
+	MD->motorUnit_[neuronIndex]->mu_isDirty_ = 1;
+
+	if (nFibres > 1)
+		qsort(orphan, nFibres, sizeof(OrphanFibre), sCompareOrphans);
+	for (i = 0; i < nFibres; i++)
+		orphan[i].of_seed = randomStreamDeriveSeed(baseSeed,
+						orphan[i].of_fibreId);
+
+	job->rj_round = 0;
+	nPending = nFibres;
+	while (nPending > 0)
+	{
+		if ( ! workPoolRun(nPending, nThreads,
+					sChooseAdoptiveMUTask, job) )
 		{
-			chosenMU = (-1);
+			LogError("Reinnervation round %d failed\n", job->rj_round);
+			return 0;
 		}
 
-		if (chosenMU > 0)
+		/**
+		 * commit the choices in fibre order; the orphans to
+		 * retry are kept, in order, at the front of the list
+		 */
+		nRetry = 0;
+		for (i = 0; i < nPending; i++)
 		{
+			fibreData = MD->getFibre(orphan[i].of_fibreId);
 
+			if (orphan[i].of_chosenMU < 0)
+			{
+				/**
+				 * If there is no adopting neuron, then
+				 * we assume the fibre dies, and becomes
+				 * adipose tissue.  This implies we do not
+				 * need to model it, so it is removed.
+				 */
+				MD->fibreLattice_->deleteFibre(orphan[i].of_fibreId);
+				MD->masterFibreList_[orphan[i].of_fibreId] = NULL;
+				delete fibreData;
+				(*nDied)++;
+				continue;
+			}
 
-			/**
-			 * flag this fibre as "used" in the bitstring,
-			 * so that we do not choose it as a later adoptive
-			 * fibre
-			 */
-			MSG_ASSERT(i < MD->getTotalNumberOfFibres(), "bitstring");
-			SET_BIT(fibreOwnerFlags, i, 1);
-
-			/**
-			 * If there was a new MU close enough, move
-			 * the fibre to the new parent neuron
-			 */
-			chosenMUIndex = chosenMU - 1;
-
-//			LogInfo("    Neuropathy:       Fibre %d adopted by MU %d\n",
-//							i, chosenMU);
+			mu = MD->motorUnit_[orphan[i].of_chosenMU - 1];
+			if ( ! sMUCanAdopt(mu, job->rj_maxFibreCountFraction))
+			{
+				orphan[nRetry++] = orphan[i];
+				continue;
+			}
 
-			MD->motorUnit_[neuronIndex]->removeFibre(i);
-			MD->motorUnit_[chosenMUIndex]->addFibre(fibreData);
-			fibreData->mf_motorUnit_ =
-						MD->motorUnit_[chosenMUIndex]->mu_id_;
 			/**
 			 * FIX:
 			 * We need to think through what happens to the
 			 * jShift here
 			 */
-		} else
-		{
-			/**
-			 * If there is no adopting neurong, then
-			 * we assume the fibre dies, and becomes
-			 * adipose tissue.  This implies we do not
-			 * need to model it, so it is removed.
-			 */
-			MD->motorUnit_[neuronIndex]->removeFibre(fibreData);
-			MD->removeFibre(fibreData);
-			delete fibreData;
+			mu->addFibre(fibreData);
+			(*nAdopted)++;
 		}
+		nPending = nRetry;
+		job->rj_round++;
 	}
 
-	MSG_ASSERT(MD->motorUnit_[neuronIndex]->getNumFibres() == 0,
-			"MU not empty after delete");
+	/** the adopted fibres may now adopt in turn */
+	for (i = 0; i < nFibres; i++)
+	{
+		fibreData = MD->getFibre(orphan[i].of_fibreId);
+		if (fibreData != NULL)
+			fibreOwner[orphan[i].of_fibreId] = fibreData->mf_motorUnit_;
+	}
 
 	return 1;
 }
@@ -324,19 +355,29 @@ removeNeuron(
 /**
  * Simulate Neuropathic involvement by removing a fraction of
  * the neurons
+ *
+ * The neurons die one after another, and the fibres of each
+ * are reinnervated by removeNeuron().  Each orphan draws on its
+ * own random stream, seeded from a value taken from the global
+ * generator and the fibre index, so the muscle is the same
+ * whatever number of threads is used.
  */
 int
 updateMuscleWithNeuropathy(
 		MuscleData *MD,
 		float involvement,
 		int maxAdoptionDistanceInCells,
-		float neuropathicEnlargementFraction
+		float neuropathicEnlargementFraction,
+		int nThreads
 	)
 {
+	ReinnervationJob job;
+	MuscleFibre *fibre;
+	int nAdopted = 0, nDied = 0;
 	int numNeuronsInvolved;
 	int numNonZeroMUs = 0;
 	int status = 1;
-	BITSTRING fibreOwnerFlags = NULL;
+	int *fibreOwner = NULL;
 	int i;
 
 	LogInfo("    Neuropathy : involvement %f\n", involvement);
@@ -345,12 +386,27 @@ updateMuscleWithNeuropathy(
 	LogInfo("    Neuropathy : max adoption distance %d\n",
 			maxAdoptionDistanceInCells);
 
-	if ( ! buildFibreRTree(MD) )
+	if ( ! buildFibreLatticeIndex(MD) )
 		return 0;
 
-	fibreOwnerFlags = ALLOC_BITSTRING(MD->getTotalNumberOfFibres() + 1);
-	LogInfo("    %d bits allocated for fibre-flag bitstring\n",
-							MD->getTotalNumberOfFibres());
+	/**
+	 * Record the owning MU of each fibre by master index, so
+	 * that candidates for adoption are checked without going
+	 * through the fibres themselves
+	 */
+	fibreOwner = (int *) ckalloc(sizeof(int)
+					* (MD->getTotalNumberOfFibres() + 1));
+	for (i = 0; i < MD->getTotalNumberOfFibres(); i++)
+	{
+		fibre = MD->getFibre(i);
+		fibreOwner[i] = (fibre == NULL) ? 0 : fibre->getMotorUnit();
+	}
+
+	memset(&job, 0, sizeof(job));
+	job.rj_MD = MD;
+	job.rj_fibreOwner = fibreOwner;
+	job.rj_maxDistance = maxAdoptionDistanceInCells;
+	job.rj_maxFibreCountFraction = neuropathicEnlargementFraction;
 
 	/**
 	 * Figure out how many MUs have non-zero fibre count
@@ -382,46 +438,29 @@ updateMuscleWithNeuropathy(
 								/ (double)numNonZeroMUs
 					));
 
+	/** remove the appropriate number of neurons */
+	for (i = 0; i < numNeuronsInvolved; i++)
 	{
-		struct report_timer *rt;
-		time_t startTime, curTime;
-
-		rt = startReportTimer(numNeuronsInvolved);
-		startTime = time(NULL);
-
-		/** remove the appropriate number of neurons */
-		for (i = 0; i < numNeuronsInvolved; i++)
+		if ( ! removeNeuron(MD, fibreOwner, &job, nThreads,
+						&nAdopted, &nDied) )
 		{
-
-			curTime = time(NULL);
-			if ((curTime - startTime > 7) && ((i % 10) == 0))
-			{
-				LogInfo("        Removing neruron %s of %d\n",
-								reportTime(i, rt), numNeuronsInvolved);
-			}
-			if ( ! removeNeuron(
-							MD,
-							MD->fibreRTreeRoot_,
-							maxAdoptionDistanceInCells,
-							fibreOwnerFlags,
-							neuropathicEnlargementFraction
-						) )
-			{
-				LogWarning("    Neuropathy : "
-							"Failure removing neuron %d of %d\n",
-							i, numNeuronsInvolved);
-				status = 0;
-				goto CLEANUP;
-			}
+			LogWarning("    Neuropathy : "
+						"Failure removing neuron %d of %d\n",
+						i, numNeuronsInvolved);
+			status = 0;
+			goto CLEANUP;
 		}
-		deleteReportTimer(rt);
 	}
 
+	LogInfo("    Neuropathy : %d fibres adopted, %d died\n",
+				nAdopted, nDied);
 	LogInfo("    Neuropathy : Simulation Successful\n");
 
 CLEANUP:
-	if (fibreOwnerFlags != NULL)
-		FREE_BITSTRING(fibreOwnerFlags);
+	if (fibreOwner != NULL)
+		ckfree(fibreOwner);
+	if (job.rj_orphans != NULL)
+		ckfree(job.rj_orphans);
 	return status;
 }
 
@@ -454,6 +493,9 @@ splitCurrentMuscleFibre(
 
 	/** move the old fibre slightly */
 	currentFibre->mf_xCell_ = currentFibre->mf_xCell_ + 0.5f;
+	if (MD->fibreLattice_ != NULL)
+		MD->fibreLattice_->moveFibre(currentFibreIndex,
+				currentFibre->mf_xCell_, currentFibre->mf_yCell_);
 
 	/**
 	 * add a new companion fibre, copying all
@@ -495,6 +537,9 @@ splitCurrentMuscleFibre(
 				"fibre index math incorrect in muscle");
 	MSG_ASSERT(MD->getTotalNumberOfFibres() == newFibreMuscleIndex + 1,
 				"fibre index math incorrect in muscle index");
+	if (MD->fibreLattice_ != NULL)
+		MD->fibreLattice_->addFibre(newFibreMuscleIndex,
+				newFibre->mf_xCell_, newFibre->mf_yCell_);
 
 
 	/**
@@ -525,6 +570,24 @@ splitCurrentMuscleFibre(
 	return 1;
 }
 
+/**
+ * Remove a fibre which has died from its MU, the muscle and
+ * the fibre lattice (if one has been built)
+ */
+static void
+removeDeadFibre(
+		MuscleData *MD,
+		MuscleFibre *currentFibre,
+		int currentFibreIndex
+	)
+{
+	MD->motorUnit_[currentFibre->mf_motorUnit_-1]->removeFibre(currentFibre);
+	if (MD->fibreLattice_ != NULL)
+		MD->fibreLattice_->deleteFibre(currentFibreIndex);
+	MD->masterFibreList_[currentFibreIndex] = NULL;
+	delete currentFibre;
+}
+
 /**
  * Simulate Myopathic involvement by attaching the fibers
  */
@@ -702,6 +765,9 @@ updateMuscleWithMyopathy(
 				if (currentFibre == NULL)
 					continue;
 
+				/** its diameter changes, so its MUP must be remade */
+				MD->motorUnit_[currentFibre->mf_motorUnit_-1]->mu_isDirty_ = 1;
+
 				/** is this fibre hyper- or a- trophic? */
 				if (GET_BIT(hypertrophicFibres, i) != 0)
 				{
@@ -759,12 +825,7 @@ updateMuscleWithMyopathy(
 							if (currentFibre->mf_diameter_
 									< myopathicFibreDeathDiameter)
 							{
-								MD->motorUnit_[
-										currentFibre->mf_motorUnit_-1
-									]->removeFibre( currentFibre);
-
-								MD->masterFibreList_[i] = NULL;
-								delete currentFibre;
+								removeDeadFibre(MD, currentFibre, i);
 								numFibresKilledThisCycle++;
 
 							}
@@ -774,13 +835,7 @@ updateMuscleWithMyopathy(
 							if (currentFibre->mf_diameter_
 									< myopathicFibreDeathDiameter)
 							{
-
-								MD->motorUnit_[
-									currentFibre->mf_motorUnit_-1
-									]->removeFibre( currentFibre);
-
-								MD->masterFibreList_[i] = NULL;
-								delete currentFibre;
+								removeDeadFibre(MD, currentFibre, i);
 								numFibresKilledThisCycle++;
 							} else
 							{
@@ -793,11 +848,7 @@ updateMuscleWithMyopathy(
 										CountFibres75 = 0;
 									} else
 									{
-										MD->motorUnit_[
-												currentFibre->mf_motorUnit_-1
-											]->removeFibre( currentFibre);
-										MD->masterFibreList_[i] = NULL;
-										delete currentFibre;
+										removeDeadFibre(MD, currentFibre, i);
 										numFibresKilledThisCycle++;
 									}
 								} else
@@ -806,11 +857,7 @@ updateMuscleWithMyopathy(
 										< Fibre25PercentDeathDiameter){
 										CountFibres25++;
 										if (CountFibres25==4){
-											MD->motorUnit_[
-												currentFibre->mf_motorUnit_-1
-												]->removeFibre( currentFibre);
-											MD->masterFibreList_[i] = NULL;
-											delete currentFibre;
+											removeDeadFibre(MD, currentFibre, i);
 											numFibresKilledThisCycle++;
 											CountFibres25 = 0;
 										}
@@ -149,9 +149,14 @@ typedef struct
 
 int changeValueByType(int i);
 
-static validation fields_[256];
-static int nFields_ = 0;
-static int currentDisplay_ = 0;
+/**
+ ** The table points into the globals it was loaded from, which
+ ** are those of the context bound on the thread (see
+ ** SimulationContext.h), so it is kept per thread as g is
+ **/
+static OS_THREAD_LOCAL validation fields_[256];
+static OS_THREAD_LOCAL int nFields_ = 0;
+static OS_THREAD_LOCAL int currentDisplay_ = 0;
 
 static void charValueN(
 	char *data,
@@ -558,6 +563,12 @@ void loadValues(struct globals *g)
 			    "Use Last Muscle?", booleanTypes);
 		enumValue(&g->use_old_firing_times, "useOldFiringTimes",
 			    "Re-use the old firing times?", booleanTypes);
+		enumValue(&g->write_firing_files, "writeFiringFiles",
+			    "Export firing times (FTMU) for re-use?", booleanTypes);
+		enumValue(&g->write_muscle_text, "writeMuscleText",
+			    "Export muscle layout as text (MF/MU.dat)?", booleanTypes);
+		enumValue(&g->write_run_statistics, "writeRunStatistics",
+			    "Write stage timings (runstats<N>.json)?", booleanTypes);
 
 	}
 	space();
@@ -579,6 +590,16 @@ void loadValues(struct globals *g)
 			    "jitterInterpExp",
 			    "internal interp. factor for jitter");
 
+	intValue(&g->worker_threads, "workerThreads",
+			    "worker threads (0 = one per CPU)");
+	intValue(&g->random_seed, "randomSeed",
+			    "random seed (0 = seed from the clock)");
+
+	floatValue(&g->MFAP_reuse_tolerance, "MFAPReuseTolerance",
+			    "needle sweep MFAP reuse (fraction of distance)");
+	intValue(&g->MFAP_cache_size_in_MB, "MFAPCacheSize",
+			    "needle sweep MFAP cache size (in MB)");
+
 	space();
 
 	floatValue(&g->muscle_->fibreDensity,
@@ -1229,6 +1250,18 @@ dumpGlobalSettings(struct globals *g)
 }
 
 
+/**
+ **    Replace one of the directory names, which are set again
+ **    for each stage of a multi-stage run
+ **/
+static void
+setDirectory(char **directory, char *newValue)
+{
+	if (*directory != NULL)
+		ckfree(*directory);
+	*directory = newValue;
+}
+
 /**
  **    Set up the stuff in the globals structure with info from
  **    the various directory paths
@@ -1257,19 +1290,19 @@ setupGlobalDirectoryInfoForOpen(
 	{
 		slnprintf(tmpBuffer, BUFSIZ, "%s\\%s", path, g->patient_name);
 	}
-	g->muscle_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->muscle_dir, osIndependentPath(tmpBuffer));
 
 	slnprintf(tmpBuffer, BUFSIZ,
 			"%s\\%s", g->muscle_dir, g->firings_dir_sub);
-	g->firings_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->firings_dir, osIndependentPath(tmpBuffer));
 
 	slnprintf(tmpBuffer, BUFSIZ,
 			"%s\\%s", g->muscle_dir, g->MUPs_dir_sub);
-	g->MUPs_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->MUPs_dir, osIndependentPath(tmpBuffer));
 
 	slnprintf(tmpBuffer, BUFSIZ,
 			"%s\\%s", g->muscle_dir, g->output_dir_sub);
-	g->output_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->output_dir, osIndependentPath(tmpBuffer));
 
 
 	return 1;
@@ -1296,16 +1329,26 @@ saveGlobalDirectoryInfo(struct globals *g, const char *userPathBase)
 		pathBase = userPathBase;
 	}
 
+	/**
+	 * the run catalogue hands out the ID without listing the
+	 * output stem, and never gives two runs the same one; the
+	 * listing is only used if the catalogue cannot be
+	 */
 	slnprintf(tmpBuffer, BUFSIZ, "%s*", pathBase);
-	dirList = dirListLoadEntries(g->output_stem, tmpBuffer);
-	if (dirList == NULL)
-	{
-		id = 0;
-	} else
+	id = runCatalogNextId(g->output_stem, tmpBuffer, 0);
+	if (id < 0)
 	{
-		id = dirList->n_entries;
-		dirListDelete(dirList);
+		dirList = dirListLoadEntries(g->output_stem, tmpBuffer);
+		if (dirList == NULL)
+		{
+			id = 0;
+		} else
+		{
+			id = dirList->n_entries;
+			dirListDelete(dirList);
+		}
 	}
+	g->run_id = id;
 
 
 
@@ -1338,23 +1381,25 @@ saveGlobalDirectoryInfo(struct globals *g, const char *userPathBase)
 			    g->patient_name);
 #endif
 
-	g->muscle_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->muscle_dir, osIndependentPath(tmpBuffer));
 	updateAttVal(g->list_,
 			    createStringAttribute("LAST_OUTPUT",
 			    g->muscle_dir));
+	updateAttVal(g->list_,
+			    createIntegerAttribute("LAST_RUN_ID", id));
 
 
 	slnprintf(tmpBuffer, BUFSIZ,
 				"%s\\%s", g->muscle_dir, g->firings_dir_sub);
-	g->firings_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->firings_dir, osIndependentPath(tmpBuffer));
 
 	slnprintf(tmpBuffer, BUFSIZ,
 				"%s\\%s", g->muscle_dir, g->MUPs_dir_sub);
-	g->MUPs_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->MUPs_dir, osIndependentPath(tmpBuffer));
 
 	slnprintf(tmpBuffer, BUFSIZ,
 				"%s\\%s", g->muscle_dir, g->output_dir_sub);
-	g->output_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->output_dir, osIndependentPath(tmpBuffer));
 
 
 	return 1;
@@ -1415,21 +1460,27 @@ reuseGlobalDirectoryInfo(struct globals *g)
 		return 0;
 	} else
 	{
-		g->muscle_dir = ckstrdup(item->data_.strptr_);
+		setDirectory(&g->muscle_dir, ckstrdup(item->data_.strptr_));
 	}
 
+	item = getAttVal(g->list_, "LAST_RUN_ID");
+	if (item != NULL && item->type_ == TT_INTEGER)
+		g->run_id = item->data_.ival_;
+	else
+		g->run_id = (-1);
+
 
 	slnprintf(tmpBuffer, BUFSIZ,
 			"%s\\%s", g->muscle_dir, g->firings_dir_sub);
-	g->firings_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->firings_dir, osIndependentPath(tmpBuffer));
 
 	slnprintf(tmpBuffer, BUFSIZ,
 			"%s\\%s", g->muscle_dir, g->MUPs_dir_sub);
-	g->MUPs_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->MUPs_dir, osIndependentPath(tmpBuffer));
 
 	slnprintf(tmpBuffer, BUFSIZ,
 			"%s\\%s", g->muscle_dir, g->output_dir_sub);
-	g->output_dir = osIndependentPath(tmpBuffer);
+	setDirectory(&g->output_dir, osIndependentPath(tmpBuffer));
 
 	LogInfo("Set output_dir to '%s'\n", g->output_dir);
 